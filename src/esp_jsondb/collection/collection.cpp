@@ -2,17 +2,57 @@
 #include "../db.h"
 #include "../db_runtime.h"
 #include "../utils/fs_utils.h"
+#include "../utils/op_stats.h"
 #include "../utils/time_utils.h"
 
 #include <algorithm>
 #include <cstdio>
+#include <new>
+
+#if ESP_JSONDB_HAS_ESP32_HEAP_CAPS && __has_include(<esp_memory_utils.h>)
+#include <esp_memory_utils.h>
+#define ESP_JSONDB_HAS_PTR_PLACEMENT 1
+#elif ESP_JSONDB_HAS_ESP32_HEAP_CAPS && __has_include(<soc/soc_memory_layout.h>)
+#include <soc/soc_memory_layout.h>
+#define ESP_JSONDB_HAS_PTR_PLACEMENT 1
+#else
+#define ESP_JSONDB_HAS_PTR_PLACEMENT 0
+#endif
 
 namespace {
-std::shared_ptr<DocumentRecord> makeSharedDocumentRecord(bool usePSRAMBuffers) {
-	return std::allocate_shared<DocumentRecord>(
-	    JsonDbAllocator<DocumentRecord>(usePSRAMBuffers),
-	    usePSRAMBuffers
-	);
+bool hasPsram() {
+#if ESP_JSONDB_HAS_ESP32_HEAP_CAPS
+	return heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+#else
+	return false;
+#endif
+}
+
+// Where a payload really is. heap_caps allocations fall back to internal RAM
+// when PSRAM runs short, so the allocator's flag is only the intent.
+bool isInPsram(const JsonDbVector<uint8_t> &buffer) {
+#if ESP_JSONDB_HAS_PTR_PLACEMENT
+	return !buffer.empty() && esp_ptr_external_ram(buffer.data());
+#else
+	return !buffer.empty() && buffer.get_allocator().usePSRAMBuffers() && hasPsram();
+#endif
+}
+
+// Rebuilds `container` around `alloc`, copying its elements into memory from
+// that allocator. JsonDbAllocator does not propagate on move or swap, so a
+// container otherwise keeps the placement it was constructed with.
+template <typename Container>
+void rebuildWithAllocator(Container &container, const typename Container::allocator_type &alloc) {
+	Container rebuilt(std::move(container), alloc);
+	container.~Container();
+	new (&container) Container(std::move(rebuilt));
+}
+
+// Tier passes group records by the bit length of their LRU age.
+constexpr size_t kAgeGroups = 33;
+
+size_t ageGroup(uint32_t age) {
+	return age == 0 ? 0 : 32 - static_cast<size_t>(__builtin_clz(age));
 }
 
 using DocumentRecordPtr = std::shared_ptr<DocumentRecord>;
@@ -29,25 +69,83 @@ using UniqueIndexMap = std::map<
     UniqueValueMap,
     std::less<std::string>,
     JsonDbAllocator<std::pair<const std::string, UniqueValueMap>>>;
+
+// Fields that get an entry in the unique indexes.
+bool isIndexedUnique(const SchemaField &field) {
+	return field.unique && field.type != FieldType::Object && field.type != FieldType::Array;
+}
+
+// DocumentHeader without the id, which knownIds already holds.
+struct ResidentHeader {
+	uint64_t createdAtMs = 0;
+	uint64_t updatedAtMs = 0;
+	uint32_t revision = 0;
+	uint32_t payloadSize = 0;
+	uint16_t flags = 0;
+	bool known = false; // false until the record has been read once
+};
+
+DocumentHeader headerOf(const DocumentRecord &rec) {
+	DocumentHeader h;
+	h.id = rec.meta.id;
+	h.createdAtMs = rec.meta.createdAtMs;
+	h.updatedAtMs = rec.meta.updatedAtMs;
+	h.revision = rec.meta.revision;
+	h.flags = rec.meta.flags;
+	h.payloadSize = static_cast<uint32_t>(rec.msgpack.size());
+	return h;
+}
+
+ResidentHeader residentOf(const DocumentHeader &h) {
+	ResidentHeader r;
+	r.createdAtMs = h.createdAtMs;
+	r.updatedAtMs = h.updatedAtMs;
+	r.revision = h.revision;
+	r.payloadSize = h.payloadSize;
+	r.flags = h.flags;
+	r.known = true;
+	return r;
+}
+
+DocumentHeader headerOf(const DocId &id, const ResidentHeader &r) {
+	DocumentHeader h;
+	h.id = id;
+	h.createdAtMs = r.createdAtMs;
+	h.updatedAtMs = r.updatedAtMs;
+	h.revision = r.revision;
+	h.flags = r.flags;
+	h.payloadSize = r.payloadSize;
+	return h;
+}
 } // namespace
 
 struct CollectionStore {
 	DocumentMap docs;
-	JsonDbVector<DocId> deletedIds;
+	JsonDbVector<Tombstone> deletedIds; // removals not yet on the filesystem
 	JsonDbVector<DocId> knownIds;
+	// Index-aligned with knownIds under CollectionConfig::residentHeaders,
+	// empty otherwise.
+	JsonDbVector<ResidentHeader> knownHeaders;
 	DbRuntime *rt = nullptr;
 	std::string name;
 	Schema schema;
 	CollectionConfig config{};
 	bool dirty = false;
-	FrMutex mu;
+	// Lookups, scans and pins share `mu`; anything that changes the maps,
+	// indexes or record contents takes it exclusively.
+	FrRwLock mu;
+	FrMutex flushMu; // orders flushDirtyToFs and write-through; taken before mu
 	std::string baseDir;
 	bool usePSRAMBuffers = false;
 	fs::FS *fs = nullptr;
 	RecordStore recordStore;
+	TombstoneLog tombstoneLog;
 	UniqueIndexMap uniqueIndexes;
-	uint64_t accessClock = 0;
-	size_t activeDecodedViews = 0;
+	std::atomic<uint32_t> accessClock{0};
+	std::atomic<size_t> activeDecodedViews{0};
+	Collection::TierStats tiers;
+	CollectionOpStats opStats;
+	uint32_t tierPassSeq = 0; // accessClock at the last tier pass
 
 	CollectionStore(
 	    DbRuntime &rtRef,
@@ -59,14 +157,17 @@ struct CollectionStore {
 	    fs::FS &filesystem
 	)
 	    : docs(DocumentMap(DocIdLess{}, DocumentMapAllocator(psram))),
-	      deletedIds(JsonDbAllocator<DocId>(psram)), knownIds(JsonDbAllocator<DocId>(psram)),
-	      rt(&rtRef), name(collectionName), schema(collectionSchema), config(collectionConfig),
+	      deletedIds(JsonDbAllocator<Tombstone>(psram)), knownIds(JsonDbAllocator<DocId>(psram)),
+	      knownHeaders(JsonDbAllocator<ResidentHeader>(psram)), rt(&rtRef), name(collectionName),
+	      schema(collectionSchema), config(collectionConfig),
 	      baseDir(std::move(baseDirValue)), usePSRAMBuffers(psram), fs(&filesystem),
-	      recordStore(filesystem, psram),
+	      recordStore(filesystem, psram), tombstoneLog(filesystem, psram),
 	      uniqueIndexes(
 	          std::less<std::string>{},
 	          JsonDbAllocator<std::pair<const std::string, UniqueValueMap>>(psram)
 	      ) {
+		mu.setName("collection:", name.c_str());
+		flushMu.setName("collectionFlush:", name.c_str());
 	}
 };
 
@@ -84,6 +185,8 @@ Collection::Collection(
               rt, name, schema, std::move(baseDir), config, usePSRAMBuffers, fs
           )
       ) {
+	FrWriteLock lk(_store->mu);
+	rehomeIndexesLocked();
 }
 
 Collection::~Collection() = default;
@@ -100,7 +203,9 @@ Collection::~Collection() = default;
 #define _usePSRAMBuffers (_store->usePSRAMBuffers)
 #define _fs (_store->fs)
 #define _recordStore (_store->recordStore)
+#define _tombstoneLog (_store->tombstoneLog)
 #define _uniqueIndexes (_store->uniqueIndexes)
+#define _opStats (_store->opStats)
 
 const std::string &Collection::name() const {
 	return _name;
@@ -123,20 +228,30 @@ size_t Collection::size() const {
 }
 
 void Collection::markAllRemoved() {
-	FrLock lk(_mu);
+	FrWriteLock lk(_mu);
 	for (auto &kv : _docs) {
 		kv.second->meta.removed = true;
 	}
 }
 
 void Collection::setConfig(const CollectionConfig &config) {
-	FrLock lk(_mu);
-	_config = config;
-	(void)ensureResidentCapacityLocked(0);
+	bool pending = false;
+	{
+		FrWriteLock lk(_mu);
+		_config = config;
+		syncResidentHeadersLocked();
+		rehomeIndexesLocked();
+		rebalanceTiersLocked();
+		(void)ensureResidentCapacityLocked(0);
+		pending = _dirty && config.durability != CollectionDurability::Deferred;
+	}
+	// Changes held back under a previous Deferred setting become flushable now.
+	if (pending && _rt)
+		_rt->noteDirtyData();
 }
 
 void Collection::setSchema(const Schema &schema) {
-	FrLock lk(_mu);
+	FrWriteLock lk(_mu);
 	_schema = schema;
 	(void)rebuildUniqueIndexesLocked();
 }
@@ -166,22 +281,48 @@ bool Collection::isDecodedBudgetEnforced() const {
 }
 
 void Collection::touchRecordLocked(const std::shared_ptr<DocumentRecord> &rec) {
+	// Safe under the shared lock: both counters are atomic.
 	if (!rec)
 		return;
-	rec->lastAccessSeq = ++_store->accessClock;
+	rec->lastAccessSeq.store(
+	    _store->accessClock.fetch_add(1, std::memory_order_relaxed) + 1,
+	    std::memory_order_relaxed
+	);
 }
 
 void Collection::rememberKnownIdLocked(const DocId &id) {
 	if (!containsKnownIdLocked(id)) {
 		_store->knownIds.push_back(id);
+		if (_config.residentHeaders)
+			_store->knownHeaders.emplace_back();
 	}
 }
 
 void Collection::forgetKnownIdLocked(const DocId &id) {
-	_store->knownIds.erase(
-	    std::remove(_store->knownIds.begin(), _store->knownIds.end(), id),
-	    _store->knownIds.end()
-	);
+	auto &ids = _store->knownIds;
+	auto it = std::find(ids.begin(), ids.end(), id);
+	if (it == ids.end())
+		return;
+	if (_config.residentHeaders)
+		_store->knownHeaders.erase(_store->knownHeaders.begin() + (it - ids.begin()));
+	ids.erase(it);
+}
+
+void Collection::syncResidentHeadersLocked() {
+	if (_config.residentHeaders) {
+		_store->knownHeaders.resize(_store->knownIds.size());
+		return;
+	}
+	JsonDbVector<ResidentHeader>(_store->knownHeaders.get_allocator()).swap(_store->knownHeaders);
+}
+
+void Collection::storeHeaderLocked(const DocumentRecord &rec) {
+	if (!_config.residentHeaders)
+		return;
+	auto &ids = _store->knownIds;
+	auto it = std::find(ids.begin(), ids.end(), rec.meta.id);
+	if (it != ids.end())
+		_store->knownHeaders[it - ids.begin()] = residentOf(headerOf(rec));
 }
 
 bool Collection::containsKnownIdLocked(const DocId &id) const {
@@ -195,21 +336,27 @@ DbStatus Collection::ensureResidentCapacityLocked(size_t additional, const DocId
 
 	while ((_docs.size() + additional) > _config.maxRecordsInMemory) {
 		auto victimIt = _docs.end();
-		uint64_t oldestSeq = UINT64_MAX;
+		// Compare ages rather than raw sequence numbers so the 32-bit clock
+		// can wrap without upsetting the LRU order.
+		const uint32_t now = _store->accessClock.load(std::memory_order_relaxed);
+		uint32_t oldestAge = 0;
 		for (auto it = _docs.begin(); it != _docs.end(); ++it) {
 			const auto &rec = it->second;
-			if (!rec || rec->meta.dirty || rec->meta.removed || rec->pinCount > 0)
+			if (!rec || rec->meta.dirty || rec->meta.removed ||
+			    rec->pinCount.load(std::memory_order_acquire) > 0)
 				continue;
 			if (protectId && it->first == *protectId)
 				continue;
-			if (rec->lastAccessSeq < oldestSeq) {
-				oldestSeq = rec->lastAccessSeq;
+			const uint32_t age = now - rec->lastAccessSeq.load(std::memory_order_relaxed);
+			if (victimIt == _docs.end() || age > oldestAge) {
+				oldestAge = age;
 				victimIt = it;
 			}
 		}
 		if (victimIt == _docs.end()) {
 			return {DbStatusCode::Busy, "record memory budget exceeded"};
 		}
+		storeHeaderLocked(*victimIt->second);
 		_docs.erase(victimIt);
 	}
 	return {DbStatusCode::Ok, ""};
@@ -218,7 +365,7 @@ DbStatus Collection::ensureResidentCapacityLocked(size_t additional, const DocId
 DbResult<std::shared_ptr<DocumentRecord>> Collection::ensureRecordLoaded(const DocId &id) {
 	DbResult<std::shared_ptr<DocumentRecord>> res{};
 	{
-		FrLock lk(_mu);
+		FrReadLock lk(_mu);
 		auto it = _docs.find(id);
 		if (it != _docs.end()) {
 			touchRecordLocked(it->second);
@@ -239,7 +386,7 @@ DbResult<std::shared_ptr<DocumentRecord>> Collection::ensureRecordLoaded(const D
 	}
 
 	{
-		FrLock lk(_mu);
+		FrWriteLock lk(_mu);
 		auto existing = _docs.find(id);
 		if (existing != _docs.end()) {
 			touchRecordLocked(existing->second);
@@ -261,11 +408,161 @@ DbResult<std::shared_ptr<DocumentRecord>> Collection::ensureRecordLoaded(const D
 	return res;
 }
 
+bool Collection::isTieringEnabled() const {
+	return _config.hotTierBytes > 0;
+}
+
+bool Collection::isTierPassDueLocked() const {
+	if (!isTieringEnabled())
+		return false;
+	const uint32_t now = _store->accessClock.load(std::memory_order_relaxed);
+	return now - _store->tierPassSeq >= kTierPassInterval;
+}
+
+void Collection::rebalanceTiersLocked() {
+	auto &tiers = _store->tiers;
+	const bool enabled = isTieringEnabled();
+	// Without tiering every payload goes back to where usePSRAMBuffers puts
+	// it; nothing to do if tiering never ran.
+	if (!enabled && tiers.passes == 0)
+		return;
+	const uint32_t now = _store->accessClock.load(std::memory_order_relaxed);
+	_store->tierPassSeq = now;
+	++tiers.passes;
+	auto groupOf = [now](const DocumentRecord &rec) {
+		return ageGroup(now - rec.lastAccessSeq.load(std::memory_order_relaxed));
+	};
+
+	// Approximate LRU: the hot budget is filled from the youngest age group
+	// up. Records in the group where it runs out stay hot while they fit, in
+	// map order. Without PSRAM nothing is moved.
+	size_t groupBytes[kAgeGroups] = {};
+	for (const auto &kv : _docs) {
+		if (kv.second)
+			groupBytes[groupOf(*kv.second)] += kv.second->msgpack.size();
+	}
+	size_t hotRoom = _config.hotTierBytes;
+	size_t hotGroups = 0;
+	while (hotGroups < kAgeGroups && groupBytes[hotGroups] <= hotRoom)
+		hotRoom -= groupBytes[hotGroups++];
+
+	// Pinned records may be decoding from their buffer right now and keep it
+	// where it is. Bytes are counted where they really are.
+	const bool canMove = hasPsram();
+	size_t hotBytes = 0;
+	size_t coldBytes = 0;
+	uint32_t hotRecords = 0;
+	uint32_t coldRecords = 0;
+	size_t evictableBytes[kAgeGroups] = {};
+	for (auto &kv : _docs) {
+		if (!kv.second)
+			continue;
+		DocumentRecord &rec = *kv.second;
+		const size_t bytes = rec.msgpack.size();
+		const size_t group = groupOf(rec);
+		bool toPsram = _usePSRAMBuffers;
+		if (enabled) {
+			toPsram = group > hotGroups || (group == hotGroups && bytes > hotRoom);
+			if (group == hotGroups && !toPsram)
+				hotRoom -= bytes;
+		}
+		const bool pinned = rec.pinCount.load(std::memory_order_acquire) > 0;
+		const bool wasInPsram = isInPsram(rec.msgpack);
+		if (canMove && !pinned && toPsram != rec.msgpack.get_allocator().usePSRAMBuffers())
+			rebuildWithAllocator(rec.msgpack, JsonDbAllocator<uint8_t>(toPsram));
+		const bool inPsram = isInPsram(rec.msgpack);
+		if (enabled && inPsram != wasInPsram)
+			++(inPsram ? tiers.demotions : tiers.promotions);
+		if (inPsram) {
+			coldBytes += bytes;
+			++coldRecords;
+			if (!rec.meta.dirty && !rec.meta.removed && !pinned)
+				evictableBytes[group] += bytes;
+		} else {
+			hotBytes += bytes;
+			++hotRecords;
+		}
+	}
+
+	// Evicted records are read back from their files, so only clean ones of
+	// a collection that loads on demand can go, oldest age groups first.
+	const bool canEvict = _config.loadPolicy == CollectionLoadPolicy::Lazy ||
+	                      _config.loadPolicy == CollectionLoadPolicy::Delayed;
+	if (enabled && canEvict && _config.coldTierBytes > 0 && coldBytes > _config.coldTierBytes) {
+		size_t excess = coldBytes - _config.coldTierBytes;
+		size_t oldestKept = kAgeGroups;
+		for (size_t planned = 0; oldestKept > 0 && planned < excess;)
+			planned += evictableBytes[--oldestKept];
+		for (auto it = _docs.begin(); it != _docs.end() && excess > 0;) {
+			const auto &rec = it->second;
+			if (!rec || groupOf(*rec) < oldestKept || !isInPsram(rec->msgpack) ||
+			    rec->meta.dirty || rec->meta.removed ||
+			    rec->pinCount.load(std::memory_order_acquire) > 0) {
+				++it;
+				continue;
+			}
+			const size_t bytes = rec->msgpack.size();
+			excess -= std::min(excess, bytes);
+			coldBytes -= bytes;
+			--coldRecords;
+			++tiers.evictions;
+			storeHeaderLocked(*rec);
+			it = _docs.erase(it);
+		}
+	}
+	tiers.hotBytes = hotBytes;
+	tiers.coldBytes = coldBytes;
+	tiers.hotRecords = hotRecords;
+	tiers.coldRecords = coldRecords;
+}
+
+void Collection::rehomeIndexesLocked() {
+	// Lookups walk these on every access, so tiering keeps them internal.
+	const bool psram = _usePSRAMBuffers && !isTieringEnabled();
+	auto rehome = [psram](auto &container) {
+		using Container = std::decay_t<decltype(container)>;
+		if (container.get_allocator().usePSRAMBuffers() != psram)
+			rebuildWithAllocator(container, typename Container::allocator_type(psram));
+	};
+	rehome(_docs);
+	rehome(_store->knownIds);
+	rehome(_store->knownHeaders);
+	rehome(_uniqueIndexes);
+}
+
+void Collection::opStatsToJson(JsonObject out) const {
+#if ESP_JSONDB_OP_STATS
+	g_opStats.collectionToJson(_opStats, out);
+#else
+	(void)out;
+#endif
+}
+
+Collection::TierStats Collection::tierStats() const {
+	FrReadLock lk(_mu);
+	return _store->tiers;
+}
+
+void Collection::rebalanceTiers() {
+	FrWriteLock lk(_mu);
+	rebalanceTiersLocked();
+}
+
+void Collection::rebalanceTiersIfDue() {
+	{
+		FrReadLock lk(_mu);
+		if (!isTierPassDueLocked())
+			return;
+	}
+	FrWriteLock lk(_mu);
+	if (isTierPassDueLocked())
+		rebalanceTiersLocked();
+}
+
 DbStatus Collection::pinRecord(const std::shared_ptr<DocumentRecord> &rec) {
 	if (!rec)
 		return {DbStatusCode::Ok, ""};
-	FrLock lk(_mu);
-	++rec->pinCount;
+	rec->pinCount.fetch_add(1, std::memory_order_acq_rel);
 	touchRecordLocked(rec);
 	return {DbStatusCode::Ok, ""};
 }
@@ -273,28 +570,32 @@ DbStatus Collection::pinRecord(const std::shared_ptr<DocumentRecord> &rec) {
 void Collection::unpinRecord(const std::shared_ptr<DocumentRecord> &rec) {
 	if (!rec)
 		return;
-	FrLock lk(_mu);
-	if (rec->pinCount > 0)
-		--rec->pinCount;
+	uint32_t pins = rec->pinCount.load(std::memory_order_acquire);
+	while (pins > 0 &&
+	       !rec->pinCount.compare_exchange_weak(pins, pins - 1, std::memory_order_acq_rel)) {
+	}
 }
 
 DbStatus Collection::acquireDecodedViewSlot() {
 	if (!isDecodedBudgetEnforced())
 		return {DbStatusCode::Ok, ""};
-	FrLock lk(_mu);
-	if (_store->activeDecodedViews >= _config.maxDecodedViews) {
-		return {DbStatusCode::Busy, "decoded view budget exceeded"};
-	}
-	++_store->activeDecodedViews;
+	size_t active = _store->activeDecodedViews.load(std::memory_order_acquire);
+	do {
+		if (active >= _config.maxDecodedViews) {
+			return {DbStatusCode::Busy, "decoded view budget exceeded"};
+		}
+	} while (!_store->activeDecodedViews
+	              .compare_exchange_weak(active, active + 1, std::memory_order_acq_rel));
 	return {DbStatusCode::Ok, ""};
 }
 
 void Collection::releaseDecodedViewSlot() {
 	if (!isDecodedBudgetEnforced())
 		return;
-	FrLock lk(_mu);
-	if (_store->activeDecodedViews > 0)
-		--_store->activeDecodedViews;
+	size_t active = _store->activeDecodedViews.load(std::memory_order_acquire);
+	while (active > 0 && !_store->activeDecodedViews
+	                          .compare_exchange_weak(active, active - 1, std::memory_order_acq_rel)) {
+	}
 }
 
 std::string Collection::collectionDir() const {
@@ -335,16 +636,23 @@ DbStatus Collection::addUniqueValuesLocked(JsonObjectConst obj, const DocId &id)
 	for (const auto &field : _schema.fields) {
 		if (!field.unique || field.type == FieldType::Object || field.type == FieldType::Array)
 			continue;
-		const auto key = uniqueValueKey(field, obj[field.name]);
-		if (key.empty())
-			continue;
-		auto &fieldIndex = _uniqueIndexes[field.name ? field.name : ""];
-		auto it = fieldIndex.find(key);
-		if (it != fieldIndex.end() && it->second != id) {
-			return {DbStatusCode::ValidationFailed, "unique constraint violated"};
-		}
-		fieldIndex[key] = id;
+		auto st = addUniqueKeyLocked(field, uniqueValueKey(field, obj[field.name]), id);
+		if (!st.ok())
+			return st;
+	}
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus
+Collection::addUniqueKeyLocked(const SchemaField &field, const std::string &key, const DocId &id) {
+	if (key.empty())
+		return {DbStatusCode::Ok, ""};
+	auto &fieldIndex = _uniqueIndexes[field.name ? field.name : ""];
+	auto it = fieldIndex.find(key);
+	if (it != fieldIndex.end() && it->second != id) {
+		return {DbStatusCode::ValidationFailed, "unique constraint violated"};
 	}
+	fieldIndex[key] = id;
 	return {DbStatusCode::Ok, ""};
 }
 
@@ -371,19 +679,25 @@ void Collection::removeUniqueValuesLocked(JsonObjectConst obj, const DocId &id)
 
 DbStatus Collection::rebuildUniqueIndexesLocked() {
 	_uniqueIndexes.clear();
+	JsonDbDocArena arena(_usePSRAMBuffers);
 	for (const auto &kv : _docs) {
-		JsonDocument doc;
 		if (!kv.second || kv.second->msgpack.empty()) {
 			continue;
 		}
-		auto err = deserializeMsgPack(doc, kv.second->msgpack.data(), kv.second->msgpack.size());
-		if (err) {
-			return {
-			    DbStatusCode::CorruptionDetected,
-			    "msgpack decode failed while rebuilding index"
-			};
+		DbStatus st{DbStatusCode::Ok, ""};
+		{
+			JsonDocument doc(&arena);
+			auto err =
+			    deserializeMsgPack(doc, kv.second->msgpack.data(), kv.second->msgpack.size());
+			if (err) {
+				return {
+				    DbStatusCode::CorruptionDetected,
+				    "msgpack decode failed while rebuilding index"
+				};
+			}
+			st = addUniqueValuesLocked(doc.as<JsonObjectConst>(), kv.first);
 		}
-		auto st = addUniqueValuesLocked(doc.as<JsonObjectConst>(), kv.first);
+		arena.reset();
 		if (!st.ok())
 			return st;
 	}
@@ -420,6 +734,7 @@ DbStatus Collection::checkUniqueFields(JsonObjectConst obj, const DocId *selfId)
 }
 
 DbResult<std::string> Collection::create(JsonObjectConst data) {
+	OpTimer timer(DbOp::Create, &_opStats);
 	DbResult<std::string> res{};
 	JsonDocument workDoc;
 	workDoc.set(data);
@@ -436,7 +751,7 @@ DbResult<std::string> Collection::create(JsonObjectConst data) {
 	std::shared_ptr<DocumentRecord> rec;
 	std::string id;
 	{
-		FrLock lk(_mu);
+		FrWriteLock lk(_mu);
 		// Enforce unique constraints before creating the record
 		auto ust = checkUniqueFields(obj, nullptr);
 		if (!ust.ok()) {
@@ -444,7 +759,7 @@ DbResult<std::string> Collection::create(JsonObjectConst data) {
 			recordStatus(res.status);
 			return res;
 		}
-		rec = makeSharedDocumentRecord(_usePSRAMBuffers);
+		rec = makeDocumentRecord(_usePSRAMBuffers);
 		rec->meta.createdAtMs = nowUtcMs();
 		rec->meta.updatedAtMs = rec->meta.createdAtMs;
 		rec->meta.id = ObjectId().toDocId();
@@ -461,6 +776,7 @@ DbResult<std::string> Collection::create(JsonObjectConst data) {
 			recordStatus(res.status);
 			return res;
 		}
+		timer.addBytes(sz);
 
 		id = rec->meta.id.c_str();
 		auto cap = ensureResidentCapacityLocked(1, &rec->meta.id);
@@ -477,6 +793,7 @@ DbResult<std::string> Collection::create(JsonObjectConst data) {
 			recordStatus(res.status);
 			return res;
 		}
+		rec->commitSeq = stampLocked(rec->meta.id, nullptr);
 		_dirty = true;
 
 		res.status = {DbStatusCode::Ok, ""};
@@ -487,6 +804,9 @@ DbResult<std::string> Collection::create(JsonObjectConst data) {
 	if (emit) {
 		if (_rt)
 			_rt->noteDocumentCreated(_name);
+		auto durable = afterCommit(rec);
+		if (!durable.ok())
+			res.status = durable;
 		emitEvent(DBEventType::DocumentCreated);
 	}
 	return res;
@@ -507,6 +827,7 @@ DbResult<std::vector<std::string>> Collection::createMany(JsonArrayConst arr) {
 	std::vector<std::string> ids;
 	ids.reserve(arr.size());
 
+	BatchScope batch(*this);
 	for (auto v : arr) {
 		if (!v.is<JsonObjectConst>()) {
 			// Skip non-object entries
@@ -535,6 +856,7 @@ DbResult<std::vector<std::string>> Collection::createMany(const JsonDocument &ar
 }
 
 DbResult<DocView> Collection::findById(const std::string &id) {
+	OpTimer timer(DbOp::FindById, &_opStats);
 	DocId lookupId;
 	if (!lookupId.assign(id)) {
 		DbStatus st{DbStatusCode::NotFound, "document not found"};
@@ -583,6 +905,7 @@ DbResult<DocView> Collection::findById(const std::string &id) {
 }
 
 DbResult<std::vector<DocView>> Collection::findMany(std::function<bool(const DocView &)> pred) {
+	OpTimer timer(DbOp::FindMany, &_opStats);
 	DbResult<std::vector<DocView>> res{};
 	auto idsRes = collectMatchingIds(std::move(pred));
 	if (!idsRes.status.ok()) {
@@ -600,7 +923,53 @@ DbResult<std::vector<DocView>> Collection::findMany(std::function<bool(const Doc
 	return res;
 }
 
+DbResult<std::vector<DocumentHeader>>
+Collection::findHeaders(std::function<bool(const DocumentHeader &)> pred) {
+	DbResult<std::vector<DocumentHeader>> res{};
+	std::vector<DocumentHeader> headers;
+	JsonDbVector<DocId> unknown{JsonDbAllocator<DocId>(_usePSRAMBuffers)};
+	{
+		FrReadLock lk(_mu);
+		const auto &ids = _store->knownIds;
+		const auto &known = _store->knownHeaders;
+		const bool resident = _config.residentHeaders && known.size() == ids.size();
+		headers.reserve(ids.size());
+		for (size_t i = 0; i < ids.size(); ++i) {
+			// Resident records carry the newest metadata, dirty or not.
+			auto it = _docs.find(ids[i]);
+			if (it != _docs.end()) {
+				if (!it->second->meta.removed)
+					headers.push_back(headerOf(*it->second));
+			} else if (resident && known[i].known) {
+				headers.push_back(headerOf(ids[i], known[i]));
+			} else {
+				unknown.push_back(ids[i]);
+			}
+		}
+	}
+	// Read the rest without caching them; only the header is kept.
+	for (const auto &id : unknown) {
+		auto rr = readDocFromFile(_baseDir, id.c_str());
+		if (!rr.status.ok() || !rr.value)
+			continue;
+		headers.push_back(headerOf(*rr.value));
+		if (_config.residentHeaders) {
+			FrWriteLock lk(_mu);
+			if (_docs.find(id) == _docs.end())
+				storeHeaderLocked(*rr.value);
+		}
+	}
+	for (auto &h : headers) {
+		if (!pred || pred(h))
+			res.value.push_back(std::move(h));
+	}
+	res.status = {DbStatusCode::Ok, ""};
+	recordStatus(res.status);
+	return res;
+}
+
 DbResult<DocView> Collection::findOne(std::function<bool(const DocView &)> pred) {
+	OpTimer timer(DbOp::FindOne, &_opStats);
 	auto idsRes = collectMatchingIds(std::move(pred));
 	if (!idsRes.status.ok()) {
 		return {
@@ -667,9 +1036,11 @@ Collection::collectMatchingIds(std::function<bool(const DocView &)> pred) {
 	res.value = JsonDbVector<DocId>(JsonDbAllocator<DocId>(_usePSRAMBuffers));
 	JsonDbVector<DocId> ids{JsonDbAllocator<DocId>(_usePSRAMBuffers)};
 	{
-		FrLock lk(_mu);
+		FrReadLock lk(_mu);
 		ids = _store->knownIds;
 	}
+	// Every candidate decodes into the same arena, rewound after each one.
+	JsonDbDocArena arena(_usePSRAMBuffers);
 	for (const auto &id : ids) {
 		auto loaded = ensureRecordLoaded(id);
 		if (!loaded.status.ok()) {
@@ -681,7 +1052,7 @@ Collection::collectMatchingIds(std::function<bool(const DocView &)> pred) {
 		}
 		bool matched = false;
 		{
-			FrLock lk(_mu);
+			FrReadLock lk(_mu);
 			auto it = _docs.find(id);
 			if (it == _docs.end())
 				continue;
@@ -699,8 +1070,10 @@ Collection::collectMatchingIds(std::function<bool(const DocView &)> pred) {
 			    false,
 			    _usePSRAMBuffers
 			);
+			v.useArena(&arena);
 			matched = !pred || pred(v);
 		}
+		arena.reset();
 		if (matched) {
 			res.value.push_back(id);
 		}
@@ -718,6 +1091,7 @@ DbStatus Collection::updateOne(
 
 	bool updated = false;
 	bool created = false;
+	std::shared_ptr<DocumentRecord> createdRec;
 	DbStatus st{DbStatusCode::NotFound, "document not found"};
 	if (!matches.value.empty()) {
 		st = updateByIdWithDecision(
@@ -731,7 +1105,7 @@ DbStatus Collection::updateOne(
 	}
 
 	if (!updated && create) {
-		auto rec = makeSharedDocumentRecord(_usePSRAMBuffers);
+		auto rec = makeDocumentRecord(_usePSRAMBuffers);
 		rec->meta.createdAtMs = nowUtcMs();
 		rec->meta.updatedAtMs = rec->meta.createdAtMs;
 		rec->meta.id = ObjectId().toDocId();
@@ -772,15 +1146,17 @@ DbStatus Collection::updateOne(
 		st = v.commit();
 		if (!st.ok())
 			return recordStatus(st);
-		FrLock lk(_mu);
+		FrWriteLock lk(_mu);
 		auto cap = ensureResidentCapacityLocked(1, &rec->meta.id);
 		if (!cap.ok())
 			return recordStatus(cap);
+		createdRec = rec;
 		_docs.emplace(rec->meta.id, std::move(rec));
 		rememberKnownIdLocked(v.meta().id);
 		auto uniqueStatus = addUniqueValuesLocked(v.asObjectConst(), v.meta().id);
 		if (!uniqueStatus.ok())
 			return recordStatus(uniqueStatus);
+		createdRec->commitSeq = stampLocked(createdRec->meta.id, nullptr);
 		_dirty = true;
 		created = true;
 		st = {DbStatusCode::Ok, ""};
@@ -788,6 +1164,9 @@ DbStatus Collection::updateOne(
 	if (created) {
 		if (_rt)
 			_rt->noteDocumentCreated(_name);
+		auto durable = afterCommit(createdRec);
+		if (!durable.ok())
+			st = durable;
 		emitEvent(DBEventType::DocumentCreated);
 	} else if (updated) {
 		emitEvent(DBEventType::DocumentUpdated);
@@ -809,6 +1188,7 @@ DbStatus Collection::updateOne(const JsonDocument &filter, const JsonDocument &p
 
 	bool updated = false;
 	bool created = false;
+	std::shared_ptr<DocumentRecord> createdRec;
 	DbStatus st{DbStatusCode::NotFound, "document not found"};
 	if (!matches.value.empty()) {
 		st = updateByIdWithDecision(
@@ -825,7 +1205,7 @@ DbStatus Collection::updateOne(const JsonDocument &filter, const JsonDocument &p
 
 	if (!updated && create) {
 		// Create a new document merging filter and patch
-		auto rec = makeSharedDocumentRecord(_usePSRAMBuffers);
+		auto rec = makeDocumentRecord(_usePSRAMBuffers);
 		rec->meta.createdAtMs = nowUtcMs();
 		rec->meta.updatedAtMs = rec->meta.createdAtMs;
 		rec->meta.id = ObjectId().toDocId();
@@ -869,15 +1249,17 @@ DbStatus Collection::updateOne(const JsonDocument &filter, const JsonDocument &p
 		st = v.commit();
 		if (!st.ok())
 			return recordStatus(st);
-		FrLock lk(_mu);
+		FrWriteLock lk(_mu);
 		auto cap = ensureResidentCapacityLocked(1, &rec->meta.id);
 		if (!cap.ok())
 			return recordStatus(cap);
+		createdRec = rec;
 		_docs.emplace(rec->meta.id, std::move(rec));
 		rememberKnownIdLocked(v.meta().id);
 		auto uniqueStatus = addUniqueValuesLocked(v.asObjectConst(), v.meta().id);
 		if (!uniqueStatus.ok())
 			return recordStatus(uniqueStatus);
+		createdRec->commitSeq = stampLocked(createdRec->meta.id, nullptr);
 		_dirty = true;
 		created = true;
 		st = {DbStatusCode::Ok, ""};
@@ -885,6 +1267,9 @@ DbStatus Collection::updateOne(const JsonDocument &filter, const JsonDocument &p
 	if (created) {
 		if (_rt)
 			_rt->noteDocumentCreated(_name);
+		auto durable = afterCommit(createdRec);
+		if (!durable.ok())
+			st = durable;
 		emitEvent(DBEventType::DocumentCreated);
 	} else if (updated) {
 		emitEvent(DBEventType::DocumentUpdated);
@@ -910,6 +1295,7 @@ DbStatus Collection::updateById(const std::string &id, std::function<void(DocVie
 DbStatus Collection::updateByIdWithDecision(
     const std::string &id, std::function<bool(DocView &)> mutator, bool &updated
 ) {
+	OpTimer timer(DbOp::Update, &_opStats);
 	updated = false;
 	DocId lookupId;
 	if (!lookupId.assign(id)) {
@@ -922,9 +1308,11 @@ DbStatus Collection::updateByIdWithDecision(
 
 	std::shared_ptr<DocumentRecord> liveRec;
 	uint32_t startRevision = 0;
-	JsonDocument beforeDoc;
+	// The before image and the working view are gone when this returns.
+	JsonDbDocArena arena(_usePSRAMBuffers);
+	JsonDocument beforeDoc(&arena);
 	{
-		FrLock lk(_mu);
+		FrReadLock lk(_mu);
 		auto it = _docs.find(lookupId);
 		if (it == _docs.end())
 			return recordStatus({DbStatusCode::NotFound, "document not found"});
@@ -942,7 +1330,7 @@ DbStatus Collection::updateByIdWithDecision(
 		}
 	}
 
-	auto candidate = makeSharedDocumentRecord(_usePSRAMBuffers);
+	auto candidate = makeDocumentRecord(_usePSRAMBuffers);
 	candidate->meta = liveRec->meta;
 	candidate->msgpack = liveRec->msgpack;
 	DocView working(
@@ -958,6 +1346,7 @@ DbStatus Collection::updateByIdWithDecision(
 	    false,
 	    _usePSRAMBuffers
 	);
+	working.useArena(&arena);
 	bool shouldCommit = mutator ? mutator(working) : true;
 	if (!shouldCommit) {
 		working.discard();
@@ -975,8 +1364,9 @@ DbStatus Collection::updateByIdWithDecision(
 	if (!st.ok())
 		return recordStatus(st);
 
+	std::shared_ptr<DocumentRecord> committedRec;
 	{
-		FrLock lk(_mu);
+		FrWriteLock lk(_mu);
 		auto it = _docs.find(lookupId);
 		if (it == _docs.end())
 			return recordStatus({DbStatusCode::Conflict, "document changed during update"});
@@ -997,33 +1387,151 @@ DbStatus Collection::updateByIdWithDecision(
 				addUniqueValuesLocked(beforeDoc.as<JsonObjectConst>(), lookupId);
 				return recordStatus(addStatus);
 			}
+			const uint32_t seq = stampLocked(lookupId, it->second.get());
 			it->second->msgpack = candidate->msgpack;
+			timer.addBytes(candidate->msgpack.size());
 			it->second->meta.updatedAtMs = candidate->meta.updatedAtMs;
 			it->second->meta.revision = candidate->meta.revision;
 			it->second->meta.dirty = true;
+			it->second->commitSeq = seq;
 			touchRecordLocked(it->second);
 			_dirty = true;
 			updated = true;
+			committedRec = it->second;
 		}
 	}
+	if (updated)
+		return recordStatus(afterCommit(committedRec));
 	return recordStatus({DbStatusCode::Ok, ""});
 }
 
 DbStatus Collection::removeById(const std::string &id) {
-	bool removed = false;
-	DbStatus st{DbStatusCode::Ok, ""};
 	DocId lookupId;
 	if (!lookupId.assign(id)) {
 		return recordStatus({DbStatusCode::NotFound, "document not found"});
 	}
+	return recordStatus(removeRecord(lookupId, nowUtcMs()));
+}
+
+DbStatus Collection::applyRemoval(const DocId &id, uint64_t deletedAtMs) {
+	auto st = removeRecord(id, deletedAtMs);
+	if (st.code == DbStatusCode::NotFound)
+		return recordStatus({DbStatusCode::Ok, ""});
+	return recordStatus(st);
+}
+
+DbStatus Collection::applyRecord(const DocumentRecord &record) {
+	const DocId &id = record.meta.id;
+	if (!id.valid()) {
+		return recordStatus({DbStatusCode::InvalidArgument, "record id is invalid"});
+	}
+	auto loaded = ensureRecordLoaded(id);
+	if (!loaded.status.ok() && loaded.status.code != DbStatusCode::NotFound)
+		return recordStatus(loaded.status);
+
+	JsonDocument afterDoc;
+	if (!record.msgpack.empty()) {
+		auto err = deserializeMsgPack(afterDoc, record.msgpack.data(), record.msgpack.size());
+		if (err) {
+			return recordStatus({DbStatusCode::CorruptionDetected, "msgpack decode failed"});
+		}
+	}
+	const JsonObjectConst afterObj = afterDoc.as<JsonObjectConst>();
+
+	std::shared_ptr<DocumentRecord> committedRec;
+	bool created = false;
+	{
+		FrWriteLock lk(_mu);
+		auto uniqueStatus = checkUniqueFields(afterObj, &id);
+		if (!uniqueStatus.ok())
+			return recordStatus(uniqueStatus);
+		auto it = _docs.find(id);
+		if (it == _docs.end()) {
+			auto cap = ensureResidentCapacityLocked(1, &id);
+			if (!cap.ok())
+				return recordStatus(cap);
+			auto rec = makeDocumentRecord(_usePSRAMBuffers);
+			rec->meta = record.meta;
+			rec->meta.dirty = true;
+			rec->meta.removed = false;
+			rec->msgpack = record.msgpack;
+			auto addStatus = addUniqueValuesLocked(afterObj, id);
+			if (!addStatus.ok())
+				return recordStatus(addStatus);
+			touchRecordLocked(rec);
+			_docs.emplace(id, rec);
+			rememberKnownIdLocked(id);
+			rec->commitSeq = stampLocked(id, nullptr);
+			committedRec = rec;
+			created = true;
+		} else {
+			JsonDocument beforeDoc;
+			if (!it->second->msgpack.empty()) {
+				auto err = deserializeMsgPack(
+				    beforeDoc,
+				    it->second->msgpack.data(),
+				    it->second->msgpack.size()
+				);
+				if (err) {
+					return recordStatus(
+					    {DbStatusCode::CorruptionDetected, "msgpack decode failed"}
+					);
+				}
+			}
+			removeUniqueValuesLocked(beforeDoc.as<JsonObjectConst>(), id);
+			auto addStatus = addUniqueValuesLocked(afterObj, id);
+			if (!addStatus.ok()) {
+				addUniqueValuesLocked(beforeDoc.as<JsonObjectConst>(), id);
+				return recordStatus(addStatus);
+			}
+			const uint32_t seq = stampLocked(id, it->second.get());
+			it->second->msgpack = record.msgpack;
+			it->second->meta.createdAtMs = record.meta.createdAtMs;
+			it->second->meta.updatedAtMs = record.meta.updatedAtMs;
+			it->second->meta.revision = record.meta.revision;
+			it->second->meta.flags = record.meta.flags;
+			it->second->meta.dirty = true;
+			it->second->commitSeq = seq;
+			touchRecordLocked(it->second);
+			committedRec = it->second;
+		}
+		_dirty = true;
+	}
+	if (created && _rt)
+		_rt->noteDocumentCreated(_name);
+	auto st = afterCommit(committedRec);
+	emitEvent(created ? DBEventType::DocumentCreated : DBEventType::DocumentUpdated);
+	return recordStatus(st);
+}
+
+DbStatus Collection::collectTombstones(uint64_t sinceMs, JsonDbVector<Tombstone> &out) {
+	// The flush lock keeps a removal from being between the pending list and
+	// the log while both are read.
+	FrLock flushLk(_store->flushMu);
+	auto st = _tombstoneLog.read(collectionDir(), sinceMs, out);
+	if (!st.ok())
+		return recordStatus(st);
+	FrReadLock lk(_mu);
+	for (const auto &pending : _deletedIds) {
+		if (pending.deletedAtMs >= sinceMs)
+			out.push_back(pending);
+	}
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus Collection::removeRecord(const DocId &lookupId, uint64_t deletedAtMs) {
+	OpTimer timer(DbOp::Remove, &_opStats);
+	const Tombstone tombstone{lookupId, deletedAtMs};
+	bool removed = false;
+	DbStatus st{DbStatusCode::Ok, ""};
 	auto loaded = ensureRecordLoaded(lookupId);
 	if (!loaded.status.ok())
-		return recordStatus(loaded.status);
+		return loaded.status;
 	{
-		FrLock lk(_mu);
+		FrWriteLock lk(_mu);
 		auto it = _docs.find(lookupId);
 		if (it == _docs.end())
-			return recordStatus({DbStatusCode::NotFound, "document not found"});
+			return {DbStatusCode::NotFound, "document not found"};
 		DocView view(
 		    it->second,
 		    &_schema,
@@ -1038,8 +1546,9 @@ DbStatus Collection::removeById(const std::string &id) {
 		    _usePSRAMBuffers
 		);
 		removeUniqueValuesLocked(view.asObjectConst(), it->first);
+		(void)stampLocked(it->first, it->second.get());
 		it->second->meta.removed = true;
-		_deletedIds.push_back(it->first);
+		_deletedIds.push_back(tombstone);
 		forgetKnownIdLocked(it->first);
 		_docs.erase(it);
 		_dirty = true;
@@ -1048,14 +1557,17 @@ DbStatus Collection::removeById(const std::string &id) {
 	if (removed) {
 		if (_rt)
 			_rt->noteDocumentDeleted(_name);
+		st = afterRemove(tombstone);
 		emitEvent(DBEventType::DocumentDeleted);
 	}
-	return recordStatus(st);
+	return st;
 }
 
 DbStatus Collection::writeDocToFile(const std::string &baseDir, const DocumentRecord &r) {
 	(void)baseDir;
-	return recordStatus(_recordStore.write(collectionDir(), r));
+	return recordStatus(
+	    _recordStore.write(collectionDir(), r, _config.payloadCodec, _config.internKeys)
+	);
 }
 
 DbResult<std::shared_ptr<DocumentRecord>>
@@ -1078,23 +1590,103 @@ DbStatus Collection::persistImmediate(const std::shared_ptr<DocumentRecord> &rec
 	if (!rec) {
 		return recordStatus({DbStatusCode::InvalidArgument, "no record"});
 	}
-	auto st = writeDocToFile(_baseDir, *rec);
-	if (!st.ok())
+	// Holding the flush lock across snapshot + write keeps this ordered with
+	// flushDirtyToFs, so an older revision can never land after a newer one.
+	FrLock flushLk(_store->flushMu);
+	DocumentRecord snapshot(_usePSRAMBuffers);
+	{
+		FrWriteLock lk(_mu);
+		if (rec->meta.removed || !rec->meta.dirty)
+			return recordStatus({DbStatusCode::Ok, ""});
+		snapshot.meta = rec->meta;
+		snapshot.msgpack = rec->msgpack;
+		rec->meta.dirty = false;
+	}
+	auto st = writeDocToFile(_baseDir, snapshot);
+	if (!st.ok()) {
+		// Leave it to the sync task to retry.
+		{
+			FrWriteLock lk(_mu);
+			rec->meta.dirty = true;
+			_dirty = true;
+		}
+		if (_rt)
+			_rt->noteDirtyData(snapshot.msgpack.size());
 		return st;
-	FrLock lk(_mu);
-	rec->meta.dirty = false;
-	rec->meta.removed = false;
-	_dirty = false;
+	}
 	return recordStatus({DbStatusCode::Ok, ""});
 }
 
+DbStatus Collection::removeImmediate(const Tombstone &tombstone) {
+	FrLock flushLk(_store->flushMu);
+	auto samePending = [&tombstone](const Tombstone &pending) {
+		return pending.id == tombstone.id;
+	};
+	{
+		FrReadLock lk(_mu);
+		// A sync pass may already have taken it.
+		if (std::none_of(_deletedIds.begin(), _deletedIds.end(), samePending))
+			return recordStatus({DbStatusCode::Ok, ""});
+	}
+	JsonDbVector<Tombstone> entries{JsonDbAllocator<Tombstone>(_usePSRAMBuffers)};
+	entries.push_back(tombstone);
+	auto st = _tombstoneLog.append(collectionDir(), entries);
+	if (st.ok())
+		st = _recordStore.remove(collectionDir(), tombstone.id);
+	if (!st.ok() && st.code != DbStatusCode::NotFound) {
+		if (_rt)
+			_rt->noteDirtyData();
+		return recordStatus({DbStatusCode::IoError, "document delete failed"});
+	}
+	FrWriteLock lk(_mu);
+	_deletedIds.erase(
+	    std::remove_if(_deletedIds.begin(), _deletedIds.end(), samePending),
+	    _deletedIds.end()
+	);
+	return recordStatus({DbStatusCode::Ok, ""});
+}
+
+CollectionDurability Collection::durability() const {
+	FrReadLock lk(_mu);
+	return _config.durability;
+}
+
+DbStatus Collection::afterCommit(const std::shared_ptr<DocumentRecord> &rec) {
+	if (!rec)
+		return {DbStatusCode::Ok, ""};
+	switch (durability()) {
+	case CollectionDurability::Immediate:
+		return persistImmediate(rec);
+	case CollectionDurability::Deferred:
+		return {DbStatusCode::Ok, ""};
+	case CollectionDurability::Batched:
+	default:
+		if (_rt)
+			_rt->noteDirtyData(rec->msgpack.size());
+		return {DbStatusCode::Ok, ""};
+	}
+}
+
+DbStatus Collection::afterRemove(const Tombstone &tombstone) {
+	switch (durability()) {
+	case CollectionDurability::Immediate:
+		return removeImmediate(tombstone);
+	case CollectionDurability::Deferred:
+		return {DbStatusCode::Ok, ""};
+	case CollectionDurability::Batched:
+	default:
+		if (_rt)
+			_rt->noteDirtyData();
+		return {DbStatusCode::Ok, ""};
+	}
+}
+
 DocView Collection::makeView(std::shared_ptr<DocumentRecord> rec) {
 	{
-		FrLock lk(_mu);
-		if (rec) {
-			++rec->pinCount;
-			touchRecordLocked(rec);
-		}
+		// Under the shared lock so a tier pass cannot move the buffer between
+		// its pin check and this pin.
+		FrReadLock lk(_mu);
+		(void)pinRecord(rec);
 	}
 	auto releasePin = [this, weakRec = std::weak_ptr<DocumentRecord>(rec)]() {
 		if (auto locked = weakRec.lock()) {
@@ -1103,12 +1695,18 @@ DocView Collection::makeView(std::shared_ptr<DocumentRecord> rec) {
 	};
 	auto acquireDecode = [this]() { return acquireDecodedViewSlot(); };
 	auto releaseDecode = [this]() { releaseDecodedViewSlot(); };
+	// Views handed out by find* can be committed by the caller. The view stages
+	// its bytes and applyViewCommit() swaps them into the live record, so open
+	// read snapshots keep the previous version.
+	auto commitSink = [this, weakRec = std::weak_ptr<DocumentRecord>(rec)](
+	                      const std::shared_ptr<DocumentRecord> &staged
+	                  ) { return applyViewCommit(weakRec.lock(), staged); };
 	return DocView(
 	    std::move(rec),
 	    &_schema,
 	    nullptr,
 	    _rt ? _rt->owner : nullptr,
-	    nullptr,
+	    commitSink,
 	    acquireDecode,
 	    releaseDecode,
 	    nullptr,
@@ -1118,6 +1716,181 @@ DocView Collection::makeView(std::shared_ptr<DocumentRecord> rec) {
 	);
 }
 
+DocView Collection::makeSnapshotView(std::shared_ptr<DocumentRecord> rec) {
+	// Snapshot records may be shared with other readers; never write them back.
+	auto commitSink = [](const std::shared_ptr<DocumentRecord> &) {
+		return DbStatus{DbStatusCode::InvalidArgument, "snapshot views are read-only"};
+	};
+	auto acquireDecode = [this]() { return acquireDecodedViewSlot(); };
+	auto releaseDecode = [this]() { releaseDecodedViewSlot(); };
+	return DocView(
+	    std::move(rec),
+	    &_schema,
+	    nullptr,
+	    _rt ? _rt->owner : nullptr,
+	    commitSink,
+	    acquireDecode,
+	    releaseDecode,
+	    nullptr,
+	    nullptr,
+	    false,
+	    _usePSRAMBuffers
+	);
+}
+
+DbStatus Collection::applyViewCommit(
+    const std::shared_ptr<DocumentRecord> &live, const std::shared_ptr<DocumentRecord> &staged
+) {
+	OpTimer timer(DbOp::Commit, &_opStats);
+	if (!live || !staged)
+		return recordStatus({DbStatusCode::NotFound, "document removed"});
+	timer.addBytes(staged->msgpack.size());
+	{
+		FrWriteLock lk(_mu);
+		if (live->meta.removed)
+			return recordStatus({DbStatusCode::NotFound, "document removed"});
+		const uint32_t seq = stampLocked(live->meta.id, live.get());
+		// Buffers with different allocators cannot be swapped.
+		if (live->msgpack.get_allocator() == staged->msgpack.get_allocator())
+			live->msgpack.swap(staged->msgpack);
+		else
+			live->msgpack = staged->msgpack;
+		live->meta.updatedAtMs = staged->meta.updatedAtMs;
+		live->meta.revision = static_cast<uint32_t>(live->meta.revision + 1U);
+		live->meta.dirty = true;
+		live->commitSeq = seq;
+		touchRecordLocked(live);
+		_dirty = true;
+	}
+	// Make sure the sync task hears about it instead of waiting for an
+	// unrelated write.
+	return afterCommit(live);
+}
+
+void Collection::beginBatch() {
+	if (_rt)
+		_rt->versions.beginBatch();
+}
+
+void Collection::endBatch() {
+	if (_rt)
+		_rt->versions.endBatch();
+}
+
+uint32_t Collection::stampLocked(const DocId &id, const DocumentRecord *prior) {
+	return _rt ? _rt->versions.stamp(_name, id, prior) : 0;
+}
+
+JsonDbVector<DocId> Collection::idsAt() {
+	JsonDbVector<DocId> ids{JsonDbAllocator<DocId>(_usePSRAMBuffers)};
+	{
+		FrReadLock lk(_mu);
+		ids = _store->knownIds;
+	}
+	if (_rt) {
+		// Documents removed since the snapshot only survive in the version
+		// store.
+		_rt->versions.idsFor(_name, ids);
+	}
+	std::sort(ids.begin(), ids.end(), DocIdLess{});
+	ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+	return ids;
+}
+
+DbResult<std::shared_ptr<DocumentRecord>> Collection::readAt(const DocId &id, uint32_t seq) {
+	DbResult<std::shared_ptr<DocumentRecord>> res{};
+	auto loaded = ensureRecordLoaded(id);
+	if (!loaded.status.ok() && loaded.status.code != DbStatusCode::NotFound) {
+		res.status = loaded.status;
+		return res;
+	}
+	// Writers stamp and change a record under the exclusive lock, so the
+	// version lookup and the copy of the live bytes see the same state.
+	FrReadLock lk(_mu);
+	std::shared_ptr<DocumentRecord> version;
+	if (_rt && _rt->versions.lookup(_name, id, seq, version)) {
+		res.status = version ? DbStatus{DbStatusCode::Ok, ""}
+		                     : DbStatus{DbStatusCode::NotFound, "document not found"};
+		res.value = std::move(version);
+		return res;
+	}
+	const auto &live = loaded.value;
+	if (!live || live->meta.removed) {
+		res.status = {DbStatusCode::NotFound, "document not found"};
+		return res;
+	}
+	touchRecordLocked(live);
+	auto copy = makeDocumentRecord(_usePSRAMBuffers);
+	copy->meta = live->meta;
+	copy->meta.dirty = false;
+	copy->msgpack = live->msgpack;
+	copy->commitSeq = live->commitSeq;
+	res.status = {DbStatusCode::Ok, ""};
+	res.value = std::move(copy);
+	return res;
+}
+
+DbResult<DocView> Collection::findByIdAt(const std::string &id, uint32_t seq) {
+	DocId lookupId;
+	DbResult<std::shared_ptr<DocumentRecord>> rr{};
+	if (lookupId.assign(id)) {
+		rr = readAt(lookupId, seq);
+	} else {
+		rr.status = {DbStatusCode::NotFound, "document not found"};
+	}
+	recordStatus(rr.status);
+	if (!rr.status.ok())
+		return {rr.status, makeSnapshotView(nullptr)};
+	return {rr.status, makeSnapshotView(std::move(rr.value))};
+}
+
+DbResult<std::vector<DocView>>
+Collection::findManyAt(uint32_t seq, std::function<bool(const DocView &)> pred) {
+	DbResult<std::vector<DocView>> res{};
+	for (const auto &id : idsAt()) {
+		auto rr = readAt(id, seq);
+		if (!rr.status.ok()) {
+			if (rr.status.code == DbStatusCode::Busy) {
+				res.status = recordStatus(rr.status);
+				return res;
+			}
+			continue;
+		}
+		auto view = makeSnapshotView(std::move(rr.value));
+		if (!pred || pred(view))
+			res.value.emplace_back(std::move(view));
+	}
+	res.status = {DbStatusCode::Ok, ""};
+	recordStatus(res.status);
+	return res;
+}
+
+DbStatus Collection::visitAt(
+    uint32_t seq, const std::function<bool(const DocumentRecord &)> &visit
+) {
+	return visitAt(seq, DocId(), visit);
+}
+
+DbStatus Collection::visitAt(
+    uint32_t seq, const DocId &after, const std::function<bool(const DocumentRecord &)> &visit
+) {
+	const auto ids = idsAt();
+	auto it = after.empty() ? ids.begin()
+	                        : std::upper_bound(ids.begin(), ids.end(), after, DocIdLess{});
+	for (; it != ids.end(); ++it) {
+		const DocId &id = *it;
+		auto rr = readAt(id, seq);
+		if (!rr.status.ok()) {
+			if (rr.status.code == DbStatusCode::NotFound)
+				continue;
+			return recordStatus(rr.status);
+		}
+		if (visit && !visit(*rr.value))
+			break;
+	}
+	return recordStatus({DbStatusCode::Ok, ""});
+}
+
 DbStatus Collection::updateOneNoCache(
     std::function<bool(const DocView &)> pred,
     std::function<void(DocView &)> mutator,
@@ -1157,7 +1930,7 @@ DbStatus Collection::updateOneNoCache(
 		}
 	}
 	if (create) {
-		auto rec = makeSharedDocumentRecord(_usePSRAMBuffers);
+		auto rec = makeDocumentRecord(_usePSRAMBuffers);
 		rec->meta.createdAtMs = nowUtcMs();
 		rec->meta.updatedAtMs = rec->meta.createdAtMs;
 		rec->meta.id = ObjectId().toDocId();
@@ -1232,7 +2005,7 @@ DbStatus Collection::updateOneJsonNoCache(
 		return recordStatus(st);
 	}
 	if (create) {
-		auto rec = makeSharedDocumentRecord(_usePSRAMBuffers);
+		auto rec = makeDocumentRecord(_usePSRAMBuffers);
 		rec->meta.createdAtMs = nowUtcMs();
 		rec->meta.updatedAtMs = rec->meta.createdAtMs;
 		rec->meta.id = ObjectId().toDocId();
@@ -1300,7 +2073,11 @@ DbStatus Collection::removeByIdNoCache(const std::string &id, bool &removed) {
 	if (!docId.assign(id)) {
 		return recordStatus({DbStatusCode::NotFound, "document not found"});
 	}
-	auto st = _recordStore.remove(collectionDir(), docId);
+	JsonDbVector<Tombstone> entries{JsonDbAllocator<Tombstone>(_usePSRAMBuffers)};
+	entries.push_back({docId, nowUtcMs()});
+	auto st = _tombstoneLog.append(collectionDir(), entries);
+	if (st.ok())
+		st = _recordStore.remove(collectionDir(), docId);
 	if (!st.ok())
 		return recordStatus(st);
 	removed = true;
@@ -1308,36 +2085,107 @@ DbStatus Collection::removeByIdNoCache(const std::string &id, bool &removed) {
 }
 
 DbStatus Collection::loadFromFs(const std::string &baseDir) {
-	JsonDbVector<DocId> ids{JsonDbAllocator<DocId>(_usePSRAMBuffers)};
 	(void)baseDir;
-	ids = listDocumentIdsFromFs();
+	const auto ids = beginLoad();
+	JsonDbVector<LoadShard> shards{JsonDbAllocator<LoadShard>(_usePSRAMBuffers)};
+	shards.emplace_back(_usePSRAMBuffers);
+	auto st = loadShard(ids, 0, ids.size(), shards.back());
+	if (!st.ok())
+		return recordStatus(st);
+	return finishLoad(shards);
+}
 
-	{
-		FrLock lk(_mu);
-		_docs.clear();
-		_store->knownIds = ids;
-		_uniqueIndexes.clear();
-	}
+JsonDbVector<DocId> Collection::beginLoad() {
+	JsonDbVector<DocId> ids = listDocumentIdsFromFs();
+	FrWriteLock lk(_mu);
+	_docs.clear();
+	_store->knownIds = ids;
+	_store->knownHeaders.clear();
+	syncResidentHeadersLocked();
+	_uniqueIndexes.clear();
+	return ids;
+}
 
-	for (const auto &id : ids) {
-		auto rr = readDocFromFile(_baseDir, id.c_str());
-		if (!rr.status.ok()) {
+DbStatus Collection::loadShard(
+    const JsonDbVector<DocId> &ids, size_t first, size_t count, LoadShard &out
+) {
+	// Only the unique fields are decoded, through an ArduinoJson filter; a
+	// schema without unique fields needs no decode at all.
+	JsonDocument filter;
+	size_t uniqueFields = 0;
+	for (const auto &field : _schema.fields) {
+		if (!isIndexedUnique(field))
+			continue;
+		if (field.name)
+			filter[field.name] = true;
+		++uniqueFields;
+	}
+	const bool eager = _config.loadPolicy == CollectionLoadPolicy::Eager;
+	const bool budgeted = isResidentBudgetEnforced();
+	const size_t last = std::min(first + count, ids.size());
+
+	out.ids.reserve(last > first ? last - first : 0);
+	JsonDbDocArena arena(_usePSRAMBuffers);
+	for (size_t i = first; i < last; ++i) {
+		auto rr = _recordStore.read(collectionDir(), ids[i].c_str());
+		if (!rr.status.ok() || !rr.value)
 			continue;
+		if (uniqueFields != 0) {
+			{
+				JsonDocument doc(&arena);
+				auto err = deserializeMsgPack(
+				    doc,
+				    rr.value->msgpack.data(),
+				    rr.value->msgpack.size(),
+				    DeserializationOption::Filter(filter)
+				);
+				if (err)
+					return {DbStatusCode::CorruptionDetected, "msgpack decode failed"};
+				JsonObjectConst obj = doc.as<JsonObjectConst>();
+				for (const auto &field : _schema.fields) {
+					if (isIndexedUnique(field))
+						out.uniqueKeys.push_back(uniqueValueKey(field, obj[field.name]));
+				}
+			}
+			arena.reset();
 		}
-		JsonDocument doc;
-		auto err = deserializeMsgPack(doc, rr.value->msgpack.data(), rr.value->msgpack.size());
-		if (err) {
-			return recordStatus({DbStatusCode::CorruptionDetected, "msgpack decode failed"});
+		out.ids.push_back(rr.value->meta.id);
+		if (_config.residentHeaders)
+			out.headers.push_back(headerOf(*rr.value));
+		// Same residency rule as a serial load: the first maxRecordsInMemory ids.
+		const bool keep = eager && (!budgeted || i < _config.maxRecordsInMemory);
+		out.records.push_back(keep ? std::move(rr.value) : nullptr);
+	}
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus Collection::finishLoad(const JsonDbVector<LoadShard> &shards) {
+	FrWriteLock lk(_mu);
+	// Shards keep the order of knownIds, minus unreadable records, so one
+	// forward walk lines the headers up.
+	size_t pos = 0;
+	for (const auto &shard : shards) {
+		for (size_t i = 0; i < shard.headers.size() && i < shard.ids.size(); ++i) {
+			while (pos < _store->knownIds.size() && _store->knownIds[pos] != shard.ids[i])
+				++pos;
+			if (pos < _store->knownHeaders.size())
+				_store->knownHeaders[pos++] = residentOf(shard.headers[i]);
 		}
-		{
-			FrLock lk(_mu);
-			auto uniqueStatus = addUniqueValuesLocked(doc.as<JsonObjectConst>(), rr.value->meta.id);
-			if (!uniqueStatus.ok())
-				return recordStatus(uniqueStatus);
-			if (_config.loadPolicy == CollectionLoadPolicy::Eager &&
-			    (!isResidentBudgetEnforced() || _docs.size() < _config.maxRecordsInMemory)) {
-				touchRecordLocked(rr.value);
-				_docs.emplace(rr.value->meta.id, rr.value);
+	}
+	for (const auto &shard : shards) {
+		size_t key = 0;
+		for (size_t i = 0; i < shard.ids.size(); ++i) {
+			for (const auto &field : _schema.fields) {
+				if (!isIndexedUnique(field) || key >= shard.uniqueKeys.size())
+					continue;
+				auto uniqueStatus = addUniqueKeyLocked(field, shard.uniqueKeys[key++], shard.ids[i]);
+				if (!uniqueStatus.ok())
+					return recordStatus(uniqueStatus);
+			}
+			const auto &rec = shard.records[i];
+			if (rec) {
+				touchRecordLocked(rec);
+				_docs.emplace(rec->meta.id, rec);
 			}
 		}
 	}
@@ -1345,9 +2193,11 @@ DbStatus Collection::loadFromFs(const std::string &baseDir) {
 }
 
 DbStatus Collection::flushDirtyToFs(const std::string &baseDir, bool &didWork) {
+	OpTimer timer(DbOp::Flush, &_opStats);
 	didWork = false;
+	FrLock flushLk(_store->flushMu);
 	// Snapshot work under lock
-	JsonDbVector<DocId> toDelete{JsonDbAllocator<DocId>(_usePSRAMBuffers)};
+	JsonDbVector<Tombstone> toDelete{JsonDbAllocator<Tombstone>(_usePSRAMBuffers)};
 	struct PendingWrite {
 		DocumentMeta meta;
 		JsonDbVector<uint8_t> bytes;
@@ -1358,7 +2208,7 @@ DbStatus Collection::flushDirtyToFs(const std::string &baseDir, bool &didWork) {
 	};
 	JsonDbVector<PendingWrite> toWrite{JsonDbAllocator<PendingWrite>(_usePSRAMBuffers)};
 	{
-		FrLock lk(_mu);
+		FrWriteLock lk(_mu);
 		toDelete.swap(_deletedIds);
 		for (auto &kv : _docs) {
 			auto &rec = kv.second;
@@ -1372,12 +2222,29 @@ DbStatus Collection::flushDirtyToFs(const std::string &baseDir, bool &didWork) {
 		}
 		_dirty = false;
 	}
+	// Idle passes would drown out the flushes that wrote something.
+	if (toDelete.empty() && toWrite.empty())
+		timer.discard();
 
-	// Process deletions (FS serialized by global mutex)
+	// Process deletions (each takes its record's path lock). Tombstones are
+	// logged first so every removal that reaches flash is on record.
 	if (!toDelete.empty()) {
 		didWork = true;
-		for (const auto &id : toDelete) {
-			auto st = _recordStore.remove(collectionDir(), id);
+		auto logged = _tombstoneLog.append(collectionDir(), toDelete);
+		if (!logged.ok()) {
+			{
+				FrWriteLock lk(_mu);
+				_deletedIds.insert(_deletedIds.begin(), toDelete.begin(), toDelete.end());
+				_dirty = true;
+			}
+			// The sync task cleared its pending flag before this pass; re-arm
+			// it so the deletes are retried without waiting for another write.
+			if (_rt)
+				_rt->noteDirtyData();
+			return recordStatus(logged);
+		}
+		for (const auto &tombstone : toDelete) {
+			auto st = _recordStore.remove(collectionDir(), tombstone.id);
 			if (!st.ok() && st.code != DbStatusCode::NotFound)
 				return recordStatus({DbStatusCode::IoError, "document delete failed"});
 		}
@@ -1391,6 +2258,7 @@ DbStatus Collection::flushDirtyToFs(const std::string &baseDir, bool &didWork) {
 		auto st = writeDocToFile(baseDir, tmp);
 		if (!st.ok())
 			return recordStatus(st);
+		timer.addBytes(tmp.msgpack.size());
 		didWork = true;
 	}
 	return recordStatus({DbStatusCode::Ok, ""});
@@ -15,6 +15,7 @@
 
 #include "../document/document.h"
 #include "../storage/record_store.h"
+#include "../storage/tombstone_log.h"
 #include "../utils/dbTypes.h"
 #include "../utils/fr_mutex.h"
 #include "../utils/jsondb_allocator.h"
@@ -57,6 +58,12 @@ class Collection {
 	// Retrieve all documents matching predicate
 	DbResult<std::vector<DocView>> findMany(std::function<bool(const DocView &)> pred);
 
+	// Headers of all documents matching predicate. Payloads are not decoded
+	// and nothing is added to the resident set; with residentHeaders no file
+	// is read either, once each header has been seen.
+	DbResult<std::vector<DocumentHeader>>
+	findHeaders(std::function<bool(const DocumentHeader &)> pred);
+
 	// Retrieve the first document matching predicate
 	DbResult<DocView> findOne(std::function<bool(const DocView &)> pred);
 
@@ -104,12 +111,59 @@ class Collection {
 
 	DbResult<size_t> updateMany(const JsonDocument &patch, const JsonDocument &filter);
 
+	// Point-in-time reads for ReadSnapshot (see ESPJsonDB::beginRead()). Views
+	// returned here are read-only copies; commit() on them fails.
+	DbResult<DocView> findByIdAt(const std::string &id, uint32_t seq);
+	DbResult<std::vector<DocView>>
+	findManyAt(uint32_t seq, std::function<bool(const DocView &)> pred);
+	// Visit every document as of `seq` in _id order; return false from `visit`
+	// to stop. The second form starts after `after` (from the start if empty).
+	DbStatus visitAt(uint32_t seq, const std::function<bool(const DocumentRecord &)> &visit);
+	DbStatus visitAt(
+	    uint32_t seq,
+	    const DocId &after,
+	    const std::function<bool(const DocumentRecord &)> &visit
+	);
+
+	// Incremental snapshot support (see ESPJsonDB::applyIncremental()).
+	// applyRecord upserts `record` keeping its id and metadata; applyRemoval
+	// removes a document if present. Neither runs schema validation.
+	DbStatus applyRecord(const DocumentRecord &record);
+	DbStatus applyRemoval(const DocId &id, uint64_t deletedAtMs);
+	// Removals since `sinceMs`, logged and still pending.
+	DbStatus collectTombstones(uint64_t sinceMs, JsonDbVector<Tombstone> &out);
+
 	// Dirty tracking
 	bool isDirty() const;
 	void clearDirty();
 
 	// Persistence hooks used by ESPJsonDB
 	DbStatus loadFromFs(const std::string &baseDir);
+
+	// loadFromFs() in three steps so a cold start can spread the file reads
+	// over several tasks. beginLoad() resets the collection and lists its ids.
+	// loadShard() reads a slice of them without touching collection state, so
+	// slices may run concurrently. finishLoad() indexes the slices in order.
+	struct LoadShard {
+		explicit LoadShard(bool usePSRAMBuffers = false)
+		    : ids(JsonDbAllocator<DocId>(usePSRAMBuffers)),
+		      records(JsonDbAllocator<std::shared_ptr<DocumentRecord>>(usePSRAMBuffers)),
+		      uniqueKeys(JsonDbAllocator<std::string>(usePSRAMBuffers)),
+		      headers(JsonDbAllocator<DocumentHeader>(usePSRAMBuffers)) {
+		}
+
+		JsonDbVector<DocId> ids;
+		// Null where the record is not kept resident.
+		JsonDbVector<std::shared_ptr<DocumentRecord>> records;
+		// One key per unique schema field and id, "" where the value is absent.
+		JsonDbVector<std::string> uniqueKeys;
+		// One per id, only with CollectionConfig::residentHeaders.
+		JsonDbVector<DocumentHeader> headers;
+	};
+	JsonDbVector<DocId> beginLoad();
+	// Read ids[first, first + count) of the list beginLoad() returned.
+	DbStatus loadShard(const JsonDbVector<DocId> &ids, size_t first, size_t count, LoadShard &out);
+	DbStatus finishLoad(const JsonDbVector<LoadShard> &shards);
 	// Flush pending writes/deletes to FS. Sets didWork=true if any file was
 	// written or removed during this call.
 	DbStatus flushDirtyToFs(const std::string &baseDir, bool &didWork);
@@ -117,6 +171,29 @@ class Collection {
 	// Optional: stats
 	size_t size() const;
 
+	// Hot/cold payload tiering (CollectionConfig::hotTierBytes). The sync
+	// task rebalances tiers by recency once kTierPassInterval record accesses
+	// have passed; the byte and record counts are as of the last pass.
+	static constexpr uint32_t kTierPassInterval = 64;
+	struct TierStats {
+		size_t hotBytes = 0;  // internal RAM
+		size_t coldBytes = 0; // PSRAM
+		uint32_t hotRecords = 0;
+		uint32_t coldRecords = 0;
+		uint32_t promotions = 0;
+		uint32_t demotions = 0;
+		uint32_t evictions = 0; // dropped over coldTierBytes
+		uint32_t passes = 0;
+	};
+	TierStats tierStats() const;
+	// Rebalance now instead of waiting for the next pass.
+	void rebalanceTiers();
+	// Rebalance if kTierPassInterval accesses passed since the last pass.
+	void rebalanceTiersIfDue();
+
+	// This collection's operation counters (see utils/op_stats.h).
+	void opStatsToJson(JsonObject out) const;
+
 	// Mark all records as removed (used when dropping a collection)
 	void markAllRemoved();
 
@@ -131,12 +208,41 @@ class Collection {
 	DbStatus checkUniqueFields(JsonObjectConst obj, const DocId *selfId);
 	JsonDbVector<DocId> listDocumentIdsFromFs() const;
 	DbStatus persistImmediate(const std::shared_ptr<DocumentRecord> &rec);
+	DbStatus removeImmediate(const Tombstone &tombstone);
+	CollectionDurability durability() const;
+	// Route a committed change according to the collection durability mode.
+	DbStatus afterCommit(const std::shared_ptr<DocumentRecord> &rec);
+	DbStatus afterRemove(const Tombstone &tombstone);
+	DbStatus removeRecord(const DocId &id, uint64_t deletedAtMs);
 	size_t countDocumentsFromFs() const;
 	DocView makeView(std::shared_ptr<DocumentRecord> rec);
+	DocView makeSnapshotView(std::shared_ptr<DocumentRecord> rec);
+	DbStatus applyViewCommit(
+	    const std::shared_ptr<DocumentRecord> &live, const std::shared_ptr<DocumentRecord> &staged
+	);
+	// Keeps a multi-document operation invisible to snapshots until it ends.
+	struct BatchScope {
+		explicit BatchScope(Collection &col) : col(col) {
+			col.beginBatch();
+		}
+		~BatchScope() {
+			col.endBatch();
+		}
+		BatchScope(const BatchScope &) = delete;
+		BatchScope &operator=(const BatchScope &) = delete;
+		Collection &col;
+	};
+	void beginBatch();
+	void endBatch();
+	// Take the next commit sequence; `prior` is the record before the change.
+	uint32_t stampLocked(const DocId &id, const DocumentRecord *prior);
+	DbResult<std::shared_ptr<DocumentRecord>> readAt(const DocId &id, uint32_t seq);
+	JsonDbVector<DocId> idsAt();
 	DbResult<JsonDbVector<DocId>> collectMatchingIds(std::function<bool(const DocView &)> pred);
 	std::string collectionDir() const;
 	std::string uniqueValueKey(const SchemaField &field, JsonVariantConst value) const;
 	DbStatus addUniqueValuesLocked(JsonObjectConst obj, const DocId &id);
+	DbStatus addUniqueKeyLocked(const SchemaField &field, const std::string &key, const DocId &id);
 	void removeUniqueValuesLocked(JsonObjectConst obj, const DocId &id);
 	DbStatus rebuildUniqueIndexesLocked();
 	bool isResidentBudgetEnforced() const;
@@ -145,7 +251,13 @@ class Collection {
 	void rememberKnownIdLocked(const DocId &id);
 	void forgetKnownIdLocked(const DocId &id);
 	bool containsKnownIdLocked(const DocId &id) const;
+	void syncResidentHeadersLocked();
+	void storeHeaderLocked(const DocumentRecord &rec);
 	DbStatus ensureResidentCapacityLocked(size_t additional, const DocId *protectId = nullptr);
+	bool isTieringEnabled() const;
+	bool isTierPassDueLocked() const;
+	void rebalanceTiersLocked();
+	void rehomeIndexesLocked();
 	DbResult<std::shared_ptr<DocumentRecord>> ensureRecordLoaded(const DocId &id);
 	DbStatus pinRecord(const std::shared_ptr<DocumentRecord> &rec);
 	void unpinRecord(const std::shared_ptr<DocumentRecord> &rec);
@@ -184,6 +296,7 @@ template <typename Pred> DbResult<size_t> Collection::removeMany(Pred &&p) {
 		res.status = matches.status;
 		return res;
 	}
+	BatchScope batch(*this);
 	for (const auto &id : matches.value) {
 		auto st = removeById(id.c_str());
 		if (st.ok())
@@ -203,6 +316,7 @@ DbResult<size_t> Collection::updateMany(Pred &&p, Mut &&m) {
 		res.status = matches.status;
 		return res;
 	}
+	BatchScope batch(*this);
 	for (const auto &id : matches.value) {
 		bool updated = false;
 		auto st = updateByIdWithDecision(
@@ -232,6 +346,7 @@ template <typename Mut, typename> DbResult<size_t> Collection::updateMany(Mut &&
 		res.status = matches.status;
 		return res;
 	}
+	BatchScope batch(*this);
 	for (const auto &id : matches.value) {
 		bool updated = false;
 		auto st = updateByIdWithDecision(
@@ -1,15 +1,54 @@
 #include "db.h"
 #include "db_runtime.h"
 #include "files/file_store_impl.h"
+#include "storage/doc_codec.h"
+#include "storage/snapshot_codec.h"
+#include "storage/snapshot_json_reader.h"
+#include "storage/tombstone_log.h"
+#include "sync/record_read_ahead.h"
+#include "utils/fs_lock.h"
 #include "utils/fs_utils.h"
 #include "utils/jsondb_allocator.h"
+#include "utils/lock_stats.h"
+#include "utils/lookahead_stream.h"
+#include "utils/op_stats.h"
 #include "utils/time_utils.h"
 #include <StreamUtils.h>
 #include <algorithm>
 #include <cstring>
 
 namespace {
-constexpr uint32_t kTaskStopTimeoutMs = 200;
+// Cold start with preloadWorkers > 1: ids per read job, so large collections
+// are split across the pool as well.
+constexpr size_t kPreloadShardDocs = 64;
+
+// One Eager collection read in parallel during preloadCollectionsFromFs().
+struct PreparedLoad {
+	explicit PreparedLoad(bool usePSRAMBuffers)
+	    : ids(JsonDbAllocator<DocId>(usePSRAMBuffers)),
+	      shards(JsonDbAllocator<Collection::LoadShard>(usePSRAMBuffers)) {
+	}
+
+	std::unique_ptr<Collection> col;
+	JsonDbVector<DocId> ids;
+	JsonDbVector<Collection::LoadShard> shards;
+};
+
+const char *autosyncTriggerToString(DbRuntime::AutosyncTrigger trigger) {
+	switch (trigger) {
+	case DbRuntime::AutosyncTrigger::Interval:
+		return "interval";
+	case DbRuntime::AutosyncTrigger::HighWater:
+		return "highWater";
+	case DbRuntime::AutosyncTrigger::MaxLatency:
+		return "maxLatency";
+	case DbRuntime::AutosyncTrigger::Manual:
+		return "manual";
+	case DbRuntime::AutosyncTrigger::None:
+	default:
+		return "none";
+	}
+}
 static DbStatus removeTree(fs::FS &fsImpl, const std::string &path);
 using DirEntry = std::pair<std::string, bool>;
 using DirEntryVector = JsonDbVector<DirEntry>;
@@ -31,8 +70,6 @@ void invokeJsonDbCallback(const Callback &callback, Args... args) noexcept {
 }
 } // namespace
 
-FrMutex g_fsMutex; // definition of global FS mutex
-
 DbRuntime::DbRuntime(bool usePSRAMBuffers)
     : cols(std::less<std::string>{}, DbRuntime::CollectionMap::allocator_type(usePSRAMBuffers)),
       schemas(std::less<std::string>{}, DbRuntime::SchemaMap::allocator_type(usePSRAMBuffers)),
@@ -52,7 +89,10 @@ DbRuntime::DbRuntime(bool usePSRAMBuffers)
           ),
           0,
           0
-      } {
+      },
+      syncWaiters(JsonDbAllocator<DbRuntime::SyncWaiter>(usePSRAMBuffers)),
+      versions(usePSRAMBuffers) {
+	mu.setName("db");
 }
 
 DbRuntime::~DbRuntime() = default;
@@ -144,6 +184,103 @@ void DbRuntime::noteDocumentDeleted(const std::string &collectionName, uint32_t
 	diagCache.lastRefreshMs = millis();
 }
 
+void DbRuntime::noteDirtyData(size_t bytes) {
+	const uint32_t added = static_cast<uint32_t>(bytes);
+	const uint32_t total = dirtyBytes.fetch_add(added, std::memory_order_acq_rel) + added;
+	const bool firstDirty = !syncWorkPending.exchange(true, std::memory_order_acq_rel);
+	const uint32_t highWater = cfg.dirtyBytesHighWater;
+	const bool crossedHighWater = highWater > 0 && total >= highWater && total - added < highWater;
+	// Only the clean -> dirty transition and the high-water crossing need to
+	// wake the sync task; everything in between is picked up by the same pass.
+	if (!firstDirty && !crossedHighWater)
+		return;
+	FrLock lk(mu);
+	if (firstDirty)
+		autosync.firstDirtyMs = millis();
+	wakeSyncTaskLocked();
+}
+
+void DbRuntime::wakeSyncTaskLocked() {
+	if (syncTask != nullptr)
+		xTaskNotifyGive(syncTask);
+}
+
+void DbRuntime::releaseSyncWaitersLocked(uint32_t completedSeq) {
+	auto it = syncWaiters.begin();
+	while (it != syncWaiters.end()) {
+		if (it->targetSeq <= completedSeq) {
+			xSemaphoreGive(it->done);
+			it = syncWaiters.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+uint32_t DbRuntime::nextAutosyncDelayMs(uint32_t now, AutosyncTrigger &trigger) {
+	const uint32_t highWater = cfg.dirtyBytesHighWater;
+	if (highWater > 0 && dirtyBytes.load(std::memory_order_acquire) >= highWater) {
+		trigger = AutosyncTrigger::HighWater;
+		return 0;
+	}
+	FrLock lk(mu);
+	const auto &state = autosync;
+	const bool dirtyPending = syncWorkPending.load(std::memory_order_acquire);
+	// The period runs from whichever is later: the previous pass or the first
+	// write after it. After a quiet spell the first write therefore waits a
+	// (possibly stretched) period for company instead of flushing alone.
+	uint32_t anchorMs = state.lastPassMs;
+	if (dirtyPending && static_cast<int32_t>(state.firstDirtyMs - state.lastPassMs) > 0)
+		anchorMs = state.firstDirtyMs;
+	const uint32_t elapsed = now - anchorMs;
+	uint32_t delayMs = elapsed >= state.currentIntervalMs ? 0 : state.currentIntervalMs - elapsed;
+	trigger = AutosyncTrigger::Interval;
+	if (cfg.maxLatencyMs > 0 && dirtyPending) {
+		const uint32_t age = now - state.firstDirtyMs;
+		const uint32_t latencyDelayMs = age >= cfg.maxLatencyMs ? 0 : cfg.maxLatencyMs - age;
+		if (latencyDelayMs < delayMs) {
+			delayMs = latencyDelayMs;
+			trigger = AutosyncTrigger::MaxLatency;
+		}
+	}
+	return delayMs;
+}
+
+void DbRuntime::recordAutosyncPassLocked(
+    AutosyncTrigger trigger, uint32_t passStartMs, uint32_t passDirtyBytes, uint32_t idleBeforeDirtyMs
+) {
+	auto &state = autosync;
+	const uint32_t baseMs = std::max<uint32_t>(cfg.intervalMs, 1U);
+	const uint32_t capMs = std::max<uint32_t>(cfg.maxIntervalMs, baseMs);
+	if (trigger == AutosyncTrigger::Manual) {
+		++state.manualPasses;
+	} else if (trigger == AutosyncTrigger::HighWater) {
+		// Burst: fall back to the base period so the next batch flushes promptly.
+		++state.highWaterPasses;
+		state.currentIntervalMs = baseMs;
+	} else {
+		if (trigger == AutosyncTrigger::MaxLatency)
+			++state.maxLatencyPasses;
+		else
+			++state.intervalPasses;
+		if (passDirtyBytes > 0) {
+			// A full period without writes before this batch means the workload
+			// is quiet: stretch the period to batch more writes per flash pass.
+			// Steady traffic halves it back towards the base interval.
+			if (idleBeforeDirtyMs >= state.currentIntervalMs) {
+				state.currentIntervalMs = state.currentIntervalMs > capMs / 2
+				                              ? capMs
+				                              : state.currentIntervalMs * 2U;
+			} else {
+				state.currentIntervalMs = std::max<uint32_t>(state.currentIntervalMs / 2U, baseMs);
+			}
+		}
+	}
+	state.lastPassMs = passStartMs;
+	state.lastPassDirtyBytes = passDirtyBytes;
+	state.lastTrigger = trigger;
+}
+
 std::string DbRuntime::fileRootDir() const {
 	return joinPath(baseDir, "_files");
 }
@@ -354,6 +491,11 @@ void ESPJsonDB::rebindAllocatorAwareStateLocked(bool preserveData) {
 	_syncStatusCbs = std::move(newSyncStatusCbs);
 	_pendingDelayedCollections = std::move(newPendingDelayed);
 	_diagCache.docsPerCollection = std::move(newDiagDocs);
+	// The sync task is stopped while rebinding, so no waiters can be parked.
+	_rt->syncWaiters = DbRuntime::SyncWaiterVector{
+	    JsonDbAllocator<DbRuntime::SyncWaiter>(usePSRAMBuffers)
+	};
+	_rt->versions.rebind(usePSRAMBuffers);
 	if (preserveData) {
 		_lastSyncStatus = oldLastSyncStatus;
 	} else {
@@ -365,12 +507,6 @@ bool ESPJsonDB::createTask(TaskFunction_t entry, const char *name, TaskHandle_t
 	return _rt->createTask(entry, name, this, outHandle);
 }
 
-void ESPJsonDB::stopTask(
-    TaskHandle_t &taskHandle, std::atomic<bool> &stopRequested, std::atomic<bool> &taskExited
-) {
-	_rt->stopTask(taskHandle, stopRequested, taskExited);
-}
-
 bool ESPJsonDB::isReservedName(const std::string &name) const {
 	return name == "_files";
 }
@@ -389,13 +525,15 @@ void ESPJsonDB::rebuildDelayedCollectionStateFromConfigLocked() {
 		}
 	}
 	_delayedPreloadPhaseCompleted = _pendingDelayedCollections.empty();
+	if (!_delayedPreloadPhaseCompleted)
+		_rt->wakeSyncTaskLocked();
 }
 
 bool ESPJsonDB::collectionDirExistsOnFs(const std::string &name) const {
 	if (!_fs || name.empty())
 		return false;
 	const std::string dirPath = joinPath(_baseDir, name);
-	FrLock fs(g_fsMutex);
+	FsNamespaceLock fs;
 	if (!_fs->exists(dirPath.c_str()))
 		return false;
 	File dir = _fs->open(dirPath.c_str());
@@ -414,8 +552,6 @@ DbStatus ESPJsonDB::preloadCollectionFromFsByName(
 		return {DbStatusCode::Ok, ""};
 	}
 
-	Schema sc{};
-	CollectionConfig collectionCfg{};
 	{
 		FrLock lk(_mu);
 		auto it = _cols.find(name);
@@ -427,6 +563,25 @@ DbStatus ESPJsonDB::preloadCollectionFromFsByName(
 			}
 			return {DbStatusCode::Ok, ""};
 		}
+	}
+
+	auto col = makeCollection(name);
+	auto st = col->loadFromFs(_baseDir);
+	if (!st.ok())
+		return st;
+
+	const bool inserted = installCollection(name, std::move(col), markDelayedHandled);
+	if (insertedOut)
+		*insertedOut = inserted;
+
+	return {DbStatusCode::Ok, ""};
+}
+
+std::unique_ptr<Collection> ESPJsonDB::makeCollection(const std::string &name) {
+	Schema sc{};
+	CollectionConfig collectionCfg{};
+	{
+		FrLock lk(_mu);
 		auto sit = _schemas.find(name);
 		if (sit != _schemas.end())
 			sc = sit->second;
@@ -437,29 +592,22 @@ DbStatus ESPJsonDB::preloadCollectionFromFsByName(
 			collectionCfg.loadPolicy = _cfg.defaultLoadPolicy;
 		}
 	}
-
-	auto col = std::make_unique<
+	return std::make_unique<
 	    Collection>(*_rt, name, sc, _baseDir, collectionCfg, _cfg.usePSRAMBuffers, *_fs);
-	auto st = col->loadFromFs(_baseDir);
-	if (!st.ok())
-		return st;
+}
 
-	bool inserted = false;
-	{
-		FrLock lk(_mu);
-		auto [it, didInsert] = _cols.emplace(name, std::move(col));
-		(void)it;
-		inserted = didInsert;
-		if (markDelayedHandled) {
-			_pendingDelayedCollections.erase(name);
-			if (_pendingDelayedCollections.empty())
-				_delayedPreloadPhaseCompleted = true;
-		}
+bool ESPJsonDB::installCollection(
+    const std::string &name, std::unique_ptr<Collection> col, bool markDelayedHandled
+) {
+	FrLock lk(_mu);
+	auto [it, inserted] = _cols.emplace(name, std::move(col));
+	(void)it;
+	if (markDelayedHandled) {
+		_pendingDelayedCollections.erase(name);
+		if (_pendingDelayedCollections.empty())
+			_delayedPreloadPhaseCompleted = true;
 	}
-	if (insertedOut)
-		*insertedOut = inserted;
-
-	return {DbStatusCode::Ok, ""};
+	return inserted;
 }
 
 DbStatus
@@ -579,6 +727,9 @@ DbStatus ESPJsonDB::maybeRunDelayedPreload(
 
 ESPJsonDB::~ESPJsonDB() {
 	deinit();
+	// The sync task still uses this object until a deferred teardown ends.
+	while (_syncTask != nullptr && xTaskGetCurrentTaskHandle() != _syncTask)
+		vTaskDelay(pdMS_TO_TICKS(1));
 }
 
 void ESPJsonDB::deinit() {
@@ -587,15 +738,28 @@ void ESPJsonDB::deinit() {
 	}
 	_initialized.store(false, std::memory_order_release);
 
+	while (!stopSyncTask().ok()) {
+		// Called from a callback on the sync task, or its pass did not end in
+		// time: the task tears down once the pass returns.
+		FrLock lk(_mu);
+		if (!_syncTaskExited.load(std::memory_order_acquire)) {
+			_rt->syncTeardownDeferred = true;
+			return;
+		}
+	}
+	resetAfterSyncStop();
+}
+
+void ESPJsonDB::resetAfterSyncStop() {
 	{
 		FrLock lk(_mu);
 		if (_rt->fileStoreImpl)
 			_rt->fileStoreImpl->stopTask(true);
-		stopSyncTaskUnlocked();
 
 		for (auto &kv : _cols) {
 			if (kv.second)
 				kv.second->markAllRemoved();
+			_rt->versions.dropCollection(kv.first);
 		}
 		_cols.clear();
 		_schemas.clear();
@@ -617,6 +781,9 @@ void ESPJsonDB::deinit() {
 	_syncKickRequested.store(false, std::memory_order_release);
 	_syncRequestSeq.store(0, std::memory_order_release);
 	_syncCompletedSeq.store(0, std::memory_order_release);
+	_rt->syncWorkPending.store(false, std::memory_order_release);
+	_rt->dirtyBytes.store(0, std::memory_order_release);
+	_rt->autosync = DbRuntime::AutosyncState{};
 	_dropAllRequested = false;
 	_baseDir.clear();
 	_cfg = ESPJsonDBConfig{};
@@ -629,6 +796,9 @@ DbStatus ESPJsonDB::init(const char *baseDir, const ESPJsonDBConfig &cfg) {
 	if (isInitialized()) {
 		deinit();
 	}
+	if (_syncTask != nullptr) {
+		return setLastError({DbStatusCode::Busy, "deinit pending on the sync task"});
+	}
 	_initialized.store(false, std::memory_order_release);
 	_baseDir = baseDir ? baseDir : std::string("/db");
 	// Normalize baseDir: ensure leading '/', drop trailing '/'
@@ -768,6 +938,7 @@ DbStatus ESPJsonDB::dropCollection(const std::string &name) {
 			it->second->markAllRemoved();
 		}
 		_cols.erase(it);
+		_rt->versions.dropCollection(name);
 		removed = true;
 	} else {
 		auto delayedIt = _pendingDelayedCollections.find(name);
@@ -793,6 +964,7 @@ DbStatus ESPJsonDB::dropCollection(const std::string &name) {
 	}
 	// schedule directory removal on next sync
 	_colsToDelete.push_back(name);
+	_rt->wakeSyncTaskLocked();
 	// emit event outside lock to avoid callbacks under lock
 	// Defer actual emit after releasing lock
 	// Note: copying name not needed here; just emit generic event
@@ -977,6 +1149,18 @@ ESPJsonDB::findMany(const std::string &name, std::function<bool(const DocView &)
 	return cr.value->findMany(std::move(pred));
 }
 
+DbResult<std::vector<DocumentHeader>> ESPJsonDB::findHeaders(
+    const std::string &name, std::function<bool(const DocumentHeader &)> pred
+) {
+	DbResult<std::vector<DocumentHeader>> res{};
+	auto cr = collection(name);
+	if (!cr.status.ok()) {
+		res.status = cr.status;
+		return res;
+	}
+	return cr.value->findHeaders(std::move(pred));
+}
+
 DbResult<DocView>
 ESPJsonDB::findOne(const std::string &name, std::function<bool(const DocView &)> pred) {
 	auto cr = collection(name);
@@ -1096,7 +1280,7 @@ DbStatus ESPJsonDB::syncNow() {
 		    {DbStatusCode::Ok, ""}
 		);
 		auto delayedStatus = maybeRunDelayedPreload(false, true, DBSyncSource::SyncNow);
-		auto passStatus = runSyncPass();
+		auto passStatus = runSyncPass(true);
 		DbStatus finalStatus = delayedStatus.ok() ? passStatus : delayedStatus;
 		if (!finalStatus.ok()) {
 			setLastError(finalStatus);
@@ -1123,28 +1307,53 @@ DbStatus ESPJsonDB::syncNow() {
 		return st;
 	}
 
-	const uint32_t targetSeq = _syncRequestSeq.fetch_add(1, std::memory_order_acq_rel) + 1;
-	_syncKickRequested.store(true, std::memory_order_release);
+	SemaphoreHandle_t done = xSemaphoreCreateBinary();
+	if (done == nullptr) {
+		auto st = setLastError({DbStatusCode::Busy, "sync waiter alloc failed"});
+		emitSyncStatus(DBSyncStage::SyncFailed, DBSyncSource::SyncNow, "", 0, 0, st);
+		return st;
+	}
+	uint32_t targetSeq = 0;
+	{
+		FrLock lk(_mu);
+		targetSeq = _syncRequestSeq.fetch_add(1, std::memory_order_acq_rel) + 1;
+		_rt->syncWaiters.push_back({targetSeq, done});
+		_syncKickRequested.store(true, std::memory_order_release);
+		_rt->wakeSyncTaskLocked();
+	}
 
-	const uint32_t startMs = millis();
+	// The sync task (or stopSyncTask) gives `done` once targetSeq is
+	// covered, so the caller sleeps instead of polling the sequence counters.
 	const uint32_t timeoutMs = std::max<uint32_t>(_cfg.intervalMs + 1000U, 60000U);
-	while (_syncCompletedSeq.load(std::memory_order_acquire) < targetSeq) {
-		if (_syncStopRequested.load(std::memory_order_acquire)) {
-			auto st = setLastError({DbStatusCode::Busy, "sync task stopping"});
-			emitSyncStatus(DBSyncStage::SyncFailed, DBSyncSource::SyncNow, "", 0, 0, st);
-			return st;
-		}
-		if ((millis() - startMs) > timeoutMs) {
-			auto st = setLastError({DbStatusCode::Busy, "sync task timeout"});
-			emitSyncStatus(DBSyncStage::SyncFailed, DBSyncSource::SyncNow, "", 0, 0, st);
-			return st;
-		}
-		vTaskDelay(pdMS_TO_TICKS(1));
+	xSemaphoreTake(done, pdMS_TO_TICKS(timeoutMs));
+	{
+		FrLock lk(_mu);
+		auto &waiters = _rt->syncWaiters;
+		waiters.erase(
+		    std::remove_if(
+		        waiters.begin(),
+		        waiters.end(),
+		        [done](const DbRuntime::SyncWaiter &w) { return w.done == done; }
+		    ),
+		    waiters.end()
+		);
+	}
+	vSemaphoreDelete(done);
+
+	if (_syncStopRequested.load(std::memory_order_acquire)) {
+		auto st = setLastError({DbStatusCode::Busy, "sync task stopping"});
+		emitSyncStatus(DBSyncStage::SyncFailed, DBSyncSource::SyncNow, "", 0, 0, st);
+		return st;
+	}
+	if (_syncCompletedSeq.load(std::memory_order_acquire) < targetSeq) {
+		auto st = setLastError({DbStatusCode::Busy, "sync task timeout"});
+		emitSyncStatus(DBSyncStage::SyncFailed, DBSyncSource::SyncNow, "", 0, 0, st);
+		return st;
 	}
 	return _lastError;
 }
 
-DbStatus ESPJsonDB::runSyncPass() {
+DbStatus ESPJsonDB::runSyncPass(bool includeDeferred) {
 	// Snapshot work under lock
 	DbRuntime::StringVector colsToDrop{JsonDbAllocator<std::string>(_cfg.usePSRAMBuffers)};
 	JsonDbVector<Collection *> cols{JsonDbAllocator<Collection *>(_cfg.usePSRAMBuffers)};
@@ -1184,15 +1393,33 @@ DbStatus ESPJsonDB::runSyncPass() {
 			anyChanges = true;
 		}
 	}
-	// Flush each collection
+	// Flush each collection; Deferred ones only on an explicit syncNow(). One
+	// job per collection keeps its writes ordered while the pool spreads
+	// independent collections across the helper tasks.
+	FlushPool::JobVector jobs{JsonDbAllocator<FlushPool::Job>(_cfg.usePSRAMBuffers)};
+	jobs.reserve(cols.size());
+	std::atomic<bool> anyFlushed{false};
 	for (auto *c : cols) {
-		bool changed = false;
-		auto st = c->flushDirtyToFs(_baseDir, changed);
-		if (!st.ok()) {
-			return setLastError(st);
-		}
-		if (changed)
-			anyChanges = true;
+		if (!includeDeferred && c->config().durability == CollectionDurability::Deferred)
+			continue;
+		jobs.emplace_back([this, c, &anyFlushed]() {
+			bool changed = false;
+			auto st = c->flushDirtyToFs(_baseDir, changed);
+			if (changed)
+				anyFlushed.store(true, std::memory_order_release);
+			return st;
+		});
+	}
+	// run() returns only once every helper is done, since the jobs capture
+	// this frame.
+	auto flushStatus = _rt->flushPool.run(jobs);
+	if (anyFlushed.load(std::memory_order_acquire))
+		anyChanges = true;
+	// Tier passes run here rather than on the lookup path.
+	for (auto *c : cols)
+		c->rebalanceTiersIfDue();
+	if (!flushStatus.ok()) {
+		return setLastError(flushStatus);
 	}
 	// Only refresh diagnostics and emit Sync if there were actual changes
 	if (anyChanges) {
@@ -1209,22 +1436,49 @@ void ESPJsonDB::syncTaskThunk(void *arg) {
 }
 
 void ESPJsonDB::syncTaskLoop() {
-	uint32_t lastSyncMs = millis();
-	while (!_syncStopRequested.load(std::memory_order_acquire)) {
+	{
+		FrLock lk(_mu);
+		_rt->autosync.currentIntervalMs = std::max<uint32_t>(_cfg.intervalMs, 1U);
+		_rt->autosync.lastPassMs = millis();
+	}
+	bool teardown = false;
+	for (;;) {
+		if (_syncStopRequested.load(std::memory_order_acquire) && confirmSyncStop(teardown))
+			break;
 		bool shouldRun = false;
 		bool triggeredByPeriodic = false;
+		auto trigger = DbRuntime::AutosyncTrigger::Manual;
 		if (_syncKickRequested.exchange(false, std::memory_order_acq_rel)) {
 			shouldRun = true;
 		}
 		const uint32_t now = millis();
-		if (!shouldRun && _cfg.autosync && (now - lastSyncMs) >= _cfg.intervalMs) {
-			shouldRun = true;
-			triggeredByPeriodic = true;
+		TickType_t waitTicks = portMAX_DELAY;
+		if (!shouldRun && _cfg.autosync && hasPendingSyncWork()) {
+			const uint32_t delayMs = _rt->nextAutosyncDelayMs(now, trigger);
+			if (delayMs == 0) {
+				shouldRun = true;
+				triggeredByPeriodic = true;
+			} else {
+				waitTicks = pdMS_TO_TICKS(delayMs);
+				if (waitTicks == 0)
+					waitTicks = 1;
+			}
 		}
 		if (!shouldRun) {
-			vTaskDelay(pdMS_TO_TICKS(10));
+			// Sleep until syncNow/dropAll kicks us, a write dirties data or
+			// crosses the high-water mark, the next deadline passes, or stop
+			// is requested.
+			ulTaskNotifyTake(pdTRUE, waitTicks);
 			continue;
 		}
+		uint32_t idleBeforeDirtyMs = 0;
+		{
+			FrLock lk(_mu);
+			if (_rt->syncWorkPending.load(std::memory_order_acquire))
+				idleBeforeDirtyMs = _rt->autosync.firstDirtyMs - _rt->autosync.lastPassMs;
+		}
+		_rt->syncWorkPending.store(false, std::memory_order_release);
+		const uint32_t passDirtyBytes = _rt->dirtyBytes.exchange(0, std::memory_order_acq_rel);
 		const uint32_t targetSeq = _syncRequestSeq.load(std::memory_order_acquire);
 		const uint32_t completedBefore = _syncCompletedSeq.load(std::memory_order_acquire);
 		const bool isManualSyncNow = targetSeq > completedBefore;
@@ -1247,8 +1501,16 @@ void ESPJsonDB::syncTaskLoop() {
 		if (!delayedStatus.ok()) {
 			setLastError(delayedStatus);
 		}
-		lastSyncMs = now;
-		auto syncStatus = runSyncPass();
+		{
+			FrLock lk(_mu);
+			_rt->recordAutosyncPassLocked(trigger, now, passDirtyBytes, idleBeforeDirtyMs);
+		}
+		const uint32_t passStartedMs = millis();
+		auto syncStatus = runSyncPass(isManualSyncNow);
+		{
+			FrLock lk(_mu);
+			_rt->autosync.lastPassDurationMs = millis() - passStartedMs;
+		}
 		DbStatus finalStatus = delayedStatus.ok() ? syncStatus : delayedStatus;
 		if (!finalStatus.ok()) {
 			setLastError(finalStatus);
@@ -1279,9 +1541,33 @@ void ESPJsonDB::syncTaskLoop() {
 		       !_syncCompletedSeq
 		            .compare_exchange_weak(completed, targetSeq, std::memory_order_acq_rel)) {
 		}
+		{
+			FrLock lk(_mu);
+			_rt->releaseSyncWaitersLocked(_syncCompletedSeq.load(std::memory_order_acquire));
+		}
 	}
-	_syncTaskExited.store(true, std::memory_order_release);
-	vTaskDelete(nullptr);
+	if (teardown) {
+		// deinit() could not join this task and left the teardown to it.
+		// Releasing the handle comes last: the destructor waits for it.
+		resetAfterSyncStop();
+		releaseSyncTask(false);
+		vTaskDelete(nullptr);
+	}
+	// stopSyncTask() deletes the task once it sees the flag; suspending
+	// instead of deleting itself keeps the handle valid until then.
+	vTaskSuspend(nullptr);
+}
+
+bool ESPJsonDB::confirmSyncStop(bool &teardown) {
+	FrLock lk(_mu);
+	// changeConfig() withdraws a stop it could not wait for.
+	if (!_syncStopRequested.load(std::memory_order_acquire))
+		return false;
+	teardown = _rt->syncTeardownDeferred;
+	_rt->syncTeardownDeferred = false;
+	if (!teardown)
+		_syncTaskExited.store(true, std::memory_order_release);
+	return true;
 }
 
 void ESPJsonDB::startSyncTaskUnlocked() {
@@ -1293,23 +1579,74 @@ void ESPJsonDB::startSyncTaskUnlocked() {
 	TaskHandle_t handle = nullptr;
 	if (createTask(syncTaskThunk, "db.sync", handle)) {
 		_syncTask = handle;
+		// Helpers are optional: if they cannot be created the pool stays empty
+		// and runSyncPass flushes serially on the sync task.
+		const uint8_t helpers = _cfg.syncWorkers > 1 ? _cfg.syncWorkers - 1 : 0;
+		(void)_rt->flushPool.start(*_rt, helpers);
 	} else {
 		_syncTaskExited.store(true, std::memory_order_release);
 	}
 }
 
-void ESPJsonDB::stopSyncTaskUnlocked() {
-	stopTask(_syncTask, _syncStopRequested, _syncTaskExited);
+DbStatus ESPJsonDB::stopSyncTask() {
+	// A pass takes _mu, collection locks and fs locks, so the task is joined
+	// after its current pass rather than deleted mid-pass, and _mu must not
+	// be held here. The stop stays requested when the join fails.
+	if (_syncTask != nullptr) {
+		_syncStopRequested.store(true, std::memory_order_release);
+		if (xTaskGetCurrentTaskHandle() == _syncTask)
+			return {DbStatusCode::Busy, "called from the sync task"};
+		// The task may be parked indefinitely; wake it so it observes the stop.
+		xTaskNotifyGive(_syncTask);
+		const uint32_t startMs = millis();
+		while (!_syncTaskExited.load(std::memory_order_acquire)) {
+			if ((millis() - startMs) >= DbRuntime::kTaskStopTimeoutMs)
+				return {DbStatusCode::Busy, "sync task did not stop"};
+			vTaskDelay(pdMS_TO_TICKS(1));
+		}
+	}
+	releaseSyncTask(true);
+	return {DbStatusCode::Ok, ""};
+}
+
+bool ESPJsonDB::withdrawSyncStop() {
+	FrLock lk(_mu);
+	if (_syncTaskExited.load(std::memory_order_acquire))
+		return false;
+	_syncStopRequested.store(false, std::memory_order_release);
+	return true;
+}
+
+void ESPJsonDB::releaseSyncTask(bool deleteTask) {
+	// Helpers are idle between passes, so they stop right away.
+	auto poolStatus = _rt->flushPool.stop();
+	if (!poolStatus.ok())
+		setLastError(poolStatus);
 	_syncKickRequested.store(false, std::memory_order_release);
+	FrLock lk(_mu);
+	if (_syncTask != nullptr) {
+		// Suspended past its loop; writers wake it only under _mu.
+		if (deleteTask)
+			vTaskDelete(_syncTask);
+		_syncTask = nullptr;
+	}
 	_syncCompletedSeq.store(
 	    _syncRequestSeq.load(std::memory_order_acquire),
 	    std::memory_order_release
 	);
+	_rt->releaseSyncWaitersLocked(_syncCompletedSeq.load(std::memory_order_acquire));
+}
+
+bool ESPJsonDB::hasPendingSyncWork() {
+	if (_rt->syncWorkPending.load(std::memory_order_acquire))
+		return true;
+	FrLock lk(_mu);
+	return !_delayedPreloadPhaseCompleted || !_colsToDelete.empty() || _dropAllRequested;
 }
 
 namespace {
 static void listDirEntries(fs::FS &fsImpl, const std::string &dir, DirEntryVector &out) {
-	FrLock fs(g_fsMutex);
+	FsNamespaceLock fs;
 	if (!fsImpl.exists(dir.c_str()))
 		return;
 	File d = fsImpl.open(dir.c_str());
@@ -1333,7 +1670,7 @@ static DbStatus removeTree(fs::FS &fsImpl, const std::string &path) {
 	// Check if path is a directory
 	bool isDir = false;
 	{
-		FrLock fs(g_fsMutex);
+		FsNamespaceLock fs;
 		if (!fsImpl.exists(path.c_str()))
 			return {DbStatusCode::Ok, ""};
 		File f = fsImpl.open(path.c_str());
@@ -1345,7 +1682,7 @@ static DbStatus removeTree(fs::FS &fsImpl, const std::string &path) {
 		}
 	}
 	if (!isDir) {
-		FrLock fs(g_fsMutex);
+		FsNamespaceLock fs;
 		if (!fsImpl.remove(path.c_str())) {
 			return {DbStatusCode::IoError, "remove file failed during recursive remove"};
 		}
@@ -1361,7 +1698,7 @@ static DbStatus removeTree(fs::FS &fsImpl, const std::string &path) {
 				return st;
 			}
 		} else {
-			FrLock fs(g_fsMutex);
+			FsNamespaceLock fs;
 			if (!fsImpl.remove(e.first.c_str())) {
 				return {DbStatusCode::IoError, "remove child file failed during recursive remove"};
 			}
@@ -1369,7 +1706,7 @@ static DbStatus removeTree(fs::FS &fsImpl, const std::string &path) {
 	}
 	// Finally remove the directory itself
 	{
-		FrLock fs(g_fsMutex);
+		FsNamespaceLock fs;
 		if (!fsImpl.rmdir(path.c_str())) {
 			return {DbStatusCode::IoError, "remove directory failed during recursive remove"};
 		}
@@ -1497,7 +1834,7 @@ DbStatus ESPJsonDB::preloadCollectionsFromFs(bool emitStatus, DBSyncSource statu
 
 	JsonDbVector<std::string> names{JsonDbAllocator<std::string>(_cfg.usePSRAMBuffers)};
 	{
-		FrLock fs(g_fsMutex);
+		FsNamespaceLock fs;
 		if (!_fs->exists(_baseDir.c_str())) {
 			return setLastError({DbStatusCode::Ok, ""});
 		}
@@ -1542,6 +1879,7 @@ DbStatus ESPJsonDB::preloadCollectionsFromFs(bool emitStatus, DBSyncSource statu
 			if (policy == CollectionLoadPolicy::Delayed) {
 				_pendingDelayedCollections[name] = true;
 				_delayedPreloadPhaseCompleted = false;
+				_rt->wakeSyncTaskLocked();
 				continue;
 			}
 			if (policy != CollectionLoadPolicy::Eager)
@@ -1563,7 +1901,48 @@ DbStatus ESPJsonDB::preloadCollectionsFromFs(bool emitStatus, DBSyncSource statu
 		);
 	}
 
-	for (const auto &name : preloadNames) {
+	// With preloadWorkers > 1, the record files of every Eager collection are
+	// read up front in shards spread over a pool; the loop below then only
+	// indexes what was read.
+	JsonDbVector<PreparedLoad> prepared{JsonDbAllocator<PreparedLoad>(_cfg.usePSRAMBuffers)};
+	const uint8_t helpers = _cfg.preloadWorkers > 1 ? _cfg.preloadWorkers - 1 : 0;
+	FlushPool pool;
+	if (helpers > 0 && !preloadNames.empty() && pool.start(*_rt, helpers)) {
+		prepared.reserve(preloadNames.size());
+		for (const auto &name : preloadNames) {
+			prepared.emplace_back(_cfg.usePSRAMBuffers);
+			auto &load = prepared.back();
+			load.col = makeCollection(name);
+			load.ids = load.col->beginLoad();
+			const size_t shards = (load.ids.size() + kPreloadShardDocs - 1) / kPreloadShardDocs;
+			for (size_t i = 0; i < shards; ++i)
+				load.shards.emplace_back(_cfg.usePSRAMBuffers);
+		}
+		FlushPool::JobVector jobs{JsonDbAllocator<FlushPool::Job>(_cfg.usePSRAMBuffers)};
+		for (auto &load : prepared) {
+			for (size_t i = 0; i < load.shards.size(); ++i) {
+				jobs.push_back([&load, i]() {
+					return load.col->loadShard(
+					    load.ids,
+					    i * kPreloadShardDocs,
+					    kPreloadShardDocs,
+					    load.shards[i]
+					);
+				});
+			}
+		}
+		auto st = pool.run(jobs);
+		pool.stop();
+		if (!st.ok()) {
+			if (emitStatus) {
+				emitSyncStatus(DBSyncStage::SyncFailed, statusSource, "", completed, total, st);
+			}
+			return setLastError(st);
+		}
+	}
+
+	for (size_t idx = 0; idx < preloadNames.size(); ++idx) {
+		const auto &name = preloadNames[idx];
 		if (emitStatus) {
 			emitSyncStatus(
 			    DBSyncStage::ColdSyncCollectionStarted,
@@ -1574,7 +1953,15 @@ DbStatus ESPJsonDB::preloadCollectionsFromFs(bool emitStatus, DBSyncSource statu
 			    {DbStatusCode::Ok, ""}
 			);
 		}
-		auto st = preloadCollectionFromFsByName(name, false);
+		DbStatus st{DbStatusCode::Ok, ""};
+		if (prepared.empty()) {
+			st = preloadCollectionFromFsByName(name, false);
+		} else {
+			auto &load = prepared[idx];
+			st = load.col->finishLoad(load.shards);
+			if (st.ok())
+				(void)installCollection(name, std::move(load.col), false);
+		}
 		if (!st.ok()) {
 			if (emitStatus) {
 				emitSyncStatus(DBSyncStage::SyncFailed, statusSource, name, completed, total, st);
@@ -1626,8 +2013,12 @@ JsonDocument ESPJsonDB::getDiagnostics() {
 	// Copy of configuration for reporting
 	ESPJsonDBConfig cfgCopy{};
 	std::string baseDirCopy;
+	DbRuntime::AutosyncState autosyncCopy{};
+	bool dirtyPending = false;
 	{
 		FrLock lk(_mu);
+		autosyncCopy = _rt->autosync;
+		dirtyPending = _rt->syncWorkPending.load(std::memory_order_acquire);
 		cached = _diagCache.docsPerCollection; // copy
 		lastRefreshMs = _diagCache.lastRefreshMs;
 		for (auto &kv : _cols) {
@@ -1683,12 +2074,87 @@ JsonDocument ESPJsonDB::getDiagnostics() {
 	cfg["coreId"] = static_cast<int32_t>(cfgCopy.coreId);
 	cfg["usePSRAMBuffers"] = cfgCopy.usePSRAMBuffers;
 	cfg["defaultLoadPolicy"] = static_cast<uint8_t>(cfgCopy.defaultLoadPolicy);
+	cfg["dirtyBytesHighWater"] = cfgCopy.dirtyBytesHighWater;
+	cfg["maxIntervalMs"] = cfgCopy.maxIntervalMs;
+	cfg["maxLatencyMs"] = cfgCopy.maxLatencyMs;
+	cfg["syncWorkers"] = static_cast<uint32_t>(cfgCopy.syncWorkers);
+	cfg["preloadWorkers"] = static_cast<uint32_t>(cfgCopy.preloadWorkers);
+	cfg["snapshotReadAhead"] = static_cast<uint32_t>(cfgCopy.snapshotReadAhead);
+
+	// Adaptive autosync policy state
+	auto autosync = doc["autosync"].to<JsonObject>();
+	autosync["currentIntervalMs"] = autosyncCopy.currentIntervalMs;
+	autosync["pendingDirtyBytes"] = _rt->dirtyBytes.load(std::memory_order_acquire);
+	autosync["oldestDirtyAgeMs"] = dirtyPending ? millis() - autosyncCopy.firstDirtyMs : 0u;
+	autosync["lastPassMs"] = autosyncCopy.lastPassMs;
+	autosync["lastPassDirtyBytes"] = autosyncCopy.lastPassDirtyBytes;
+	autosync["lastPassDurationMs"] = autosyncCopy.lastPassDurationMs;
+	autosync["lastTrigger"] = autosyncTriggerToString(autosyncCopy.lastTrigger);
+	autosync["intervalPasses"] = autosyncCopy.intervalPasses;
+	autosync["highWaterPasses"] = autosyncCopy.highWaterPasses;
+	autosync["maxLatencyPasses"] = autosyncCopy.maxLatencyPasses;
+	autosync["manualPasses"] = autosyncCopy.manualPasses;
+
+#if ESP_JSONDB_SLAB_POOLS
+	SlabPools::instance().statsToJson(doc["allocatorPools"].to<JsonObject>());
+#endif
+
+#if ESP_JSONDB_OP_STATS
+	// Operation latencies (process-wide, since boot) and per-collection totals
+	g_opStats.toJson(doc["operations"].to<JsonObject>());
+	auto collectionOps = doc["collectionOperations"].to<JsonObject>();
+	{
+		FrLock lk(_mu);
+		for (const auto &kv : _cols) {
+			if (kv.second && !isReservedName(kv.first))
+				kv.second->opStatsToJson(collectionOps[kv.first.c_str()].to<JsonObject>());
+		}
+	}
+#endif
+
+#if ESP_JSONDB_LOCK_STATS
+	// Named library locks with the most wait time (process-wide, since boot)
+	LockProfiler::instance().topToJson(doc["locks"].to<JsonArray>());
+#endif
+
+	// Hot/cold payload tiers of collections with CollectionConfig::hotTierBytes
+	auto memoryTiers = doc["memoryTiers"].to<JsonObject>();
+	{
+		FrLock lk(_mu);
+		for (const auto &kv : _cols) {
+			if (!kv.second || isReservedName(kv.first) || kv.second->config().hotTierBytes == 0)
+				continue;
+			const auto stats = kv.second->tierStats();
+			auto tiers = memoryTiers[kv.first.c_str()].to<JsonObject>();
+			tiers["hotBytes"] = static_cast<uint32_t>(stats.hotBytes);
+			tiers["hotBudgetBytes"] = static_cast<uint32_t>(kv.second->config().hotTierBytes);
+			tiers["coldBytes"] = static_cast<uint32_t>(stats.coldBytes);
+			tiers["coldBudgetBytes"] = static_cast<uint32_t>(kv.second->config().coldTierBytes);
+			tiers["hotRecords"] = stats.hotRecords;
+			tiers["coldRecords"] = stats.coldRecords;
+			tiers["promotions"] = stats.promotions;
+			tiers["demotions"] = stats.demotions;
+			tiers["evictions"] = stats.evictions;
+			tiers["passes"] = stats.passes;
+		}
+	}
+
+	// Open read snapshots and the superseded versions they keep alive
+	uint32_t retainedVersions = 0;
+	uint32_t retainedBytes = 0;
+	_rt->versions.stats(retainedVersions, retainedBytes);
+	auto readSnapshots = doc["readSnapshots"].to<JsonObject>();
+	readSnapshots["open"] = _rt->versions.openCount();
+	readSnapshots["retainedVersions"] = retainedVersions;
+	readSnapshots["retainedBytes"] = retainedBytes;
 
 	auto policies = cfg["collectionLoadPolicies"].to<JsonObject>();
+	auto durability = cfg["collectionDurability"].to<JsonObject>();
 	{
 		FrLock lk(_mu);
 		for (const auto &kv : _collectionConfigs) {
 			policies[kv.first.c_str()] = static_cast<uint8_t>(kv.second.loadPolicy);
+			durability[kv.first.c_str()] = static_cast<uint8_t>(kv.second.durability);
 		}
 	}
 
@@ -1763,11 +2229,19 @@ DbStatus ESPJsonDB::changeConfig(const ESPJsonDBConfig &cfg) {
 		return setLastError(ready);
 	}
 	// Stop existing task if running and apply new config
+	auto stopStatus = stopSyncTask();
+	if (!stopStatus.ok()) {
+		// Keep the running task unless it exited while we gave up on it.
+		if (withdrawSyncStop())
+			return setLastError(stopStatus);
+		stopStatus = stopSyncTask();
+		if (!stopStatus.ok())
+			return setLastError(stopStatus);
+	}
 	{
 		FrLock lk(_mu);
 		if (_rt->fileStoreImpl)
 			_rt->fileStoreImpl->stopTask(true);
-		stopSyncTaskUnlocked();
 		_cfg = cfg;
 		rebindAllocatorAwareStateLocked(true);
 		_rt->fileStoreImpl = std::make_unique<FileStoreImpl>(*_rt);
@@ -1815,111 +2289,300 @@ std::string snapshotCollectionName(const std::string &path) {
 	auto pos = path.find_last_of('/');
 	return (pos == std::string::npos) ? path : path.substr(pos + 1);
 }
+
+// Inverse of fillSnapshotEntry. Entries without an _id leave `hasId` false.
+DbStatus recordFromSnapshotEntry(JsonObjectConst obj, DocumentRecord &record, bool &hasId) {
+	hasId = false;
+	const char *id = obj["_id"].is<const char *>() ? obj["_id"].as<const char *>() : nullptr;
+	if (!id || !*id)
+		return {DbStatusCode::Ok, ""};
+	if (!DocId::isHex(id, std::strlen(id))) {
+		return {DbStatusCode::InvalidArgument, "snapshot contains invalid _id"};
+	}
+	hasId = true;
+
+	// Copy object without _id into a temp doc
+	JsonDocument tmp;
+	tmp.to<JsonObject>().set(obj);
+	tmp.remove("_id");
+	tmp.remove("_meta");
+
+	size_t sz = measureMsgPack(tmp);
+	record.meta.id = DocId(id);
+	record.msgpack.resize(sz);
+	size_t written = serializeMsgPack(tmp, record.msgpack.data(), record.msgpack.size());
+	if (written != sz)
+		return {DbStatusCode::IoError, "serialize msgpack failed"};
+
+	JsonObjectConst meta = obj["_meta"].as<JsonObjectConst>();
+	if (!meta.isNull()) {
+		record.meta.createdAtMs = meta["createdAtMs"] | nowUtcMs();
+		record.meta.updatedAtMs = meta["updatedAtMs"] | record.meta.createdAtMs;
+		record.meta.revision = meta["revision"] | 1U;
+		record.meta.flags = meta["flags"] | static_cast<uint16_t>(0);
+	} else {
+		record.meta.createdAtMs = nowUtcMs();
+		record.meta.updatedAtMs = record.meta.createdAtMs;
+		record.meta.revision = 1;
+		record.meta.flags = 0;
+	}
+	record.meta.dirty = false;
+	record.meta.removed = false;
+	return {DbStatusCode::Ok, ""};
+}
+
+bool fillSnapshotEntry(JsonObject obj, const DocumentRecord &rec) {
+	JsonDocument payload;
+	auto err = deserializeMsgPack(payload, rec.msgpack.data(), rec.msgpack.size());
+	if (err)
+		return false;
+	obj.set(payload.as<JsonObjectConst>());
+	obj["_id"] = rec.meta.id.c_str();
+	auto meta = obj["_meta"].to<JsonObject>();
+	meta["createdAtMs"] = rec.meta.createdAtMs;
+	meta["updatedAtMs"] = rec.meta.updatedAtMs;
+	meta["revision"] = rec.meta.revision;
+	meta["flags"] = rec.meta.flags;
+	return true;
+}
+// Writers timestamp a change shortly before it gets its commit sequence. The
+// incremental watermark trails the export start by this much so a change in
+// that window lands in the next export rather than in neither.
+constexpr uint64_t kIncrementalOverlapMs = 1000;
+
+// writeSnapshotChunk() resume token: "s1:<last _id>:<open collection>". Both
+// parts are empty when only the opening brace has been written.
+constexpr const char *kChunkTokenPrefix = "s1:";
+
+std::string encodeChunkToken(const std::string &collection, const DocId &lastId) {
+	std::string token = kChunkTokenPrefix;
+	token += lastId.c_str();
+	token += ':';
+	token += collection;
+	return token;
+}
+
+bool decodeChunkToken(const std::string &token, std::string &collection, DocId &lastId) {
+	const size_t prefixLen = std::strlen(kChunkTokenPrefix);
+	if (token.compare(0, prefixLen, kChunkTokenPrefix) != 0)
+		return false;
+	const size_t sep = token.find(':', prefixLen);
+	if (sep == std::string::npos)
+		return false;
+	const size_t idLen = sep - prefixLen;
+	lastId.clear();
+	if (idLen != 0 && !lastId.assign(token.c_str() + prefixLen, idLen))
+		return false;
+	collection = token.substr(sep + 1);
+	return !collection.empty() || idLen == 0;
+}
 } // namespace
 
-DbStatus ESPJsonDB::writeSnapshot(Stream &out, SnapshotMode mode) {
+ReadSnapshot ESPJsonDB::beginRead() {
+	auto ready = ensureReady();
+	if (!ready.ok()) {
+		setLastError(ready);
+		return ReadSnapshot();
+	}
+	setLastError({DbStatusCode::Ok, ""});
+	return ReadSnapshot(this, _rt->versions.begin());
+}
+
+DbResult<Collection *> ESPJsonDB::snapshotCollection(const std::string &name) {
+	// Like collection(), but never creates one just to read from it.
+	{
+		FrLock lk(_mu);
+		auto it = _cols.find(name);
+		if (it != _cols.end()) {
+			return {{DbStatusCode::Ok, ""}, it->second.get()};
+		}
+		const bool pendingDelete =
+		    std::find(_colsToDelete.begin(), _colsToDelete.end(), name) != _colsToDelete.end();
+		const bool pendingDelayed =
+		    _pendingDelayedCollections.find(name) != _pendingDelayedCollections.end();
+		if (pendingDelete || (!pendingDelayed && !collectionDirExistsOnFs(name))) {
+			return {setLastError({DbStatusCode::NotFound, "collection not found"}), nullptr};
+		}
+	}
+	return collection(name);
+}
+
+void ESPJsonDB::listSnapshotCollections(SnapshotMode mode, JsonDbVector<std::string> &names) {
+	DbRuntime::StringBoolMap seen{
+	    std::less<std::string>{},
+	    DbRuntime::StringBoolMap::allocator_type(_cfg.usePSRAMBuffers)
+	};
+	DirEntryVector colDirs{JsonDbAllocator<DirEntry>(_cfg.usePSRAMBuffers)};
+	listDirEntries(*_fs, _baseDir, colDirs);
+	for (auto &entry : colDirs) {
+		if (entry.second)
+			seen[snapshotCollectionName(entry.first)] = true;
+	}
 	if (mode == SnapshotMode::InMemoryConsistent) {
-		auto syncStatus = syncNow();
-		if (!syncStatus.ok()) {
-			return setLastError(syncStatus);
+		FrLock lk(_mu);
+		for (const auto &kv : _cols)
+			seen[kv.first] = true;
+		for (const auto &name : _colsToDelete)
+			seen.erase(name);
+	}
+	names.clear();
+	for (const auto &kv : seen) {
+		if (!isReservedName(kv.first))
+			names.push_back(kv.first);
+	}
+}
+
+DbStatus ESPJsonDB::visitSnapshotCollections(
+    SnapshotMode mode,
+    const std::function<DbStatus(const std::string &)> &onCollection,
+    const std::function<DbStatus(const DocumentRecord &)> &onRecord,
+    const std::function<DbStatus(const JsonDbVector<uint8_t> &)> &onEncoded
+) {
+	if (mode == SnapshotMode::OnDiskOnly) {
+		DbRuntime::StringVector colNames{JsonDbAllocator<std::string>(_cfg.usePSRAMBuffers)};
+		listSnapshotCollections(mode, colNames);
+		DbRuntime::StringVector dirs{JsonDbAllocator<std::string>(_cfg.usePSRAMBuffers)};
+		dirs.reserve(colNames.size());
+		for (const auto &name : colNames)
+			dirs.push_back(joinPath(_baseDir, name));
+		const bool raw = static_cast<bool>(onEncoded);
+		auto deliver = [&](const RecordReadAhead::Item &item) {
+			if (item.kind == RecordReadAhead::Item::Kind::Collection)
+				return onCollection(colNames[item.collection]);
+			// Hand over the stored bytes as-is; no decode, no re-encode.
+			return raw ? onEncoded(item.encoded) : onRecord(*item.record);
+		};
+
+		// With read-ahead, a helper task reads and checks the next records
+		// while this task encodes and writes the current one.
+		RecordReadAhead readAhead(*_fs, _cfg.usePSRAMBuffers, raw);
+		if (readAhead.start(*_rt, dirs, _cfg.snapshotReadAhead)) {
+			RecordReadAhead::Item item(_cfg.usePSRAMBuffers);
+			while (readAhead.next(item)) {
+				auto st = deliver(item);
+				if (!st.ok())
+					return st; // readAhead's destructor cancels the helper
+			}
+			return {DbStatusCode::Ok, ""};
+		}
+
+		RecordStore store(*_fs, _cfg.usePSRAMBuffers);
+		for (size_t i = 0; i < dirs.size(); ++i) {
+			RecordReadAhead::Item item(_cfg.usePSRAMBuffers);
+			item.kind = RecordReadAhead::Item::Kind::Collection;
+			item.collection = i;
+			auto st = deliver(item);
+			if (!st.ok())
+				return st;
+			const auto ids = store.listIds(dirs[i]);
+			for (const auto &id : ids) {
+				if (!RecordReadAhead::load(store, dirs[i], id.c_str(), raw, item))
+					continue;
+				st = deliver(item);
+				if (!st.ok())
+					return st;
+			}
 		}
+		return {DbStatusCode::Ok, ""};
 	}
+
+	// InMemoryConsistent: read every collection through one read snapshot
+	// instead of forcing a sync, so unflushed changes are included and
+	// concurrent writers neither block nor tear the export.
+	auto snap = beginRead();
+	if (!snap.valid())
+		return lastError();
+
+	DbRuntime::StringVector names{JsonDbAllocator<std::string>(_cfg.usePSRAMBuffers)};
+	listSnapshotCollections(mode, names);
+	for (const auto &name : names) {
+		auto cr = snapshotCollection(name);
+		if (!cr.status.ok()) {
+			if (cr.status.code == DbStatusCode::NotFound)
+				continue;
+			return cr.status;
+		}
+		auto st = onCollection(name);
+		if (!st.ok())
+			return st;
+		DbStatus recordStatus{DbStatusCode::Ok, ""};
+		st = cr.value->visitAt(snap.sequence(), [&](const DocumentRecord &rec) {
+			recordStatus = onRecord(rec);
+			return recordStatus.ok();
+		});
+		if (!recordStatus.ok())
+			return recordStatus;
+		if (!st.ok())
+			return st;
+	}
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus ESPJsonDB::writeSnapshot(Stream &out, SnapshotMode mode, SnapshotFormat format) {
 	if (!_fs) {
 		return setLastError({DbStatusCode::IoError, "filesystem not ready"});
 	}
 
 	WriteBufferingStream buffered(out, 512);
+	if (format == SnapshotFormat::Binary) {
+		auto st = writeBinarySnapshot(buffered, mode);
+		if (!st.ok())
+			return setLastError(st);
+		buffered.flush();
+		if (buffered.getWriteError())
+			return setLastError({DbStatusCode::IoError, "snapshot write failed"});
+		return setLastError({DbStatusCode::Ok, ""});
+	}
+
 	auto writeStatus = writeSnapshotBytes(buffered, "{\"collections\":{");
 	if (!writeStatus.ok()) {
 		return setLastError(writeStatus);
 	}
 
-	DirEntryVector colDirs{JsonDbAllocator<DirEntry>(_cfg.usePSRAMBuffers)};
-	listDirEntries(*_fs, _baseDir, colDirs);
-
-	RecordStore store(*_fs, _cfg.usePSRAMBuffers);
 	bool firstCollection = true;
-	for (auto &entry : colDirs) {
-		if (!entry.second) {
-			continue;
-		}
-
-		const std::string colName = snapshotCollectionName(entry.first);
-		if (isReservedName(colName)) {
-			continue;
-		}
-
+	bool firstDocument = true;
+	auto onCollection = [&](const std::string &colName) {
 		JsonDocument keyDoc;
 		keyDoc.set(colName.c_str());
 		std::string keyJson;
 		serializeJson(keyDoc, keyJson);
 
 		if (!firstCollection) {
-			writeStatus = writeSnapshotBytes(buffered, ",");
-			if (!writeStatus.ok()) {
-				return setLastError(writeStatus);
-			}
+			auto st = writeSnapshotBytes(buffered, "],");
+			if (!st.ok())
+				return st;
 		}
 		firstCollection = false;
+		firstDocument = true;
 
-		writeStatus = writeSnapshotString(buffered, keyJson);
-		if (!writeStatus.ok()) {
-			return setLastError(writeStatus);
-		}
-		writeStatus = writeSnapshotBytes(buffered, ":[");
-		if (!writeStatus.ok()) {
-			return setLastError(writeStatus);
-		}
-
-		const auto ids = store.listIds(entry.first);
-		bool firstDocument = true;
-		for (const auto &id : ids) {
-			auto rec = store.read(entry.first, id.c_str());
-			if (!rec.status.ok() || !rec.value) {
-				continue;
-			}
-
-			JsonDocument payload;
-			auto err =
-			    deserializeMsgPack(payload, rec.value->msgpack.data(), rec.value->msgpack.size());
-			if (err) {
-				continue;
-			}
-
-			JsonDocument snapshotEntry;
-			JsonObject obj = snapshotEntry.to<JsonObject>();
-			obj.set(payload.as<JsonObjectConst>());
-			obj["_id"] = rec.value->meta.id.c_str();
-			auto meta = obj["_meta"].to<JsonObject>();
-			meta["createdAtMs"] = rec.value->meta.createdAtMs;
-			meta["updatedAtMs"] = rec.value->meta.updatedAtMs;
-			meta["revision"] = rec.value->meta.revision;
-			meta["flags"] = rec.value->meta.flags;
+		auto st = writeSnapshotString(buffered, keyJson);
+		if (!st.ok())
+			return st;
+		return writeSnapshotBytes(buffered, ":[");
+	};
+	auto onRecord = [&](const DocumentRecord &rec) {
+		JsonDocument snapshotEntry;
+		if (!fillSnapshotEntry(snapshotEntry.to<JsonObject>(), rec))
+			return DbStatus{DbStatusCode::Ok, ""};
 
-			std::string entryJson;
-			serializeJson(snapshotEntry, entryJson);
+		std::string entryJson;
+		serializeJson(snapshotEntry, entryJson);
 
-			if (!firstDocument) {
-				writeStatus = writeSnapshotBytes(buffered, ",");
-				if (!writeStatus.ok()) {
-					return setLastError(writeStatus);
-				}
-			}
-			firstDocument = false;
-
-			writeStatus = writeSnapshotString(buffered, entryJson);
-			if (!writeStatus.ok()) {
-				return setLastError(writeStatus);
-			}
+		if (!firstDocument) {
+			auto st = writeSnapshotBytes(buffered, ",");
+			if (!st.ok())
+				return st;
 		}
+		firstDocument = false;
+		return writeSnapshotString(buffered, entryJson);
+	};
 
-		writeStatus = writeSnapshotBytes(buffered, "]");
-		if (!writeStatus.ok()) {
-			return setLastError(writeStatus);
-		}
+	writeStatus = visitSnapshotCollections(mode, onCollection, onRecord);
+	if (!writeStatus.ok()) {
+		return setLastError(writeStatus);
 	}
 
-	writeStatus = writeSnapshotBytes(buffered, "}}");
+	writeStatus = writeSnapshotBytes(buffered, firstCollection ? "}}" : "]}}");
 	if (!writeStatus.ok()) {
 		return setLastError(writeStatus);
 	}
@@ -1932,68 +2595,287 @@ DbStatus ESPJsonDB::writeSnapshot(Stream &out, SnapshotMode mode) {
 	return setLastError({DbStatusCode::Ok, ""});
 }
 
-JsonDocument ESPJsonDB::getSnapshot(SnapshotMode mode) {
-	JsonDocument snap;
+DbResult<std::string> ESPJsonDB::writeSnapshotChunk(
+    Stream &out, const std::string &resumeToken, const SnapshotChunkLimits &limits, SnapshotMode mode
+) {
+	DbResult<std::string> res{};
+	if (!_fs) {
+		res.status = setLastError({DbStatusCode::IoError, "filesystem not ready"});
+		return res;
+	}
+	std::string openCollection;
+	DocId lastId;
+	const bool resuming = !resumeToken.empty();
+	if (resuming && !decodeChunkToken(resumeToken, openCollection, lastId)) {
+		res.status = setLastError({DbStatusCode::InvalidArgument, "invalid resume token"});
+		return res;
+	}
+	ReadSnapshot snap;
 	if (mode == SnapshotMode::InMemoryConsistent) {
-		auto syncStatus = syncNow();
-		if (!syncStatus.ok()) {
-			setLastError(syncStatus);
-			return snap;
+		snap = beginRead();
+		if (!snap.valid()) {
+			res.status = lastError();
+			return res;
 		}
 	}
+
+	WriteBufferingStream buffered(out, 512);
+	size_t bytes = 0;
+	size_t documents = 0;
+	bool full = false;
+	// Write `piece` unless it breaks the budget; the first piece always fits.
+	auto emit = [&](const std::string &piece, bool isDocument) {
+		const bool overBytes = limits.maxBytes != 0 && bytes + piece.size() > limits.maxBytes;
+		const bool overDocuments =
+		    isDocument && limits.maxDocuments != 0 && documents >= limits.maxDocuments;
+		if (bytes != 0 && (overBytes || overDocuments)) {
+			full = true;
+			return DbStatus{DbStatusCode::Ok, ""};
+		}
+		auto st = writeSnapshotString(buffered, piece);
+		if (!st.ok())
+			return st;
+		bytes += piece.size();
+		if (isDocument)
+			++documents;
+		return st;
+	};
+
+	// Documents of `name` after lastId, in _id order, until the budget is used.
+	auto writeDocuments = [&](const std::string &name) {
+		DbStatus writeStatus{DbStatusCode::Ok, ""};
+		bool firstDocument = lastId.empty();
+		auto visit = [&](const DocumentRecord &rec) {
+			JsonDocument entry;
+			if (!fillSnapshotEntry(entry.to<JsonObject>(), rec))
+				return true;
+			std::string entryJson;
+			serializeJson(entry, entryJson);
+			writeStatus = emit(firstDocument ? entryJson : "," + entryJson, true);
+			if (!writeStatus.ok() || full)
+				return false;
+			firstDocument = false;
+			lastId = rec.meta.id;
+			return true;
+		};
+		if (mode == SnapshotMode::OnDiskOnly) {
+			RecordStore store(*_fs, _cfg.usePSRAMBuffers);
+			const std::string dir = joinPath(_baseDir, name);
+			auto ids = store.listIds(dir);
+			std::sort(ids.begin(), ids.end(), DocIdLess{});
+			auto it = lastId.empty() ? ids.begin()
+			                         : std::upper_bound(ids.begin(), ids.end(), lastId, DocIdLess{});
+			for (; it != ids.end(); ++it) {
+				auto rec = store.read(dir, it->c_str());
+				if (!rec.status.ok() || !rec.value)
+					continue;
+				if (!visit(*rec.value))
+					break;
+			}
+			return writeStatus;
+		}
+		auto cr = snapshotCollection(name);
+		if (!cr.status.ok()) {
+			return cr.status.code == DbStatusCode::NotFound ? DbStatus{DbStatusCode::Ok, ""}
+			                                               : cr.status;
+		}
+		auto st = cr.value->visitAt(snap.sequence(), lastId, visit);
+		return writeStatus.ok() ? st : writeStatus;
+	};
+
+	DbStatus st{DbStatusCode::Ok, ""};
+	if (!resuming)
+		st = emit("{\"collections\":{", false);
+	// A resumed collection may have been dropped since; it then just closes.
+	if (st.ok() && !full && !openCollection.empty())
+		st = writeDocuments(openCollection);
+	if (st.ok() && !full) {
+		DbRuntime::StringVector names{JsonDbAllocator<std::string>(_cfg.usePSRAMBuffers)};
+		listSnapshotCollections(mode, names);
+		auto it = openCollection.empty()
+		              ? names.begin()
+		              : std::upper_bound(names.begin(), names.end(), openCollection);
+		for (; st.ok() && !full && it != names.end(); ++it) {
+			JsonDocument keyDoc;
+			keyDoc.set(it->c_str());
+			std::string keyJson;
+			serializeJson(keyDoc, keyJson);
+			st = emit((openCollection.empty() ? "" : "],") + keyJson + ":[", false);
+			if (!st.ok() || full)
+				break;
+			openCollection = *it;
+			lastId.clear();
+			st = writeDocuments(openCollection);
+		}
+	}
+	if (st.ok() && !full)
+		st = emit(openCollection.empty() ? "}}" : "]}}", false);
+	if (!st.ok()) {
+		res.status = setLastError(st);
+		return res;
+	}
+	buffered.flush();
+	if (buffered.getWriteError()) {
+		res.status = setLastError({DbStatusCode::IoError, "snapshot write failed"});
+		return res;
+	}
+	res.value = full ? encodeChunkToken(openCollection, lastId) : std::string();
+	res.status = setLastError({DbStatusCode::Ok, ""});
+	return res;
+}
+
+DbStatus ESPJsonDB::writeBinarySnapshot(Print &out, SnapshotMode mode) {
+	auto st = SnapshotCodec::writeHeader(out);
+	if (!st.ok())
+		return st;
+	uint32_t collections = 0;
+	uint32_t records = 0;
+	JsonDbVector<uint8_t> encoded{JsonDbAllocator<uint8_t>(_cfg.usePSRAMBuffers)};
+	st = visitSnapshotCollections(
+	    mode,
+	    [&](const std::string &colName) {
+		    ++collections;
+		    return SnapshotCodec::writeCollection(out, colName);
+	    },
+	    [&](const DocumentRecord &rec) {
+		    // In-memory records only need the .jdb envelope around their msgpack.
+		    auto encodeStatus = DocCodec::encodeRecord(rec, encoded);
+		    if (!encodeStatus.ok())
+			    return encodeStatus;
+		    ++records;
+		    return SnapshotCodec::writeRecord(out, encoded.data(), encoded.size());
+	    },
+	    [&](const JsonDbVector<uint8_t> &stored) {
+		    ++records;
+		    return SnapshotCodec::writeRecord(out, stored.data(), stored.size());
+	    }
+	);
+	if (!st.ok())
+		return st;
+	return SnapshotCodec::writeEnd(out, collections, records);
+}
+
+JsonDocument ESPJsonDB::getSnapshot(SnapshotMode mode) {
+	JsonDocument snap;
 	if (!_fs) {
 		setLastError({DbStatusCode::IoError, "filesystem not ready"});
 		return snap;
 	}
 	auto colsObj = snap["collections"].to<JsonObject>();
-	RecordStore store(*_fs, _cfg.usePSRAMBuffers);
+	JsonArray arr;
+	auto status = visitSnapshotCollections(
+	    mode,
+	    [&](const std::string &colName) {
+		    arr = colsObj[colName.c_str()].to<JsonArray>();
+		    return DbStatus{DbStatusCode::Ok, ""};
+	    },
+	    [&](const DocumentRecord &rec) {
+		    JsonObject obj = arr.add<JsonObject>();
+		    if (!fillSnapshotEntry(obj, rec))
+			    arr.remove(arr.size() - 1);
+		    return DbStatus{DbStatusCode::Ok, ""};
+	    }
+	);
+	if (!status.ok()) {
+		setLastError(status);
+		return JsonDocument();
+	}
+	setLastError({DbStatusCode::Ok, ""});
+	return snap;
+}
 
-	// Scan collections dirs
-	DirEntryVector colDirs{JsonDbAllocator<DirEntry>(_cfg.usePSRAMBuffers)};
-	listDirEntries(*_fs, _baseDir, colDirs);
-	for (auto &cd : colDirs) {
-		if (!cd.second)
-			continue; // not a directory
-		const std::string &full = cd.first;
-		auto p = full.find_last_of('/');
-		std::string colName = (p == std::string::npos) ? full : full.substr(p + 1);
-		if (isReservedName(colName))
-			continue;
+DbStatus ESPJsonDB::restoreFromSnapshot(Stream &in, const SnapshotRestoreProgressCb &onProgress) {
+	// The format byte is taken with a timed read and kept for the decoder;
+	// in.peek() does not wait for it on a network stream.
+	LookaheadStream source(in);
+	if (SnapshotCodec::looksBinary(source.peek()))
+		return restoreBinarySnapshot(source, onProgress);
+	return restoreJsonSnapshot(source, onProgress);
+}
+
+DbStatus ESPJsonDB::restoreJsonSnapshot(Stream &in, const SnapshotRestoreProgressCb &onProgress) {
+	if (!_fs) {
+		return setLastError({DbStatusCode::IoError, "filesystem not ready"});
+	}
+	ReadBufferingStream buffered(in, 512);
+	SnapshotJsonReader reader(buffered);
+	// Nothing is dropped until the header and the first collection key have
+	// parsed, so input that is not a snapshot, or that stalls before its data,
+	// leaves the DB untouched.
+	auto st = reader.begin();
+	if (!st.ok())
+		return setLastError(st);
+	if (reader.incremental()) {
+		return setLastError(
+		    {DbStatusCode::InvalidArgument, "incremental snapshot; use applyIncremental()"}
+		);
+	}
+	bool done = false;
+	std::string colName;
+	st = reader.nextCollection(colName, done);
+	if (!st.ok())
+		return setLastError(st);
+
+	st = dropAll();
+	if (!st.ok())
+		return st;
 
-		// Iterate files in collection dir
-		const auto ids = store.listIds(full);
-		JsonArray arr = colsObj[colName.c_str()].to<JsonArray>();
-		for (const auto &id : ids) {
-			auto rec = store.read(full, id.c_str());
-			if (!rec.status.ok() || !rec.value)
+	RecordStore store(*_fs, _cfg.usePSRAMBuffers);
+	SnapshotRestoreProgress progress;
+	JsonDocument entry;
+	while (!done) {
+		const bool skip = colName.empty() || isReservedName(colName);
+		const std::string dir = joinPath(_baseDir, colName);
+		if (!skip) {
+			FsNamespaceLock fs;
+			fsEnsureDir(*_fs, dir);
+			progress.collectionName = colName;
+			++progress.collectionsRestored;
+		}
+		for (;;) {
+			bool docsDone = false;
+			st = reader.nextDocument(entry, docsDone);
+			if (!st.ok())
+				return setLastError(st);
+			if (docsDone)
+				break;
+			if (skip || !entry.is<JsonObjectConst>())
 				continue;
-			JsonDocument tmp;
-			auto derr =
-			    deserializeMsgPack(tmp, rec.value->msgpack.data(), rec.value->msgpack.size());
-			if (derr)
+			bool restored = false;
+			st = restoreSnapshotEntry(store, dir, entry.as<JsonObjectConst>(), restored);
+			if (!st.ok())
+				return setLastError(st);
+			if (!restored)
 				continue;
-			JsonObject obj = arr.add<JsonObject>();
-			obj.set(tmp.as<JsonObjectConst>());
-			obj["_id"] = rec.value->meta.id.c_str();
-			auto meta = obj["_meta"].to<JsonObject>();
-			meta["createdAtMs"] = rec.value->meta.createdAtMs;
-			meta["updatedAtMs"] = rec.value->meta.updatedAtMs;
-			meta["revision"] = rec.value->meta.revision;
-			meta["flags"] = rec.value->meta.flags;
+			++progress.documentsRestored;
+			if (onProgress)
+				onProgress(progress);
 		}
+		st = reader.nextCollection(colName, done);
+		if (!st.ok())
+			return setLastError(st);
 	}
-	setLastError({DbStatusCode::Ok, ""});
-	return snap;
+	st = reader.finish();
+	if (!st.ok())
+		return setLastError(st);
+
+	refreshDiagFromFs();
+	emitEvent(DBEventType::Sync);
+	return setLastError({DbStatusCode::Ok, ""});
 }
 
-DbStatus ESPJsonDB::restoreFromSnapshot(Stream &in) {
-	ReadBufferingStream buffered(in, 512);
-	JsonDocument snapshot;
-	auto err = deserializeJson(snapshot, buffered);
-	if (err) {
-		return setLastError({DbStatusCode::InvalidArgument, "snapshot parse failed"});
-	}
-	return restoreFromSnapshot(snapshot);
+DbStatus ESPJsonDB::restoreSnapshotEntry(
+    RecordStore &store, const std::string &dir, JsonObjectConst obj, bool &restored
+) {
+	restored = false;
+	DocumentRecord record(_cfg.usePSRAMBuffers);
+	bool hasId = false;
+	auto st = recordFromSnapshotEntry(obj, record, hasId);
+	if (!st.ok() || !hasId)
+		return st;
+	st = store.write(dir, record);
+	restored = st.ok();
+	return st;
 }
 
 DbStatus ESPJsonDB::restoreFromSnapshot(const JsonDocument &snapshot) {
@@ -2012,6 +2894,7 @@ DbStatus ESPJsonDB::restoreFromSnapshot(const JsonDocument &snapshot) {
 		return st;
 
 	// For each collection, recreate documents
+	RecordStore store(*_fs, _cfg.usePSRAMBuffers);
 	for (auto kv : cols) {
 		const char *colName = kv.key().c_str();
 		if (!colName || !*colName)
@@ -2023,56 +2906,15 @@ DbStatus ESPJsonDB::restoreFromSnapshot(const JsonDocument &snapshot) {
 			continue;
 
 		// Ensure directory exists
-		std::string dir = _baseDir;
-		if (!dir.empty() && dir.back() != '/')
-			dir += '/';
-		dir += colName;
+		const std::string dir = joinPath(_baseDir, colName);
 		{
-			FrLock fs(g_fsMutex);
+			FsNamespaceLock fs;
 			fsEnsureDir(*_fs, dir);
 		}
 
-		RecordStore store(*_fs, _cfg.usePSRAMBuffers);
 		for (JsonObjectConst obj : arr) {
-			const char *id =
-			    obj["_id"].is<const char *>() ? obj["_id"].as<const char *>() : nullptr;
-			if (!id || !*id)
-				continue;
-			if (!DocId::isHex(id, std::strlen(id))) {
-				return setLastError(
-				    {DbStatusCode::InvalidArgument, "snapshot contains invalid _id"}
-				);
-			}
-
-			// Copy object without _id into a temp doc
-			JsonDocument tmp;
-			tmp.to<JsonObject>().set(obj);
-			tmp.remove("_id");
-			tmp.remove("_meta");
-
-			size_t sz = measureMsgPack(tmp);
-			DocumentRecord record(_cfg.usePSRAMBuffers);
-			record.meta.id = DocId(id);
-			record.msgpack.resize(sz);
-			size_t written = serializeMsgPack(tmp, record.msgpack.data(), record.msgpack.size());
-			if (written != sz)
-				return setLastError({DbStatusCode::IoError, "serialize msgpack failed"});
-
-			JsonObjectConst meta = obj["_meta"].as<JsonObjectConst>();
-			if (!meta.isNull()) {
-				record.meta.createdAtMs = meta["createdAtMs"] | nowUtcMs();
-				record.meta.updatedAtMs = meta["updatedAtMs"] | record.meta.createdAtMs;
-				record.meta.revision = meta["revision"] | 1U;
-				record.meta.flags = meta["flags"] | static_cast<uint16_t>(0);
-			} else {
-				record.meta.createdAtMs = nowUtcMs();
-				record.meta.updatedAtMs = record.meta.createdAtMs;
-				record.meta.revision = 1;
-				record.meta.flags = 0;
-			}
-			record.meta.dirty = false;
-			record.meta.removed = false;
-			auto stWrite = store.write(dir, record);
+			bool restored = false;
+			auto stWrite = restoreSnapshotEntry(store, dir, obj, restored);
 			if (!stWrite.ok())
 				return setLastError(stWrite);
 		}
@@ -2084,6 +2926,298 @@ DbStatus ESPJsonDB::restoreFromSnapshot(const JsonDocument &snapshot) {
 	return setLastError({DbStatusCode::Ok, ""});
 }
 
+DbStatus ESPJsonDB::restoreBinarySnapshot(Stream &in, const SnapshotRestoreProgressCb &onProgress) {
+	if (!_fs) {
+		return setLastError({DbStatusCode::IoError, "filesystem not ready"});
+	}
+	ReadBufferingStream buffered(in, 512);
+	auto st = SnapshotCodec::readHeader(buffered);
+	if (!st.ok())
+		return setLastError(st);
+
+	st = dropAll();
+	if (!st.ok())
+		return st;
+
+	RecordStore store(*_fs, _cfg.usePSRAMBuffers);
+	JsonDbVector<uint8_t> encoded{JsonDbAllocator<uint8_t>(_cfg.usePSRAMBuffers)};
+	std::string dir;
+	bool inCollection = false;
+	bool skipCollection = false;
+	uint32_t collections = 0;
+	uint32_t records = 0;
+	SnapshotRestoreProgress progress;
+	for (;;) {
+		SnapshotCodec::Frame frame;
+		st = SnapshotCodec::readFrame(buffered, frame, encoded);
+		if (!st.ok())
+			return setLastError(st);
+
+		if (frame.tag == SnapshotCodec::kTagEnd) {
+			if (frame.collections != collections || frame.records != records) {
+				return setLastError({DbStatusCode::CorruptionDetected, "snapshot counts mismatch"});
+			}
+			break;
+		}
+		if (frame.tag == SnapshotCodec::kTagCollection) {
+			++collections;
+			inCollection = true;
+			skipCollection = frame.name.empty() || isReservedName(frame.name) ||
+			                 frame.name.find('/') != std::string::npos;
+			if (!skipCollection) {
+				dir = joinPath(_baseDir, frame.name);
+				{
+					FsNamespaceLock fs;
+					fsEnsureDir(*_fs, dir);
+				}
+				progress.collectionName = frame.name;
+				++progress.collectionsRestored;
+			}
+			continue;
+		}
+
+		++records;
+		if (!inCollection) {
+			return setLastError(
+			    {DbStatusCode::CorruptionDetected, "snapshot record outside collection"}
+			);
+		}
+		if (skipCollection)
+			continue;
+		// Validate the envelope and CRC, then store the bytes unchanged.
+		RecordHeader header;
+		size_t payloadOffset = 0;
+		size_t payloadSize = 0;
+		st = DocCodec::decodeRecordInPlace(
+		    encoded.data(),
+		    encoded.size(),
+		    header,
+		    payloadOffset,
+		    payloadSize
+		);
+		if (!st.ok())
+			return setLastError(st);
+		st = store.writeEncoded(dir, header.id, encoded);
+		if (!st.ok())
+			return setLastError(st);
+		++progress.documentsRestored;
+		if (onProgress)
+			onProgress(progress);
+	}
+
+	refreshDiagFromFs();
+	emitEvent(DBEventType::Sync);
+	return setLastError({DbStatusCode::Ok, ""});
+}
+
+DbResult<uint64_t> ESPJsonDB::writeIncrementalSnapshot(Stream &out, uint64_t sinceMs) {
+	DbResult<uint64_t> res{};
+	if (!_fs) {
+		res.status = setLastError({DbStatusCode::IoError, "filesystem not ready"});
+		return res;
+	}
+	const uint64_t startedAtMs = nowUtcMs();
+	const uint64_t untilMs =
+	    startedAtMs > kIncrementalOverlapMs ? startedAtMs - kIncrementalOverlapMs : 0;
+
+	WriteBufferingStream buffered(out, 512);
+	JsonDocument header;
+	header["sinceMs"] = sinceMs;
+	header["untilMs"] = untilMs;
+	std::string headerJson;
+	serializeJson(header, headerJson);
+	auto st = writeSnapshotBytes(buffered, "{\"incremental\":");
+	if (st.ok())
+		st = writeSnapshotString(buffered, headerJson);
+	if (st.ok())
+		st = writeSnapshotBytes(buffered, ",\"collections\":{");
+	if (!st.ok()) {
+		res.status = setLastError(st);
+		return res;
+	}
+
+	std::string current;
+	bool firstCollection = true;
+	bool firstDocument = true;
+	auto writeEntry = [&](const JsonDocument &entry) {
+		std::string entryJson;
+		serializeJson(entry, entryJson);
+		if (!firstDocument) {
+			auto st = writeSnapshotBytes(buffered, ",");
+			if (!st.ok())
+				return st;
+		}
+		firstDocument = false;
+		return writeSnapshotString(buffered, entryJson);
+	};
+	// Tombstones follow the collection's records so that applying the stream
+	// in order lets a removal win over a record exported for the same id.
+	auto closeCollection = [&]() {
+		if (firstCollection)
+			return DbStatus{DbStatusCode::Ok, ""};
+		JsonDbVector<Tombstone> tombstones{JsonDbAllocator<Tombstone>(_cfg.usePSRAMBuffers)};
+		Collection *loaded = nullptr;
+		{
+			FrLock lk(_mu);
+			auto it = _cols.find(current);
+			if (it != _cols.end())
+				loaded = it->second.get();
+		}
+		auto st = loaded ? loaded->collectTombstones(sinceMs, tombstones)
+		                 : TombstoneLog(*_fs, _cfg.usePSRAMBuffers)
+		                       .read(joinPath(_baseDir, current), sinceMs, tombstones);
+		if (!st.ok())
+			return st;
+		for (const auto &tombstone : tombstones) {
+			JsonDocument entry;
+			entry["_id"] = tombstone.id.c_str();
+			entry["_deleted"] = true;
+			entry["_meta"]["deletedAtMs"] = tombstone.deletedAtMs;
+			st = writeEntry(entry);
+			if (!st.ok())
+				return st;
+		}
+		return writeSnapshotBytes(buffered, "]");
+	};
+	auto onCollection = [&](const std::string &colName) {
+		auto st = closeCollection();
+		if (!st.ok())
+			return st;
+		if (!firstCollection) {
+			st = writeSnapshotBytes(buffered, ",");
+			if (!st.ok())
+				return st;
+		}
+		firstCollection = false;
+		firstDocument = true;
+		current = colName;
+
+		JsonDocument keyDoc;
+		keyDoc.set(colName.c_str());
+		std::string keyJson;
+		serializeJson(keyDoc, keyJson);
+		st = writeSnapshotString(buffered, keyJson);
+		if (!st.ok())
+			return st;
+		return writeSnapshotBytes(buffered, ":[");
+	};
+	auto onRecord = [&](const DocumentRecord &rec) {
+		if (rec.meta.updatedAtMs < sinceMs)
+			return DbStatus{DbStatusCode::Ok, ""};
+		JsonDocument entry;
+		if (!fillSnapshotEntry(entry.to<JsonObject>(), rec))
+			return DbStatus{DbStatusCode::Ok, ""};
+		return writeEntry(entry);
+	};
+
+	st = visitSnapshotCollections(SnapshotMode::InMemoryConsistent, onCollection, onRecord);
+	if (st.ok())
+		st = closeCollection();
+	if (st.ok())
+		st = writeSnapshotBytes(buffered, "}}");
+	if (!st.ok()) {
+		res.status = setLastError(st);
+		return res;
+	}
+	buffered.flush();
+	if (buffered.getWriteError()) {
+		res.status = setLastError({DbStatusCode::IoError, "snapshot write failed"});
+		return res;
+	}
+	res.status = setLastError({DbStatusCode::Ok, ""});
+	res.value = untilMs;
+	return res;
+}
+
+DbStatus ESPJsonDB::applyIncremental(Stream &in, const SnapshotRestoreProgressCb &onProgress) {
+	if (!_fs) {
+		return setLastError({DbStatusCode::IoError, "filesystem not ready"});
+	}
+	ReadBufferingStream buffered(in, 512);
+	SnapshotJsonReader reader(buffered);
+	auto st = reader.begin();
+	if (!st.ok())
+		return setLastError(st);
+	if (!reader.incremental()) {
+		return setLastError({DbStatusCode::InvalidArgument, "not an incremental snapshot"});
+	}
+
+	SnapshotRestoreProgress progress;
+	JsonDocument entry;
+	for (;;) {
+		bool done = false;
+		std::string colName;
+		st = reader.nextCollection(colName, done);
+		if (!st.ok())
+			return setLastError(st);
+		if (done)
+			break;
+
+		Collection *col = nullptr;
+		if (!colName.empty() && !isReservedName(colName)) {
+			auto cr = collection(colName);
+			if (!cr.status.ok())
+				return setLastError(cr.status);
+			col = cr.value;
+			progress.collectionName = colName;
+			++progress.collectionsRestored;
+		}
+		for (;;) {
+			st = reader.nextDocument(entry, done);
+			if (!st.ok())
+				return setLastError(st);
+			if (done)
+				break;
+			if (!col || !entry.is<JsonObjectConst>())
+				continue;
+			JsonObjectConst obj = entry.as<JsonObjectConst>();
+			if (obj["_deleted"] | false) {
+				DocId id;
+				if (!id.assign(obj["_id"] | "")) {
+					return setLastError(
+					    {DbStatusCode::InvalidArgument, "snapshot contains invalid _id"}
+					);
+				}
+				st = col->applyRemoval(id, obj["_meta"]["deletedAtMs"] | nowUtcMs());
+			} else {
+				DocumentRecord record(_cfg.usePSRAMBuffers);
+				bool hasId = false;
+				st = recordFromSnapshotEntry(obj, record, hasId);
+				if (st.ok() && !hasId)
+					continue;
+				if (st.ok())
+					st = col->applyRecord(record);
+			}
+			if (!st.ok())
+				return setLastError(st);
+			++progress.documentsRestored;
+			if (onProgress)
+				onProgress(progress);
+		}
+	}
+	st = reader.finish();
+	if (!st.ok())
+		return setLastError(st);
+	return setLastError({DbStatusCode::Ok, ""});
+}
+
+DbStatus ESPJsonDB::pruneTombstones(uint64_t beforeMs) {
+	auto ready = ensureReady();
+	if (!ready.ok())
+		return setLastError(ready);
+	DirEntryVector colDirs{JsonDbAllocator<DirEntry>(_cfg.usePSRAMBuffers)};
+	listDirEntries(*_fs, _baseDir, colDirs);
+	TombstoneLog log(*_fs, _cfg.usePSRAMBuffers);
+	for (const auto &entry : colDirs) {
+		if (!entry.second || isReservedName(snapshotCollectionName(entry.first)))
+			continue;
+		auto st = log.prune(entry.first, beforeMs);
+		if (!st.ok())
+			return setLastError(st);
+	}
+	return setLastError({DbStatusCode::Ok, ""});
+}
+
 // Private: expensive FS scan; called on init and after successful sync
 void ESPJsonDB::refreshDiagFromFs() {
 	if (!_fs)
@@ -2094,7 +3228,7 @@ void ESPJsonDB::refreshDiagFromFs() {
 	};
 	uint32_t colCount = 0;
 	{
-		FrLock fs(g_fsMutex);
+		FsNamespaceLock fs;
 		if (!_fs->exists(_baseDir.c_str())) {
 			// No base dir yet → empty
 		} else {
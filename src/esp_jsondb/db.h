@@ -15,6 +15,7 @@
 
 #include "collection/collection.h"
 #include "files/file_store.h"
+#include "read_snapshot.h"
 #include "utils/dbTypes.h"
 #include "utils/fr_mutex.h"
 #include "utils/jsondb_allocator.h"
@@ -26,6 +27,7 @@
 #endif
 
 struct DbRuntime;
+class RecordStore;
 
 class ESPJsonDB {
   public:
@@ -82,6 +84,11 @@ class ESPJsonDB {
 	DbResult<std::vector<DocView>>
 	findMany(const std::string &collectionName, std::function<bool(const DocView &)> pred);
 
+	// Convenience: headers of documents matching predicate, payloads untouched
+	DbResult<std::vector<DocumentHeader>> findHeaders(
+	    const std::string &collectionName, std::function<bool(const DocumentHeader &)> pred
+	);
+
 	// Convenience: find the first document matching predicate in the given collection
 	DbResult<DocView>
 	findOne(const std::string &collectionName, std::function<bool(const DocView &)> pred);
@@ -144,6 +151,10 @@ class ESPJsonDB {
 	    const std::string &collectionName, const JsonDocument &patch, const JsonDocument &filter
 	);
 
+	// Open a consistent point-in-time read view across all collections. Writers
+	// keep running; the snapshot keeps seeing the state at this moment.
+	ReadSnapshot beginRead();
+
 	// Manual sync (safe to call from app)
 	DbStatus syncNow();
 
@@ -157,12 +168,44 @@ class ESPJsonDB {
 	JsonDocument getDiagnostics();
 
 	// Backup/restore
-	DbStatus writeSnapshot(Stream &out, SnapshotMode mode = SnapshotMode::OnDiskOnly);
+	DbStatus writeSnapshot(
+	    Stream &out,
+	    SnapshotMode mode = SnapshotMode::OnDiskOnly,
+	    SnapshotFormat format = SnapshotFormat::Json
+	);
+	// Resumable JSON export, one bounded piece per call. Collections go out in
+	// name order and documents in _id order. Start with an empty token and
+	// pass each returned token to the next call; an empty result means the
+	// export is complete. The pieces concatenate to a writeSnapshot() stream.
+	// Nothing is held between calls, so each piece reads the current state.
+	DbResult<std::string> writeSnapshotChunk(
+	    Stream &out,
+	    const std::string &resumeToken,
+	    const SnapshotChunkLimits &limits = {},
+	    SnapshotMode mode = SnapshotMode::OnDiskOnly
+	);
 	JsonDocument getSnapshot(SnapshotMode mode = SnapshotMode::OnDiskOnly);
-	DbStatus restoreFromSnapshot(Stream &in);
+	// Accepts both SnapshotFormat::Json and SnapshotFormat::Binary streams and
+	// writes each document as soon as it is parsed, so memory use is bounded by
+	// the largest document rather than the snapshot.
+	DbStatus restoreFromSnapshot(Stream &in, const SnapshotRestoreProgressCb &onProgress = nullptr);
 	DbStatus restoreFromSnapshot(const JsonDocument &snapshot);
 
+	// Incremental backup: documents changed at or after `sinceMs` and
+	// tombstones for documents removed since then, read through one read
+	// snapshot. The result value is the watermark to pass as `sinceMs` next
+	// time; 0 exports everything.
+	DbResult<uint64_t> writeIncrementalSnapshot(Stream &out, uint64_t sinceMs);
+	// Apply a writeIncrementalSnapshot() stream on top of the current data.
+	// Nothing is dropped; a tombstone wins over a record for the same id.
+	DbStatus applyIncremental(Stream &in, const SnapshotRestoreProgressCb &onProgress = nullptr);
+	// Forget tombstones older than `beforeMs`, e.g. after a full backup.
+	DbStatus pruneTombstones(uint64_t beforeMs);
+
 #if __has_include(<ESPCompressor.h>)
+	// The snapshot streams through a 4 KiB pipe to `compressor`, which runs
+	// on a "db.compress" helper task; `onProgress` is called on that task.
+	// Busy when the pipe or the task cannot be created.
 	DbStatus writeCompressedSnapshot(
 	    ESPCompressor &compressor,
 	    CompressionSink &sink,
@@ -170,6 +213,8 @@ class ESPJsonDB {
 	    ProgressCallback onProgress = nullptr,
 	    const CompressionJobOptions &options = {}
 	);
+	// Decompresses on a "db.decompress" helper task, which also calls
+	// `onProgress`, while the calling task restores documents as they arrive.
 	DbStatus restoreCompressedSnapshot(
 	    ESPCompressor &compressor,
 	    CompressionSource &source,
@@ -192,12 +237,21 @@ class ESPJsonDB {
 	void noteDocumentDeleted(const std::string &collectionName, uint32_t count = 1);
 
   private:
+	friend class ReadSnapshot;
+
 	// sync task
 	static void syncTaskThunk(void *arg);
 	void syncTaskLoop();
-	DbStatus runSyncPass();
+	DbStatus runSyncPass(bool includeDeferred);
 	void startSyncTaskUnlocked();
-	void stopSyncTaskUnlocked();
+	// Call without _mu. Busy when called on the sync task itself or when its
+	// pass does not end within kTaskStopTimeoutMs.
+	DbStatus stopSyncTask();
+	bool withdrawSyncStop();
+	bool confirmSyncStop(bool &teardown);
+	void releaseSyncTask(bool deleteTask);
+	void resetAfterSyncStop();
+	bool hasPendingSyncWork();
 
 	DbStatus setLastError(const DbStatus &st);
 	void emitSyncStatus(const DBSyncStatus &status);
@@ -224,13 +278,34 @@ class ESPJsonDB {
 	DbStatus preloadCollectionFromFsByName(
 	    const std::string &name, bool markDelayedHandled, bool *insertedOut = nullptr
 	);
+	// Unloaded Collection for `name` with its registered schema and config.
+	std::unique_ptr<Collection> makeCollection(const std::string &name);
+	// Add a loaded collection unless one with that name appeared meanwhile.
+	bool installCollection(
+	    const std::string &name, std::unique_ptr<Collection> col, bool markDelayedHandled
+	);
 	bool collectionDirExistsOnFs(const std::string &name) const;
 	bool createTask(TaskFunction_t entry, const char *name, TaskHandle_t &outHandle);
-	void stopTask(
-	    TaskHandle_t &taskHandle, std::atomic<bool> &stopRequested, std::atomic<bool> &taskExited
-	);
 	static uint32_t stackBytesToWords(uint32_t stackBytes);
 
+	// Snapshot helpers
+	DbResult<Collection *> snapshotCollection(const std::string &name);
+	// Collection names to export in `mode`, sorted, without reserved names.
+	void listSnapshotCollections(SnapshotMode mode, JsonDbVector<std::string> &names);
+	DbStatus visitSnapshotCollections(
+	    SnapshotMode mode,
+	    const std::function<DbStatus(const std::string &)> &onCollection,
+	    const std::function<DbStatus(const DocumentRecord &)> &onRecord,
+	    const std::function<DbStatus(const JsonDbVector<uint8_t> &)> &onEncoded = nullptr
+	);
+	DbStatus writeBinarySnapshot(Print &out, SnapshotMode mode);
+	DbStatus restoreJsonSnapshot(Stream &in, const SnapshotRestoreProgressCb &onProgress);
+	DbStatus restoreBinarySnapshot(Stream &in, const SnapshotRestoreProgressCb &onProgress);
+	// Write one snapshot JSON entry; `restored` is false for entries without an _id.
+	DbStatus restoreSnapshotEntry(
+	    RecordStore &store, const std::string &dir, JsonObjectConst obj, bool &restored
+	);
+
 	// Refresh diag cache from filesystem (expensive; used only for explicit full refresh paths)
 	void refreshDiagFromFs();
 	DbStatus preloadCollectionsFromFs(bool emitStatus, DBSyncSource statusSource);
@@ -3,10 +3,16 @@
 #if __has_include(<ESPCompressor.h>)
 
 #include "db_runtime.h"
-#include "utils/fs_utils.h"
+#include "utils/snapshot_pipe.h"
+
+#include <atomic>
 
 namespace {
 
+// Ring between the snapshot and the compressor; the whole snapshot streams
+// through it, so this is all the staging either direction needs.
+constexpr size_t kSnapshotPipeBytes = 4096;
+
 DbStatus compressionStatus(CompressionError error) {
 	switch (error) {
 	case CompressionError::Ok:
@@ -35,48 +41,80 @@ DbStatus compressionStatus(CompressionError error) {
 	}
 }
 
-std::string sanitizeTempToken(const std::string &input) {
-	std::string out;
-	out.reserve(input.size());
-	for (char c : input) {
-		if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
-			out.push_back(c);
-		} else {
-			out.push_back('_');
-		}
+// Compressor input read from a SnapshotPipe that writeSnapshot() fills.
+class PipeSource : public CompressionSource {
+  public:
+	explicit PipeSource(SnapshotPipe &pipe) : _pipe(&pipe) {
+	}
+	size_t read(uint8_t *dst, size_t len) override {
+		return _pipe->readSome(dst, len);
+	}
+	bool eof() const override {
+		return _pipe->ended();
 	}
-	return out.empty() ? std::string("db") : out;
-}
 
-std::string snapshotTempPath(const std::string &baseDir, const char *suffix) {
-	return "/" + sanitizeTempToken(baseDir) + suffix;
-}
+  private:
+	SnapshotPipe *_pipe;
+};
 
-void removeTempFile(fs::FS &filesystem, const std::string &path) {
-	FrLock fs(g_fsMutex);
-	if (filesystem.exists(path.c_str())) {
-		filesystem.remove(path.c_str());
+// Decompressor output written into a SnapshotPipe that restoreFromSnapshot()
+// reads. Fails once the restore stopped reading.
+class PipeSink : public CompressionSink {
+  public:
+	explicit PipeSink(SnapshotPipe &pipe) : _pipe(&pipe) {
 	}
-	if (filesystem.exists((path + ".tmp").c_str())) {
-		filesystem.remove((path + ".tmp").c_str());
+	bool write(const uint8_t *data, size_t len) override {
+		return _pipe->write(data, len) == len;
 	}
-}
 
-DbStatus openFileForWrite(fs::FS &filesystem, const std::string &path, File &outFile) {
-	FrLock fs(g_fsMutex);
-	outFile = filesystem.open(path.c_str(), FILE_WRITE);
-	if (!outFile) {
-		return {DbStatusCode::IoError, "open snapshot staging file failed"};
+  private:
+	SnapshotPipe *_pipe;
+};
+
+// One compress() or decompress() call on a helper task, so the database side
+// of the pipe runs on the caller.
+struct CompressorJob {
+	ESPCompressor *compressor = nullptr;
+	CompressionSource *source = nullptr;
+	CompressionSink *sink = nullptr;
+	ProgressCallback onProgress;
+	const CompressionJobOptions *options = nullptr;
+	SnapshotPipe *pipe = nullptr;
+	bool compress = true;
+	CompressionResult result{};
+	std::atomic<bool> exited{false};
+};
+
+void compressorJobTask(void *arg) {
+	auto *job = static_cast<CompressorJob *>(arg);
+	if (job->compress) {
+		job->result =
+		    job->compressor->compress(*job->source, *job->sink, job->onProgress, *job->options);
+		// Unblock writeSnapshot() if the compressor stopped before the end.
+		job->pipe->closeRead();
+	} else {
+		job->result =
+		    job->compressor->decompress(*job->source, *job->sink, job->onProgress, *job->options);
+		job->pipe->closeWrite();
 	}
-	return {DbStatusCode::Ok, ""};
+	job->exited.store(true, std::memory_order_release);
+	// waitForJob() deletes the task; suspending keeps the handle valid.
+	vTaskSuspend(nullptr);
 }
 
-DbStatus openFileForRead(fs::FS &filesystem, const std::string &path, File &outFile) {
-	FrLock fs(g_fsMutex);
-	outFile = filesystem.open(path.c_str(), FILE_READ);
-	if (!outFile) {
-		return {DbStatusCode::IoError, "open snapshot staging file failed"};
+// Both ends of the pipe are closed by now, so the job only has the tail of
+// its output left. A compressor stuck on its source or sink is deleted after
+// kTaskStopTimeoutMs rather than waited on forever.
+DbStatus waitForJob(const CompressorJob &job, TaskHandle_t task) {
+	const uint32_t startMs = millis();
+	while (!job.exited.load(std::memory_order_acquire)) {
+		if ((millis() - startMs) >= DbRuntime::kTaskStopTimeoutMs) {
+			vTaskDelete(task);
+			return {DbStatusCode::Busy, "compressor task did not finish"};
+		}
+		vTaskDelay(pdMS_TO_TICKS(1));
 	}
+	vTaskDelete(task);
 	return {DbStatusCode::Ok, ""};
 }
 
@@ -94,29 +132,35 @@ DbStatus ESPJsonDB::writeCompressedSnapshot(
 		return setLastError(ready);
 	}
 
-	fs::FS *filesystem = _rt->fs;
-	const std::string tempPath = snapshotTempPath(_rt->baseDir, "_snapshot_export.json");
-	removeTempFile(*filesystem, tempPath);
-
-	File snapshotFile;
-	auto openStatus = openFileForWrite(*filesystem, tempPath, snapshotFile);
-	if (!openStatus.ok()) {
-		return setLastError(openStatus);
+	// The snapshot streams into the compressor through a small pipe, so it is
+	// never held in full, in RAM or on flash.
+	SnapshotPipe pipe(kSnapshotPipeBytes);
+	PipeSource pipeSource(pipe);
+	CompressorJob job;
+	job.compressor = &compressor;
+	job.source = &pipeSource;
+	job.sink = &sink;
+	job.onProgress = onProgress;
+	job.options = &options;
+	job.pipe = &pipe;
+	job.compress = true;
+	TaskHandle_t task = nullptr;
+	if (!pipe.valid() || !_rt->createTask(compressorJobTask, "db.compress", &job, task)) {
+		return setLastError({DbStatusCode::Busy, "no memory for the compressor pipe or task"});
+	}
+	auto snapshotStatus = writeSnapshot(pipe, mode);
+	pipe.closeWrite();
+	auto jobStatus = waitForJob(job, task);
+	if (!jobStatus.ok()) {
+		return setLastError(jobStatus);
+	}
+	// A compressor failure also cuts the snapshot short; report the cause.
+	if (!job.result.ok()) {
+		return setLastError(compressionStatus(job.result.error));
 	}
-
-	auto snapshotStatus = writeSnapshot(snapshotFile, mode);
-	snapshotFile.close();
 	if (!snapshotStatus.ok()) {
-		removeTempFile(*filesystem, tempPath);
 		return snapshotStatus;
 	}
-
-	FileSource source(*filesystem, tempPath.c_str());
-	auto result = compressor.compress(source, sink, onProgress, options);
-	removeTempFile(*filesystem, tempPath);
-	if (!result.ok()) {
-		return setLastError(compressionStatus(result.error));
-	}
 	return setLastError({DbStatusCode::Ok, ""});
 }
 
@@ -131,27 +175,37 @@ DbStatus ESPJsonDB::restoreCompressedSnapshot(
 		return setLastError(ready);
 	}
 
-	fs::FS *filesystem = _rt->fs;
-	const std::string tempPath = snapshotTempPath(_rt->baseDir, "_snapshot_restore.json");
-	removeTempFile(*filesystem, tempPath);
-
-	FileSink sink(*filesystem, tempPath.c_str(), true);
-	auto result = compressor.decompress(source, sink, onProgress, options);
-	if (!result.ok()) {
-		removeTempFile(*filesystem, tempPath);
-		return setLastError(compressionStatus(result.error));
+	// The decompressor feeds the streaming restore through a small pipe.
+	SnapshotPipe pipe(kSnapshotPipeBytes);
+	PipeSink pipeSink(pipe);
+	CompressorJob job;
+	job.compressor = &compressor;
+	job.source = &source;
+	job.sink = &pipeSink;
+	job.onProgress = onProgress;
+	job.options = &options;
+	job.pipe = &pipe;
+	job.compress = false;
+	TaskHandle_t task = nullptr;
+	if (!pipe.valid() || !_rt->createTask(compressorJobTask, "db.decompress", &job, task)) {
+		return setLastError({DbStatusCode::Busy, "no memory for the decompressor pipe or task"});
 	}
-
-	File snapshotFile;
-	auto openStatus = openFileForRead(*filesystem, tempPath, snapshotFile);
-	if (!openStatus.ok()) {
-		removeTempFile(*filesystem, tempPath);
-		return setLastError(openStatus);
+	auto restoreStatus = restoreFromSnapshot(pipe);
+	if (restoreStatus.ok()) {
+		// Let the decompressor finish whatever follows the snapshot.
+		uint8_t rest[64];
+		while (pipe.readSome(rest, sizeof(rest)) > 0) {
+		}
+	}
+	pipe.closeRead();
+	auto jobStatus = waitForJob(job, task);
+	if (!jobStatus.ok()) {
+		return setLastError(jobStatus);
+	}
+	// Corrupt input also cuts the snapshot short; report the cause.
+	if (!job.result.ok()) {
+		return setLastError(compressionStatus(job.result.error));
 	}
-
-	auto restoreStatus = restoreFromSnapshot(snapshotFile);
-	snapshotFile.close();
-	removeTempFile(*filesystem, tempPath);
 	return restoreStatus;
 }
 
@@ -4,6 +4,7 @@
 
 #include <atomic>
 #include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <freertos/task.h>
 #include <functional>
 #include <map>
@@ -11,6 +12,8 @@
 #include <string>
 
 #include "files/file_store.h"
+#include "storage/version_store.h"
+#include "sync/flush_pool.h"
 #include "utils/dbTypes.h"
 #include "utils/fr_mutex.h"
 #include "utils/jsondb_allocator.h"
@@ -21,6 +24,9 @@ class ESPJsonDB;
 struct FileStoreImpl;
 
 struct DbRuntime {
+	// How long stopping a task waits for it before giving up.
+	static constexpr uint32_t kTaskStopTimeoutMs = 200;
+
 	using CollectionMap = JsonDbMap<std::string, std::unique_ptr<Collection>>;
 	using SchemaMap = JsonDbMap<std::string, Schema>;
 	using StringBoolMap = JsonDbMap<std::string, bool>;
@@ -31,6 +37,29 @@ struct DbRuntime {
 	using ErrorCallbackVector = JsonDbVector<std::function<void(const DbStatus &)>>;
 	using SyncStatusCallbackVector = JsonDbVector<std::function<void(const DBSyncStatus &)>>;
 
+	// A syncNow() caller parked until the sync task completes targetSeq.
+	struct SyncWaiter {
+		uint32_t targetSeq = 0;
+		SemaphoreHandle_t done = nullptr;
+	};
+	using SyncWaiterVector = JsonDbVector<SyncWaiter>;
+
+	enum class AutosyncTrigger : uint8_t { None = 0, Interval, HighWater, MaxLatency, Manual };
+
+	// Adaptive autosync policy state; guarded by mu.
+	struct AutosyncState {
+		uint32_t currentIntervalMs = 0;
+		uint32_t lastPassMs = 0;
+		uint32_t firstDirtyMs = 0;
+		uint32_t lastPassDirtyBytes = 0;
+		uint32_t lastPassDurationMs = 0;
+		uint32_t intervalPasses = 0;
+		uint32_t highWaterPasses = 0;
+		uint32_t maxLatencyPasses = 0;
+		uint32_t manualPasses = 0;
+		AutosyncTrigger lastTrigger = AutosyncTrigger::None;
+	};
+
 	struct DiagCache {
 		StringUint32Map docsPerCollection;
 		uint32_t collections = 0;
@@ -57,9 +86,21 @@ struct DbRuntime {
 	TaskHandle_t syncTask = nullptr;
 	std::atomic<bool> syncStopRequested{false};
 	std::atomic<bool> syncTaskExited{true};
+	// deinit() could not join the sync task; it tears down after its pass.
+	// Guarded by mu.
+	bool syncTeardownDeferred = false;
 	std::atomic<bool> syncKickRequested{false};
 	std::atomic<uint32_t> syncRequestSeq{0};
 	std::atomic<uint32_t> syncCompletedSeq{0};
+	// Set when a write leaves data for the sync task to flush; cleared by the
+	// sync task right before it snapshots collections for a pass.
+	std::atomic<bool> syncWorkPending{false};
+	std::atomic<uint32_t> dirtyBytes{0};
+	AutosyncState autosync;
+	SyncWaiterVector syncWaiters;
+	FlushPool flushPool;
+	// Commit sequencing and record versions retained for open read snapshots.
+	VersionStore versions;
 	bool delayedPreloadPhaseCompleted = true;
 	bool dropAllRequested = false;
 	ESPJsonDB *owner = nullptr;
@@ -75,6 +116,13 @@ struct DbRuntime {
 	void emitError(const DbStatus &st);
 	void noteDocumentCreated(const std::string &collectionName, uint32_t count = 1);
 	void noteDocumentDeleted(const std::string &collectionName, uint32_t count = 1);
+	void noteDirtyData(size_t bytes = 0);
+	void wakeSyncTaskLocked();
+	void releaseSyncWaitersLocked(uint32_t completedSeq);
+	uint32_t nextAutosyncDelayMs(uint32_t now, AutosyncTrigger &trigger);
+	void recordAutosyncPassLocked(
+	    AutosyncTrigger trigger, uint32_t passStartMs, uint32_t passDirtyBytes, uint32_t idleBeforeDirtyMs
+	);
 	std::string fileRootDir() const;
 	bool createTask(TaskFunction_t entry, const char *name, void *arg, TaskHandle_t &outHandle);
 	void stopTask(
@@ -2,6 +2,8 @@
 #include "../db.h"
 #include "../utils/refs.h"
 #include "../utils/time_utils.h"
+#include <cstring>
+#include <new>
 #include <utility>
 
 DocView::DocView(
@@ -35,13 +37,14 @@ DocView::DocView(
 DocView::DocView(DocView &&other) noexcept
     : _rec(std::move(other._rec)), _schema(other._schema), _doc(std::move(other._doc)),
       _dirtyLocally(other._dirtyLocally), _mu(other._mu), _db(other._db),
-      _commitSink(std::move(other._commitSink)), _decodeAcquire(std::move(other._decodeAcquire)),
+      _commitSink(std::move(other._commitSink)), _staged(std::move(other._staged)),
+      _decodeAcquire(std::move(other._decodeAcquire)),
       _decodeRelease(std::move(other._decodeRelease)), _pinRelease(std::move(other._pinRelease)),
       _usePSRAMBuffers(other._usePSRAMBuffers), _decodeReserved(other._decodeReserved),
       _pinHeld(other._pinHeld)
 #if ESP_JSONDB_HAS_JSONDOC_ALLOCATOR
       ,
-      _docAllocator(other._usePSRAMBuffers)
+      _docAllocator(other._usePSRAMBuffers), _arena(other._arena)
 #endif
 {
 	other._decodeReserved = false;
@@ -59,6 +62,7 @@ DocView &DocView::operator=(DocView &&other) noexcept {
 	_mu = other._mu;
 	_db = other._db;
 	_commitSink = std::move(other._commitSink);
+	_staged = std::move(other._staged);
 	_decodeAcquire = std::move(other._decodeAcquire);
 	_decodeRelease = std::move(other._decodeRelease);
 	_pinRelease = std::move(other._pinRelease);
@@ -67,6 +71,7 @@ DocView &DocView::operator=(DocView &&other) noexcept {
 	_pinHeld = other._pinHeld;
 #if ESP_JSONDB_HAS_JSONDOC_ALLOCATOR
 	_docAllocator.setUsePSRAMBuffers(_usePSRAMBuffers);
+	_arena = other._arena;
 #endif
 	other._decodeReserved = false;
 	other._pinHeld = false;
@@ -77,6 +82,13 @@ DocView::~DocView() {
 	releaseResources();
 }
 
+void JsonDocDeleter::operator()(JsonDocument *doc) const {
+	if (inArena)
+		doc->~JsonDocument();
+	else
+		delete doc;
+}
+
 void DocView::releaseResources() {
 	_doc.reset();
 	if (_decodeReserved && _decodeRelease) {
@@ -102,10 +114,22 @@ DbStatus DocView::decode() {
 		_decodeReserved = true;
 	}
 #if ESP_JSONDB_HAS_JSONDOC_ALLOCATOR
-	_docAllocator.setUsePSRAMBuffers(_usePSRAMBuffers);
-	_doc = std::make_unique<JsonDocument>(&_docAllocator);
+	if (_arena) {
+		// The document object lives in the arena too, so a scan allocates
+		// nothing per view once the arena has grown to fit.
+		void *slot = _arena->allocate(sizeof(JsonDocument));
+		if (!slot)
+			return recordStatus({DbStatusCode::Busy, "document arena exhausted"});
+		_doc = std::unique_ptr<JsonDocument, JsonDocDeleter>(
+		    new (slot) JsonDocument(_arena),
+		    JsonDocDeleter{true}
+		);
+	} else {
+		_docAllocator.setUsePSRAMBuffers(_usePSRAMBuffers);
+		_doc = std::unique_ptr<JsonDocument, JsonDocDeleter>(new JsonDocument(&_docAllocator));
+	}
 #else
-	_doc = std::make_unique<JsonDocument>();
+	_doc = std::unique_ptr<JsonDocument, JsonDocDeleter>(new JsonDocument());
 #endif
 	// If there is no backing record (e.g., NotFound), treat as empty object
 	if (!_rec) {
@@ -193,16 +217,27 @@ DbStatus DocView::encode() {
 		// else: fall through to write new bytes
 	}
 
-	// Allocate and write new bytes
-	_rec->msgpack.resize(sz);
-	size_t written =
-	    serializeMsgPack(_doc->as<JsonVariantConst>(), _rec->msgpack.data(), _rec->msgpack.size());
+	// Allocate and write new bytes. A sink-backed view never touches the live
+	// record directly, so the owner can keep its previous bytes if needed.
+	std::shared_ptr<DocumentRecord> target = _rec;
+	if (_commitSink) {
+		target = makeDocumentRecord(_usePSRAMBuffers);
+		target->meta = _rec->meta;
+	}
+	target->msgpack.resize(sz);
+	size_t written = serializeMsgPack(
+	    _doc->as<JsonVariantConst>(),
+	    target->msgpack.data(),
+	    target->msgpack.size()
+	);
 	if (written != sz) {
 		return recordStatus({DbStatusCode::IoError, "serialize msgpack size mismatch"});
 	}
-	_rec->meta.updatedAtMs = nowUtcMs();
-	_rec->meta.revision = static_cast<uint32_t>(_rec->meta.revision + 1U);
-	_rec->meta.dirty = true;
+	target->meta.updatedAtMs = nowUtcMs();
+	target->meta.revision = static_cast<uint32_t>(target->meta.revision + 1U);
+	target->meta.dirty = true;
+	if (_commitSink)
+		_staged = std::move(target);
 	_dirtyLocally = false;
 	return recordStatus({DbStatusCode::Ok, ""});
 }
@@ -277,13 +312,15 @@ DbStatus DocView::commit() {
 	auto st = encode();
 	if (!st.ok())
 		return st;
-	if (_commitSink && _rec) {
-		st = _commitSink(_rec);
+	if (_commitSink && _staged) {
+		auto staged = std::move(_staged);
+		st = _commitSink(staged);
 	}
 	return st;
 }
 
 void DocView::discard() {
+	_staged.reset();
 	if (_doc) {
 		_doc.reset();
 		if (_decodeReserved && _decodeRelease) {
@@ -378,3 +415,111 @@ DocView DocView::populate(const char *field, uint8_t maxDepth) const {
 	}
 	return std::move(fr.value);
 }
+
+#if ESP_JSONDB_HAS_JSONDOC_ALLOCATOR
+namespace {
+constexpr size_t kArenaAlign = alignof(std::max_align_t);
+
+constexpr size_t alignUp(size_t size) {
+	return (size + kArenaAlign - 1) & ~(kArenaAlign - 1);
+}
+
+// Each block is preceded by its size, which reallocate() needs to copy it.
+constexpr size_t kBlockHeader = alignUp(sizeof(size_t));
+} // namespace
+
+struct JsonDbDocArena::Chunk {
+	Chunk *next;
+	size_t size;
+	size_t used;
+
+	uint8_t *data() {
+		return reinterpret_cast<uint8_t *>(this) + alignUp(sizeof(Chunk));
+	}
+};
+
+JsonDbDocArena::JsonDbDocArena(bool usePSRAMBuffers, size_t chunkSize)
+    : _usePSRAMBuffers(usePSRAMBuffers), _chunkSize(chunkSize) {
+}
+
+JsonDbDocArena::~JsonDbDocArena() {
+	while (_head) {
+		Chunk *next = _head->next;
+		jsondb_allocator_detail::deallocate(_head);
+		_head = next;
+	}
+}
+
+JsonDbDocArena::Chunk *JsonDbDocArena::chunkWithRoom(size_t bytes) {
+	if (_current && _current->size - _current->used >= bytes)
+		return _current;
+	// Chunks past the current one were emptied by reset().
+	Chunk *prev = _current;
+	for (Chunk *c = _current ? _current->next : _head; c; prev = c, c = c->next) {
+		if (c->size >= bytes)
+			return _current = c;
+	}
+	const size_t size = bytes > _chunkSize ? bytes : _chunkSize;
+	void *raw = jsondb_allocator_detail::allocate(alignUp(sizeof(Chunk)) + size, _usePSRAMBuffers);
+	if (!raw)
+		return nullptr;
+	Chunk *chunk = static_cast<Chunk *>(raw);
+	chunk->next = nullptr;
+	chunk->size = size;
+	chunk->used = 0;
+	if (prev)
+		prev->next = chunk;
+	else
+		_head = chunk;
+	_capacity += size;
+	return _current = chunk;
+}
+
+void *JsonDbDocArena::allocate(size_t size) {
+	const size_t bytes = kBlockHeader + alignUp(size);
+	Chunk *chunk = chunkWithRoom(bytes);
+	if (!chunk)
+		return nullptr;
+	uint8_t *block = chunk->data() + chunk->used;
+	chunk->used += bytes;
+	std::memcpy(block, &size, sizeof(size));
+	_last = block + kBlockHeader;
+	return _last;
+}
+
+void JsonDbDocArena::deallocate(void *ptr) {
+	(void)ptr;
+}
+
+void *JsonDbDocArena::reallocate(void *ptr, size_t new_size) {
+	if (!ptr)
+		return allocate(new_size);
+	uint8_t *block = static_cast<uint8_t *>(ptr) - kBlockHeader;
+	size_t oldSize = 0;
+	std::memcpy(&oldSize, block, sizeof(oldSize));
+	// The newest block resizes in place while its chunk has room; ArduinoJson
+	// grows strings and shrinks pools this way.
+	if (ptr == _last) {
+		const size_t start = static_cast<size_t>(block - _current->data());
+		const size_t bytes = kBlockHeader + alignUp(new_size);
+		if (start + bytes <= _current->size) {
+			_current->used = start + bytes;
+			std::memcpy(block, &new_size, sizeof(new_size));
+			return ptr;
+		}
+	}
+	if (new_size <= oldSize)
+		return ptr;
+	void *moved = allocate(new_size);
+	if (moved)
+		std::memcpy(moved, ptr, oldSize);
+	return moved;
+}
+
+void JsonDbDocArena::reset() {
+	for (Chunk *c = _head; c; c = c->next)
+		c->used = 0;
+	_current = _head;
+	_last = nullptr;
+}
+#endif
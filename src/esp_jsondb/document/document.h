@@ -3,6 +3,7 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 
+#include <atomic>
 #include <cstdint>
 #include <ctime>
 #include <functional>
@@ -50,6 +51,42 @@ class JsonDbDocAllocator : public ArduinoJson::Allocator {
   private:
 	bool _usePSRAMBuffers = false;
 };
+
+// Bump allocator for short-lived JsonDocuments. deallocate() is a no-op and
+// reset() rewinds every chunk at once, so the next document decodes into the
+// memory of the previous one instead of going back to the heap. Chunks are
+// kept until the arena is destroyed. One arena per task; not thread-safe.
+class JsonDbDocArena : public ArduinoJson::Allocator {
+  public:
+	static constexpr size_t kChunkSize = 1024;
+
+	explicit JsonDbDocArena(bool usePSRAMBuffers = false, size_t chunkSize = kChunkSize);
+	~JsonDbDocArena();
+
+	JsonDbDocArena(const JsonDbDocArena &) = delete;
+	JsonDbDocArena &operator=(const JsonDbDocArena &) = delete;
+
+	void *allocate(size_t size) override;
+	void deallocate(void *ptr) override;
+	void *reallocate(void *ptr, size_t new_size) override;
+
+	// Every document built on the arena must be gone before this.
+	void reset();
+	size_t capacity() const {
+		return _capacity;
+	}
+
+  private:
+	struct Chunk;
+	Chunk *chunkWithRoom(size_t bytes);
+
+	bool _usePSRAMBuffers = false;
+	size_t _chunkSize = kChunkSize;
+	Chunk *_head = nullptr;
+	Chunk *_current = nullptr;
+	uint8_t *_last = nullptr; // newest block, which can grow in place
+	size_t _capacity = 0;
+};
 #endif
 
 /**
@@ -68,6 +105,16 @@ struct DocumentMeta {
 	bool removed = false; // logically deleted; DocView::commit should fail
 };
 
+// Metadata of one document without its payload (Collection::findHeaders()).
+struct DocumentHeader {
+	DocId id;
+	uint64_t createdAtMs = 0;
+	uint64_t updatedAtMs = 0;
+	uint32_t revision = 0;
+	uint16_t flags = 0;
+	uint32_t payloadSize = 0; // MessagePack bytes
+};
+
 // Internal storage unit (owned by Collection)
 struct DocumentRecord {
 	explicit DocumentRecord(bool usePSRAMBuffers = false)
@@ -76,12 +123,30 @@ struct DocumentRecord {
 
 	DocumentMeta meta;
 	JsonDbVector<uint8_t> msgpack; // authoritative source
-	uint32_t pinCount = 0;
-	uint64_t lastAccessSeq = 0;
+	// Touched by concurrent readers under the collection's shared lock.
+	std::atomic<uint32_t> pinCount{0};
+	std::atomic<uint32_t> lastAccessSeq{0};
+	// Sequence of the commit that produced this content (0 = loaded from FS).
+	uint32_t commitSeq = 0;
 	// Optional decoded cache; created on demand and freed when view
 	// destroyed Decoding/encoding uses ArduinoJson.
 };
 
+// Records are served from the slab pools (see JsonDbPooledAllocator).
+inline std::shared_ptr<DocumentRecord> makeDocumentRecord(bool usePSRAMBuffers) {
+	return std::allocate_shared<DocumentRecord>(
+	    JsonDbPooledAllocator<DocumentRecord>(usePSRAMBuffers),
+	    usePSRAMBuffers
+	);
+}
+
+// Deletes a DocView's document or, for one placed in a JsonDbDocArena, only
+// destroys it.
+struct JsonDocDeleter {
+	bool inArena = false;
+	void operator()(JsonDocument *doc) const;
+};
+
 // A short-lived, RAII view for convenient operator[] access
 // - On creation: deserialize MessagePack into JsonDocument
 // - On commit(): reserialize to MessagePack and mark dirty
@@ -136,14 +201,26 @@ class DocView {
 		return _rec ? _rec->meta : kEmptyMeta;
 	}
 
+#if ESP_JSONDB_HAS_JSONDOC_ALLOCATOR
+	// Decode into `arena` rather than the heap. Set before the first access;
+	// the arena must outlive the view. Used by scans that reset one arena
+	// between documents.
+	void useArena(JsonDbDocArena *arena) {
+		_arena = arena;
+	}
+#endif
+
   private:
 	std::shared_ptr<DocumentRecord> _rec; // shared lifetime with collection
 	const Schema *_schema = nullptr;
-	std::unique_ptr<JsonDocument> _doc; // decoded pool
+	std::unique_ptr<JsonDocument, JsonDocDeleter> _doc; // decoded pool
 	bool _dirtyLocally = false;
 	FrMutex *_mu = nullptr; // optional: used when called without external lock
 	ESPJsonDB *_db = nullptr;
+	// With a commit sink, encode() stages new bytes here and the sink applies
+	// them to the live record; without one the record is updated in place.
 	std::function<DbStatus(const std::shared_ptr<DocumentRecord> &)> _commitSink;
+	std::shared_ptr<DocumentRecord> _staged;
 	std::function<DbStatus()> _decodeAcquire;
 	std::function<void()> _decodeRelease;
 	std::function<void()> _pinRelease;
@@ -152,6 +229,7 @@ class DocView {
 	bool _pinHeld = false;
 #if ESP_JSONDB_HAS_JSONDOC_ALLOCATOR
 	JsonDbDocAllocator _docAllocator;
+	JsonDbDocArena *_arena = nullptr;
 #endif
 	DbStatus decode();
 	DbStatus encode();
@@ -4,15 +4,15 @@
 
 #include "../db_runtime.h"
 #include "../utils/fr_mutex.h"
+#include "../utils/fs_lock.h"
 #include "../utils/fs_utils.h"
 #include "../utils/jsondb_allocator.h"
+#include "../utils/op_stats.h"
 
 #include <StreamUtils.h>
 
 #include <algorithm>
 
-extern FrMutex g_fsMutex;
-
 namespace {
 
 std::string parentDirOf(const std::string &path) {
@@ -42,7 +42,7 @@ DbStatus statFileEntry(
     const std::string &relativePath,
     FileEntryInfo &out
 ) {
-	FrLock fs(g_fsMutex);
+	FsPathLock fs(absolutePath);
 	if (!filesystem.exists(absolutePath.c_str())) {
 		return {DbStatusCode::NotFound, "file not found"};
 	}
@@ -75,7 +75,7 @@ DbStatus collectDirectoryEntries(
 ) {
 	std::vector<std::pair<std::string, std::string>> pendingDirs;
 	{
-		FrLock fs(g_fsMutex);
+		FsNamespaceLock fs;
 		File dir = filesystem.open(absoluteDir.c_str(), FILE_READ);
 		if (!dir || !dir.isDirectory()) {
 			if (dir)
@@ -144,18 +144,21 @@ DbStatus writeFromPullCb(
 	const std::string parentDir = parentDirOf(finalPath);
 	const std::string tmpPath = finalPath + ".tmp";
 
-	FrLock fs(g_fsMutex);
-	if (!fsEnsureDir(filesystem, parentDir)) {
-		return {DbStatusCode::IoError, "mkdir file parent failed"};
-	}
-	if (!opts.overwrite && filesystem.exists(finalPath.c_str())) {
-		return {DbStatusCode::AlreadyExists, "file already exists"};
-	}
-	if (filesystem.exists(tmpPath.c_str())) {
-		filesystem.remove(tmpPath.c_str());
+	FsStagingLock staging(finalPath);
+	File file;
+	{
+		FsNamespaceLock fs;
+		if (!fsEnsureDir(filesystem, parentDir)) {
+			return {DbStatusCode::IoError, "mkdir file parent failed"};
+		}
+		if (!opts.overwrite && filesystem.exists(finalPath.c_str())) {
+			return {DbStatusCode::AlreadyExists, "file already exists"};
+		}
+		if (filesystem.exists(tmpPath.c_str())) {
+			filesystem.remove(tmpPath.c_str());
+		}
+		file = filesystem.open(tmpPath.c_str(), FILE_WRITE);
 	}
-
-	File file = filesystem.open(tmpPath.c_str(), FILE_WRITE);
 	if (!file) {
 		return {DbStatusCode::IoError, "open file for write failed"};
 	}
@@ -164,6 +167,7 @@ DbStatus writeFromPullCb(
 	auto fail = [&](DbStatus st) {
 		buffered.flush();
 		file.close();
+		FsNamespaceLock fs;
 		filesystem.remove(tmpPath.c_str());
 		return st;
 	};
@@ -196,10 +200,17 @@ DbStatus writeFromPullCb(
 	buffered.flush();
 	file.close();
 
-	if (opts.overwrite && filesystem.exists(finalPath.c_str()) &&
-	    !filesystem.remove(finalPath.c_str())) {
-		filesystem.remove(tmpPath.c_str());
-		return {DbStatusCode::IoError, "remove old file failed"};
+	FsPathLock pathLock(finalPath);
+	FsNamespaceLock fs;
+	if (filesystem.exists(finalPath.c_str())) {
+		if (!opts.overwrite) {
+			filesystem.remove(tmpPath.c_str());
+			return {DbStatusCode::AlreadyExists, "file already exists"};
+		}
+		if (!filesystem.remove(finalPath.c_str())) {
+			filesystem.remove(tmpPath.c_str());
+			return {DbStatusCode::IoError, "remove old file failed"};
+		}
 	}
 	if (!filesystem.rename(tmpPath.c_str(), finalPath.c_str())) {
 		filesystem.remove(tmpPath.c_str());
@@ -356,7 +367,7 @@ DbStatus FileStoreImpl::writeFileFromPath(
 
 	File source;
 	{
-		FrLock fs(g_fsMutex);
+		FsPathLock fs(sourceFsPath);
 		source = _rt->fs->open(sourceFsPath.c_str(), FILE_READ);
 	}
 	if (!source) {
@@ -389,18 +400,21 @@ DbStatus FileStoreImpl::writeFile(
 	const std::string parentDir = parentDirOf(finalPath);
 	const std::string tmpPath = finalPath + ".tmp";
 
-	FrLock fs(g_fsMutex);
-	if (!fsEnsureDir(*_rt->fs, parentDir)) {
-		return _rt->recordStatus({DbStatusCode::IoError, "mkdir file parent failed"});
-	}
-	if (!overwrite && _rt->fs->exists(finalPath.c_str())) {
-		return _rt->recordStatus({DbStatusCode::AlreadyExists, "file already exists"});
-	}
-	if (_rt->fs->exists(tmpPath.c_str())) {
-		_rt->fs->remove(tmpPath.c_str());
+	FsStagingLock staging(finalPath);
+	File f;
+	{
+		FsNamespaceLock fs;
+		if (!fsEnsureDir(*_rt->fs, parentDir)) {
+			return _rt->recordStatus({DbStatusCode::IoError, "mkdir file parent failed"});
+		}
+		if (!overwrite && _rt->fs->exists(finalPath.c_str())) {
+			return _rt->recordStatus({DbStatusCode::AlreadyExists, "file already exists"});
+		}
+		if (_rt->fs->exists(tmpPath.c_str())) {
+			_rt->fs->remove(tmpPath.c_str());
+		}
+		f = _rt->fs->open(tmpPath.c_str(), FILE_WRITE);
 	}
-
-	File f = _rt->fs->open(tmpPath.c_str(), FILE_WRITE);
 	if (!f) {
 		return _rt->recordStatus({DbStatusCode::IoError, "open file for write failed"});
 	}
@@ -412,14 +426,22 @@ DbStatus FileStoreImpl::writeFile(
 	}
 	buffered.flush();
 	f.close();
+
+	FsPathLock pathLock(finalPath);
+	FsNamespaceLock fs;
 	if (written != size) {
 		_rt->fs->remove(tmpPath.c_str());
 		return _rt->recordStatus({DbStatusCode::IoError, "file write failed"});
 	}
-
-	if (overwrite && _rt->fs->exists(finalPath.c_str()) && !_rt->fs->remove(finalPath.c_str())) {
-		_rt->fs->remove(tmpPath.c_str());
-		return _rt->recordStatus({DbStatusCode::IoError, "remove old file failed"});
+	if (_rt->fs->exists(finalPath.c_str())) {
+		if (!overwrite) {
+			_rt->fs->remove(tmpPath.c_str());
+			return _rt->recordStatus({DbStatusCode::AlreadyExists, "file already exists"});
+		}
+		if (!_rt->fs->remove(finalPath.c_str())) {
+			_rt->fs->remove(tmpPath.c_str());
+			return _rt->recordStatus({DbStatusCode::IoError, "remove old file failed"});
+		}
 	}
 	if (!_rt->fs->rename(tmpPath.c_str(), finalPath.c_str())) {
 		_rt->fs->remove(tmpPath.c_str());
@@ -462,7 +484,7 @@ FileStoreImpl::readFileStream(const std::string &relativePath, Stream &out, size
 	buffer.resize(chunkSize);
 	const std::string path = joinPath(_rt->fileRootDir(), normalized);
 
-	FrLock fs(g_fsMutex);
+	FsPathLock fs(path);
 	File f = _rt->fs->open(path.c_str(), FILE_READ);
 	if (!f) {
 		res.status = _rt->recordStatus({DbStatusCode::NotFound, "file not found"});
@@ -506,7 +528,7 @@ DbResult<std::vector<uint8_t>> FileStoreImpl::readFile(const std::string &relati
 
 	const std::string path = joinPath(_rt->fileRootDir(), normalized);
 
-	FrLock fs(g_fsMutex);
+	FsPathLock fs(path);
 	File f = _rt->fs->open(path.c_str(), FILE_READ);
 	if (!f) {
 		res.status = _rt->recordStatus({DbStatusCode::NotFound, "file not found"});
@@ -641,7 +663,8 @@ DbStatus FileStoreImpl::removeFile(const std::string &relativePath) {
 		return _rt->recordStatus(nst);
 
 	const std::string path = joinPath(_rt->fileRootDir(), normalized);
-	FrLock fs(g_fsMutex);
+	FsPathLock pathLock(path);
+	FsNamespaceLock fs;
 	if (!_rt->fs->exists(path.c_str())) {
 		return _rt->recordStatus({DbStatusCode::NotFound, "file not found"});
 	}
@@ -667,7 +690,7 @@ DbResult<bool> FileStoreImpl::fileExists(const std::string &relativePath) {
 	}
 
 	const std::string path = joinPath(_rt->fileRootDir(), normalized);
-	FrLock fs(g_fsMutex);
+	FsPathLock fs(path);
 	res.value = _rt->fs->exists(path.c_str());
 	res.status = _rt->recordStatus({DbStatusCode::Ok, ""});
 	return res;
@@ -689,7 +712,7 @@ DbResult<size_t> FileStoreImpl::fileSize(const std::string &relativePath) {
 	}
 
 	const std::string path = joinPath(_rt->fileRootDir(), normalized);
-	FrLock fs(g_fsMutex);
+	FsPathLock fs(path);
 	File f = _rt->fs->open(path.c_str(), FILE_READ);
 	if (!f) {
 		res.status = _rt->recordStatus({DbStatusCode::NotFound, "file not found"});
@@ -898,8 +921,12 @@ FileStoreImpl::runUploadJob(const std::shared_ptr<FileUploadJob> &job, size_t &b
 	const std::string parentDir = parentDirOf(finalPath);
 	const std::string tmpPath = finalPath + ".tmp";
 
+	// Chunks stream into the staging file without any filesystem lock held, so
+	// record loads and other file reads proceed while the upload runs.
+	FsStagingLock staging(finalPath);
+	File f;
 	{
-		FrLock fs(g_fsMutex);
+		FsNamespaceLock fs;
 		if (!fsEnsureDir(*_rt->fs, parentDir)) {
 			return {DbStatusCode::IoError, "mkdir file parent failed"};
 		}
@@ -909,11 +936,6 @@ FileStoreImpl::runUploadJob(const std::shared_ptr<FileUploadJob> &job, size_t &b
 		if (_rt->fs->exists(tmpPath.c_str())) {
 			_rt->fs->remove(tmpPath.c_str());
 		}
-	}
-
-	File f;
-	{
-		FrLock fs(g_fsMutex);
 		f = _rt->fs->open(tmpPath.c_str(), FILE_WRITE);
 	}
 	if (!f) {
@@ -921,8 +943,8 @@ FileStoreImpl::runUploadJob(const std::shared_ptr<FileUploadJob> &job, size_t &b
 	}
 
 	auto cleanupTmp = [&]() {
-		FrLock fs(g_fsMutex);
 		f.close();
+		FsNamespaceLock fs;
 		if (_rt->fs->exists(tmpPath.c_str())) {
 			_rt->fs->remove(tmpPath.c_str());
 		}
@@ -953,11 +975,7 @@ FileStoreImpl::runUploadJob(const std::shared_ptr<FileUploadJob> &job, size_t &b
 		}
 
 		if (produced > 0) {
-			size_t written = 0;
-			{
-				FrLock fs(g_fsMutex);
-				written = f.write(buffer.data(), produced);
-			}
+			const size_t written = f.write(buffer.data(), produced);
 			if (written != produced) {
 				cleanupTmp();
 				return {DbStatusCode::IoError, "file write failed"};
@@ -973,16 +991,20 @@ FileStoreImpl::runUploadJob(const std::shared_ptr<FileUploadJob> &job, size_t &b
 		}
 	}
 
+	f.flush();
+	f.close();
 	{
-		FrLock fs(g_fsMutex);
-		f.flush();
-		f.close();
-		if (job->opts.overwrite && _rt->fs->exists(finalPath.c_str()) &&
-		    !_rt->fs->remove(finalPath.c_str())) {
-			if (_rt->fs->exists(tmpPath.c_str())) {
-				_rt->fs->remove(tmpPath.c_str());
+		FsPathLock pathLock(finalPath);
+		FsNamespaceLock fs;
+		if (_rt->fs->exists(finalPath.c_str())) {
+			const bool canReplace = job->opts.overwrite;
+			if (!canReplace || !_rt->fs->remove(finalPath.c_str())) {
+				if (_rt->fs->exists(tmpPath.c_str())) {
+					_rt->fs->remove(tmpPath.c_str());
+				}
+				return canReplace ? DbStatus{DbStatusCode::IoError, "remove old file failed"}
+				                  : DbStatus{DbStatusCode::AlreadyExists, "file already exists"};
 			}
-			return {DbStatusCode::IoError, "remove old file failed"};
 		}
 		if (!_rt->fs->rename(tmpPath.c_str(), finalPath.c_str())) {
 			if (_rt->fs->exists(tmpPath.c_str())) {
@@ -1034,7 +1056,12 @@ void FileStoreImpl::taskLoop() {
 		}
 
 		size_t bytesWritten = 0;
-		auto st = runUploadJob(job, bytesWritten);
+		DbStatus st;
+		{
+			OpTimer timer(DbOp::FileUpload);
+			st = runUploadJob(job, bytesWritten);
+			timer.addBytes(bytesWritten);
+		}
 
 		DbFileUploadDoneCb doneCb;
 		DbStatus finalStatus = st;
@@ -1077,6 +1104,8 @@ DbStatus FileStore::writeFileStream(
 ) {
 	if (!_impl)
 		return {DbStatusCode::NotInitialized, "file store not initialized"};
+	OpTimer timer(DbOp::FileWrite);
+	timer.addBytes(bytesToWrite);
 	return _impl->writeFileStream(relativePath, in, bytesToWrite, opts);
 }
 
@@ -1087,6 +1116,7 @@ DbStatus FileStore::writeFileStream(
 ) {
 	if (!_impl)
 		return {DbStatusCode::NotInitialized, "file store not initialized"};
+	OpTimer timer(DbOp::FileWrite);
 	return _impl->writeFileStream(relativePath, pullCb, opts);
 }
 
@@ -1097,6 +1127,7 @@ DbStatus FileStore::writeFileFromPath(
 ) {
 	if (!_impl)
 		return {DbStatusCode::NotInitialized, "file store not initialized"};
+	OpTimer timer(DbOp::FileWrite);
 	return _impl->writeFileFromPath(relativePath, sourceFsPath, opts);
 }
 
@@ -1105,6 +1136,8 @@ DbStatus FileStore::writeFile(
 ) {
 	if (!_impl)
 		return {DbStatusCode::NotInitialized, "file store not initialized"};
+	OpTimer timer(DbOp::FileWrite);
+	timer.addBytes(size);
 	return _impl->writeFile(relativePath, data, size, overwrite);
 }
 
@@ -1112,6 +1145,8 @@ DbStatus
 FileStore::writeTextFile(const std::string &relativePath, const std::string &text, bool overwrite) {
 	if (!_impl)
 		return {DbStatusCode::NotInitialized, "file store not initialized"};
+	OpTimer timer(DbOp::FileWrite);
+	timer.addBytes(text.size());
 	return _impl->writeTextFile(relativePath, text, overwrite);
 }
 
@@ -1119,19 +1154,28 @@ DbResult<size_t>
 FileStore::readFileStream(const std::string &relativePath, Stream &out, size_t chunkSize) {
 	if (!_impl)
 		return {{DbStatusCode::NotInitialized, "file store not initialized"}, 0};
-	return _impl->readFileStream(relativePath, out, chunkSize);
+	OpTimer timer(DbOp::FileRead);
+	auto res = _impl->readFileStream(relativePath, out, chunkSize);
+	timer.addBytes(res.value);
+	return res;
 }
 
 DbResult<std::vector<uint8_t>> FileStore::readFile(const std::string &relativePath) {
 	if (!_impl)
 		return {{DbStatusCode::NotInitialized, "file store not initialized"}, {}};
-	return _impl->readFile(relativePath);
+	OpTimer timer(DbOp::FileRead);
+	auto res = _impl->readFile(relativePath);
+	timer.addBytes(res.value.size());
+	return res;
 }
 
 DbResult<std::string> FileStore::readTextFile(const std::string &relativePath) {
 	if (!_impl)
 		return {{DbStatusCode::NotInitialized, "file store not initialized"}, {}};
-	return _impl->readTextFile(relativePath);
+	OpTimer timer(DbOp::FileRead);
+	auto res = _impl->readTextFile(relativePath);
+	timer.addBytes(res.value.size());
+	return res;
 }
 
 DbResult<JsonDocument> FileStore::getFileInfo(const std::string &relativePath) {
@@ -1149,6 +1193,7 @@ DbResult<JsonDocument> FileStore::listFiles(const std::string &relativePrefix, b
 DbStatus FileStore::removeFile(const std::string &relativePath) {
 	if (!_impl)
 		return {DbStatusCode::NotInitialized, "file store not initialized"};
+	OpTimer timer(DbOp::FileRemove);
 	return _impl->removeFile(relativePath);
 }
 
@@ -0,0 +1,62 @@
+#include "read_snapshot.h"
+
+#include "db.h"
+#include "db_runtime.h"
+
+#include <utility>
+
+ReadSnapshot::~ReadSnapshot() {
+	end();
+}
+
+ReadSnapshot::ReadSnapshot(ReadSnapshot &&other) noexcept : _db(other._db), _seq(other._seq) {
+	other._db = nullptr;
+}
+
+ReadSnapshot &ReadSnapshot::operator=(ReadSnapshot &&other) noexcept {
+	if (this == &other)
+		return *this;
+	end();
+	_db = other._db;
+	_seq = other._seq;
+	other._db = nullptr;
+	return *this;
+}
+
+void ReadSnapshot::end() {
+	if (!_db)
+		return;
+	_db->_rt->versions.end(_seq);
+	_db = nullptr;
+}
+
+DbResult<DocView>
+ReadSnapshot::findById(const std::string &collectionName, const std::string &id) {
+	if (!_db) {
+		return {
+		    {DbStatusCode::InvalidArgument, "snapshot ended"},
+		    DocView(nullptr)
+		};
+	}
+	auto cr = _db->snapshotCollection(collectionName);
+	if (!cr.status.ok()) {
+		return {cr.status, DocView(nullptr, nullptr, nullptr, _db)};
+	}
+	return cr.value->findByIdAt(id, _seq);
+}
+
+DbResult<std::vector<DocView>> ReadSnapshot::findMany(
+    const std::string &collectionName, std::function<bool(const DocView &)> pred
+) {
+	DbResult<std::vector<DocView>> res{};
+	if (!_db) {
+		res.status = {DbStatusCode::InvalidArgument, "snapshot ended"};
+		return res;
+	}
+	auto cr = _db->snapshotCollection(collectionName);
+	if (!cr.status.ok()) {
+		res.status = cr.status;
+		return res;
+	}
+	return cr.value->findManyAt(_seq, std::move(pred));
+}
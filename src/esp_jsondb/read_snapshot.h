@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "document/document.h"
+#include "utils/dbTypes.h"
+
+class ESPJsonDB;
+
+// A consistent, point-in-time view across all collections, obtained from
+// ESPJsonDB::beginRead(). Reads through a snapshot never block writers and are
+// never torn by them: documents changed or removed after the snapshot was
+// opened keep their old content for it, documents created later stay hidden.
+//
+// Versions superseded while a snapshot is open are retained in memory until
+// it ends, so keep snapshots short-lived. Dropped collections are not
+// retained. Do not open a snapshot from inside a mutator callback.
+class ReadSnapshot {
+  public:
+	ReadSnapshot() = default;
+	~ReadSnapshot();
+
+	ReadSnapshot(const ReadSnapshot &) = delete;
+	ReadSnapshot &operator=(const ReadSnapshot &) = delete;
+	ReadSnapshot(ReadSnapshot &&other) noexcept;
+	ReadSnapshot &operator=(ReadSnapshot &&other) noexcept;
+
+	bool valid() const {
+		return _db != nullptr;
+	}
+	// Commit sequence the snapshot observes.
+	uint32_t sequence() const {
+		return _seq;
+	}
+
+	// Read-only views; commit() on them fails.
+	DbResult<DocView> findById(const std::string &collectionName, const std::string &id);
+	DbResult<std::vector<DocView>>
+	findMany(const std::string &collectionName, std::function<bool(const DocView &)> pred);
+
+	// Release retained versions. Called automatically on destruction.
+	void end();
+
+  private:
+	friend class ESPJsonDB;
+	ReadSnapshot(ESPJsonDB *db, uint32_t seq) : _db(db), _seq(seq) {
+	}
+
+	ESPJsonDB *_db = nullptr;
+	uint32_t _seq = 0;
+};
@@ -2,30 +2,46 @@
 
 #include <cstring>
 
+#include "lz4_block.h"
+
+#if ESP_JSONDB_CRC32_USE_ROM
+#include <esp_rom_crc.h>
+#endif
+
 namespace {
 constexpr uint8_t kMagic[4] = {'J', 'D', 'B', '2'};
 constexpr uint16_t kVersionWithDuplicatedFlags = 1;
 constexpr uint16_t kVersionPrefixFlagsOnly = 2;
+// v3 adds the storage flags after the CRC, so all 16 prefix flag bits stay
+// DocumentMeta::flags as they were in v1 and v2.
+constexpr uint16_t kVersionStorageFlags = 3;
 constexpr uint32_t kHeaderSizeV1 = 24 + 8 + 8 + 4 + 4 + 2;
 constexpr uint32_t kHeaderSizeV2 = 24 + 8 + 8 + 4 + 4;
-constexpr uint32_t kPrefixSize = 4 + 2 + 2 + 4 + 4;
+constexpr uint32_t kHeaderSizeV3 = kHeaderSizeV2 + 2;
+constexpr size_t kPrefixSize = DocCodec::kPrefixSize;
+static_assert(kHeaderSizeV1 <= DocCodec::kMaxHeaderSize, "kMaxHeaderSize too small");
+static_assert(kHeaderSizeV3 <= DocCodec::kMaxHeaderSize, "kMaxHeaderSize too small");
+static_assert(kPrefixSize + kHeaderSizeV3 == DocCodec::kEncodedHeaderSize, "v3 header size");
 
-void appendU16(JsonDbVector<uint8_t> &out, uint16_t value) {
-	out.push_back(static_cast<uint8_t>(value & 0xFFu));
-	out.push_back(static_cast<uint8_t>((value >> 8) & 0xFFu));
+uint8_t *putU16(uint8_t *out, uint16_t value) {
+	out[0] = static_cast<uint8_t>(value & 0xFFu);
+	out[1] = static_cast<uint8_t>((value >> 8) & 0xFFu);
+	return out + 2;
 }
 
-void appendU32(JsonDbVector<uint8_t> &out, uint32_t value) {
-	out.push_back(static_cast<uint8_t>(value & 0xFFu));
-	out.push_back(static_cast<uint8_t>((value >> 8) & 0xFFu));
-	out.push_back(static_cast<uint8_t>((value >> 16) & 0xFFu));
-	out.push_back(static_cast<uint8_t>((value >> 24) & 0xFFu));
+uint8_t *putU32(uint8_t *out, uint32_t value) {
+	out[0] = static_cast<uint8_t>(value & 0xFFu);
+	out[1] = static_cast<uint8_t>((value >> 8) & 0xFFu);
+	out[2] = static_cast<uint8_t>((value >> 16) & 0xFFu);
+	out[3] = static_cast<uint8_t>((value >> 24) & 0xFFu);
+	return out + 4;
 }
 
-void appendU64(JsonDbVector<uint8_t> &out, uint64_t value) {
+uint8_t *putU64(uint8_t *out, uint64_t value) {
 	for (uint8_t shift = 0; shift < 8; ++shift) {
-		out.push_back(static_cast<uint8_t>((value >> (shift * 8U)) & 0xFFu));
+		out[shift] = static_cast<uint8_t>((value >> (shift * 8U)) & 0xFFu);
 	}
+	return out + 8;
 }
 
 bool readU16(const uint8_t *data, size_t size, size_t &offset, uint16_t &value) {
@@ -56,46 +72,164 @@ bool readU64(const uint8_t *data, size_t size, size_t &offset, uint64_t &value)
 	offset += 8;
 	return true;
 }
+
+// Tables for slicing-by-8: t[0] is the classic byte table, t[k] advances a
+// byte through k further zero bytes, so eight input bytes fold in at once.
+struct Crc32Tables {
+	uint32_t t[8][256];
+};
+
+constexpr Crc32Tables makeCrc32Tables() {
+	Crc32Tables tables{};
+	for (uint32_t i = 0; i < 256; ++i) {
+		uint32_t crc = i;
+		for (uint8_t bit = 0; bit < 8; ++bit)
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+		tables.t[0][i] = crc;
+	}
+	for (uint32_t i = 0; i < 256; ++i) {
+		for (size_t k = 1; k < 8; ++k) {
+			const uint32_t prev = tables.t[k - 1][i];
+			tables.t[k][i] = (prev >> 8) ^ tables.t[0][prev & 0xFFu];
+		}
+	}
+	return tables;
+}
+
+constexpr Crc32Tables kCrc32 = makeCrc32Tables();
+
+uint32_t loadU32(const uint8_t *data) {
+	return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+	       (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
 } // namespace
 
 uint32_t DocCodec::crc32(const uint8_t *data, size_t size) {
+#if ESP_JSONDB_CRC32_USE_ROM
+	// The ROM routine takes and returns the finalized value, like zlib.
+	return esp_rom_crc32_le(0, data, static_cast<uint32_t>(size));
+#else
+	return crc32Portable(data, size);
+#endif
+}
+
+uint32_t DocCodec::crc32Portable(const uint8_t *data, size_t size) {
+	const auto &t = kCrc32.t;
 	uint32_t crc = 0xFFFFFFFFu;
-	for (size_t i = 0; i < size; ++i) {
-		crc ^= static_cast<uint32_t>(data[i]);
-		for (uint8_t bit = 0; bit < 8; ++bit) {
-			const uint32_t mask = static_cast<uint32_t>(-(static_cast<int32_t>(crc & 1u)));
-			crc = (crc >> 1) ^ (0xEDB88320u & mask);
-		}
+	while (size >= 8) {
+		const uint32_t lo = loadU32(data) ^ crc;
+		const uint32_t hi = loadU32(data + 4);
+		crc = t[7][lo & 0xFFu] ^ t[6][(lo >> 8) & 0xFFu] ^ t[5][(lo >> 16) & 0xFFu] ^
+		      t[4][lo >> 24] ^ t[3][hi & 0xFFu] ^ t[2][(hi >> 8) & 0xFFu] ^
+		      t[1][(hi >> 16) & 0xFFu] ^ t[0][hi >> 24];
+		data += 8;
+		size -= 8;
 	}
+	while (size-- > 0)
+		crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFFu];
 	return ~crc;
 }
 
-DbStatus DocCodec::encodeRecord(
-    const RecordHeader &header, const JsonDbVector<uint8_t> &payload, JsonDbVector<uint8_t> &out
+DbStatus DocCodec::encodeEnvelope(
+    const RecordHeader &header, size_t payloadSize, uint8_t *head, uint8_t *trailer
 ) {
 	if (!header.id.valid()) {
 		return {DbStatusCode::InvalidArgument, "record id is invalid"};
 	}
 
-	const uint32_t payloadCrc = crc32(payload.data(), payload.size());
+	std::memcpy(head, kMagic, sizeof(kMagic));
+	uint8_t *out = head + sizeof(kMagic);
+	out = putU16(out, kVersionStorageFlags);
+	out = putU16(out, header.flags);
+	out = putU32(out, kHeaderSizeV3);
+	out = putU32(out, static_cast<uint32_t>(payloadSize));
+	std::memcpy(out, header.id.c_str(), DocId::kHexLength);
+	out += DocId::kHexLength;
+	out = putU64(out, header.createdAtMs);
+	out = putU64(out, header.updatedAtMs);
+	out = putU32(out, header.revision);
+	out = putU32(out, header.payloadCrc32);
+	putU16(out, header.storageFlags);
+	putU32(trailer, header.payloadCrc32);
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus DocCodec::encodeRecord(
+    const RecordHeader &header, const JsonDbVector<uint8_t> &payload, JsonDbVector<uint8_t> &out
+) {
+	RecordHeader withCrc = header;
+	withCrc.payloadCrc32 = crc32(payload.data(), payload.size());
+	uint8_t head[kEncodedHeaderSize];
+	uint8_t trailer[kTrailerSize];
+	auto st = encodeEnvelope(withCrc, payload.size(), head, trailer);
+	if (!st.ok())
+		return st;
 	out.clear();
-	out.reserve(kPrefixSize + kHeaderSizeV2 + payload.size() + sizeof(uint32_t));
-	out.insert(out.end(), kMagic, kMagic + sizeof(kMagic));
-	appendU16(out, kVersionPrefixFlagsOnly);
-	appendU16(out, header.flags);
-	appendU32(out, kHeaderSizeV2);
-	appendU32(out, static_cast<uint32_t>(payload.size()));
+	out.reserve(sizeof(head) + payload.size() + sizeof(trailer));
+	out.insert(out.end(), head, head + sizeof(head));
+	out.insert(out.end(), payload.begin(), payload.end());
+	out.insert(out.end(), trailer, trailer + sizeof(trailer));
+	return {DbStatusCode::Ok, ""};
+}
 
-	for (size_t idx = 0; idx < DocId::kHexLength; ++idx) {
-		out.push_back(static_cast<uint8_t>(header.id.c_str()[idx]));
-	}
-	appendU64(out, header.createdAtMs);
-	appendU64(out, header.updatedAtMs);
-	appendU32(out, header.revision);
-	appendU32(out, payloadCrc);
+DbStatus DocCodec::encodeRecord(const DocumentRecord &record, JsonDbVector<uint8_t> &out) {
+	RecordHeader header;
+	header.id = record.meta.id;
+	header.createdAtMs = record.meta.createdAtMs;
+	header.updatedAtMs = record.meta.updatedAtMs;
+	header.revision = record.meta.revision;
+	header.flags = record.meta.flags;
+	return encodeRecord(header, record.msgpack, out);
+}
 
-	out.insert(out.end(), payload.begin(), payload.end());
-	appendU32(out, payloadCrc);
+PayloadCodec DocCodec::codecOf(uint16_t storageFlags) {
+	return static_cast<PayloadCodec>((storageFlags & kCodecFlagMask) >> kCodecFlagShift);
+}
+
+uint16_t DocCodec::withCodec(uint16_t storageFlags, PayloadCodec codec) {
+	return static_cast<uint16_t>(
+	    (storageFlags & ~kCodecFlagMask) | (static_cast<uint16_t>(codec) << kCodecFlagShift)
+	);
+}
+
+void DocCodec::packPayload(
+    PayloadCodec codec,
+    const uint8_t *msgpack,
+    size_t size,
+    JsonDbVector<uint8_t> &stored,
+    PayloadCodec &used
+) {
+	used = PayloadCodec::None;
+	if (codec != PayloadCodec::Lz4)
+		return;
+	// The block is preceded by the decoded size, which LZ4 blocks do not carry.
+	JsonDbVector<uint8_t> block{stored.get_allocator()};
+	if (!Lz4Block::compress(msgpack, size, block) || block.size() + 4 >= size)
+		return;
+	stored.resize(4);
+	putU32(stored.data(), static_cast<uint32_t>(size));
+	stored.insert(stored.end(), block.begin(), block.end());
+	used = PayloadCodec::Lz4;
+}
+
+DbStatus DocCodec::unpackPayload(
+    PayloadCodec codec, const uint8_t *stored, size_t size, JsonDbVector<uint8_t> &msgpack
+) {
+	if (codec == PayloadCodec::None) {
+		msgpack.assign(stored, stored + size);
+		return {DbStatusCode::Ok, ""};
+	}
+	if (codec != PayloadCodec::Lz4)
+		return {DbStatusCode::SchemaMismatch, "unsupported payload codec"};
+	size_t offset = 0;
+	uint32_t rawSize = 0;
+	if (!readU32(stored, size, offset, rawSize))
+		return {DbStatusCode::CorruptionDetected, "compressed payload truncated"};
+	msgpack.resize(rawSize);
+	if (!Lz4Block::decompress(stored + offset, size - offset, msgpack.data(), rawSize)) {
+		msgpack.clear();
+		return {DbStatusCode::CorruptionDetected, "payload decompress failed"};
+	}
 	return {DbStatusCode::Ok, ""};
 }
 
@@ -107,7 +241,38 @@ DbStatus DocCodec::decodeRecord(
     bool usePSRAMBuffers
 ) {
 	payload = JsonDbVector<uint8_t>(JsonDbAllocator<uint8_t>(usePSRAMBuffers));
-	if (!data || size < (kPrefixSize + kHeaderSizeV2 + sizeof(uint32_t))) {
+	size_t payloadOffset = 0;
+	size_t payloadSize = 0;
+	auto st = decodeRecordInPlace(data, size, header, payloadOffset, payloadSize);
+	if (!st.ok())
+		return st;
+	return unpackPayload(codecOf(header.storageFlags), data + payloadOffset, payloadSize, payload);
+}
+
+DbStatus DocCodec::decodeRecordInPlace(
+    const uint8_t *data,
+    size_t size,
+    RecordHeader &header,
+    size_t &payloadOffset,
+    size_t &payloadSize
+) {
+	uint32_t headerSize = 0;
+	uint32_t bodySize = 0;
+	auto st = decodePrefix(data, size, headerSize, bodySize);
+	if (!st.ok())
+		return st;
+	st = decodeHeader(data, kPrefixSize + headerSize, header);
+	if (!st.ok())
+		return st;
+	payloadOffset = kPrefixSize + headerSize;
+	payloadSize = bodySize;
+	return checkPayload(header, data + payloadOffset, payloadSize, data + payloadOffset + bodySize);
+}
+
+DbStatus DocCodec::decodePrefix(
+    const uint8_t *data, size_t recordSize, uint32_t &headerSize, uint32_t &payloadSize
+) {
+	if (!data || recordSize < (kPrefixSize + kHeaderSizeV2 + kTrailerSize)) {
 		return {DbStatusCode::CorruptionDetected, "record too small"};
 	}
 	if (std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
@@ -117,20 +282,37 @@ DbStatus DocCodec::decodeRecord(
 	size_t offset = sizeof(kMagic);
 	uint16_t version = 0;
 	uint16_t prefixFlags = 0;
-	uint32_t headerSize = 0;
-	uint32_t payloadSize = 0;
-	if (!readU16(data, size, offset, version) || !readU16(data, size, offset, prefixFlags) ||
-	    !readU32(data, size, offset, headerSize) || !readU32(data, size, offset, payloadSize)) {
+	if (!readU16(data, kPrefixSize, offset, version) ||
+	    !readU16(data, kPrefixSize, offset, prefixFlags) ||
+	    !readU32(data, kPrefixSize, offset, headerSize) ||
+	    !readU32(data, kPrefixSize, offset, payloadSize)) {
 		return {DbStatusCode::CorruptionDetected, "record header truncated"};
 	}
 	const bool isV1 = version == kVersionWithDuplicatedFlags && headerSize == kHeaderSizeV1;
 	const bool isV2 = version == kVersionPrefixFlagsOnly && headerSize == kHeaderSizeV2;
-	if (!isV1 && !isV2) {
+	const bool isV3 = version == kVersionStorageFlags && headerSize == kHeaderSizeV3;
+	if (!isV1 && !isV2 && !isV3) {
 		return {DbStatusCode::SchemaMismatch, "unsupported record version"};
 	}
-	if (size != (kPrefixSize + headerSize + payloadSize + sizeof(uint32_t))) {
+	if (recordSize != (kPrefixSize + headerSize + payloadSize + kTrailerSize)) {
 		return {DbStatusCode::CorruptionDetected, "record size mismatch"};
 	}
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus DocCodec::decodeHeader(const uint8_t *data, size_t size, RecordHeader &header) {
+	size_t offset = sizeof(kMagic);
+	uint16_t version = 0;
+	uint16_t prefixFlags = 0;
+	uint32_t headerSize = 0;
+	if (!data || !readU16(data, size, offset, version) ||
+	    !readU16(data, size, offset, prefixFlags) || !readU32(data, size, offset, headerSize)) {
+		return {DbStatusCode::CorruptionDetected, "record header truncated"};
+	}
+	offset = kPrefixSize;
+	if (offset + headerSize > size) {
+		return {DbStatusCode::CorruptionDetected, "record header payload truncated"};
+	}
 
 	char idBuffer[DocId::kStorageLength];
 	if (offset + DocId::kHexLength > size) {
@@ -148,28 +330,26 @@ DbStatus DocCodec::decodeRecord(
 	    !readU32(data, size, offset, header.payloadCrc32)) {
 		return {DbStatusCode::CorruptionDetected, "record header payload truncated"};
 	}
-	if (isV1) {
-		uint16_t legacyFlags = 0;
-		if (!readU16(data, size, offset, legacyFlags)) {
-			return {DbStatusCode::CorruptionDetected, "record header payload truncated"};
-		}
-	}
-
-	payload.resize(payloadSize);
-	if (payloadSize > 0) {
-		std::memcpy(payload.data(), data + offset, payloadSize);
+	header.storageFlags = 0;
+	if (version == kVersionStorageFlags && !readU16(data, size, offset, header.storageFlags)) {
+		return {DbStatusCode::CorruptionDetected, "record header payload truncated"};
 	}
-	offset += payloadSize;
+	// v1 repeats the flags after the header fields; the prefix copy wins.
+	header.flags = prefixFlags;
+	return {DbStatusCode::Ok, ""};
+}
 
+DbStatus DocCodec::checkPayload(
+    const RecordHeader &header, const uint8_t *payload, size_t size, const uint8_t *trailer
+) {
+	size_t offset = 0;
 	uint32_t trailerCrc = 0;
-	if (!readU32(data, size, offset, trailerCrc)) {
+	if (!trailer || !readU32(trailer, kTrailerSize, offset, trailerCrc)) {
 		return {DbStatusCode::CorruptionDetected, "record crc truncated"};
 	}
-
-	const uint32_t actualCrc = crc32(payload.data(), payload.size());
+	const uint32_t actualCrc = crc32(payload, size);
 	if (actualCrc != header.payloadCrc32 || actualCrc != trailerCrc) {
 		return {DbStatusCode::CorruptionDetected, "record crc mismatch"};
 	}
-	header.flags = prefixFlags;
 	return {DbStatusCode::Ok, ""};
 }
@@ -9,23 +9,60 @@
 #include "../utils/dbTypes.h"
 #include "../utils/jsondb_allocator.h"
 
+// crc32() uses the ESP ROM routine when the SDK provides it; define
+// ESP_JSONDB_CRC32_USE_ROM=0 to build the portable table version instead.
+#ifndef ESP_JSONDB_CRC32_USE_ROM
+#if defined(ESP_PLATFORM) && __has_include(<esp_rom_crc.h>)
+#define ESP_JSONDB_CRC32_USE_ROM 1
+#else
+#define ESP_JSONDB_CRC32_USE_ROM 0
+#endif
+#endif
+
 struct RecordHeader {
 	DocId id;
 	uint64_t createdAtMs = 0;
 	uint64_t updatedAtMs = 0;
 	uint32_t revision = 0;
-	uint32_t payloadCrc32 = 0;
-	uint16_t flags = 0;
+	uint32_t payloadCrc32 = 0; // of the stored, possibly compressed, payload
+	uint16_t flags = 0;        // DocumentMeta::flags
+	uint16_t storageFlags = 0; // codec and interned keys; v3 records only
 };
 
 class DocCodec {
   public:
 	static constexpr const char *kRecordExtension = ".jdb";
+	// Magic, version, flags, header size and payload size.
+	static constexpr size_t kPrefixSize = 4 + 2 + 2 + 4 + 4;
+	// Largest header any supported version writes after the prefix.
+	static constexpr size_t kMaxHeaderSize = 24 + 8 + 8 + 4 + 4 + 2;
+	static constexpr size_t kTrailerSize = 4;
+	// Prefix plus header as written by the current version.
+	static constexpr size_t kEncodedHeaderSize = kPrefixSize + 24 + 8 + 8 + 4 + 4 + 2;
+	// RecordHeader::storageFlags bits holding the PayloadCodec of the stored
+	// payload, and the bit marking map keys replaced by KeyDictionary ids.
+	// Records older than v3 have no such field and read as plain MessagePack.
+	static constexpr uint16_t kCodecFlagMask = 0xC000;
+	static constexpr uint8_t kCodecFlagShift = 14;
+	static constexpr uint16_t kInternedKeysFlag = 0x2000;
 
+	// CRC-32 (IEEE 802.3, as in zlib) of the payload.
 	static uint32_t crc32(const uint8_t *data, size_t size);
+	// Slicing-by-8 table implementation; crc32() without the ROM path.
+	static uint32_t crc32Portable(const uint8_t *data, size_t size);
 	static DbStatus encodeRecord(
 	    const RecordHeader &header, const JsonDbVector<uint8_t> &payload, JsonDbVector<uint8_t> &out
 	);
+	// Encode `record` with a header built from its metadata.
+	static DbStatus encodeRecord(const DocumentRecord &record, JsonDbVector<uint8_t> &out);
+	// The bytes around a payload kept elsewhere: kEncodedHeaderSize into
+	// `head` and kTrailerSize into `trailer`. header.payloadCrc32 must
+	// already hold the payload CRC.
+	static DbStatus encodeEnvelope(
+	    const RecordHeader &header, size_t payloadSize, uint8_t *head, uint8_t *trailer
+	);
+	// Decodes the payload back to MessagePack whatever codec stored it.
+	// Interned keys stay ids; RecordStore::read expands them.
 	static DbStatus decodeRecord(
 	    const uint8_t *data,
 	    size_t size,
@@ -33,4 +70,41 @@ class DocCodec {
 	    JsonDbVector<uint8_t> &payload,
 	    bool usePSRAMBuffers
 	);
+	// Validate a record without copying its payload, which stays at
+	// data[payloadOffset, payloadOffset + payloadSize).
+	static DbStatus decodeRecordInPlace(
+	    const uint8_t *data,
+	    size_t size,
+	    RecordHeader &header,
+	    size_t &payloadOffset,
+	    size_t &payloadSize
+	);
+
+	static PayloadCodec codecOf(uint16_t storageFlags);
+	static uint16_t withCodec(uint16_t storageFlags, PayloadCodec codec);
+	// Stored form of a MessagePack payload. `used` is None, and `stored`
+	// untouched, when `codec` is None or would not make it smaller.
+	static void packPayload(
+	    PayloadCodec codec,
+	    const uint8_t *msgpack,
+	    size_t size,
+	    JsonDbVector<uint8_t> &stored,
+	    PayloadCodec &used
+	);
+	// MessagePack payload from its stored form.
+	static DbStatus unpackPayload(
+	    PayloadCodec codec, const uint8_t *stored, size_t size, JsonDbVector<uint8_t> &msgpack
+	);
+
+	// Piecewise decode for readers that place the payload themselves.
+	// decodePrefix() takes the first kPrefixSize bytes of a `recordSize` byte
+	// record, decodeHeader() the prefix followed by `headerSize` bytes, and
+	// checkPayload() the payload and the kTrailerSize bytes after it.
+	static DbStatus decodePrefix(
+	    const uint8_t *data, size_t recordSize, uint32_t &headerSize, uint32_t &payloadSize
+	);
+	static DbStatus decodeHeader(const uint8_t *data, size_t size, RecordHeader &header);
+	static DbStatus checkPayload(
+	    const RecordHeader &header, const uint8_t *payload, size_t size, const uint8_t *trailer
+	);
 };
@@ -0,0 +1,479 @@
+#include "key_dictionary.h"
+
+#include <StreamUtils.h>
+
+#include <string_view>
+
+#include "../utils/fs_lock.h"
+#include "../utils/fs_utils.h"
+
+namespace {
+constexpr uint8_t kMaxDepth = 32;
+
+using KeyHandler = std::function<bool(size_t &pos, uint8_t depth)>;
+
+std::string dictPathFor(const std::string &collectionDir) {
+	return joinPath(collectionDir, KeyDictionary::kFileName);
+}
+
+uint32_t readBe(const uint8_t *data, size_t bytes) {
+	uint32_t value = 0;
+	for (size_t i = 0; i < bytes; ++i)
+		value = (value << 8) | data[i];
+	return value;
+}
+
+// Size of the MessagePack item at data[pos]: the whole item for scalars, the
+// header alone for arrays and maps, which report their element count.
+bool readItem(
+    const uint8_t *data, size_t size, size_t pos, size_t &length, uint32_t &count, bool &isMap
+) {
+	if (pos >= size)
+		return false;
+	const uint8_t b = data[pos];
+	const size_t avail = size - pos;
+	count = 0;
+	isMap = false;
+	length = 1;
+	if (b <= 0x7f || b >= 0xe0 || b == 0xc0 || b == 0xc2 || b == 0xc3)
+		return true;
+	if (b <= 0x8f) {
+		isMap = true;
+		count = b & 0x0fu;
+		return true;
+	}
+	if (b <= 0x9f) {
+		count = b & 0x0fu;
+		return true;
+	}
+	if (b <= 0xbf) {
+		length += b & 0x1fu;
+		return length <= avail;
+	}
+
+	size_t lengthBytes = 0;
+	size_t fixed = 0;
+	uint8_t container = 0; // 1 array, 2 map
+	switch (b) {
+	case 0xc4: // bin 8
+	case 0xd9: // str 8
+		lengthBytes = 1;
+		break;
+	case 0xc5:
+	case 0xda:
+		lengthBytes = 2;
+		break;
+	case 0xc6:
+	case 0xdb:
+		lengthBytes = 4;
+		break;
+	case 0xc7: // ext 8/16/32 carry a type byte after the length
+		lengthBytes = 1;
+		fixed = 1;
+		break;
+	case 0xc8:
+		lengthBytes = 2;
+		fixed = 1;
+		break;
+	case 0xc9:
+		lengthBytes = 4;
+		fixed = 1;
+		break;
+	case 0xcc:
+	case 0xd0:
+		fixed = 1;
+		break;
+	case 0xcd:
+	case 0xd1:
+		fixed = 2;
+		break;
+	case 0xca:
+	case 0xce:
+	case 0xd2:
+		fixed = 4;
+		break;
+	case 0xcb:
+	case 0xcf:
+	case 0xd3:
+		fixed = 8;
+		break;
+	case 0xd4: // fixext 1..16: type byte plus data
+		fixed = 2;
+		break;
+	case 0xd5:
+		fixed = 3;
+		break;
+	case 0xd6:
+		fixed = 5;
+		break;
+	case 0xd7:
+		fixed = 9;
+		break;
+	case 0xd8:
+		fixed = 17;
+		break;
+	case 0xdc:
+		lengthBytes = 2;
+		container = 1;
+		break;
+	case 0xdd:
+		lengthBytes = 4;
+		container = 1;
+		break;
+	case 0xde:
+		lengthBytes = 2;
+		container = 2;
+		break;
+	case 0xdf:
+		lengthBytes = 4;
+		container = 2;
+		break;
+	default:
+		return false;
+	}
+	if (1 + lengthBytes > avail)
+		return false;
+	const uint32_t n = readBe(data + pos + 1, lengthBytes);
+	length += lengthBytes;
+	if (container != 0) {
+		count = n;
+		isMap = container == 2;
+		return true;
+	}
+	if (n > avail)
+		return false;
+	length += fixed + n;
+	return length <= avail;
+}
+
+// The string at data[pos], if that item is one.
+bool stringAt(
+    const uint8_t *data, size_t size, size_t pos, std::string_view &value, size_t &length
+) {
+	uint32_t count = 0;
+	bool isMap = false;
+	if (!readItem(data, size, pos, length, count, isMap))
+		return false;
+	const uint8_t b = data[pos];
+	size_t header = 0;
+	if (b >= 0xa0 && b <= 0xbf)
+		header = 1;
+	else if (b == 0xd9)
+		header = 2;
+	else if (b == 0xda)
+		header = 3;
+	else if (b == 0xdb)
+		header = 5;
+	else
+		return false;
+	value = std::string_view(reinterpret_cast<const char *>(data + pos + header), length - header);
+	return true;
+}
+
+// The small unsigned integer at data[pos], if that item is one.
+bool idAt(const uint8_t *data, size_t size, size_t pos, uint16_t &id, size_t &length) {
+	if (pos >= size)
+		return false;
+	const uint8_t b = data[pos];
+	if (b <= 0x7f) {
+		id = b;
+		length = 1;
+		return true;
+	}
+	if (b == 0xcc && size - pos >= 2) {
+		id = data[pos + 1];
+		length = 2;
+		return true;
+	}
+	if (b == 0xcd && size - pos >= 3) {
+		id = static_cast<uint16_t>(readBe(data + pos + 1, 2));
+		length = 3;
+		return true;
+	}
+	return false;
+}
+
+void putId(JsonDbVector<uint8_t> &out, uint16_t id) {
+	if (id <= 0x7f) {
+		out.push_back(static_cast<uint8_t>(id));
+	} else if (id <= 0xff) {
+		out.push_back(0xcc);
+		out.push_back(static_cast<uint8_t>(id));
+	} else {
+		out.push_back(0xcd);
+		out.push_back(static_cast<uint8_t>(id >> 8));
+		out.push_back(static_cast<uint8_t>(id & 0xffu));
+	}
+}
+
+void putString(JsonDbVector<uint8_t> &out, const std::string &value) {
+	if (value.size() < 32) {
+		out.push_back(static_cast<uint8_t>(0xa0u | value.size()));
+	} else {
+		out.push_back(0xd9);
+		out.push_back(static_cast<uint8_t>(value.size()));
+	}
+	out.insert(out.end(), value.begin(), value.end());
+}
+
+// Copy one item and everything inside it, handing each map key to `onKey`,
+// which consumes it and writes its replacement.
+bool copyValue(
+    const uint8_t *data,
+    size_t size,
+    size_t &pos,
+    JsonDbVector<uint8_t> &out,
+    const KeyHandler &onKey,
+    uint8_t depth
+) {
+	size_t length = 0;
+	uint32_t count = 0;
+	bool isMap = false;
+	if (depth > kMaxDepth || !readItem(data, size, pos, length, count, isMap))
+		return false;
+	out.insert(out.end(), data + pos, data + pos + length);
+	pos += length;
+	for (uint32_t i = 0; i < count; ++i) {
+		if (isMap && !onKey(pos, depth + 1))
+			return false;
+		if (!copyValue(data, size, pos, out, onKey, depth + 1))
+			return false;
+	}
+	return true;
+}
+
+bool walk(
+    const uint8_t *data, size_t size, JsonDbVector<uint8_t> &out, const KeyHandler &onKey
+) {
+	out.clear();
+	out.reserve(size);
+	size_t pos = 0;
+	return copyValue(data, size, pos, out, onKey, 0) && pos == size;
+}
+} // namespace
+
+KeyDictionary::KeyDictionary(fs::FS &fs, bool usePSRAMBuffers)
+    : _fs(&fs), _keys(JsonDbAllocator<std::string>(usePSRAMBuffers)),
+      _ids(
+          std::less<>{},
+          JsonDbAllocator<std::pair<const std::string, uint16_t>>(usePSRAMBuffers)
+      ) {
+	_mu.setName("keyDictionary");
+}
+
+DbStatus KeyDictionary::intern(
+    const std::string &collectionDir,
+    const uint8_t *msgpack,
+    size_t size,
+    JsonDbVector<uint8_t> &out
+) {
+	if (!_fs) {
+		return {DbStatusCode::IoError, "filesystem not ready"};
+	}
+	FrLock lk(_mu);
+	if (_dir != collectionDir)
+		loadLocked(collectionDir);
+
+	size_t firstNew = _keys.size();
+	bool integerKey = false;
+	KeyHandler onKey;
+	onKey = [&](size_t &pos, uint8_t depth) {
+		std::string_view key;
+		size_t length = 0;
+		uint16_t id = 0;
+		// expand() would take an integer key for an id.
+		if (idAt(msgpack, size, pos, id, length)) {
+			integerKey = true;
+			return false;
+		}
+		if (stringAt(msgpack, size, pos, key, length)) {
+			auto it = _ids.find(key);
+			if (it != _ids.end()) {
+				putId(out, it->second);
+				pos += length;
+				return true;
+			}
+			if (_keys.size() < kMaxKeys && !key.empty() && key.size() <= kMaxKeyLength) {
+				id = static_cast<uint16_t>(_keys.size());
+				_keys.emplace_back(key);
+				_ids.emplace(_keys.back(), id);
+				putId(out, id);
+				pos += length;
+				return true;
+			}
+		}
+		return copyValue(msgpack, size, pos, out, onKey, depth);
+	};
+	// A second round runs when the file changed under the cache: the ids
+	// handed out in the first one may already belong to other keys.
+	for (int round = 0;; ++round) {
+		firstNew = _keys.size();
+		if (!walk(msgpack, size, out, onKey)) {
+			forgetFromLocked(firstNew);
+			if (integerKey)
+				return {DbStatusCode::Unsupported, "integer map key"};
+			return {DbStatusCode::CorruptionDetected, "msgpack key walk failed"};
+		}
+		// Known keys only: nothing to write.
+		if (firstNew == _keys.size())
+			return {DbStatusCode::Ok, ""};
+		bool stale = false;
+		auto st = appendLocked(firstNew, stale);
+		if (st.ok())
+			return st;
+		forgetFromLocked(firstNew);
+		if (!stale || round > 0)
+			return st;
+		loadLocked(collectionDir);
+	}
+}
+
+DbStatus KeyDictionary::expand(
+    const std::string &collectionDir,
+    const uint8_t *data,
+    size_t size,
+    JsonDbVector<uint8_t> &out
+) {
+	if (!_fs) {
+		return {DbStatusCode::IoError, "filesystem not ready"};
+	}
+	FrLock lk(_mu);
+	if (_dir != collectionDir)
+		loadLocked(collectionDir);
+
+	bool unknownId = false;
+	KeyHandler onKey;
+	onKey = [&](size_t &pos, uint8_t depth) {
+		uint16_t id = 0;
+		size_t length = 0;
+		if (!idAt(data, size, pos, id, length))
+			return copyValue(data, size, pos, out, onKey, depth);
+		if (id >= _keys.size()) {
+			unknownId = true;
+			return false;
+		}
+		putString(out, _keys[id]);
+		pos += length;
+		return true;
+	};
+	if (walk(data, size, out, onKey))
+		return {DbStatusCode::Ok, ""};
+	// Another store may have added keys since the cache was filled.
+	if (unknownId) {
+		loadLocked(collectionDir);
+		if (walk(data, size, out, onKey))
+			return {DbStatusCode::Ok, ""};
+	}
+	out.clear();
+	return {DbStatusCode::CorruptionDetected, "interned key decode failed"};
+}
+
+void KeyDictionary::loadLocked(const std::string &collectionDir) {
+	_dir = collectionDir;
+	_keys.clear();
+	_ids.clear();
+	_fileBytes = 0;
+	const std::string path = dictPathFor(collectionDir);
+	FsPathLock pathLock(path);
+	File file = _fs->open(path.c_str(), FILE_READ);
+	if (!file)
+		return;
+	const size_t onFlash = file.size();
+	ReadBufferingStream buffered(file, 256);
+	char key[kMaxKeyLength];
+	for (;;) {
+		const int length = buffered.read();
+		if (length <= 0 || _keys.size() >= kMaxKeys)
+			break;
+		if (buffered.readBytes(key, static_cast<size_t>(length)) != static_cast<size_t>(length))
+			break;
+		_keys.emplace_back(key, static_cast<size_t>(length));
+		_ids.emplace(_keys.back(), static_cast<uint16_t>(_keys.size() - 1));
+		_fileBytes += 1 + static_cast<size_t>(length);
+	}
+	file.close();
+	// Drop a torn tail so the next append lines up with the entries. If that
+	// fails, appends keep reporting the file as changed.
+	if (onFlash != _fileBytes)
+		(void)rewriteLocked();
+}
+
+DbStatus KeyDictionary::appendLocked(size_t firstNew, bool &stale) {
+	stale = false;
+	const std::string path = dictPathFor(_dir);
+	FsPathLock pathLock(path);
+	File file;
+	{
+		FsNamespaceLock fs;
+		if (!fsEnsureDir(*_fs, _dir)) {
+			return {DbStatusCode::IoError, "mkdir failed"};
+		}
+		file = _fs->open(path.c_str(), FILE_APPEND);
+	}
+	if (!file) {
+		return {DbStatusCode::IoError, "open key dictionary failed"};
+	}
+	// Another store appended keys, or the file was removed: the cache no
+	// longer describes it, and writing from it would reassign ids.
+	if (file.size() != _fileBytes) {
+		file.close();
+		stale = true;
+		return {DbStatusCode::Conflict, "key dictionary changed on flash"};
+	}
+	const bool ok = writeKeys(file, firstNew);
+	file.close();
+	if (!ok) {
+		// Whatever reached the file is reloaded next time.
+		_dir.clear();
+		return {DbStatusCode::IoError, "key dictionary write failed"};
+	}
+	for (size_t i = firstNew; i < _keys.size(); ++i)
+		_fileBytes += 1 + _keys[i].size();
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus KeyDictionary::rewriteLocked() {
+	const std::string path = dictPathFor(_dir);
+	const std::string tmpPath = path + ".tmp";
+	File file;
+	{
+		FsNamespaceLock fs;
+		file = _fs->open(tmpPath.c_str(), FILE_WRITE);
+	}
+	if (!file) {
+		return {DbStatusCode::IoError, "open key dictionary failed"};
+	}
+	bool ok = writeKeys(file, 0);
+	file.close();
+	FsNamespaceLock fs;
+	if (ok) {
+		if (_fs->exists(path.c_str()))
+			_fs->remove(path.c_str());
+		ok = _fs->rename(tmpPath.c_str(), path.c_str());
+	}
+	if (!ok) {
+		_fs->remove(tmpPath.c_str());
+		return {DbStatusCode::IoError, "key dictionary write failed"};
+	}
+	return {DbStatusCode::Ok, ""};
+}
+
+bool KeyDictionary::writeKeys(File &file, size_t from) const {
+	WriteBufferingStream buffered(file, 256);
+	bool ok = true;
+	for (size_t i = from; ok && i < _keys.size(); ++i) {
+		const auto &key = _keys[i];
+		const uint8_t length = static_cast<uint8_t>(key.size());
+		ok = buffered.write(&length, 1) == 1 &&
+		     buffered.write(reinterpret_cast<const uint8_t *>(key.data()), key.size()) ==
+		         key.size();
+	}
+	buffered.flush();
+	return ok;
+}
+
+void KeyDictionary::forgetFromLocked(size_t firstNew) {
+	for (size_t i = firstNew; i < _keys.size(); ++i)
+		_ids.erase(_keys[i]);
+	_keys.resize(firstNew);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <FS.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "../utils/dbTypes.h"
+#include "../utils/fr_mutex.h"
+#include "../utils/jsondb_allocator.h"
+
+// Per-collection table of MessagePack map keys, kept in `_keys.dict` next to
+// the records. Interned payloads carry a key's index, as a MessagePack
+// integer, in place of the key string.
+//
+// Entries are a length byte followed by the key bytes, in id order. The file
+// is append-only and new keys reach flash before any record that uses them,
+// so an id never changes meaning. Only interning a new key touches the file.
+// If it no longer matches the cache, because another store appended to it,
+// the cache is reloaded and the keys are interned again before appending.
+// A trailing partial entry left by a power cut is dropped on load.
+// Keys past kMaxKeys, or longer than kMaxKeyLength, stay strings.
+class KeyDictionary {
+  public:
+	static constexpr const char *kFileName = "_keys.dict";
+	static constexpr size_t kMaxKeys = 1024;
+	static constexpr size_t kMaxKeyLength = 255;
+
+	KeyDictionary(fs::FS &fs, bool usePSRAMBuffers = false);
+
+	KeyDictionary(const KeyDictionary &) = delete;
+	KeyDictionary &operator=(const KeyDictionary &) = delete;
+
+	// Copy `msgpack` into `out` with every map key replaced by its id. Keys
+	// not seen before are added to the file first. Payloads with integer map
+	// keys, which JSON documents never have, return Unsupported.
+	DbStatus intern(
+	    const std::string &collectionDir,
+	    const uint8_t *msgpack,
+	    size_t size,
+	    JsonDbVector<uint8_t> &out
+	);
+	// Reverse of intern().
+	DbStatus expand(
+	    const std::string &collectionDir,
+	    const uint8_t *data,
+	    size_t size,
+	    JsonDbVector<uint8_t> &out
+	);
+
+  private:
+	// std::less<> lets lookups take a view into the payload without a copy.
+	using KeyIds = JsonDbMap<std::string, uint16_t, std::less<>>;
+
+	// Callers hold _mu.
+	void loadLocked(const std::string &collectionDir);
+	// Append keys from `firstNew`. Sets `stale` when the file size does not
+	// match the cache, in which case nothing is written.
+	DbStatus appendLocked(size_t firstNew, bool &stale);
+	// Replace the file with the cache. Caller also holds the path lock.
+	DbStatus rewriteLocked();
+	bool writeKeys(File &file, size_t from) const;
+	void forgetFromLocked(size_t firstNew);
+
+	fs::FS *_fs = nullptr;
+	FrMutex _mu;
+	std::string _dir; // whose keys are cached; empty before the first load
+	size_t _fileBytes = 0;
+	JsonDbVector<std::string> _keys;
+	KeyIds _ids;
+};
@@ -0,0 +1,140 @@
+#include "lz4_block.h"
+
+#include <cstring>
+
+namespace {
+constexpr size_t kMinMatch = 4;
+constexpr size_t kLastLiterals = 5; // the block always ends in literals
+constexpr size_t kMatchFindLimit = 12; // no match may start past size - 12
+constexpr size_t kMaxOffset = 65535;
+constexpr uint8_t kHashBits = 10;
+
+uint32_t load32(const uint8_t *p) {
+	uint32_t v;
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+uint32_t hashOf(uint32_t sequence) {
+	return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+void putLength(JsonDbVector<uint8_t> &out, size_t length) {
+	while (length >= 255) {
+		out.push_back(255);
+		length -= 255;
+	}
+	out.push_back(static_cast<uint8_t>(length));
+}
+
+void putSequence(
+    JsonDbVector<uint8_t> &out,
+    const uint8_t *literals,
+    size_t literalCount,
+    size_t offset,
+    size_t matchLength
+) {
+	const size_t matchCode = matchLength >= kMinMatch ? matchLength - kMinMatch : 0;
+	uint8_t token = static_cast<uint8_t>((literalCount < 15 ? literalCount : 15) << 4);
+	if (matchLength >= kMinMatch)
+		token |= static_cast<uint8_t>(matchCode < 15 ? matchCode : 15);
+	out.push_back(token);
+	if (literalCount >= 15)
+		putLength(out, literalCount - 15);
+	out.insert(out.end(), literals, literals + literalCount);
+	if (matchLength < kMinMatch)
+		return;
+	out.push_back(static_cast<uint8_t>(offset & 0xFFu));
+	out.push_back(static_cast<uint8_t>((offset >> 8) & 0xFFu));
+	if (matchCode >= 15)
+		putLength(out, matchCode - 15);
+}
+
+bool readLength(const uint8_t *data, size_t size, size_t &pos, size_t &length) {
+	uint8_t b = 0;
+	do {
+		if (pos >= size)
+			return false;
+		b = data[pos++];
+		length += b;
+	} while (b == 255);
+	return true;
+}
+} // namespace
+
+bool Lz4Block::compress(const uint8_t *data, size_t size, JsonDbVector<uint8_t> &out) {
+	out.clear();
+	if (!data || size <= kMatchFindLimit)
+		return false;
+	out.reserve(size);
+	JsonDbVector<uint32_t> table(
+	    static_cast<size_t>(1) << kHashBits,
+	    0,
+	    JsonDbAllocator<uint32_t>(out.get_allocator().usePSRAMBuffers())
+	);
+
+	const size_t matchLimit = size - kLastLiterals;
+	const size_t findLimit = size - kMatchFindLimit;
+	size_t anchor = 0;
+	size_t pos = 0;
+	while (pos <= findLimit) {
+		const uint32_t sequence = load32(data + pos);
+		uint32_t &slot = table[hashOf(sequence)];
+		const size_t candidate = slot;
+		slot = static_cast<uint32_t>(pos);
+		if (candidate >= pos || pos - candidate > kMaxOffset ||
+		    load32(data + candidate) != sequence) {
+			++pos;
+			continue;
+		}
+		size_t length = kMinMatch;
+		while (pos + length < matchLimit && data[candidate + length] == data[pos + length])
+			++length;
+		putSequence(out, data + anchor, pos - anchor, pos - candidate, length);
+		pos += length;
+		anchor = pos;
+		// Give up once the output stops paying for itself.
+		if (out.size() >= size)
+			return false;
+	}
+	putSequence(out, data + anchor, size - anchor, 0, 0);
+	return out.size() < size;
+}
+
+bool Lz4Block::decompress(const uint8_t *data, size_t size, uint8_t *out, size_t outSize) {
+	if (!data || (!out && outSize != 0))
+		return false;
+	size_t in = 0;
+	size_t written = 0;
+	while (in < size) {
+		const uint8_t token = data[in++];
+		size_t literals = token >> 4;
+		if (literals == 15 && !readLength(data, size, in, literals))
+			return false;
+		if (literals > size - in || literals > outSize - written)
+			return false;
+		std::memcpy(out + written, data + in, literals);
+		in += literals;
+		written += literals;
+		if (in == size)
+			break; // the last sequence has no match
+		if (size - in < 2)
+			return false;
+		const size_t offset = static_cast<size_t>(data[in]) | (static_cast<size_t>(data[in + 1]) << 8);
+		in += 2;
+		if (offset == 0 || offset > written)
+			return false;
+		size_t length = token & 0x0Fu;
+		if (length == 15 && !readLength(data, size, in, length))
+			return false;
+		length += kMinMatch;
+		if (length > outSize - written)
+			return false;
+		// Matches may overlap their own output, so copy forwards bytewise.
+		const uint8_t *from = out + written - offset;
+		for (size_t i = 0; i < length; ++i)
+			out[written + i] = from[i];
+		written += length;
+	}
+	return written == outSize;
+}
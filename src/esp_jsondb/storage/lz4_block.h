@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../utils/jsondb_allocator.h"
+
+// Minimal LZ4 block format codec for record payloads: greedy single-probe
+// matching, no frame header. The output is a plain LZ4 block, so any LZ4
+// block decoder reads it.
+class Lz4Block {
+  public:
+	// Compress `size` bytes into `out`. Returns false when the result would
+	// not be smaller than the input; `out` is then unspecified.
+	static bool compress(const uint8_t *data, size_t size, JsonDbVector<uint8_t> &out);
+	// Decompress a block that expands to exactly `outSize` bytes. Returns
+	// false on malformed input without reading or writing out of bounds.
+	static bool decompress(const uint8_t *data, size_t size, uint8_t *out, size_t outSize);
+};
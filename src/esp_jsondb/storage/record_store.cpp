@@ -1,21 +1,55 @@
 #include "record_store.h"
 
-#include <StreamUtils.h>
-
 #include <cstring>
 
 #include "../storage/doc_codec.h"
-#include "../utils/fr_mutex.h"
+#include "../utils/fs_lock.h"
 #include "../utils/fs_utils.h"
 #include "../utils/jsondb_allocator.h"
+#include "../utils/op_stats.h"
 
 namespace {
 std::string recordPathFor(const std::string &collectionDir, const std::string &id) {
 	return joinPath(collectionDir, id + DocCodec::kRecordExtension);
 }
+
+bool readExact(File &file, uint8_t *out, size_t size) {
+	return size == 0 || file.read(out, size) == size;
+}
+
+// Header first, then the payload straight into `payload`, so the record is
+// never held in RAM twice. The CRC is left to the caller, outside the lock.
+DbStatus readRecordParts(
+    File &file, RecordHeader &header, JsonDbVector<uint8_t> &payload, uint8_t *trailer
+) {
+	uint8_t head[DocCodec::kPrefixSize + DocCodec::kMaxHeaderSize];
+	uint32_t headerSize = 0;
+	uint32_t payloadSize = 0;
+	if (!readExact(file, head, DocCodec::kPrefixSize))
+		return {DbStatusCode::CorruptionDetected, "record too small"};
+	auto st = DocCodec::decodePrefix(head, file.size(), headerSize, payloadSize);
+	if (!st.ok())
+		return st;
+	if (!readExact(file, head + DocCodec::kPrefixSize, headerSize))
+		return {DbStatusCode::IoError, "read failed"};
+	st = DocCodec::decodeHeader(head, DocCodec::kPrefixSize + headerSize, header);
+	if (!st.ok())
+		return st;
+	payload.resize(payloadSize);
+	if (!readExact(file, payload.data(), payloadSize) ||
+	    !readExact(file, trailer, DocCodec::kTrailerSize))
+		return {DbStatusCode::IoError, "read failed"};
+	return {DbStatusCode::Ok, ""};
+}
 } // namespace
 
-DbStatus RecordStore::write(const std::string &collectionDir, const DocumentRecord &record) {
+DbStatus RecordStore::write(
+    const std::string &collectionDir,
+    const DocumentRecord &record,
+    PayloadCodec codec,
+    bool internKeys
+) {
+	OpTimer timer(DbOp::RecordWrite);
 	if (!_fs) {
 		return {DbStatusCode::IoError, "filesystem not ready"};
 	}
@@ -23,33 +57,105 @@ DbStatus RecordStore::write(const std::string &collectionDir, const DocumentReco
 		return {DbStatusCode::InvalidArgument, "record id is invalid"};
 	}
 
-	JsonDbVector<uint8_t> encoded{JsonDbAllocator<uint8_t>(_usePSRAMBuffers)};
+	// Header and trailer come from the stack; a plain payload is written from
+	// the record's own buffer, so nothing payload-sized is allocated.
+	const uint8_t *payload = record.msgpack.data();
+	size_t payloadSize = record.msgpack.size();
+	JsonDbVector<uint8_t> interned{JsonDbAllocator<uint8_t>(_usePSRAMBuffers)};
+	if (internKeys) {
+		auto st = _keys.intern(collectionDir, payload, payloadSize, interned);
+		if (st.ok()) {
+			payload = interned.data();
+			payloadSize = interned.size();
+		} else if (st.code == DbStatusCode::Unsupported) {
+			internKeys = false;
+		} else {
+			return st;
+		}
+	}
+	JsonDbVector<uint8_t> packed{JsonDbAllocator<uint8_t>(_usePSRAMBuffers)};
+	PayloadCodec used = PayloadCodec::None;
+	DocCodec::packPayload(codec, payload, payloadSize, packed, used);
+	if (used != PayloadCodec::None) {
+		payload = packed.data();
+		payloadSize = packed.size();
+	}
+
 	RecordHeader header;
 	header.id = record.meta.id;
 	header.createdAtMs = record.meta.createdAtMs;
 	header.updatedAtMs = record.meta.updatedAtMs;
 	header.revision = record.meta.revision;
 	header.flags = record.meta.flags;
-	auto encodeStatus = DocCodec::encodeRecord(header, record.msgpack, encoded);
+	header.storageFlags = DocCodec::withCodec(0, used);
+	if (internKeys)
+		header.storageFlags |= DocCodec::kInternedKeysFlag;
+	header.payloadCrc32 = DocCodec::crc32(payload, payloadSize);
+	uint8_t head[DocCodec::kEncodedHeaderSize];
+	uint8_t trailer[DocCodec::kTrailerSize];
+	auto encodeStatus = DocCodec::encodeEnvelope(header, payloadSize, head, trailer);
 	if (!encodeStatus.ok())
 		return encodeStatus;
+	const Part parts[] = {
+	    {head, sizeof(head)},
+	    {payload, payloadSize},
+	    {trailer, sizeof(trailer)},
+	};
+	timer.addBytes(sizeof(head) + payloadSize + sizeof(trailer));
+	return writeParts(collectionDir, record.meta.id, parts, 3);
+}
 
-	const std::string finalPath = recordPathFor(collectionDir, record.meta.id.c_str());
+DbStatus RecordStore::writeEncoded(
+    const std::string &collectionDir, const DocId &id, const JsonDbVector<uint8_t> &encoded
+) {
+	OpTimer timer(DbOp::RecordWrite);
+	timer.addBytes(encoded.size());
+	const Part part{encoded.data(), encoded.size()};
+	return writeParts(collectionDir, id, &part, 1);
+}
+
+DbStatus RecordStore::writeParts(
+    const std::string &collectionDir, const DocId &id, const Part *parts, size_t count
+) {
+	if (!_fs) {
+		return {DbStatusCode::IoError, "filesystem not ready"};
+	}
+	if (!id.valid()) {
+		return {DbStatusCode::InvalidArgument, "record id is invalid"};
+	}
+
+	const std::string finalPath = recordPathFor(collectionDir, id.c_str());
 	const std::string tmpPath = finalPath + ".tmp";
 
-	FrLock fs(g_fsMutex);
-	if (!fsEnsureDir(*_fs, collectionDir)) {
-		return {DbStatusCode::IoError, "mkdir failed"};
+	// Two writers of the same record (a flush and a restore, say) would
+	// otherwise interleave on the shared .tmp file.
+	FsStagingLock staging(finalPath);
+	File file;
+	{
+		FsNamespaceLock fs;
+		if (!fsEnsureDir(*_fs, collectionDir)) {
+			return {DbStatusCode::IoError, "mkdir failed"};
+		}
+		file = _fs->open(tmpPath.c_str(), FILE_WRITE);
 	}
-	File file = _fs->open(tmpPath.c_str(), FILE_WRITE);
 	if (!file) {
 		return {DbStatusCode::IoError, "open for write failed"};
 	}
-	WriteBufferingStream buffered(file, 256);
-	const size_t written = buffered.write(encoded.data(), encoded.size());
-	buffered.flush();
+	// Only the staging lock is held while the payload streams; the
+	// filesystem serializes its own calls, and readers and flushes of other
+	// records are not held up. Parts go straight to the file; the filesystem
+	// buffers small writes itself.
+	bool written = true;
+	for (size_t i = 0; written && i < count; ++i) {
+		written = parts[i].size == 0 || file.write(parts[i].data, parts[i].size) == parts[i].size;
+	}
 	file.close();
-	if (written != encoded.size()) {
+
+	// Replace under the record's path lock so a concurrent read never sees
+	// the gap between remove and rename.
+	FsPathLock pathLock(finalPath);
+	FsNamespaceLock fs;
+	if (!written) {
 		_fs->remove(tmpPath.c_str());
 		return {DbStatusCode::IoError, "write failed"};
 	}
@@ -66,43 +172,56 @@ DbStatus RecordStore::write(const std::string &collectionDir, const DocumentReco
 
 DbResult<std::shared_ptr<DocumentRecord>>
 RecordStore::read(const std::string &collectionDir, const std::string &id) const {
+	OpTimer timer(DbOp::RecordRead);
 	DbResult<std::shared_ptr<DocumentRecord>> result{};
 	if (!_fs) {
 		result.status = {DbStatusCode::IoError, "filesystem not ready"};
 		return result;
 	}
 
-	const std::string path = recordPathFor(collectionDir, id);
-	JsonDbVector<uint8_t> encoded{JsonDbAllocator<uint8_t>(_usePSRAMBuffers)};
+	auto record = makeDocumentRecord(_usePSRAMBuffers);
+	RecordHeader header;
+	uint8_t trailer[DocCodec::kTrailerSize];
+	DbStatus readStatus{DbStatusCode::Ok, ""};
 	{
-		FrLock fs(g_fsMutex);
+		const std::string path = recordPathFor(collectionDir, id);
+		FsPathLock fs(path);
 		File file = _fs->open(path.c_str(), FILE_READ);
 		if (!file) {
 			result.status = {DbStatusCode::NotFound, "file not found"};
 			return result;
 		}
-		const size_t size = file.size();
-		encoded.resize(size);
-		const size_t readSize = file.read(encoded.data(), size);
+		timer.addBytes(file.size());
+		readStatus = readRecordParts(file, header, record->msgpack, trailer);
 		file.close();
-		if (readSize != size) {
-			result.status = {DbStatusCode::IoError, "read failed"};
-			return result;
-		}
 	}
-
-	auto record = std::allocate_shared<DocumentRecord>(
-	    JsonDbAllocator<DocumentRecord>(_usePSRAMBuffers),
-	    _usePSRAMBuffers
-	);
-	RecordHeader header;
-	auto decodeStatus = DocCodec::decodeRecord(
-	    encoded.data(),
-	    encoded.size(),
-	    header,
-	    record->msgpack,
-	    _usePSRAMBuffers
-	);
+	if (!readStatus.ok()) {
+		result.status = readStatus;
+		return result;
+	}
+	auto decodeStatus =
+	    DocCodec::checkPayload(header, record->msgpack.data(), record->msgpack.size(), trailer);
+	const PayloadCodec codec = DocCodec::codecOf(header.storageFlags);
+	if (decodeStatus.ok() && codec != PayloadCodec::None) {
+		JsonDbVector<uint8_t> msgpack{JsonDbAllocator<uint8_t>(_usePSRAMBuffers)};
+		decodeStatus = DocCodec::unpackPayload(
+		    codec,
+		    record->msgpack.data(),
+		    record->msgpack.size(),
+		    msgpack
+		);
+		record->msgpack.swap(msgpack);
+	}
+	if (decodeStatus.ok() && (header.storageFlags & DocCodec::kInternedKeysFlag) != 0) {
+		JsonDbVector<uint8_t> msgpack{JsonDbAllocator<uint8_t>(_usePSRAMBuffers)};
+		decodeStatus = _keys.expand(
+		    collectionDir,
+		    record->msgpack.data(),
+		    record->msgpack.size(),
+		    msgpack
+		);
+		record->msgpack.swap(msgpack);
+	}
 	if (!decodeStatus.ok()) {
 		result.status = decodeStatus;
 		return result;
@@ -119,12 +238,36 @@ RecordStore::read(const std::string &collectionDir, const std::string &id) const
 	return result;
 }
 
+DbStatus RecordStore::readEncoded(
+    const std::string &collectionDir, const std::string &id, JsonDbVector<uint8_t> &encoded
+) const {
+	OpTimer timer(DbOp::RecordRead);
+	if (!_fs) {
+		return {DbStatusCode::IoError, "filesystem not ready"};
+	}
+	const std::string path = recordPathFor(collectionDir, id);
+	FsPathLock fs(path);
+	File file = _fs->open(path.c_str(), FILE_READ);
+	if (!file) {
+		return {DbStatusCode::NotFound, "file not found"};
+	}
+	const size_t size = file.size();
+	timer.addBytes(size);
+	encoded.resize(size);
+	const size_t readSize = file.read(encoded.data(), size);
+	file.close();
+	if (readSize != size) {
+		return {DbStatusCode::IoError, "read failed"};
+	}
+	return {DbStatusCode::Ok, ""};
+}
+
 JsonDbVector<DocId> RecordStore::listIds(const std::string &collectionDir) const {
 	JsonDbVector<DocId> ids{JsonDbAllocator<DocId>(_usePSRAMBuffers)};
 	if (!_fs)
 		return ids;
 
-	FrLock fs(g_fsMutex);
+	FsNamespaceLock fs;
 	if (!_fs->exists(collectionDir.c_str()))
 		return ids;
 	File dir = _fs->open(collectionDir.c_str());
@@ -163,7 +306,8 @@ DbStatus RecordStore::remove(const std::string &collectionDir, const DocId &id)
 		return {DbStatusCode::IoError, "filesystem not ready"};
 	}
 	const std::string path = recordPathFor(collectionDir, id.c_str());
-	FrLock fs(g_fsMutex);
+	FsPathLock pathLock(path);
+	FsNamespaceLock fs;
 	if (!_fs->exists(path.c_str())) {
 		return {DbStatusCode::NotFound, "file not found"};
 	}
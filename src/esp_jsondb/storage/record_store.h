@@ -6,22 +6,47 @@
 #include <string>
 
 #include "../document/document.h"
+#include "../storage/key_dictionary.h"
 #include "../utils/dbTypes.h"
 #include "../utils/jsondb_allocator.h"
 
 class RecordStore {
   public:
 	RecordStore(fs::FS &fs, bool usePSRAMBuffers = false)
-	    : _fs(&fs), _usePSRAMBuffers(usePSRAMBuffers) {
+	    : _fs(&fs), _usePSRAMBuffers(usePSRAMBuffers), _keys(fs, usePSRAMBuffers) {
 	}
 
-	DbStatus write(const std::string &collectionDir, const DocumentRecord &record);
+	// `internKeys` swaps map keys for dictionary ids before `codec` runs.
+	DbStatus write(
+	    const std::string &collectionDir,
+	    const DocumentRecord &record,
+	    PayloadCodec codec = PayloadCodec::None,
+	    bool internKeys = false
+	);
 	DbResult<std::shared_ptr<DocumentRecord>>
 	read(const std::string &collectionDir, const std::string &id) const;
+	// Raw .jdb bytes, as produced by DocCodec::encodeRecord. writeEncoded
+	// does not validate `encoded`; callers decode it first if it is untrusted.
+	// readEncoded bytes may carry interned keys, which only read() expands.
+	DbStatus writeEncoded(
+	    const std::string &collectionDir, const DocId &id, const JsonDbVector<uint8_t> &encoded
+	);
+	DbStatus readEncoded(
+	    const std::string &collectionDir, const std::string &id, JsonDbVector<uint8_t> &encoded
+	) const;
 	JsonDbVector<DocId> listIds(const std::string &collectionDir) const;
 	DbStatus remove(const std::string &collectionDir, const DocId &id) const;
 
   private:
+	struct Part {
+		const uint8_t *data;
+		size_t size;
+	};
+	// Write `parts` back to back as the record file of `id`, via a .tmp file.
+	DbStatus
+	writeParts(const std::string &collectionDir, const DocId &id, const Part *parts, size_t count);
+
 	fs::FS *_fs = nullptr;
 	bool _usePSRAMBuffers = false;
+	mutable KeyDictionary _keys; // read() may reload it
 };
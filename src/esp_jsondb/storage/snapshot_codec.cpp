@@ -0,0 +1,150 @@
+#include "snapshot_codec.h"
+
+#include <cstring>
+
+namespace {
+DbStatus writeAll(Print &out, const uint8_t *data, size_t size) {
+	if (size == 0)
+		return {DbStatusCode::Ok, ""};
+	if (out.write(data, size) != size)
+		return {DbStatusCode::IoError, "snapshot write failed"};
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus writeU16(Print &out, uint16_t value) {
+	const uint8_t bytes[2] = {
+	    static_cast<uint8_t>(value & 0xFFu),
+	    static_cast<uint8_t>((value >> 8) & 0xFFu)
+	};
+	return writeAll(out, bytes, sizeof(bytes));
+}
+
+DbStatus writeU32(Print &out, uint32_t value) {
+	const uint8_t bytes[4] = {
+	    static_cast<uint8_t>(value & 0xFFu),
+	    static_cast<uint8_t>((value >> 8) & 0xFFu),
+	    static_cast<uint8_t>((value >> 16) & 0xFFu),
+	    static_cast<uint8_t>((value >> 24) & 0xFFu)
+	};
+	return writeAll(out, bytes, sizeof(bytes));
+}
+
+bool readAll(Stream &in, uint8_t *data, size_t size) {
+	return size == 0 || in.readBytes(reinterpret_cast<char *>(data), size) == size;
+}
+
+bool readU16(Stream &in, uint16_t &value) {
+	uint8_t bytes[2];
+	if (!readAll(in, bytes, sizeof(bytes)))
+		return false;
+	value = static_cast<uint16_t>(bytes[0]) | (static_cast<uint16_t>(bytes[1]) << 8);
+	return true;
+}
+
+bool readU32(Stream &in, uint32_t &value) {
+	uint8_t bytes[4];
+	if (!readAll(in, bytes, sizeof(bytes)))
+		return false;
+	value = static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+	        (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+	return true;
+}
+} // namespace
+
+DbStatus SnapshotCodec::writeHeader(Print &out) {
+	auto st = writeAll(out, kMagic, sizeof(kMagic));
+	if (!st.ok())
+		return st;
+	st = writeU16(out, kVersion);
+	if (!st.ok())
+		return st;
+	return writeU16(out, 0);
+}
+
+DbStatus SnapshotCodec::writeCollection(Print &out, const std::string &name) {
+	if (name.size() > UINT16_MAX)
+		return {DbStatusCode::InvalidArgument, "collection name too long"};
+	const uint8_t tag = kTagCollection;
+	auto st = writeAll(out, &tag, 1);
+	if (!st.ok())
+		return st;
+	st = writeU16(out, static_cast<uint16_t>(name.size()));
+	if (!st.ok())
+		return st;
+	return writeAll(out, reinterpret_cast<const uint8_t *>(name.data()), name.size());
+}
+
+DbStatus SnapshotCodec::writeRecord(Print &out, const uint8_t *data, size_t size) {
+	if (size > kMaxRecordBytes)
+		return {DbStatusCode::InvalidArgument, "record too large for snapshot"};
+	const uint8_t tag = kTagRecord;
+	auto st = writeAll(out, &tag, 1);
+	if (!st.ok())
+		return st;
+	st = writeU32(out, static_cast<uint32_t>(size));
+	if (!st.ok())
+		return st;
+	return writeAll(out, data, size);
+}
+
+DbStatus SnapshotCodec::writeEnd(Print &out, uint32_t collections, uint32_t records) {
+	const uint8_t tag = kTagEnd;
+	auto st = writeAll(out, &tag, 1);
+	if (!st.ok())
+		return st;
+	st = writeU32(out, collections);
+	if (!st.ok())
+		return st;
+	return writeU32(out, records);
+}
+
+DbStatus SnapshotCodec::readHeader(Stream &in) {
+	uint8_t magic[sizeof(kMagic)];
+	uint16_t version = 0;
+	uint16_t reserved = 0;
+	if (!readAll(in, magic, sizeof(magic)) || !readU16(in, version) || !readU16(in, reserved)) {
+		return {DbStatusCode::CorruptionDetected, "snapshot header truncated"};
+	}
+	if (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+		return {DbStatusCode::InvalidArgument, "snapshot magic mismatch"};
+	}
+	if (version != kVersion) {
+		return {DbStatusCode::SchemaMismatch, "unsupported snapshot version"};
+	}
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus SnapshotCodec::readFrame(Stream &in, Frame &frame, JsonDbVector<uint8_t> &record) {
+	frame = Frame{};
+	if (!readAll(in, &frame.tag, 1)) {
+		return {DbStatusCode::CorruptionDetected, "snapshot truncated"};
+	}
+	switch (frame.tag) {
+	case kTagCollection: {
+		uint16_t length = 0;
+		if (!readU16(in, length))
+			return {DbStatusCode::CorruptionDetected, "snapshot truncated"};
+		frame.name.resize(length);
+		if (!readAll(in, reinterpret_cast<uint8_t *>(&frame.name[0]), length))
+			return {DbStatusCode::CorruptionDetected, "snapshot truncated"};
+		return {DbStatusCode::Ok, ""};
+	}
+	case kTagRecord: {
+		uint32_t length = 0;
+		if (!readU32(in, length))
+			return {DbStatusCode::CorruptionDetected, "snapshot truncated"};
+		if (length > kMaxRecordBytes)
+			return {DbStatusCode::CorruptionDetected, "snapshot record too large"};
+		record.resize(length);
+		if (!readAll(in, record.data(), length))
+			return {DbStatusCode::CorruptionDetected, "snapshot truncated"};
+		return {DbStatusCode::Ok, ""};
+	}
+	case kTagEnd:
+		if (!readU32(in, frame.collections) || !readU32(in, frame.records))
+			return {DbStatusCode::CorruptionDetected, "snapshot truncated"};
+		return {DbStatusCode::Ok, ""};
+	default:
+		return {DbStatusCode::CorruptionDetected, "snapshot frame tag invalid"};
+	}
+}
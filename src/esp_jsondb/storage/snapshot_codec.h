@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "../utils/dbTypes.h"
+#include "../utils/jsondb_allocator.h"
+
+// Binary snapshot stream (SnapshotFormat::Binary). Little-endian throughout.
+//
+//   header      "JDBS" u16 version u16 reserved
+//   collection  'C' u16 nameLength name
+//   record      'R' u32 length <one .jdb record, exactly as stored on disk>
+//   end         'E' u32 collections u32 records
+//
+// Records belong to the most recent collection frame. The end frame doubles
+// as a truncation check.
+class SnapshotCodec {
+  public:
+	static constexpr uint8_t kMagic[4] = {'J', 'D', 'B', 'S'};
+	static constexpr uint16_t kVersion = 1;
+	static constexpr uint8_t kTagCollection = 'C';
+	static constexpr uint8_t kTagRecord = 'R';
+	static constexpr uint8_t kTagEnd = 'E';
+	// Upper bound for one record frame; anything larger is treated as corrupt.
+	static constexpr uint32_t kMaxRecordBytes = 4U * 1024U * 1024U;
+
+	struct Frame {
+		uint8_t tag = 0;
+		std::string name; // kTagCollection
+		uint32_t collections = 0; // kTagEnd
+		uint32_t records = 0;     // kTagEnd
+	};
+
+	// True if `firstByte` can start a binary snapshot (JSON starts with '{').
+	static bool looksBinary(int firstByte) {
+		return firstByte == kMagic[0];
+	}
+
+	static DbStatus writeHeader(Print &out);
+	static DbStatus writeCollection(Print &out, const std::string &name);
+	static DbStatus writeRecord(Print &out, const uint8_t *data, size_t size);
+	static DbStatus writeEnd(Print &out, uint32_t collections, uint32_t records);
+
+	static DbStatus readHeader(Stream &in);
+	// Reads the next frame. For kTagRecord the record bytes land in `record`.
+	static DbStatus readFrame(Stream &in, Frame &frame, JsonDbVector<uint8_t> &record);
+};
@@ -0,0 +1,181 @@
+#include "snapshot_json_reader.h"
+
+namespace {
+DbStatus parseError() {
+	return {DbStatusCode::InvalidArgument, "snapshot parse failed"};
+}
+
+DbStatus missingCollections() {
+	return {DbStatusCode::InvalidArgument, "missing collections"};
+}
+} // namespace
+
+int SnapshotJsonReader::peekNonSpace() {
+	for (;;) {
+		int c = _in.peek();
+		if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+			return c;
+		_in.read();
+	}
+}
+
+bool SnapshotJsonReader::consume(char expected) {
+	if (peekNonSpace() != expected)
+		return false;
+	_in.read();
+	return true;
+}
+
+DbStatus SnapshotJsonReader::readKey(std::string &key) {
+	if (peekNonSpace() != '"')
+		return parseError();
+	// A quoted string ends at its closing quote, so deserializeJson() does not
+	// read past it.
+	JsonDocument keyDoc;
+	auto err = deserializeJson(keyDoc, _in);
+	if (err || !keyDoc.is<const char *>())
+		return parseError();
+	key = keyDoc.as<const char *>();
+	if (!consume(':'))
+		return parseError();
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus SnapshotJsonReader::skipValue() {
+	// Scan to the end of the value without storing it. Scalars end at the next
+	// delimiter, which is left in the stream.
+	peekNonSpace();
+	int depth = 0;
+	bool inString = false;
+	bool escaped = false;
+	for (;;) {
+		int c = _in.peek();
+		if (c < 0)
+			return parseError();
+		if (inString) {
+			_in.read();
+			if (escaped) {
+				escaped = false;
+			} else if (c == '\\') {
+				escaped = true;
+			} else if (c == '"') {
+				inString = false;
+				if (depth == 0)
+					return {DbStatusCode::Ok, ""};
+			}
+			continue;
+		}
+		if (depth == 0 && (c == ',' || c == '}' || c == ']'))
+			return {DbStatusCode::Ok, ""};
+		_in.read();
+		if (c == '"') {
+			inString = true;
+		} else if (c == '{' || c == '[') {
+			++depth;
+		} else if (c == '}' || c == ']') {
+			if (--depth == 0)
+				return {DbStatusCode::Ok, ""};
+		}
+	}
+}
+
+DbStatus SnapshotJsonReader::begin() {
+	if (!consume('{'))
+		return parseError();
+	for (bool first = true;; first = false) {
+		int c = peekNonSpace();
+		if (c == '}')
+			return missingCollections();
+		if (!first && !consume(','))
+			return parseError();
+		std::string key;
+		auto st = readKey(key);
+		if (!st.ok())
+			return st;
+		if (key == "collections") {
+			if (!consume('{'))
+				return missingCollections();
+			_firstCollection = true;
+			return {DbStatusCode::Ok, ""};
+		}
+		if (key == "incremental" && peekNonSpace() == '{') {
+			JsonDocument header;
+			auto err = deserializeJson(header, _in);
+			if (err)
+				return parseError();
+			_incremental = true;
+			_untilMs = header["untilMs"] | static_cast<uint64_t>(0);
+			continue;
+		}
+		st = skipValue();
+		if (!st.ok())
+			return st;
+	}
+}
+
+DbStatus SnapshotJsonReader::nextCollection(std::string &name, bool &done) {
+	done = false;
+	for (;;) {
+		if (peekNonSpace() == '}') {
+			_in.read();
+			done = true;
+			return {DbStatusCode::Ok, ""};
+		}
+		if (!_firstCollection && !consume(','))
+			return parseError();
+		_firstCollection = false;
+		auto st = readKey(name);
+		if (!st.ok())
+			return st;
+		if (consume('[')) {
+			_firstDocument = true;
+			return {DbStatusCode::Ok, ""};
+		}
+		st = skipValue();
+		if (!st.ok())
+			return st;
+	}
+}
+
+DbStatus SnapshotJsonReader::nextDocument(JsonDocument &doc, bool &done) {
+	done = false;
+	doc.clear();
+	if (peekNonSpace() == ']') {
+		_in.read();
+		done = true;
+		return {DbStatusCode::Ok, ""};
+	}
+	if (!_firstDocument && !consume(','))
+		return parseError();
+	_firstDocument = false;
+	if (peekNonSpace() != '{') {
+		// Not a document; leave `doc` null so the caller skips it. Numbers
+		// would make deserializeJson() swallow the following delimiter.
+		return skipValue();
+	}
+	auto err = deserializeJson(doc, _in);
+	if (err == DeserializationError::NoMemory)
+		return {DbStatusCode::IoError, "snapshot document too large"};
+	if (err)
+		return parseError();
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus SnapshotJsonReader::finish() {
+	for (;;) {
+		int c = peekNonSpace();
+		if (c == '}') {
+			_in.read();
+			return {DbStatusCode::Ok, ""};
+		}
+		if (!consume(','))
+			return parseError();
+		std::string key;
+		auto st = readKey(key);
+		if (!st.ok())
+			return st;
+		st = skipValue();
+		if (!st.ok())
+			return st;
+	}
+}
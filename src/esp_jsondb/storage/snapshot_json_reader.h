@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <string>
+
+#include "../utils/dbTypes.h"
+#include "../utils/lookahead_stream.h"
+
+// Pull reader for JSON snapshot streams: {"collections":{"name":[{...},...],...}}.
+//
+// Only structural characters are consumed by hand; each document is handed to
+// deserializeJson() on its own, so memory stays bounded by the largest single
+// document instead of the whole snapshot. Top-level members other than
+// "collections" and collection values that are not arrays are skipped without
+// being stored, except an "incremental" header placed before "collections".
+// Lookahead uses timed reads, so a network stream that pauses mid-snapshot is
+// waited for up to its setTimeout() instead of being taken as truncated.
+class SnapshotJsonReader {
+  public:
+	explicit SnapshotJsonReader(Stream &in) : _in(in) {
+	}
+
+	// Consume input up to and including the '{' that opens "collections".
+	DbStatus begin();
+	// Advance to the next collection array. Sets `done` once the collections
+	// object is closed.
+	DbStatus nextCollection(std::string &name, bool &done);
+	// Parse the next document of the current collection into `doc`. Sets
+	// `done` once the array is closed.
+	DbStatus nextDocument(JsonDocument &doc, bool &done);
+	// Consume the remaining top-level members and the closing '}'.
+	DbStatus finish();
+
+	// Set by begin() when the stream came from writeIncrementalSnapshot().
+	bool incremental() const {
+		return _incremental;
+	}
+	uint64_t untilMs() const {
+		return _untilMs;
+	}
+
+  private:
+	int peekNonSpace();
+	bool consume(char expected);
+	DbStatus readKey(std::string &key);
+	DbStatus skipValue();
+
+	LookaheadStream _in;
+	bool _firstCollection = true;
+	bool _firstDocument = true;
+	bool _incremental = false;
+	uint64_t _untilMs = 0;
+};
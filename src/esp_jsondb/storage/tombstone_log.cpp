@@ -0,0 +1,166 @@
+#include "tombstone_log.h"
+
+#include <StreamUtils.h>
+
+#include <cstring>
+
+#include "../utils/fs_lock.h"
+#include "../utils/fs_utils.h"
+
+namespace {
+std::string logPathFor(const std::string &collectionDir) {
+	return joinPath(collectionDir, TombstoneLog::kFileName);
+}
+
+void encodeEntry(const Tombstone &entry, uint8_t *out) {
+	std::memcpy(out, entry.id.c_str(), DocId::kHexLength);
+	for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+		out[DocId::kHexLength + i] = static_cast<uint8_t>((entry.deletedAtMs >> (8 * i)) & 0xFFu);
+	}
+}
+
+bool decodeEntry(const uint8_t *in, Tombstone &entry) {
+	if (!entry.id.assign(reinterpret_cast<const char *>(in), DocId::kHexLength))
+		return false;
+	entry.deletedAtMs = 0;
+	for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+		entry.deletedAtMs |= static_cast<uint64_t>(in[DocId::kHexLength + i]) << (8 * i);
+	}
+	return true;
+}
+
+// Caller holds the log's path lock.
+void readEntries(
+    fs::FS &fsImpl, const std::string &path, uint64_t sinceMs, JsonDbVector<Tombstone> &out
+) {
+	File file = fsImpl.open(path.c_str(), FILE_READ);
+	if (!file)
+		return;
+	ReadBufferingStream buffered(file, 256);
+	uint8_t entry[TombstoneLog::kEntrySize];
+	while (buffered.readBytes(reinterpret_cast<char *>(entry), sizeof(entry)) == sizeof(entry)) {
+		Tombstone tombstone;
+		if (decodeEntry(entry, tombstone) && tombstone.deletedAtMs >= sinceMs) {
+			out.push_back(tombstone);
+		}
+	}
+	file.close();
+}
+
+bool writeEntries(File &file, const JsonDbVector<Tombstone> &entries) {
+	WriteBufferingStream buffered(file, 256);
+	uint8_t entry[TombstoneLog::kEntrySize];
+	bool ok = true;
+	for (const auto &tombstone : entries) {
+		encodeEntry(tombstone, entry);
+		if (buffered.write(entry, sizeof(entry)) != sizeof(entry)) {
+			ok = false;
+			break;
+		}
+	}
+	buffered.flush();
+	return ok;
+}
+
+// Replace the log with `entries` through a temporary file. Caller holds the
+// log's path lock.
+DbStatus rewriteEntries(
+    fs::FS &fsImpl, const std::string &path, const JsonDbVector<Tombstone> &entries
+) {
+	const std::string tmpPath = path + ".tmp";
+	File file;
+	{
+		FsNamespaceLock fs;
+		file = fsImpl.open(tmpPath.c_str(), FILE_WRITE);
+	}
+	if (!file) {
+		return {DbStatusCode::IoError, "open for write failed"};
+	}
+	const bool ok = writeEntries(file, entries);
+	file.close();
+
+	FsNamespaceLock fs;
+	if (!ok) {
+		fsImpl.remove(tmpPath.c_str());
+		return {DbStatusCode::IoError, "write failed"};
+	}
+	if (fsImpl.exists(path.c_str()) && !fsImpl.remove(path.c_str())) {
+		fsImpl.remove(tmpPath.c_str());
+		return {DbStatusCode::IoError, "replace tombstone log failed"};
+	}
+	if (!fsImpl.rename(tmpPath.c_str(), path.c_str())) {
+		fsImpl.remove(tmpPath.c_str());
+		return {DbStatusCode::IoError, "rename failed"};
+	}
+	return {DbStatusCode::Ok, ""};
+}
+} // namespace
+
+DbStatus
+TombstoneLog::append(const std::string &collectionDir, const JsonDbVector<Tombstone> &entries) {
+	if (!_fs) {
+		return {DbStatusCode::IoError, "filesystem not ready"};
+	}
+	if (entries.empty())
+		return {DbStatusCode::Ok, ""};
+
+	const std::string path = logPathFor(collectionDir);
+	FsPathLock pathLock(path);
+	File file;
+	{
+		FsNamespaceLock fs;
+		if (!fsEnsureDir(*_fs, collectionDir)) {
+			return {DbStatusCode::IoError, "mkdir failed"};
+		}
+		file = _fs->open(path.c_str(), FILE_APPEND);
+	}
+	if (!file) {
+		return {DbStatusCode::IoError, "open tombstone log failed"};
+	}
+	if (file.size() % kEntrySize != 0) {
+		// A torn entry would shift every later one out of frame. Rewrite the
+		// whole entries with the new ones after them, dropping the torn tail.
+		file.close();
+		JsonDbVector<Tombstone> merged{JsonDbAllocator<Tombstone>(_usePSRAMBuffers)};
+		readEntries(*_fs, path, 0, merged);
+		merged.insert(merged.end(), entries.begin(), entries.end());
+		return rewriteEntries(*_fs, path, merged);
+	}
+	const bool ok = writeEntries(file, entries);
+	file.close();
+	if (!ok) {
+		return {DbStatusCode::IoError, "tombstone log write failed"};
+	}
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus TombstoneLog::read(
+    const std::string &collectionDir, uint64_t sinceMs, JsonDbVector<Tombstone> &out
+) const {
+	if (!_fs) {
+		return {DbStatusCode::IoError, "filesystem not ready"};
+	}
+	const std::string path = logPathFor(collectionDir);
+	FsPathLock pathLock(path);
+	readEntries(*_fs, path, sinceMs, out);
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus TombstoneLog::prune(const std::string &collectionDir, uint64_t beforeMs) {
+	if (!_fs) {
+		return {DbStatusCode::IoError, "filesystem not ready"};
+	}
+	const std::string path = logPathFor(collectionDir);
+	// Held across read and rewrite so no append slips in between.
+	FsPathLock pathLock(path);
+	JsonDbVector<Tombstone> kept{JsonDbAllocator<Tombstone>(_usePSRAMBuffers)};
+	readEntries(*_fs, path, beforeMs, kept);
+	if (kept.empty()) {
+		FsNamespaceLock fs;
+		if (_fs->exists(path.c_str()) && !_fs->remove(path.c_str())) {
+			return {DbStatusCode::IoError, "remove tombstone log failed"};
+		}
+		return {DbStatusCode::Ok, ""};
+	}
+	return rewriteEntries(*_fs, path, kept);
+}
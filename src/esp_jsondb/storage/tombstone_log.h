@@ -0,0 +1,45 @@
+#pragma once
+
+#include <FS.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "../utils/dbTypes.h"
+#include "../utils/doc_id.h"
+#include "../utils/jsondb_allocator.h"
+
+struct Tombstone {
+	DocId id;
+	uint64_t deletedAtMs = 0;
+};
+
+// Durable deletion log kept next to a collection's records, used by
+// incremental snapshots to carry removals.
+//
+// Entries are fixed-size: the 24-char hex id followed by deletedAtMs as a
+// little-endian u64. A trailing partial entry left by a power cut is ignored
+// by reads and dropped by the next append, which keeps later entries aligned.
+// Entries are appended before the record files are removed, so a deletion
+// that reached flash always has its tombstone.
+class TombstoneLog {
+  public:
+	static constexpr const char *kFileName = "_tombstones.log";
+	static constexpr size_t kEntrySize = DocId::kHexLength + sizeof(uint64_t);
+
+	TombstoneLog(fs::FS &fs, bool usePSRAMBuffers = false)
+	    : _fs(&fs), _usePSRAMBuffers(usePSRAMBuffers) {
+	}
+
+	DbStatus append(const std::string &collectionDir, const JsonDbVector<Tombstone> &entries);
+	// Entries with deletedAtMs >= sinceMs, in log order.
+	DbStatus
+	read(const std::string &collectionDir, uint64_t sinceMs, JsonDbVector<Tombstone> &out) const;
+	// Drop entries with deletedAtMs < beforeMs; removes the file once empty.
+	DbStatus prune(const std::string &collectionDir, uint64_t beforeMs);
+
+  private:
+	fs::FS *_fs = nullptr;
+	bool _usePSRAMBuffers = false;
+};
@@ -0,0 +1,196 @@
+#include "version_store.h"
+
+#include <algorithm>
+
+VersionStore::VersionStore(bool usePSRAMBuffers)
+    : _usePSRAMBuffers(usePSRAMBuffers), _openSeqs(JsonDbAllocator<uint32_t>(usePSRAMBuffers)),
+      _batchOwners(JsonDbAllocator<TaskHandle_t>(usePSRAMBuffers)),
+      _versions(std::less<std::string>{}, CollectionVersions::allocator_type(usePSRAMBuffers)) {
+	_mu.setName("versions");
+}
+
+uint32_t VersionStore::begin() {
+	const TaskHandle_t self = xTaskGetCurrentTaskHandle();
+	for (;;) {
+		{
+			FrLock lk(_mu);
+			// A task inside its own batch would wait for itself; it gets the
+			// partial view instead.
+			const bool ready =
+			    _batchOwners.empty() ||
+			    std::find(_batchOwners.begin(), _batchOwners.end(), self) != _batchOwners.end();
+			if (ready) {
+				_openCount.fetch_add(1);
+				const uint32_t seq = _commitSeq.load();
+				_openSeqs.push_back(seq);
+				return seq;
+			}
+		}
+		vTaskDelay(1);
+	}
+}
+
+void VersionStore::beginBatch() {
+	FrLock lk(_mu);
+	_batchOwners.push_back(xTaskGetCurrentTaskHandle());
+}
+
+void VersionStore::endBatch() {
+	FrLock lk(_mu);
+	auto it = std::find(_batchOwners.begin(), _batchOwners.end(), xTaskGetCurrentTaskHandle());
+	if (it != _batchOwners.end())
+		_batchOwners.erase(it);
+}
+
+void VersionStore::end(uint32_t seq) {
+	FrLock lk(_mu);
+	auto it = std::find(_openSeqs.begin(), _openSeqs.end(), seq);
+	if (it == _openSeqs.end())
+		return;
+	_openSeqs.erase(it);
+	_openCount.fetch_sub(1);
+	pruneLocked();
+}
+
+bool VersionStore::neededByLocked(uint32_t createdSeq, uint32_t supersededSeq) const {
+	for (uint32_t seq : _openSeqs) {
+		if (createdSeq <= seq && seq < supersededSeq)
+			return true;
+	}
+	return false;
+}
+
+uint32_t VersionStore::stamp(
+    const std::string &collection, const DocId &id, const DocumentRecord *prior
+) {
+	const uint32_t seq = _commitSeq.fetch_add(1) + 1;
+	if (_openCount.load() == 0)
+		return seq;
+
+	FrLock lk(_mu);
+	const uint32_t createdSeq = prior ? prior->commitSeq : 0;
+	if (!neededByLocked(createdSeq, seq))
+		return seq;
+	std::shared_ptr<DocumentRecord> copy;
+	if (prior) {
+		copy = makeDocumentRecord(_usePSRAMBuffers);
+		copy->meta = prior->meta;
+		copy->meta.dirty = false;
+		copy->msgpack = prior->msgpack;
+		copy->commitSeq = createdSeq;
+	}
+	auto colIt = _versions.find(collection);
+	if (colIt == _versions.end()) {
+		colIt = _versions
+		            .emplace(
+		                collection,
+		                DocVersions(DocIdLess{}, DocVersions::allocator_type(_usePSRAMBuffers))
+		            )
+		            .first;
+	}
+	auto docIt = colIt->second.find(id);
+	if (docIt == colIt->second.end()) {
+		docIt = colIt->second
+		            .emplace(id, VersionVector(JsonDbAllocator<Version>(_usePSRAMBuffers)))
+		            .first;
+	}
+	// Writers of one document are serialized by its collection lock, so each
+	// list stays ordered by supersededSeq.
+	docIt->second.push_back(Version{createdSeq, seq, std::move(copy)});
+	return seq;
+}
+
+bool VersionStore::lookup(
+    const std::string &collection,
+    const DocId &id,
+    uint32_t seq,
+    std::shared_ptr<DocumentRecord> &out
+) const {
+	out.reset();
+	FrLock lk(_mu);
+	auto colIt = _versions.find(collection);
+	if (colIt == _versions.end())
+		return false;
+	auto docIt = colIt->second.find(id);
+	if (docIt == colIt->second.end())
+		return false;
+	for (const auto &version : docIt->second) {
+		if (version.supersededSeq <= seq)
+			continue;
+		if (version.createdSeq <= seq)
+			out = version.record;
+		return true;
+	}
+	return false;
+}
+
+void VersionStore::idsFor(const std::string &collection, JsonDbVector<DocId> &out) const {
+	FrLock lk(_mu);
+	auto colIt = _versions.find(collection);
+	if (colIt == _versions.end())
+		return;
+	for (const auto &kv : colIt->second)
+		out.push_back(kv.first);
+}
+
+void VersionStore::dropCollection(const std::string &collection) {
+	FrLock lk(_mu);
+	_versions.erase(collection);
+}
+
+void VersionStore::rebind(bool usePSRAMBuffers) {
+	FrLock lk(_mu);
+	if (_usePSRAMBuffers == usePSRAMBuffers)
+		return;
+	JsonDbVector<uint32_t> openSeqs{JsonDbAllocator<uint32_t>(usePSRAMBuffers)};
+	openSeqs.assign(_openSeqs.begin(), _openSeqs.end());
+	_openSeqs.swap(openSeqs);
+	JsonDbVector<TaskHandle_t> batchOwners{JsonDbAllocator<TaskHandle_t>(usePSRAMBuffers)};
+	batchOwners.assign(_batchOwners.begin(), _batchOwners.end());
+	_batchOwners.swap(batchOwners);
+	// Versions retained for open snapshots keep their original allocator;
+	// new copies follow the new setting.
+	if (_versions.empty()) {
+		_versions = CollectionVersions(
+		    std::less<std::string>{},
+		    CollectionVersions::allocator_type(usePSRAMBuffers)
+		);
+	}
+	_usePSRAMBuffers = usePSRAMBuffers;
+}
+
+void VersionStore::stats(uint32_t &versions, uint32_t &bytes) const {
+	versions = 0;
+	bytes = 0;
+	FrLock lk(_mu);
+	for (const auto &col : _versions) {
+		for (const auto &doc : col.second) {
+			for (const auto &version : doc.second) {
+				++versions;
+				if (version.record)
+					bytes += static_cast<uint32_t>(version.record->msgpack.size());
+			}
+		}
+	}
+}
+
+void VersionStore::pruneLocked() {
+	for (auto colIt = _versions.begin(); colIt != _versions.end();) {
+		auto &docs = colIt->second;
+		for (auto docIt = docs.begin(); docIt != docs.end();) {
+			auto &list = docIt->second;
+			list.erase(
+			    std::remove_if(
+			        list.begin(),
+			        list.end(),
+			        [this](const Version &v) {
+				        return !neededByLocked(v.createdSeq, v.supersededSeq);
+			        }
+			    ),
+			    list.end()
+			);
+			docIt = list.empty() ? docs.erase(docIt) : std::next(docIt);
+		}
+		colIt = docs.empty() ? _versions.erase(colIt) : std::next(colIt);
+	}
+}
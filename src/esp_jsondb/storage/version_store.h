@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "../document/document.h"
+#include "../utils/doc_id.h"
+#include "../utils/fr_mutex.h"
+#include "../utils/jsondb_allocator.h"
+
+// Superseded record versions kept alive for open read snapshots.
+//
+// Every committed change takes a sequence number from stamp(). A snapshot
+// opened at sequence S sees, per document, the version with
+// createdSeq <= S < supersededSeq; the live record covers everything newer.
+// Writers hand the previous bytes to stamp() and they are copied only while
+// some open snapshot can still see them. With no snapshot open, stamp() is a
+// single atomic increment.
+//
+// A change spanning several documents runs between beginBatch() and
+// endBatch(). begin() waits for open batches, so a snapshot sees all of such
+// a change or none of it.
+class VersionStore {
+  public:
+	explicit VersionStore(bool usePSRAMBuffers = false);
+
+	VersionStore(const VersionStore &) = delete;
+	VersionStore &operator=(const VersionStore &) = delete;
+
+	// Open a snapshot at the latest committed sequence and return it. Waits
+	// while another task has a batch open.
+	uint32_t begin();
+	// Close a snapshot and drop versions no other snapshot needs.
+	void end(uint32_t seq);
+
+	// Bracket a multi-document change made by the calling task. Batches may
+	// nest and may be open on several tasks at once.
+	void beginBatch();
+	void endBatch();
+
+	// Allocate the next commit sequence for a change to `id`. `prior` is the
+	// record as it was before the change (nullptr for a create); it is kept
+	// for every open snapshot that must not see the change.
+	// Call with the owning collection locked exclusively.
+	uint32_t stamp(const std::string &collection, const DocId &id, const DocumentRecord *prior);
+
+	// Resolve `id` as of `seq` from retained versions. Returns false when the
+	// live record decides; otherwise `out` holds the version, or nullptr if
+	// the document did not exist at `seq`.
+	bool lookup(
+	    const std::string &collection,
+	    const DocId &id,
+	    uint32_t seq,
+	    std::shared_ptr<DocumentRecord> &out
+	) const;
+	// Ids that have retained versions in `collection`.
+	void idsFor(const std::string &collection, JsonDbVector<DocId> &out) const;
+
+	void dropCollection(const std::string &collection);
+	void rebind(bool usePSRAMBuffers);
+
+	uint32_t openCount() const {
+		return _openCount.load();
+	}
+	void stats(uint32_t &versions, uint32_t &bytes) const;
+
+  private:
+	struct Version {
+		uint32_t createdSeq = 0;
+		uint32_t supersededSeq = 0;
+		std::shared_ptr<DocumentRecord> record; // nullptr: did not exist yet
+	};
+	using VersionVector = JsonDbVector<Version>;
+	using DocVersions = JsonDbMap<DocId, VersionVector, DocIdLess>;
+	using CollectionVersions = JsonDbMap<std::string, DocVersions>;
+
+	bool neededByLocked(uint32_t createdSeq, uint32_t supersededSeq) const;
+	void pruneLocked();
+
+	mutable FrMutex _mu;
+	bool _usePSRAMBuffers = false;
+	JsonDbVector<uint32_t> _openSeqs;
+	JsonDbVector<TaskHandle_t> _batchOwners; // one entry per open batch
+	// Both counters are sequentially consistent: a writer bumps _commitSeq and
+	// then checks _openCount, begin() does the reverse, so one of them always
+	// sees the other.
+	std::atomic<uint32_t> _openCount{0};
+	std::atomic<uint32_t> _commitSeq{0};
+	CollectionVersions _versions;
+};
@@ -0,0 +1,112 @@
+#include "flush_pool.h"
+
+#include "../db_runtime.h"
+
+#include <Arduino.h>
+#include <algorithm>
+
+FlushPool::~FlushPool() {
+	(void)stop();
+}
+
+bool FlushPool::start(DbRuntime &rt, uint8_t helpers) {
+	if (!stop().ok())
+		return false;
+	if (helpers == 0)
+		return true;
+	_doneSem = xSemaphoreCreateCounting(helpers, 0);
+	if (_doneSem == nullptr)
+		return false;
+	_stopRequested.store(false, std::memory_order_release);
+	_exited.store(0, std::memory_order_release);
+	_workers.reserve(helpers);
+	for (uint8_t i = 0; i < helpers; ++i) {
+		TaskHandle_t handle = nullptr;
+		if (!rt.createTask(workerThunk, "db.flush", this, handle)) {
+			(void)stop();
+			return false;
+		}
+		_workers.push_back(handle);
+	}
+	return true;
+}
+
+DbStatus FlushPool::stop() {
+	if (!_workers.empty()) {
+		const TaskHandle_t self = xTaskGetCurrentTaskHandle();
+		if (std::find(_workers.begin(), _workers.end(), self) != _workers.end())
+			return {DbStatusCode::Busy, "called from a flush helper"};
+		_stopRequested.store(true, std::memory_order_release);
+		for (auto handle : _workers)
+			xTaskNotifyGive(handle);
+		// Helpers only look at the flag between batches and may be holding
+		// collection or fs locks inside one, so wait for them instead of
+		// deleting them. On timeout the pool is left as it is for a retry.
+		const uint32_t startMs = millis();
+		while (_exited.load(std::memory_order_acquire) < _workers.size()) {
+			if ((millis() - startMs) >= DbRuntime::kTaskStopTimeoutMs)
+				return {DbStatusCode::Busy, "flush helpers did not stop"};
+			vTaskDelay(pdMS_TO_TICKS(1));
+		}
+		_workers.clear();
+	}
+	if (_doneSem != nullptr) {
+		vSemaphoreDelete(_doneSem);
+		_doneSem = nullptr;
+	}
+	return {DbStatusCode::Ok, ""};
+}
+
+DbStatus FlushPool::run(JobVector &jobs) {
+	if (jobs.empty())
+		return {DbStatusCode::Ok, ""};
+	_jobs = &jobs;
+	_next.store(0, std::memory_order_release);
+	{
+		FrLock lk(_statusMu);
+		_firstError = {DbStatusCode::Ok, ""};
+	}
+	// Helpers left behind by a stop() that timed out are not woken again.
+	const size_t wake = _stopRequested.load(std::memory_order_acquire)
+	                        ? 0
+	                        : std::min(_workers.size(), jobs.size() - 1);
+	for (size_t i = 0; i < wake; ++i)
+		xTaskNotifyGive(_workers[i]);
+	drain();
+	for (size_t i = 0; i < wake; ++i)
+		xSemaphoreTake(_doneSem, portMAX_DELAY);
+	_jobs = nullptr;
+	FrLock lk(_statusMu);
+	return _firstError;
+}
+
+void FlushPool::drain() {
+	JobVector &jobs = *_jobs;
+	for (;;) {
+		const size_t idx = _next.fetch_add(1, std::memory_order_acq_rel);
+		if (idx >= jobs.size())
+			return;
+		auto st = jobs[idx] ? jobs[idx]() : DbStatus{DbStatusCode::Ok, ""};
+		if (!st.ok()) {
+			FrLock lk(_statusMu);
+			if (_firstError.ok())
+				_firstError = st;
+		}
+	}
+}
+
+void FlushPool::workerThunk(void *arg) {
+	static_cast<FlushPool *>(arg)->workerLoop();
+}
+
+void FlushPool::workerLoop() {
+	for (;;) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		if (_stopRequested.load(std::memory_order_acquire))
+			break;
+		drain();
+		xSemaphoreGive(_doneSem);
+	}
+	_exited.fetch_add(1, std::memory_order_acq_rel);
+	vTaskDelete(nullptr);
+}
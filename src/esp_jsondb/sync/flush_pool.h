@@ -0,0 +1,57 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <functional>
+
+#include "../utils/dbTypes.h"
+#include "../utils/fr_mutex.h"
+#include "../utils/jsondb_allocator.h"
+
+struct DbRuntime;
+
+// Fixed set of helper tasks that drain one batch of independent jobs together
+// with the calling task. Jobs in a batch must not depend on each other; the
+// sync pass submits one job per collection so per-collection ordering holds.
+class FlushPool {
+  public:
+	using Job = std::function<DbStatus()>;
+	using JobVector = JsonDbVector<Job>;
+
+	FlushPool() = default;
+	~FlushPool();
+
+	FlushPool(const FlushPool &) = delete;
+	FlushPool &operator=(const FlushPool &) = delete;
+
+	// Spawn `helpers` tasks using the runtime task settings. Returns false and
+	// leaves the pool empty if any task fails to start.
+	bool start(DbRuntime &rt, uint8_t helpers);
+	// Waits up to DbRuntime::kTaskStopTimeoutMs for the helpers to exit.
+	// Busy on timeout or when called from a helper.
+	DbStatus stop();
+	size_t helperCount() const {
+		return _workers.size();
+	}
+
+	// Run every job and return the first failure (or Ok). Must only be called
+	// from one task at a time.
+	DbStatus run(JobVector &jobs);
+
+  private:
+	static void workerThunk(void *arg);
+	void workerLoop();
+	void drain();
+
+	JsonDbVector<TaskHandle_t> _workers;
+	SemaphoreHandle_t _doneSem = nullptr;
+	JobVector *_jobs = nullptr;
+	std::atomic<size_t> _next{0};
+	std::atomic<bool> _stopRequested{false};
+	std::atomic<size_t> _exited{0};
+	FrMutex _statusMu;
+	DbStatus _firstError{DbStatusCode::Ok, ""};
+};
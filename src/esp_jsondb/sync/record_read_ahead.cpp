@@ -0,0 +1,162 @@
+#include "record_read_ahead.h"
+
+#include "../db_runtime.h"
+#include "../storage/doc_codec.h"
+
+#include <Arduino.h>
+#include <utility>
+
+RecordReadAhead::RecordReadAhead(fs::FS &fs, bool usePSRAMBuffers, bool raw)
+    : _store(fs, usePSRAMBuffers), _usePSRAMBuffers(usePSRAMBuffers), _raw(raw),
+      _slots(JsonDbAllocator<Item>(usePSRAMBuffers)) {
+}
+
+RecordReadAhead::~RecordReadAhead() {
+	stop();
+}
+
+bool RecordReadAhead::start(DbRuntime &rt, const JsonDbVector<std::string> &dirs, uint8_t depth) {
+	stop();
+	if (depth == 0)
+		return false;
+	_dirs = &dirs;
+	// Items share one allocator so moving them through the queue never copies.
+	_slots.assign(depth, Item(_usePSRAMBuffers));
+	_head = 0;
+	_tail = 0;
+	_ended = false;
+	_cancel.store(false, std::memory_order_release);
+	_exited.store(false, std::memory_order_release);
+	_freeSem = xSemaphoreCreateCounting(depth, depth);
+	_filledSem = xSemaphoreCreateCounting(depth, 0);
+	if (_freeSem == nullptr || _filledSem == nullptr ||
+	    !rt.createTask(producerThunk, "db.readahead", this, _task)) {
+		_task = nullptr;
+		stop();
+		return false;
+	}
+	return true;
+}
+
+bool RecordReadAhead::next(Item &out) {
+	if (_task == nullptr || _ended)
+		return false;
+	xSemaphoreTake(_filledSem, portMAX_DELAY);
+	Item &slot = _slots[_tail];
+	_tail = (_tail + 1) % _slots.size();
+	out = std::move(slot);
+	slot = Item(_usePSRAMBuffers);
+	xSemaphoreGive(_freeSem);
+	if (out.kind == Item::Kind::End) {
+		_ended = true;
+		return false;
+	}
+	return true;
+}
+
+void RecordReadAhead::stop() {
+	if (_task != nullptr) {
+		// The producer always finishes with an End item, so draining until it
+		// shows up cannot block forever; cancel just gets it there sooner.
+		_cancel.store(true, std::memory_order_release);
+		Item discard(_usePSRAMBuffers);
+		while (next(discard)) {
+		}
+		while (!_exited.load(std::memory_order_acquire))
+			vTaskDelay(pdMS_TO_TICKS(1));
+		_task = nullptr;
+	}
+	if (_freeSem != nullptr) {
+		vSemaphoreDelete(_freeSem);
+		_freeSem = nullptr;
+	}
+	if (_filledSem != nullptr) {
+		vSemaphoreDelete(_filledSem);
+		_filledSem = nullptr;
+	}
+	_slots.clear();
+	_dirs = nullptr;
+}
+
+bool RecordReadAhead::load(
+    const RecordStore &store,
+    const std::string &dir,
+    const std::string &id,
+    bool raw,
+    Item &out
+) {
+	out.kind = Item::Kind::Record;
+	if (!raw) {
+		auto rec = store.read(dir, id);
+		if (!rec.status.ok() || !rec.value)
+			return false;
+		out.record = std::move(rec.value);
+		return true;
+	}
+	if (!store.readEncoded(dir, id, out.encoded).ok())
+		return false;
+	// Stored bytes are copied out unchanged; decode only to check the CRC.
+	RecordHeader header;
+	size_t payloadOffset = 0;
+	size_t payloadSize = 0;
+	if (!DocCodec::decodeRecordInPlace(
+	         out.encoded.data(),
+	         out.encoded.size(),
+	         header,
+	         payloadOffset,
+	         payloadSize
+	     )
+	         .ok())
+		return false;
+	if ((header.storageFlags & DocCodec::kInternedKeysFlag) == 0)
+		return true;
+	// Interned ids mean nothing without the collection's dictionary, so the
+	// copy is re-encoded with plain keys.
+	auto rec = store.read(dir, id);
+	return rec.status.ok() && rec.value &&
+	       DocCodec::encodeRecord(*rec.value, out.encoded).ok();
+}
+
+void RecordReadAhead::producerThunk(void *arg) {
+	static_cast<RecordReadAhead *>(arg)->produce();
+}
+
+bool RecordReadAhead::push(Item &item) {
+	xSemaphoreTake(_freeSem, portMAX_DELAY);
+	_slots[_head] = std::move(item);
+	_head = (_head + 1) % _slots.size();
+	xSemaphoreGive(_filledSem);
+	return !_cancel.load(std::memory_order_acquire);
+}
+
+void RecordReadAhead::produce() {
+	bool running = true;
+	for (size_t i = 0; running && i < _dirs->size(); ++i) {
+		Item item(_usePSRAMBuffers);
+		item.kind = Item::Kind::Collection;
+		item.collection = i;
+		running = push(item);
+		if (!running)
+			break;
+		const auto ids = _store.listIds((*_dirs)[i]);
+		for (const auto &id : ids) {
+			if (_cancel.load(std::memory_order_acquire)) {
+				running = false;
+				break;
+			}
+			Item rec(_usePSRAMBuffers);
+			rec.collection = i;
+			if (!load(_store, (*_dirs)[i], id.c_str(), _raw, rec))
+				continue;
+			if (!push(rec)) {
+				running = false;
+				break;
+			}
+		}
+	}
+	Item end(_usePSRAMBuffers);
+	push(end);
+	// Last access to `this`; stop() may free the object right after.
+	_exited.store(true, std::memory_order_release);
+	vTaskDelete(nullptr);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "../document/document.h"
+#include "../storage/record_store.h"
+#include "../utils/dbTypes.h"
+#include "../utils/jsondb_allocator.h"
+
+struct DbRuntime;
+
+// Reads record files of a list of collection directories on a helper task,
+// one bounded queue ahead of the consumer. The helper does the flash reads
+// and CRC checks while the calling task encodes and writes what it already
+// has. Single producer, single consumer.
+class RecordReadAhead {
+  public:
+	struct Item {
+		enum class Kind : uint8_t { Collection, Record, End };
+		explicit Item(bool usePSRAMBuffers = false)
+		    : encoded(JsonDbAllocator<uint8_t>(usePSRAMBuffers)) {
+		}
+
+		Kind kind = Kind::End;
+		size_t collection = 0; // index into the directory list
+		// Decoded record, or the verified .jdb bytes in raw mode.
+		std::shared_ptr<DocumentRecord> record;
+		JsonDbVector<uint8_t> encoded;
+	};
+
+	// `raw` hands out stored bytes instead of decoded records.
+	RecordReadAhead(fs::FS &fs, bool usePSRAMBuffers, bool raw);
+	~RecordReadAhead();
+
+	RecordReadAhead(const RecordReadAhead &) = delete;
+	RecordReadAhead &operator=(const RecordReadAhead &) = delete;
+
+	// Spawn the producer over `dirs` with room for `depth` items. Returns false
+	// if the queue or the task cannot be created; the caller then reads inline.
+	// `dirs` must outlive the producer.
+	bool start(DbRuntime &rt, const JsonDbVector<std::string> &dirs, uint8_t depth);
+	// Block for the next item. Returns false once every directory is done.
+	bool next(Item &out);
+	// Cancel the producer, drop queued items and wait for the task to exit.
+	void stop();
+
+	// Read and check one record into `out`. Unreadable or corrupt records
+	// return false and are skipped by both the helper and inline readers.
+	static bool load(
+	    const RecordStore &store,
+	    const std::string &dir,
+	    const std::string &id,
+	    bool raw,
+	    Item &out
+	);
+
+  private:
+	static void producerThunk(void *arg);
+	void produce();
+	bool push(Item &item);
+
+	RecordStore _store;
+	bool _usePSRAMBuffers = false;
+	bool _raw = false;
+	const JsonDbVector<std::string> *_dirs = nullptr;
+	JsonDbVector<Item> _slots;
+	size_t _head = 0; // producer only
+	size_t _tail = 0; // consumer only
+	SemaphoreHandle_t _freeSem = nullptr;
+	SemaphoreHandle_t _filledSem = nullptr;
+	TaskHandle_t _task = nullptr;
+	std::atomic<bool> _cancel{false};
+	std::atomic<bool> _exited{false};
+	bool _ended = false;
+};
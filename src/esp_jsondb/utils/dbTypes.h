@@ -32,12 +32,48 @@ enum class DbStatusCode : uint8_t {
 
 enum class SnapshotMode : uint8_t { InMemoryConsistent = 0, OnDiskOnly };
 
+// Wire format for writeSnapshot(Stream&):
+// - Json: the human-readable {"collections": {...}} document (default)
+// - Binary: raw .jdb records framed per collection, no payload re-encoding
+enum class SnapshotFormat : uint8_t { Json = 0, Binary };
+
 enum class CollectionLoadPolicy : uint8_t { Eager = 0, Lazy, Delayed };
 
+// When committed changes reach the filesystem:
+// - Batched: flushed by the background sync task (default)
+// - Immediate: written through on commit; the sync task only retries failures
+// - Deferred: kept in RAM until an explicit syncNow()
+enum class CollectionDurability : uint8_t { Batched = 0, Immediate, Deferred };
+
+// How record payloads are stored on flash:
+// - None: MessagePack as-is (default)
+// - Lz4: LZ4 block compressed; kept as-is when that would not save space
+enum class PayloadCodec : uint8_t { None = 0, Lz4 };
+
 struct CollectionConfig {
 	CollectionLoadPolicy loadPolicy = CollectionLoadPolicy::Eager;
 	size_t maxDecodedViews = 0;
 	size_t maxRecordsInMemory = 0;
+	CollectionDurability durability = CollectionDurability::Batched;
+	// Keep every document's header (timestamps, revision, flags, payload
+	// size) in RAM, also for records evicted under maxRecordsInMemory or
+	// never loaded by a Lazy/Delayed collection, so findHeaders() reads no
+	// files. Costs about 32 bytes per document.
+	bool residentHeaders = false;
+	// Applied when records are written; records are read by the codec they
+	// were written with, so the setting can change at any time.
+	PayloadCodec payloadCodec = PayloadCodec::None;
+	// Store map keys as ids from a per-collection dictionary (`_keys.dict`)
+	// instead of strings. Like payloadCodec, records keep whichever form they
+	// were written in.
+	bool internKeys = false;
+	// Hot/cold tiering of resident payloads; 0 disables it. The most recently
+	// used records keep their MessagePack in internal RAM up to hotTierBytes,
+	// older ones are moved to PSRAM, and the lookup structures stay in
+	// internal RAM regardless of usePSRAMBuffers. With Lazy/Delayed loading,
+	// coldTierBytes (0 = no cap) evicts the oldest clean PSRAM records.
+	size_t hotTierBytes = 0;
+	size_t coldTierBytes = 0;
 };
 
 struct ESPJsonDBConfig {
@@ -53,6 +89,19 @@ struct ESPJsonDBConfig {
 	const char *partitionLabel = "spiffs";
 	bool usePSRAMBuffers = false; // Prefer PSRAM for internal byte buffers when available
 	CollectionLoadPolicy defaultLoadPolicy = CollectionLoadPolicy::Eager;
+	// Adaptive autosync; 0 disables each knob and keeps the fixed intervalMs period.
+	uint32_t dirtyBytesHighWater = 0; // flush early once this many payload bytes are dirty
+	uint32_t maxIntervalMs = 0;       // upper bound when the period is stretched while idle
+	uint32_t maxLatencyMs = 0;        // upper bound on how long a dirty write may wait
+	// Tasks flushing collections in parallel during a sync pass (the sync task
+	// counts as one; 1 keeps flushing serial on the sync task).
+	uint8_t syncWorkers = 1;
+	// Tasks reading Eager collections during init (the calling task counts as
+	// one; 1 keeps the cold start serial). Large collections are split too.
+	uint8_t preloadWorkers = 1;
+	// OnDiskOnly snapshot exports read up to this many records ahead on a
+	// helper task while the caller writes; 0 reads inline on the caller.
+	uint8_t snapshotReadAhead = 0;
 };
 
 struct ESPJsonDBFileOptions {
@@ -188,6 +237,22 @@ using DbFileUploadPullCb =
 using DbFileUploadDoneCb =
     std::function<void(uint32_t uploadId, const DbStatus &status, size_t bytesWritten)>;
 
+// Reported by restoreFromSnapshot(Stream&) after each restored document.
+struct SnapshotRestoreProgress {
+	std::string collectionName;
+	uint32_t collectionsRestored = 0; // including the one in progress
+	uint32_t documentsRestored = 0;
+};
+
+using SnapshotRestoreProgressCb = std::function<void(const SnapshotRestoreProgress &)>;
+
+// Per-call budget for ESPJsonDB::writeSnapshotChunk(); 0 disables a limit. A
+// call always makes progress, so one oversized document still goes out alone.
+struct SnapshotChunkLimits {
+	size_t maxBytes = 4096;
+	size_t maxDocuments = 0;
+};
+
 template <typename T> struct DbResult {
 	DbStatus status;
 	T value;
@@ -1,10 +1,59 @@
 #pragma once
 
+#include <cstdint>
+
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
 
+#ifndef ESP_JSONDB_LOCK_STATS
+#define ESP_JSONDB_LOCK_STATS 0
+#endif
+
+#if ESP_JSONDB_LOCK_STATS
+// Contention profiling, see utils/lock_stats.h. Locks named with setName()
+// report the wait and hold time of every acquisition; unnamed locks are not
+// timed.
+struct LockSite;
+LockSite *lockSiteFor(const char *name, const char *suffix);
+int64_t lockClockUs();
+void lockSiteRecord(LockSite *site, bool shared, bool contended, int64_t waitUs, int64_t holdUs);
+
+// Wait and hold time of one acquisition.
+struct LockTiming {
+	LockSite *site = nullptr;
+	bool contended = false;
+	int64_t waitUs = 0;
+	int64_t acquiredUs = 0;
+	int64_t holdUs = 0;
+
+	// Falls back to the blocking `lock` only when `tryLock` fails, so the
+	// uncontended path costs two clock reads.
+	template <typename TryLock, typename Lock> void acquire(TryLock tryLock, Lock lock) {
+		if (!tryLock()) {
+			contended = true;
+			const int64_t started = lockClockUs();
+			lock();
+			acquiredUs = lockClockUs();
+			waitUs = acquiredUs - started;
+			return;
+		}
+		acquiredUs = lockClockUs();
+	}
+	// stop() right before unlocking, report() once unlocked.
+	void stop() {
+		holdUs = lockClockUs() - acquiredUs;
+	}
+	void report(bool shared) const {
+		lockSiteRecord(site, shared, contended, waitUs, holdUs);
+	}
+};
+#endif
+
 struct FrMutex {
 	SemaphoreHandle_t h{nullptr};
+#if ESP_JSONDB_LOCK_STATS
+	LockSite *site = nullptr;
+#endif
 	FrMutex() {
 		h = xSemaphoreCreateMutex();
 	}
@@ -15,20 +64,198 @@ struct FrMutex {
 	// non-copyable
 	FrMutex(const FrMutex &) = delete;
 	FrMutex &operator=(const FrMutex &) = delete;
+
+	// Profiling name (`name` + `suffix`); locks sharing a name share counters.
+	// Call before the mutex is shared. No-op unless ESP_JSONDB_LOCK_STATS.
+	void setName(const char *name, const char *suffix = "") {
+#if ESP_JSONDB_LOCK_STATS
+		site = lockSiteFor(name, suffix);
+#else
+		(void)name;
+		(void)suffix;
+#endif
+	}
 };
 
 struct FrLock {
 	FrMutex &m;
 	explicit FrLock(FrMutex &mtx) : m(mtx) {
+#if ESP_JSONDB_LOCK_STATS
+		if ((_timing.site = m.site) != nullptr) {
+			_timing.acquire(
+			    [this] { return xSemaphoreTake(m.h, 0) == pdTRUE; },
+			    [this] { xSemaphoreTake(m.h, portMAX_DELAY); }
+			);
+			return;
+		}
+#endif
 		xSemaphoreTake(m.h, portMAX_DELAY);
 	}
 	~FrLock() {
+#if ESP_JSONDB_LOCK_STATS
+		if (_timing.site) {
+			_timing.stop();
+			xSemaphoreGive(m.h);
+			_timing.report(false);
+			return;
+		}
+#endif
 		xSemaphoreGive(m.h);
 	}
 	// non-copyable
 	FrLock(const FrLock &) = delete;
 	FrLock &operator=(const FrLock &) = delete;
+
+#if ESP_JSONDB_LOCK_STATS
+  private:
+	LockTiming _timing;
+#endif
 };
 
-// Global FS mutex to serialize LittleFS operations across tasks
-extern FrMutex g_fsMutex;
+// Reader/writer lock. Any number of readers may hold it together; a writer
+// closes the turnstile so new readers queue behind it, waits for the room to
+// drain, then runs alone. Neither mode is recursive and a reader must not
+// upgrade to writer.
+struct FrRwLock {
+	SemaphoreHandle_t turnstile{nullptr}; // mutex, held by a writer for its whole section
+	SemaphoreHandle_t roomEmpty{nullptr}; // binary, taken by the first reader or a writer
+	SemaphoreHandle_t readersMu{nullptr}; // guards `readers`
+	uint32_t readers = 0;
+#if ESP_JSONDB_LOCK_STATS
+	LockSite *site = nullptr;
+#endif
+
+	FrRwLock() {
+		turnstile = xSemaphoreCreateMutex();
+		readersMu = xSemaphoreCreateMutex();
+		roomEmpty = xSemaphoreCreateBinary();
+		if (roomEmpty)
+			xSemaphoreGive(roomEmpty);
+	}
+	~FrRwLock() {
+		if (turnstile)
+			vSemaphoreDelete(turnstile);
+		if (readersMu)
+			vSemaphoreDelete(readersMu);
+		if (roomEmpty)
+			vSemaphoreDelete(roomEmpty);
+	}
+	FrRwLock(const FrRwLock &) = delete;
+	FrRwLock &operator=(const FrRwLock &) = delete;
+
+	// See FrMutex::setName().
+	void setName(const char *name, const char *suffix = "") {
+#if ESP_JSONDB_LOCK_STATS
+		site = lockSiteFor(name, suffix);
+#else
+		(void)name;
+		(void)suffix;
+#endif
+	}
+
+	void lockShared() {
+		xSemaphoreTake(turnstile, portMAX_DELAY);
+		xSemaphoreGive(turnstile);
+		xSemaphoreTake(readersMu, portMAX_DELAY);
+		if (++readers == 1)
+			xSemaphoreTake(roomEmpty, portMAX_DELAY);
+		xSemaphoreGive(readersMu);
+	}
+	void unlockShared() {
+		xSemaphoreTake(readersMu, portMAX_DELAY);
+		if (--readers == 0)
+			xSemaphoreGive(roomEmpty);
+		xSemaphoreGive(readersMu);
+	}
+	void lock() {
+		xSemaphoreTake(turnstile, portMAX_DELAY);
+		xSemaphoreTake(roomEmpty, portMAX_DELAY);
+	}
+	void unlock() {
+		xSemaphoreGive(roomEmpty);
+		xSemaphoreGive(turnstile);
+	}
+	// Non-blocking variants; false when the lock would have to wait.
+	bool tryLockShared() {
+		if (xSemaphoreTake(turnstile, 0) != pdTRUE)
+			return false;
+		xSemaphoreGive(turnstile);
+		xSemaphoreTake(readersMu, portMAX_DELAY);
+		const bool entered = readers > 0 || xSemaphoreTake(roomEmpty, 0) == pdTRUE;
+		if (entered)
+			++readers;
+		xSemaphoreGive(readersMu);
+		return entered;
+	}
+	bool tryLock() {
+		if (xSemaphoreTake(turnstile, 0) != pdTRUE)
+			return false;
+		if (xSemaphoreTake(roomEmpty, 0) != pdTRUE) {
+			xSemaphoreGive(turnstile);
+			return false;
+		}
+		return true;
+	}
+};
+
+struct FrReadLock {
+	FrRwLock &m;
+	explicit FrReadLock(FrRwLock &mtx) : m(mtx) {
+#if ESP_JSONDB_LOCK_STATS
+		if ((_timing.site = m.site) != nullptr) {
+			_timing.acquire([this] { return m.tryLockShared(); }, [this] { m.lockShared(); });
+			return;
+		}
+#endif
+		m.lockShared();
+	}
+	~FrReadLock() {
+#if ESP_JSONDB_LOCK_STATS
+		if (_timing.site) {
+			_timing.stop();
+			m.unlockShared();
+			_timing.report(true);
+			return;
+		}
+#endif
+		m.unlockShared();
+	}
+	FrReadLock(const FrReadLock &) = delete;
+	FrReadLock &operator=(const FrReadLock &) = delete;
+
+#if ESP_JSONDB_LOCK_STATS
+  private:
+	LockTiming _timing;
+#endif
+};
+
+struct FrWriteLock {
+	FrRwLock &m;
+	explicit FrWriteLock(FrRwLock &mtx) : m(mtx) {
+#if ESP_JSONDB_LOCK_STATS
+		if ((_timing.site = m.site) != nullptr) {
+			_timing.acquire([this] { return m.tryLock(); }, [this] { m.lock(); });
+			return;
+		}
+#endif
+		m.lock();
+	}
+	~FrWriteLock() {
+#if ESP_JSONDB_LOCK_STATS
+		if (_timing.site) {
+			_timing.stop();
+			m.unlock();
+			_timing.report(false);
+			return;
+		}
+#endif
+		m.unlock();
+	}
+	FrWriteLock(const FrWriteLock &) = delete;
+	FrWriteLock &operator=(const FrWriteLock &) = delete;
+
+#if ESP_JSONDB_LOCK_STATS
+  private:
+	LockTiming _timing;
+#endif
+};
@@ -0,0 +1,31 @@
+#include "fs_lock.h"
+
+FsLocks g_fsLocks; // definition of global FS lock set
+
+namespace {
+size_t stripeFor(const std::string &path) {
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (char c : path) {
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 16777619u;
+	}
+	return hash % FsLocks::kPathStripes;
+}
+} // namespace
+
+FsLocks::FsLocks() {
+	_namespace.setName("fsNamespace");
+	for (size_t i = 0; i < kPathStripes; ++i) {
+		_paths[i].setName("fsPath");
+		_staging[i].setName("fsStaging");
+	}
+}
+
+FrMutex &FsLocks::pathMutex(const std::string &path) {
+	return _paths[stripeFor(path)];
+}
+
+FrMutex &FsLocks::stagingMutex(const std::string &path) {
+	return _staging[stripeFor(path)];
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "fr_mutex.h"
+
+// Filesystem locking. LittleFS serializes individual calls on its own, so the
+// library only guards multi-step sequences:
+// - the namespace lock covers directory structure (mkdir, create, remove,
+//   rename, directory listings);
+// - path locks cover one file's content (reading it, or replacing it through
+//   the tmp + rename sequence). Paths hash onto a fixed set of stripes so
+//   unrelated files rarely contend;
+// - staging locks keep two writers of the same target off its shared ".tmp"
+//   file while the payload streams. They use their own stripes, so a long
+//   upload never blocks readers.
+// Lock order: staging, then path, then namespace; at most one of each.
+
+// The locks are named fsNamespace, fsPath and fsStaging for contention
+// profiling (utils/lock_stats.h); the stripes of a kind share counters.
+class FsLocks {
+  public:
+	static constexpr size_t kPathStripes = 16;
+
+	FsLocks();
+
+	FrMutex &namespaceMutex() {
+		return _namespace;
+	}
+	FrMutex &pathMutex(const std::string &path);
+	FrMutex &stagingMutex(const std::string &path);
+
+  private:
+	FrMutex _namespace;
+	FrMutex _paths[kPathStripes];
+	FrMutex _staging[kPathStripes];
+};
+
+extern FsLocks g_fsLocks;
+
+// Directory-structure changes and listings.
+class FsNamespaceLock : public FrLock {
+  public:
+	FsNamespaceLock() : FrLock(g_fsLocks.namespaceMutex()) {
+	}
+};
+
+// Content of a single file.
+class FsPathLock : public FrLock {
+  public:
+	explicit FsPathLock(const std::string &path) : FrLock(g_fsLocks.pathMutex(path)) {
+	}
+};
+
+// Exclusive use of a target's ".tmp" staging file while its payload streams.
+class FsStagingLock : public FrLock {
+  public:
+	explicit FsStagingLock(const std::string &finalPath)
+	    : FrLock(g_fsLocks.stagingMutex(finalPath)) {
+	}
+};
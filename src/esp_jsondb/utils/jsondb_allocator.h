@@ -17,14 +17,24 @@
 #define ESP_JSONDB_HAS_ESP32_HEAP_CAPS 0
 #endif
 
+#ifndef ESP_JSONDB_SLAB_POOLS
+#define ESP_JSONDB_SLAB_POOLS 1
+#endif
+
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <deque>
 #include <limits>
 #include <map>
 #include <new>
+#include <type_traits>
 #include <vector>
 
+#if ESP_JSONDB_SLAB_POOLS
+#include "slab_pool.h"
+#endif
+
 namespace jsondb_allocator_detail {
 
 inline void *allocate(std::size_t bytes, bool usePSRAMBuffers) noexcept {
@@ -69,6 +79,28 @@ inline void *reallocate(void *ptr, std::size_t bytes, bool usePSRAMBuffers) noex
 #endif
 }
 
+// Blocks of up to SlabPools::kMaxBlockBytes come from the slab pools. Blocks
+// must be freed with the size they were allocated with.
+inline void *allocatePooled(std::size_t bytes, bool usePSRAMBuffers) noexcept {
+#if ESP_JSONDB_SLAB_POOLS
+	if (bytes <= SlabPools::kMaxBlockBytes)
+		return SlabPools::instance().allocate(bytes, usePSRAMBuffers);
+#endif
+	return allocate(bytes, usePSRAMBuffers);
+}
+
+inline void deallocatePooled(void *ptr, std::size_t bytes) noexcept {
+#if ESP_JSONDB_SLAB_POOLS
+	if (bytes <= SlabPools::kMaxBlockBytes) {
+		SlabPools::instance().deallocate(ptr);
+		return;
+	}
+#else
+	(void)bytes;
+#endif
+	deallocate(ptr);
+}
+
 } // namespace jsondb_allocator_detail
 
 template <typename T> class JsonDbAllocator {
@@ -91,6 +123,9 @@ template <typename T> class JsonDbAllocator {
 			return nullptr;
 		}
 
+		// Payload bytes are pooled like records; see JsonDbPooledAllocator.
+		if (std::is_same<T, uint8_t>::value)
+			return static_cast<T *>(jsondb_allocator_detail::allocatePooled(n, _usePSRAMBuffers));
 		void *memory = jsondb_allocator_detail::allocate(n * sizeof(T), _usePSRAMBuffers);
 		if (memory == nullptr) {
 			return nullptr;
@@ -98,7 +133,11 @@ template <typename T> class JsonDbAllocator {
 		return static_cast<T *>(memory);
 	}
 
-	void deallocate(T *ptr, std::size_t) noexcept {
+	void deallocate(T *ptr, std::size_t n) noexcept {
+		if (std::is_same<T, uint8_t>::value) {
+			jsondb_allocator_detail::deallocatePooled(ptr, n);
+			return;
+		}
 		jsondb_allocator_detail::deallocate(ptr);
 	}
 
@@ -120,6 +159,50 @@ template <typename T> class JsonDbAllocator {
 	bool _usePSRAMBuffers = false;
 };
 
+// Allocator for document records (std::allocate_shared), served from the slab
+// pools so record churn reuses the same slabs.
+template <typename T> class JsonDbPooledAllocator {
+  public:
+	using value_type = T;
+
+	JsonDbPooledAllocator() noexcept = default;
+	explicit JsonDbPooledAllocator(bool usePSRAMBuffers) noexcept
+	    : _usePSRAMBuffers(usePSRAMBuffers) {
+	}
+
+	template <typename U>
+	JsonDbPooledAllocator(const JsonDbPooledAllocator<U> &other) noexcept
+	    : _usePSRAMBuffers(other.usePSRAMBuffers()) {
+	}
+
+	T *allocate(std::size_t n) {
+		if (n == 0 || n > (std::numeric_limits<std::size_t>::max() / sizeof(T)))
+			return nullptr;
+		return static_cast<T *>(
+		    jsondb_allocator_detail::allocatePooled(n * sizeof(T), _usePSRAMBuffers)
+		);
+	}
+
+	void deallocate(T *ptr, std::size_t n) noexcept {
+		jsondb_allocator_detail::deallocatePooled(ptr, n * sizeof(T));
+	}
+
+	bool usePSRAMBuffers() const noexcept {
+		return _usePSRAMBuffers;
+	}
+
+	template <typename U> bool operator==(const JsonDbPooledAllocator<U> &other) const noexcept {
+		return _usePSRAMBuffers == other.usePSRAMBuffers();
+	}
+
+	template <typename U> bool operator!=(const JsonDbPooledAllocator<U> &other) const noexcept {
+		return !(*this == other);
+	}
+
+  private:
+	bool _usePSRAMBuffers = false;
+};
+
 template <typename T> using JsonDbVector = std::vector<T, JsonDbAllocator<T>>;
 template <typename T> using JsonDbDeque = std::deque<T, JsonDbAllocator<T>>;
 template <typename Key, typename T, typename Compare = std::less<Key>>
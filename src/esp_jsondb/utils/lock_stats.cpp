@@ -0,0 +1,129 @@
+#include "lock_stats.h"
+
+#if ESP_JSONDB_LOCK_STATS
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+uint32_t clampUs(int64_t us) {
+	if (us <= 0)
+		return 0;
+	return us > static_cast<int64_t>(UINT32_MAX) ? UINT32_MAX : static_cast<uint32_t>(us);
+}
+
+void accumulate(LockStats &stats, bool contended, uint32_t waitUs, uint32_t holdUs) {
+	++stats.acquisitions;
+	if (contended)
+		++stats.contended;
+	stats.totalWaitUs += waitUs;
+	stats.totalHoldUs += holdUs;
+	if (waitUs > stats.maxWaitUs)
+		stats.maxWaitUs = waitUs;
+	if (holdUs > stats.maxHoldUs)
+		stats.maxHoldUs = holdUs;
+}
+
+void writeStats(JsonObject out, const LockStats &stats) {
+	out["acquisitions"] = stats.acquisitions;
+	out["contended"] = stats.contended;
+	out["avgWaitUs"] = stats.acquisitions
+	                       ? static_cast<uint32_t>(stats.totalWaitUs / stats.acquisitions)
+	                       : 0u;
+	out["maxWaitUs"] = stats.maxWaitUs;
+	out["totalWaitUs"] = stats.totalWaitUs;
+	out["avgHoldUs"] = stats.acquisitions
+	                       ? static_cast<uint32_t>(stats.totalHoldUs / stats.acquisitions)
+	                       : 0u;
+	out["maxHoldUs"] = stats.maxHoldUs;
+}
+} // namespace
+
+LockSite *lockSiteFor(const char *name, const char *suffix) {
+	return LockProfiler::instance().site(name, suffix);
+}
+
+int64_t lockClockUs() {
+	return esp_timer_get_time();
+}
+
+void lockSiteRecord(LockSite *site, bool shared, bool contended, int64_t waitUs, int64_t holdUs) {
+	LockProfiler::instance().record(site, shared, contended, clampUs(waitUs), clampUs(holdUs));
+}
+
+LockProfiler &LockProfiler::instance() {
+	static LockProfiler *profiler = new LockProfiler();
+	return *profiler;
+}
+
+LockProfiler::LockProfiler() {
+	_mu = xSemaphoreCreateMutex();
+}
+
+LockSite *LockProfiler::site(const char *name, const char *suffix) {
+	std::string full(name ? name : "");
+	full += suffix ? suffix : "";
+	xSemaphoreTake(_mu, portMAX_DELAY);
+	LockSite *found = nullptr;
+	for (auto &entry : _sites) {
+		if (entry.name == full) {
+			found = &entry;
+			break;
+		}
+	}
+	if (!found) {
+		_sites.emplace_back();
+		found = &_sites.back();
+		found->name = std::move(full);
+	}
+	xSemaphoreGive(_mu);
+	return found;
+}
+
+void LockProfiler::record(
+    LockSite *site, bool shared, bool contended, uint32_t waitUs, uint32_t holdUs
+) {
+	if (!site)
+		return;
+	xSemaphoreTake(_mu, portMAX_DELAY);
+	accumulate(shared ? site->shared : site->exclusive, contended, waitUs, holdUs);
+	xSemaphoreGive(_mu);
+}
+
+void LockProfiler::reset() {
+	xSemaphoreTake(_mu, portMAX_DELAY);
+	for (auto &entry : _sites) {
+		entry.exclusive = LockStats{};
+		entry.shared = LockStats{};
+	}
+	xSemaphoreGive(_mu);
+}
+
+void LockProfiler::topToJson(JsonArray out, size_t topN) {
+	std::vector<LockSite> copy;
+	xSemaphoreTake(_mu, portMAX_DELAY);
+	copy.reserve(_sites.size());
+	for (const auto &entry : _sites) {
+		if (entry.exclusive.acquisitions > 0 || entry.shared.acquisitions > 0)
+			copy.push_back(entry);
+	}
+	xSemaphoreGive(_mu);
+
+	auto waitOf = [](const LockSite &entry) {
+		return entry.exclusive.totalWaitUs + entry.shared.totalWaitUs;
+	};
+	std::sort(copy.begin(), copy.end(), [&](const LockSite &a, const LockSite &b) {
+		return waitOf(a) > waitOf(b);
+	});
+	if (copy.size() > topN)
+		copy.resize(topN);
+	for (const auto &entry : copy) {
+		auto item = out.add<JsonObject>();
+		item["name"] = entry.name;
+		writeStats(item, entry.exclusive);
+		if (entry.shared.acquisitions > 0)
+			writeStats(item["shared"].to<JsonObject>(), entry.shared);
+	}
+}
+#endif
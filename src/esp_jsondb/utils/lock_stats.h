@@ -0,0 +1,58 @@
+#pragma once
+
+#include <ArduinoJson.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include "fr_mutex.h"
+
+// Lock contention profiling. With ESP_JSONDB_LOCK_STATS=1 (off by default)
+// every FrMutex/FrRwLock given a name through setName() counts acquisitions,
+// the ones that had to wait, and the wait and hold time of each. Shared
+// (reader) acquisitions of an FrRwLock are counted apart from exclusive ones.
+// ESPJsonDB::getDiagnostics() reports the locks with the most wait time under
+// "locks".
+#if ESP_JSONDB_LOCK_STATS
+struct LockStats {
+	uint32_t acquisitions = 0;
+	uint32_t contended = 0;
+	uint32_t maxWaitUs = 0;
+	uint32_t maxHoldUs = 0;
+	uint64_t totalWaitUs = 0;
+	uint64_t totalHoldUs = 0;
+};
+
+struct LockSite {
+	std::string name;
+	LockStats exclusive;
+	LockStats shared;
+};
+
+class LockProfiler {
+  public:
+	static constexpr size_t kReportTop = 8;
+
+	// Never destroyed, like the locks that may report to it.
+	static LockProfiler &instance();
+
+	// Counters for `name` + `suffix`, created on first use and kept for good,
+	// so a collection dropped and created again continues its counters.
+	LockSite *site(const char *name, const char *suffix);
+	void record(LockSite *site, bool shared, bool contended, uint32_t waitUs, uint32_t holdUs);
+	void reset();
+	// [{name, acquisitions, contended, avgWaitUs, maxWaitUs, totalWaitUs,
+	// avgHoldUs, maxHoldUs, shared?}] for the `topN` sites with the most
+	// total wait, exclusive and shared together; idle sites are left out.
+	void topToJson(JsonArray out, size_t topN = kReportTop);
+
+  private:
+	LockProfiler();
+
+	// A plain semaphore: an FrMutex here could end up profiling itself.
+	SemaphoreHandle_t _mu = nullptr;
+	std::deque<LockSite> _sites; // stable addresses
+};
+#endif
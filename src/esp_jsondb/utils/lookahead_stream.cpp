@@ -0,0 +1,31 @@
+#include "lookahead_stream.h"
+
+int LookaheadStream::available() {
+	return _in.available() + (_peeked >= 0 ? 1 : 0);
+}
+
+int LookaheadStream::read() {
+	const int c = peek();
+	_peeked = -1;
+	return c;
+}
+
+int LookaheadStream::peek() {
+	if (_peeked < 0) {
+		char c = 0;
+		if (_in.readBytes(&c, 1) == 1)
+			_peeked = static_cast<uint8_t>(c);
+	}
+	return _peeked;
+}
+
+size_t LookaheadStream::readBytes(char *buffer, size_t length) {
+	if (length == 0)
+		return 0;
+	size_t got = 0;
+	if (_peeked >= 0) {
+		buffer[got++] = static_cast<char>(_peeked);
+		_peeked = -1;
+	}
+	return got + _in.readBytes(buffer + got, length - got);
+}
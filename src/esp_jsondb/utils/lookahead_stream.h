@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstddef>
+
+// Read-only Stream adapter whose peek() waits like read() does. Arduino's
+// peek() never waits: on a network stream it returns -1 whenever the next
+// byte is still in flight, which a parser takes for the end of the input.
+// Here the lookahead byte is taken with a timed readBytes() on the source, so
+// peek() and read() both honour its setTimeout() and return -1 only when it
+// expires or the data has ended.
+class LookaheadStream : public Stream {
+  public:
+	explicit LookaheadStream(Stream &in) : _in(in) {
+	}
+
+	int available() override;
+	int read() override;
+	int peek() override;
+	using Stream::readBytes;
+	size_t readBytes(char *buffer, size_t length) override;
+
+	size_t write(uint8_t) override {
+		return 0;
+	}
+
+  private:
+	Stream &_in;
+	int _peeked = -1;
+};
@@ -0,0 +1,151 @@
+#include "op_stats.h"
+
+#if ESP_JSONDB_OP_STATS
+#include <esp_timer.h>
+
+#include <algorithm>
+
+OpStats g_opStats; // definition of global operation counters
+
+namespace {
+uint32_t clampUs(int64_t us) {
+	if (us <= 0)
+		return 0;
+	return us > static_cast<int64_t>(UINT32_MAX) ? UINT32_MAX : static_cast<uint32_t>(us);
+}
+
+void writeSummary(JsonObject out, const OpSummary &summary) {
+	out["count"] = summary.count;
+	out["bytes"] = summary.bytes;
+	out["avgUs"] = summary.count ? static_cast<uint32_t>(summary.totalUs / summary.count) : 0u;
+	out["maxUs"] = summary.maxUs;
+}
+} // namespace
+
+void AtomicOpSummary::add(uint32_t us, size_t bytes) {
+	_count.fetch_add(1, std::memory_order_relaxed);
+	_totalUs.add(us);
+	_bytes.add(bytes > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(bytes));
+	uint32_t seen = _maxUs.load(std::memory_order_relaxed);
+	while (us > seen && !_maxUs.compare_exchange_weak(seen, us, std::memory_order_relaxed)) {
+	}
+}
+
+OpSummary AtomicOpSummary::load() const {
+	OpSummary summary;
+	summary.count = _count.load(std::memory_order_relaxed);
+	summary.maxUs = _maxUs.load(std::memory_order_relaxed);
+	summary.totalUs = _totalUs.load();
+	summary.bytes = _bytes.load();
+	return summary;
+}
+
+void AtomicOpSummary::reset() {
+	_count.store(0, std::memory_order_relaxed);
+	_maxUs.store(0, std::memory_order_relaxed);
+	_totalUs.reset();
+	_bytes.reset();
+}
+
+size_t OpHistogram::bucketOf(uint32_t us) {
+	if (us < kSubBuckets)
+		return us;
+	const uint32_t octave = 31 - static_cast<uint32_t>(__builtin_clz(us));
+	if (octave >= kOctaves)
+		return kBuckets - 1;
+	const uint32_t sub = (us >> (octave - 2)) & (kSubBuckets - 1);
+	return kSubBuckets + (octave - 2) * kSubBuckets + sub;
+}
+
+uint32_t OpHistogram::upperBoundOf(size_t bucket) {
+	if (bucket < kSubBuckets)
+		return static_cast<uint32_t>(bucket);
+	if (bucket >= kBuckets - 1)
+		return UINT32_MAX; // open-ended; callers cap it with the maximum
+	const uint32_t octave = static_cast<uint32_t>((bucket - kSubBuckets) / kSubBuckets) + 2;
+	const uint32_t sub = static_cast<uint32_t>((bucket - kSubBuckets) % kSubBuckets);
+	return ((kSubBuckets + sub + 1) << (octave - 2)) - 1;
+}
+
+uint32_t OpHistogram::snapshot(Counts &out) const {
+	uint32_t count = 0;
+	for (size_t bucket = 0; bucket < kBuckets; ++bucket) {
+		out[bucket] = _counts[bucket].load(std::memory_order_relaxed);
+		count += out[bucket];
+	}
+	return count;
+}
+
+void OpHistogram::reset() {
+	for (auto &count : _counts)
+		count.store(0, std::memory_order_relaxed);
+}
+
+uint32_t OpHistogram::percentile(const Counts &counts, uint32_t count, uint32_t perMille) {
+	if (count == 0)
+		return 0;
+	const uint64_t rank = std::max<uint64_t>(
+	    1,
+	    (static_cast<uint64_t>(count) * perMille + 999) / 1000
+	);
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < kBuckets; ++bucket) {
+		seen += counts[bucket];
+		if (seen >= rank)
+			return upperBoundOf(bucket);
+	}
+	return UINT32_MAX;
+}
+
+void OpStats::record(DbOp op, uint32_t us, size_t bytes, CollectionOpStats *collection) {
+	const auto idx = static_cast<size_t>(op);
+	if (idx >= kDbOpCount)
+		return;
+	_summaries[idx].add(us, bytes);
+	_histograms[idx].record(us);
+	if (collection && idx < kCollectionOpCount)
+		collection->ops[idx].add(us, bytes);
+}
+
+void OpStats::reset() {
+	for (size_t i = 0; i < kDbOpCount; ++i) {
+		_summaries[i].reset();
+		_histograms[i].reset();
+	}
+}
+
+void OpStats::toJson(JsonObject out) {
+	for (size_t i = 0; i < kDbOpCount; ++i) {
+		const OpSummary summary = _summaries[i].load();
+		if (summary.count == 0)
+			continue;
+		// Percentiles come from the bucket total, which may be a few samples
+		// ahead of or behind the summary.
+		OpHistogram::Counts counts;
+		const uint32_t samples = _histograms[i].snapshot(counts);
+		auto entry = out[kDbOpNames[i]].to<JsonObject>();
+		writeSummary(entry, summary);
+		entry["p50Us"] = std::min(OpHistogram::percentile(counts, samples, 500), summary.maxUs);
+		entry["p90Us"] = std::min(OpHistogram::percentile(counts, samples, 900), summary.maxUs);
+		entry["p99Us"] = std::min(OpHistogram::percentile(counts, samples, 990), summary.maxUs);
+	}
+}
+
+void OpStats::collectionToJson(const CollectionOpStats &stats, JsonObject out) {
+	for (size_t i = 0; i < kCollectionOpCount; ++i) {
+		const OpSummary summary = stats.ops[i].load();
+		if (summary.count > 0)
+			writeSummary(out[kDbOpNames[i]].to<JsonObject>(), summary);
+	}
+}
+
+OpTimer::OpTimer(DbOp op, CollectionOpStats *collection)
+    : _op(op), _collection(collection), _startedUs(esp_timer_get_time()) {
+}
+
+OpTimer::~OpTimer() {
+	if (_op == DbOp::Count)
+		return;
+	g_opStats.record(_op, clampUs(esp_timer_get_time() - _startedUs), _bytes, _collection);
+}
+#endif
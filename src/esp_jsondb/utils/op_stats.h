@@ -0,0 +1,190 @@
+#pragma once
+
+#include <ArduinoJson.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#ifndef ESP_JSONDB_OP_STATS
+#define ESP_JSONDB_OP_STATS 1
+#endif
+
+// Operation latency counters. Each timed call lands in a log-linear histogram
+// for its operation (four buckets per power of two of microseconds, so
+// percentiles are within a quarter octave), and the collection operations are
+// also summed per collection. Every counter is a relaxed 32-bit atomic, so
+// recording takes no lock; a report read while calls complete may be off by
+// those calls. Reported by ESPJsonDB::getDiagnostics(); define
+// ESP_JSONDB_OP_STATS=0 to compile the timers out.
+enum class DbOp : uint8_t {
+	// Per collection as well
+	FindById = 0,
+	FindMany,
+	FindOne,
+	Create,
+	Update, // one document, also inside updateOne/updateMany
+	Remove,
+	Commit, // DocView::commit()
+	Flush,  // Collection::flushDirtyToFs()
+	// Storage primitives
+	RecordRead,
+	RecordWrite,
+	FileRead,
+	FileWrite,
+	FileRemove,
+	FileUpload, // a writeFileStreamAsync() job while it runs
+	Count
+};
+
+static constexpr size_t kCollectionOpCount = static_cast<size_t>(DbOp::RecordRead);
+static constexpr size_t kDbOpCount = static_cast<size_t>(DbOp::Count);
+
+static constexpr const char *kDbOpNames[] = {
+    "findById",
+    "findMany",
+    "findOne",
+    "create",
+    "update",
+    "remove",
+    "commit",
+    "flush",
+    "recordRead",
+    "recordWrite",
+    "fileRead",
+    "fileWrite",
+    "fileRemove",
+    "fileUpload",
+};
+
+inline const char *dbOpToString(DbOp op) {
+	const auto idx = static_cast<size_t>(op);
+	return idx < kDbOpCount ? kDbOpNames[idx] : "Unknown";
+}
+
+struct OpSummary {
+	uint32_t count = 0;
+	uint32_t maxUs = 0;
+	uint64_t totalUs = 0;
+	uint64_t bytes = 0;
+};
+
+#if ESP_JSONDB_OP_STATS
+// 64-bit running total kept in two 32-bit atomics (64-bit atomics take a
+// lock on 32-bit targets). The add that wraps the low word carries.
+class AtomicTotal {
+  public:
+	void add(uint32_t value) {
+		if (_low.fetch_add(value, std::memory_order_relaxed) > UINT32_MAX - value)
+			_high.fetch_add(1, std::memory_order_relaxed);
+	}
+	uint64_t load() const {
+		return (static_cast<uint64_t>(_high.load(std::memory_order_relaxed)) << 32) |
+		       _low.load(std::memory_order_relaxed);
+	}
+	void reset() {
+		_low.store(0, std::memory_order_relaxed);
+		_high.store(0, std::memory_order_relaxed);
+	}
+
+  private:
+	std::atomic<uint32_t> _low{0};
+	std::atomic<uint32_t> _high{0};
+};
+
+class AtomicOpSummary {
+  public:
+	void add(uint32_t us, size_t bytes);
+	OpSummary load() const;
+	void reset();
+
+  private:
+	std::atomic<uint32_t> _count{0};
+	std::atomic<uint32_t> _maxUs{0};
+	AtomicTotal _totalUs;
+	AtomicTotal _bytes;
+};
+
+// Owned by each collection.
+struct CollectionOpStats {
+	AtomicOpSummary ops[kCollectionOpCount];
+};
+
+class OpHistogram {
+  public:
+	static constexpr uint32_t kSubBuckets = 4;
+	// Samples of 2^kOctaves us (~16.8 s) and more share the last bucket.
+	static constexpr uint32_t kOctaves = 24;
+	static constexpr size_t kBuckets = kSubBuckets + (kOctaves - 2) * kSubBuckets;
+	using Counts = uint32_t[kBuckets];
+
+	void record(uint32_t us) {
+		_counts[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+	}
+	// Copies the buckets; returns the number of samples in them.
+	uint32_t snapshot(Counts &out) const;
+	void reset();
+	// Upper bound of the bucket holding the `perMille`th of `count` samples,
+	// 0 when empty.
+	static uint32_t percentile(const Counts &counts, uint32_t count, uint32_t perMille);
+
+	static size_t bucketOf(uint32_t us);
+	static uint32_t upperBoundOf(size_t bucket);
+
+  private:
+	std::atomic<uint32_t> _counts[kBuckets] = {};
+};
+
+class OpStats {
+  public:
+	void record(DbOp op, uint32_t us, size_t bytes, CollectionOpStats *collection);
+	void reset();
+	// {"<op>": {count, bytes, avgUs, p50Us, p90Us, p99Us, maxUs}} for every
+	// operation that ran at least once.
+	void toJson(JsonObject out);
+	// The same without percentiles, for one collection's counters.
+	void collectionToJson(const CollectionOpStats &stats, JsonObject out);
+
+  private:
+	AtomicOpSummary _summaries[kDbOpCount];
+	OpHistogram _histograms[kDbOpCount];
+};
+
+extern OpStats g_opStats;
+
+// Times its own lifetime as one `op`.
+class OpTimer {
+  public:
+	explicit OpTimer(DbOp op, CollectionOpStats *collection = nullptr);
+	~OpTimer();
+
+	OpTimer(const OpTimer &) = delete;
+	OpTimer &operator=(const OpTimer &) = delete;
+
+	void addBytes(size_t bytes) {
+		_bytes += bytes;
+	}
+	// Do not record this call.
+	void discard() {
+		_op = DbOp::Count;
+	}
+
+  private:
+	DbOp _op;
+	CollectionOpStats *_collection;
+	size_t _bytes = 0;
+	int64_t _startedUs = 0;
+};
+#else
+struct CollectionOpStats {};
+
+class OpTimer {
+  public:
+	explicit OpTimer(DbOp, CollectionOpStats * = nullptr) {
+	}
+	void addBytes(size_t) {
+	}
+	void discard() {
+	}
+};
+#endif
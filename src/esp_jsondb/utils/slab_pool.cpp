@@ -0,0 +1,176 @@
+#include "slab_pool.h"
+
+#include <new>
+
+#include "jsondb_allocator.h"
+
+struct SlabPools::Slab {
+	Pool *pool;
+	Slab *prev; // on the pool's partial list
+	Slab *next;
+	void *freeList;
+	size_t inUse;
+};
+
+namespace {
+constexpr size_t kAlign = alignof(std::max_align_t);
+
+constexpr size_t alignUp(size_t bytes) {
+	return (bytes + kAlign - 1) / kAlign * kAlign;
+}
+
+// Every block is preceded by a pointer to its slab, null for a block that
+// came from the heap.
+constexpr size_t kBlockHeaderBytes = alignUp(sizeof(void *));
+
+size_t classFor(size_t bytes) {
+	size_t cls = 0;
+	while (SlabPools::kClassBytes[cls] < bytes)
+		++cls;
+	return cls;
+}
+
+void writeStats(JsonArray out, const SlabPoolStats *stats) {
+	for (size_t cls = 0; cls < SlabPools::kClassCount; ++cls) {
+		auto entry = out.add<JsonObject>();
+		entry["blockBytes"] = static_cast<uint32_t>(SlabPools::kClassBytes[cls]);
+		entry["slabs"] = stats[cls].slabs;
+		entry["released"] = stats[cls].released;
+		entry["inUse"] = stats[cls].inUse;
+		entry["peakInUse"] = stats[cls].peakInUse;
+		entry["free"] = stats[cls].free;
+		entry["fallbacks"] = stats[cls].fallbacks;
+	}
+}
+} // namespace
+
+SlabPools &SlabPools::instance() {
+	static SlabPools *pools = new SlabPools();
+	return *pools;
+}
+
+SlabPools::SlabPools() {
+	for (size_t region = 0; region < 2; ++region) {
+		for (size_t cls = 0; cls < kClassCount; ++cls) {
+			Pool &pool = _pools[region][cls];
+			pool.stride = alignUp(kBlockHeaderBytes + kClassBytes[cls]);
+			pool.perSlab = (kSlabBytes - alignUp(sizeof(Slab))) / pool.stride;
+			pool.usePSRAMBuffers = region == 1;
+			pool.mu.setName("slabPools");
+		}
+	}
+}
+
+void *SlabPools::allocate(size_t bytes, bool usePSRAMBuffers) {
+	Pool &pool = _pools[usePSRAMBuffers ? 1 : 0][classFor(bytes)];
+	{
+		FrLock lk(pool.mu);
+		Slab *slab = pool.partial ? pool.partial : carveLocked(pool);
+		if (slab) {
+			void *block = slab->freeList;
+			slab->freeList = *static_cast<void **>(block);
+			if (++slab->inUse == pool.perSlab)
+				unlinkLocked(pool, slab);
+			--pool.stats.free;
+			if (++pool.stats.inUse > pool.stats.peakInUse)
+				pool.stats.peakInUse = pool.stats.inUse;
+			return block;
+		}
+		++pool.stats.fallbacks;
+	}
+	auto *raw = static_cast<uint8_t *>(
+	    jsondb_allocator_detail::allocate(kBlockHeaderBytes + bytes, usePSRAMBuffers)
+	);
+	if (!raw)
+		return nullptr;
+	*reinterpret_cast<Slab **>(raw) = nullptr;
+	return raw + kBlockHeaderBytes;
+}
+
+void SlabPools::deallocate(void *ptr) {
+	if (!ptr)
+		return;
+	uint8_t *raw = static_cast<uint8_t *>(ptr) - kBlockHeaderBytes;
+	Slab *slab = *reinterpret_cast<Slab **>(raw);
+	if (!slab) {
+		jsondb_allocator_detail::deallocate(raw);
+		return;
+	}
+	Pool &pool = *slab->pool;
+	bool release = false;
+	{
+		FrLock lk(pool.mu);
+		*static_cast<void **>(ptr) = slab->freeList;
+		slab->freeList = ptr;
+		if (slab->inUse-- == pool.perSlab)
+			linkLocked(pool, slab);
+		--pool.stats.inUse;
+		++pool.stats.free;
+		// The last slab with free blocks stays, so a class hovering at a slab
+		// boundary does not allocate and release one on every call.
+		if (slab->inUse == 0 && (slab->prev || slab->next)) {
+			unlinkLocked(pool, slab);
+			--pool.stats.slabs;
+			++pool.stats.released;
+			pool.stats.free -= static_cast<uint32_t>(pool.perSlab);
+			release = true;
+		}
+	}
+	if (release)
+		jsondb_allocator_detail::deallocate(slab);
+}
+
+SlabPools::Slab *SlabPools::carveLocked(Pool &pool) {
+	auto *base = static_cast<uint8_t *>(
+	    jsondb_allocator_detail::allocate(kSlabBytes, pool.usePSRAMBuffers)
+	);
+	if (!base)
+		return nullptr;
+	Slab *slab = new (base) Slab{&pool, nullptr, nullptr, nullptr, 0};
+	// Thread the blocks onto the free list, lowest address first.
+	uint8_t *first = base + alignUp(sizeof(Slab));
+	for (size_t i = pool.perSlab; i-- > 0;) {
+		uint8_t *raw = first + i * pool.stride;
+		*reinterpret_cast<Slab **>(raw) = slab;
+		void *block = raw + kBlockHeaderBytes;
+		*static_cast<void **>(block) = slab->freeList;
+		slab->freeList = block;
+	}
+	linkLocked(pool, slab);
+	++pool.stats.slabs;
+	pool.stats.free += static_cast<uint32_t>(pool.perSlab);
+	return slab;
+}
+
+void SlabPools::linkLocked(Pool &pool, Slab *slab) {
+	slab->prev = nullptr;
+	slab->next = pool.partial;
+	if (pool.partial)
+		pool.partial->prev = slab;
+	pool.partial = slab;
+}
+
+void SlabPools::unlinkLocked(Pool &pool, Slab *slab) {
+	if (slab->prev)
+		slab->prev->next = slab->next;
+	else
+		pool.partial = slab->next;
+	if (slab->next)
+		slab->next->prev = slab->prev;
+	slab->prev = nullptr;
+	slab->next = nullptr;
+}
+
+void SlabPools::statsToJson(JsonObject out) {
+	SlabPoolStats copy[2][kClassCount];
+	for (size_t region = 0; region < 2; ++region) {
+		for (size_t cls = 0; cls < kClassCount; ++cls) {
+			Pool &pool = _pools[region][cls];
+			FrLock lk(pool.mu);
+			copy[region][cls] = pool.stats;
+		}
+	}
+	writeStats(out["internal"].to<JsonArray>(), copy[0]);
+	writeStats(out["psram"].to<JsonArray>(), copy[1]);
+	out["slabBytes"] = static_cast<uint32_t>(kSlabBytes);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <ArduinoJson.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "fr_mutex.h"
+
+// Size-class pools for document records and small payload buffers. Blocks are
+// cut from fixed-size slabs, and a freed block goes back to its slab instead
+// of to the heap. Churn then reuses the same slabs rather than scattering
+// small holes across the heap, which is what makes large allocations fail on
+// long-running devices.
+//
+// Every block starts with a header naming its slab, so a free never searches
+// for the owner, and each size class has its own lock. A slab whose blocks
+// are all free goes back to the heap unless it is the last one of its class
+// with free blocks. When no slab can be had, the block comes from the heap
+// with a header marking it as such, and is counted as a fallback.
+// Internal RAM and PSRAM blocks use separate pools. Define
+// ESP_JSONDB_SLAB_POOLS=0 to send everything to the heap.
+struct SlabPoolStats {
+	uint32_t slabs = 0;
+	uint32_t released = 0; // slabs handed back to the heap
+	uint32_t inUse = 0;
+	uint32_t peakInUse = 0;
+	uint32_t free = 0;
+	uint32_t fallbacks = 0; // slab allocations that failed
+};
+
+class SlabPools {
+  public:
+	static constexpr size_t kClassCount = 5;
+	static constexpr size_t kClassBytes[kClassCount] = {16, 32, 64, 128, 256};
+	static constexpr size_t kMaxBlockBytes = 256;
+	static constexpr size_t kSlabBytes = 2048;
+
+	// Never destroyed, so blocks may be freed during static destruction.
+	static SlabPools &instance();
+
+	// `bytes` must be 1..kMaxBlockBytes. nullptr only when neither a slab
+	// nor the heap had room.
+	void *allocate(size_t bytes, bool usePSRAMBuffers);
+	// Takes any block returned by allocate(), pooled or not.
+	void deallocate(void *ptr);
+
+	// Writes {"internal", "psram"} per-class counters into `out`.
+	void statsToJson(JsonObject out);
+
+  private:
+	struct Slab;
+	struct Pool {
+		FrMutex mu;
+		Slab *partial = nullptr; // slabs with at least one free block
+		size_t stride = 0;
+		size_t perSlab = 0;
+		bool usePSRAMBuffers = false;
+		SlabPoolStats stats;
+	};
+
+	SlabPools();
+	Slab *carveLocked(Pool &pool);
+	static void linkLocked(Pool &pool, Slab *slab);
+	static void unlinkLocked(Pool &pool, Slab *slab);
+
+	Pool _pools[2][kClassCount]; // [usePSRAMBuffers][class]
+};
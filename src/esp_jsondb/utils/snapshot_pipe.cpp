@@ -0,0 +1,94 @@
+#include "snapshot_pipe.h"
+
+namespace {
+// How often a blocked side rechecks whether the other one closed.
+constexpr TickType_t kPollTicks = pdMS_TO_TICKS(20);
+} // namespace
+
+SnapshotPipe::SnapshotPipe(size_t capacity) {
+	_buffer = xStreamBufferCreate(capacity, 1);
+}
+
+SnapshotPipe::~SnapshotPipe() {
+	if (_buffer != nullptr)
+		vStreamBufferDelete(_buffer);
+}
+
+size_t SnapshotPipe::write(uint8_t byte) {
+	return write(&byte, 1);
+}
+
+size_t SnapshotPipe::write(const uint8_t *data, size_t size) {
+	if (_buffer == nullptr)
+		return 0;
+	size_t sent = 0;
+	while (sent < size && !_readClosed.load(std::memory_order_acquire))
+		sent += xStreamBufferSend(_buffer, data + sent, size - sent, kPollTicks);
+	return sent;
+}
+
+void SnapshotPipe::closeWrite() {
+	_writeClosed.store(true, std::memory_order_release);
+}
+
+int SnapshotPipe::available() {
+	if (_buffer == nullptr)
+		return 0;
+	return static_cast<int>(xStreamBufferBytesAvailable(_buffer)) + (_peeked >= 0 ? 1 : 0);
+}
+
+int SnapshotPipe::read() {
+	uint8_t byte = 0;
+	return readSome(&byte, 1) == 1 ? byte : -1;
+}
+
+int SnapshotPipe::peek() {
+	if (_peeked < 0) {
+		uint8_t byte = 0;
+		if (readSome(&byte, 1) == 1)
+			_peeked = byte;
+	}
+	return _peeked;
+}
+
+size_t SnapshotPipe::readBytes(char *buffer, size_t length) {
+	auto *out = reinterpret_cast<uint8_t *>(buffer);
+	size_t got = 0;
+	while (got < length) {
+		const size_t n = readSome(out + got, length - got);
+		if (n == 0)
+			break;
+		got += n;
+	}
+	return got;
+}
+
+size_t SnapshotPipe::readSome(uint8_t *data, size_t size) {
+	if (_buffer == nullptr || size == 0)
+		return 0;
+	if (_peeked >= 0) {
+		data[0] = static_cast<uint8_t>(_peeked);
+		_peeked = -1;
+		return 1;
+	}
+	for (;;) {
+		// Everything was sent before the close flag was set, so one
+		// non-blocking receive after seeing it drains the rest.
+		const bool closed = _writeClosed.load(std::memory_order_acquire);
+		const size_t got = xStreamBufferReceive(_buffer, data, size, closed ? 0 : kPollTicks);
+		if (got > 0 || closed)
+			return got;
+	}
+}
+
+bool SnapshotPipe::ended() const {
+	if (_buffer == nullptr)
+		return true;
+	if (_peeked >= 0)
+		return false;
+	return _writeClosed.load(std::memory_order_acquire) && xStreamBufferIsEmpty(_buffer) == pdTRUE;
+}
+
+void SnapshotPipe::closeRead() {
+	_readClosed.store(true, std::memory_order_release);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/stream_buffer.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded byte pipe between two tasks over a FreeRTOS stream buffer. One task
+// writes a snapshot through the Print side while the other consumes it
+// through the Stream side, so neither end ever holds more than `capacity`
+// bytes of it. Single writer, single reader. closeWrite() marks the end of the
+// data; closeRead() makes pending and later writes come up short, so a writer
+// never blocks on a reader that gave up.
+class SnapshotPipe : public Stream {
+  public:
+	explicit SnapshotPipe(size_t capacity);
+	~SnapshotPipe() override;
+
+	SnapshotPipe(const SnapshotPipe &) = delete;
+	SnapshotPipe &operator=(const SnapshotPipe &) = delete;
+
+	// False when the stream buffer could not be allocated.
+	bool valid() const {
+		return _buffer != nullptr;
+	}
+
+	// Writer side; blocks while the pipe is full.
+	using Print::write;
+	size_t write(uint8_t byte) override;
+	size_t write(const uint8_t *data, size_t size) override;
+	void closeWrite();
+
+	// Reader side; blocks until data arrives or the writer closes. read() and
+	// peek() return -1, and readBytes() comes up short, only at the end.
+	int available() override;
+	int read() override;
+	int peek() override;
+	using Stream::readBytes;
+	size_t readBytes(char *buffer, size_t length) override;
+	// Up to `size` bytes; at least one unless the data has ended.
+	size_t readSome(uint8_t *data, size_t size);
+	// The writer closed and everything it wrote has been read.
+	bool ended() const;
+	void closeRead();
+
+  private:
+	StreamBufferHandle_t _buffer = nullptr;
+	int _peeked = -1;
+	std::atomic<bool> _writeClosed{false};
+	std::atomic<bool> _readClosed{false};
+};
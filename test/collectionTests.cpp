@@ -1,9 +1,115 @@
 #include "dbTest.h"
 
+#include <atomic>
+#include <string>
+#include <vector>
+
 namespace {
 bool pathExists(const std::string &path) {
 	return LittleFS.exists(path.c_str());
 }
+
+size_t directoryBytes(const std::string &path) {
+	size_t total = 0;
+	File dir = LittleFS.open(path.c_str());
+	if (!dir || !dir.isDirectory())
+		return 0;
+	for (File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+		if (!file.isDirectory())
+			total += file.size();
+		file.close();
+	}
+	dir.close();
+	return total;
+}
+
+struct ConcurrentReaderCtx {
+	ESPJsonDB *db = nullptr;
+	const std::vector<std::string> *ids = nullptr;
+	int rounds = 0;
+	std::atomic<uint32_t> failures{0};
+	std::atomic<bool> done{false};
+	uint32_t elapsedMs = 0;
+};
+
+uint32_t readAllIds(ESPJsonDB &db, const std::vector<std::string> &ids, int rounds) {
+	uint32_t failures = 0;
+	for (int r = 0; r < rounds; ++r) {
+		for (const auto &id : ids) {
+			auto found = db.findById("concurrent_reads", id);
+			if (!found.status.ok() || found.value["slot"].as<int>() < 0)
+				++failures;
+		}
+	}
+	return failures;
+}
+
+void concurrentReaderTask(void *arg) {
+	auto *ctx = static_cast<ConcurrentReaderCtx *>(arg);
+	const uint32_t started = millis();
+	ctx->failures.store(readAllIds(*ctx->db, *ctx->ids, ctx->rounds));
+	ctx->elapsedMs = millis() - started;
+	ctx->done.store(true);
+	vTaskDelete(nullptr);
+}
+
+struct LockBenchCtx {
+	ESPJsonDB *db = nullptr;
+	const std::vector<std::string> *ids = nullptr;
+	int rounds = 0;
+	bool writer = false;
+	std::atomic<uint32_t> failures{0};
+	std::atomic<bool> done{false};
+};
+
+void lockBenchTask(void *arg) {
+	auto *ctx = static_cast<LockBenchCtx *>(arg);
+	uint32_t failures = 0;
+	for (int r = 0; r < ctx->rounds; ++r) {
+		for (const auto &id : *ctx->ids) {
+			if (ctx->writer) {
+				auto updated = ctx->db->updateById("lock_bench", id, [r](DocView &doc) {
+					doc["round"] = r;
+				});
+				if (!updated.ok())
+					++failures;
+			} else if (!ctx->db->findById("lock_bench", id).status.ok()) {
+				++failures;
+			}
+		}
+	}
+	ctx->failures.store(failures);
+	ctx->done.store(true);
+	vTaskDelete(nullptr);
+}
+
+struct BatchSnapshotCtx {
+	ESPJsonDB *db = nullptr;
+	std::atomic<bool> go{false};
+	std::atomic<bool> done{false};
+	int before = 0;
+	int after = 0;
+	bool ok = false;
+};
+
+void batchSnapshotReaderTask(void *arg) {
+	auto *ctx = static_cast<BatchSnapshotCtx *>(arg);
+	while (!ctx->go.load())
+		vTaskDelay(1);
+	{
+		auto snap = ctx->db->beginRead();
+		auto seen = snap.findMany("snapshot_batch", nullptr);
+		ctx->ok = snap.valid() && seen.status.ok();
+		for (auto &view : seen.value) {
+			if (view["state"].as<std::string>() == "after")
+				++ctx->after;
+			else
+				++ctx->before;
+		}
+	}
+	ctx->done.store(true);
+	vTaskDelete(nullptr);
+}
 } // namespace
 
 void DbTester::simpleCollectionCreate() {
@@ -324,3 +430,964 @@ void DbTester::collectionBudgetEnforcementTest() {
 	budgetDb.deinit();
 	ESP_LOGI(DB_TESTER_TAG, "Collection budget enforcement test passed");
 }
+
+void DbTester::collectionDurabilityModesTest() {
+	ESPJsonDB durabilityDb;
+	ESPJsonDBConfig cfg;
+	cfg.autosync = true;
+	cfg.intervalMs = 50;
+
+	auto initStatus = durabilityDb.init("/test_durability_db", cfg);
+	if (!initStatus.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "collectionDurabilityModesTest init failed: %s",
+		    initStatus.message
+		);
+		return;
+	}
+	(void)durabilityDb.dropAll();
+
+	CollectionConfig immediateCfg;
+	immediateCfg.durability = CollectionDurability::Immediate;
+	CollectionConfig deferredCfg;
+	deferredCfg.durability = CollectionDurability::Deferred;
+	if (!durabilityDb.configureCollection("durable_config", immediateCfg).ok() ||
+	    !durabilityDb.configureCollection("volatile_cache", deferredCfg).ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "collectionDurabilityModesTest configure failed");
+		durabilityDb.deinit();
+		return;
+	}
+
+	JsonDocument doc;
+	doc["kind"] = "durability";
+	auto immediateCreate = durabilityDb.create("durable_config", doc.as<JsonObjectConst>());
+	auto deferredCreate = durabilityDb.create("volatile_cache", doc.as<JsonObjectConst>());
+	if (!immediateCreate.status.ok() || !deferredCreate.status.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "collectionDurabilityModesTest seed create failed");
+		durabilityDb.deinit();
+		return;
+	}
+
+	const std::string immediatePath =
+	    "/test_durability_db/durable_config/" + immediateCreate.value + ".jdb";
+	const std::string deferredPath =
+	    "/test_durability_db/volatile_cache/" + deferredCreate.value + ".jdb";
+	if (!pathExists(immediatePath)) {
+		ESP_LOGE(DB_TESTER_TAG, "Immediate collection did not write through on create");
+		durabilityDb.deinit();
+		return;
+	}
+
+	// Several autosync periods pass; Deferred must stay RAM-only.
+	delay(300);
+	if (pathExists(deferredPath)) {
+		ESP_LOGE(DB_TESTER_TAG, "Deferred collection was flushed by autosync");
+		durabilityDb.deinit();
+		return;
+	}
+
+	auto syncStatus = durabilityDb.syncNow();
+	if (!syncStatus.ok() || !pathExists(deferredPath)) {
+		ESP_LOGE(DB_TESTER_TAG, "Deferred collection was not flushed by syncNow()");
+		durabilityDb.deinit();
+		return;
+	}
+
+	auto removeStatus = durabilityDb.removeById("durable_config", immediateCreate.value);
+	if (!removeStatus.ok() || pathExists(immediatePath)) {
+		ESP_LOGE(DB_TESTER_TAG, "Immediate collection did not write through on remove");
+		durabilityDb.deinit();
+		return;
+	}
+
+	(void)durabilityDb.dropAll();
+	durabilityDb.deinit();
+	ESP_LOGI(DB_TESTER_TAG, "Collection durability modes test passed");
+}
+
+void DbTester::parallelCollectionFlushTest() {
+	constexpr int kCollections = 8;
+	constexpr int kDocsPerCollection = 6;
+	const uint8_t workerCounts[] = {1, 4};
+	uint32_t elapsedByWorkers[2] = {0, 0};
+
+	for (size_t run = 0; run < 2; ++run) {
+		ESPJsonDB flushDb;
+		ESPJsonDBConfig cfg;
+		cfg.autosync = false;
+		cfg.syncWorkers = workerCounts[run];
+		auto initStatus = flushDb.init("/test_parallel_flush_db", cfg);
+		if (!initStatus.ok()) {
+			ESP_LOGE(
+			    DB_TESTER_TAG,
+			    "parallelCollectionFlushTest init failed: %s",
+			    initStatus.message
+			);
+			return;
+		}
+		(void)flushDb.dropAll();
+
+		for (int c = 0; c < kCollections; ++c) {
+			const std::string name = "flush_" + std::to_string(c);
+			for (int d = 0; d < kDocsPerCollection; ++d) {
+				JsonDocument doc;
+				doc["collection"] = c;
+				doc["index"] = d;
+				doc["payload"] = "parallel-flush-payload-parallel-flush-payload";
+				if (!flushDb.create(name, doc.as<JsonObjectConst>()).status.ok()) {
+					ESP_LOGE(DB_TESTER_TAG, "parallelCollectionFlushTest seed create failed");
+					flushDb.deinit();
+					return;
+				}
+			}
+		}
+
+		const uint32_t startMs = millis();
+		auto syncStatus = flushDb.syncNow();
+		elapsedByWorkers[run] = millis() - startMs;
+		if (!syncStatus.ok()) {
+			ESP_LOGE(
+			    DB_TESTER_TAG,
+			    "parallelCollectionFlushTest syncNow failed: %s",
+			    syncStatus.message
+			);
+			flushDb.deinit();
+			return;
+		}
+		flushDb.deinit();
+
+		initStatus = flushDb.init("/test_parallel_flush_db", cfg);
+		if (!initStatus.ok()) {
+			ESP_LOGE(DB_TESTER_TAG, "parallelCollectionFlushTest re-init failed");
+			return;
+		}
+		for (int c = 0; c < kCollections; ++c) {
+			const std::string name = "flush_" + std::to_string(c);
+			auto docs = flushDb.findMany(name, [](const DocView &) { return true; });
+			if (!docs.status.ok() || docs.value.size() != kDocsPerCollection) {
+				ESP_LOGE(
+				    DB_TESTER_TAG,
+				    "parallelCollectionFlushTest %s lost documents with %u workers",
+				    name.c_str(),
+				    static_cast<unsigned>(workerCounts[run])
+				);
+				flushDb.deinit();
+				return;
+			}
+		}
+		(void)flushDb.dropAll();
+		flushDb.deinit();
+	}
+
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "Parallel flush of %d collections: 1 worker %u ms, 4 workers %u ms",
+	    kCollections,
+	    static_cast<unsigned>(elapsedByWorkers[0]),
+	    static_cast<unsigned>(elapsedByWorkers[1])
+	);
+	ESP_LOGI(DB_TESTER_TAG, "Parallel collection flush test passed");
+}
+
+void DbTester::parallelColdStartTest() {
+	constexpr int kLargeDocs = 150; // spans several preload shards
+	constexpr int kSmallCollections = 3;
+	constexpr int kSmallDocs = 5;
+	const char *dbPath = "/test_cold_start_db";
+	Schema uniqueSchema;
+	uniqueSchema.fields = {{"serial", FieldType::Int32}};
+	uniqueSchema.fields[0].unique = true;
+
+	{
+		ESPJsonDB seedDb;
+		ESPJsonDBConfig cfg;
+		cfg.autosync = false;
+		if (!seedDb.init(dbPath, cfg).ok()) {
+			ESP_LOGE(DB_TESTER_TAG, "parallelColdStartTest seed init failed");
+			return;
+		}
+		(void)seedDb.dropAll();
+		(void)seedDb.registerSchema("cold_large", uniqueSchema);
+		for (int i = 0; i < kLargeDocs; ++i) {
+			JsonDocument doc;
+			doc["serial"] = i;
+			doc["payload"] = "cold-start-payload";
+			if (!seedDb.create("cold_large", doc.as<JsonObjectConst>()).status.ok()) {
+				ESP_LOGE(DB_TESTER_TAG, "parallelColdStartTest seed create failed");
+				seedDb.deinit();
+				return;
+			}
+		}
+		for (int c = 0; c < kSmallCollections; ++c) {
+			for (int i = 0; i < kSmallDocs; ++i) {
+				JsonDocument doc;
+				doc["index"] = i;
+				(void)seedDb.create("cold_small_" + std::to_string(c), doc.as<JsonObjectConst>());
+			}
+		}
+		(void)seedDb.syncNow();
+		seedDb.deinit();
+	}
+
+	const uint8_t workerCounts[] = {1, 4};
+	uint32_t elapsedByWorkers[2] = {0, 0};
+	for (size_t run = 0; run < 2; ++run) {
+		ESPJsonDB coldDb;
+		ESPJsonDBConfig cfg;
+		cfg.autosync = false;
+		cfg.preloadWorkers = workerCounts[run];
+		(void)coldDb.registerSchema("cold_large", uniqueSchema);
+		const uint32_t startMs = millis();
+		auto initStatus = coldDb.init(dbPath, cfg);
+		elapsedByWorkers[run] = millis() - startMs;
+		if (!initStatus.ok()) {
+			ESP_LOGE(DB_TESTER_TAG, "parallelColdStartTest init failed: %s", initStatus.message);
+			return;
+		}
+
+		auto large = coldDb.findMany("cold_large", [](const DocView &) { return true; });
+		bool ok = large.status.ok() && large.value.size() == kLargeDocs;
+		for (int c = 0; ok && c < kSmallCollections; ++c) {
+			auto small = coldDb.findMany(
+			    "cold_small_" + std::to_string(c),
+			    [](const DocView &) { return true; }
+			);
+			ok = small.status.ok() && small.value.size() == kSmallDocs;
+		}
+		// The unique index was built from the preloaded keys.
+		JsonDocument duplicate;
+		duplicate["serial"] = kLargeDocs - 1;
+		auto dupRes = coldDb.create("cold_large", duplicate.as<JsonObjectConst>());
+		ok = ok && dupRes.status.code == DbStatusCode::ValidationFailed;
+		if (run == 1)
+			(void)coldDb.dropAll();
+		coldDb.deinit();
+		if (!ok) {
+			ESP_LOGE(
+			    DB_TESTER_TAG,
+			    "parallelColdStartTest verification failed with %u workers",
+			    static_cast<unsigned>(workerCounts[run])
+			);
+			return;
+		}
+	}
+
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "Cold start of %d documents: 1 worker %u ms, 4 workers %u ms",
+	    kLargeDocs + kSmallCollections * kSmallDocs,
+	    static_cast<unsigned>(elapsedByWorkers[0]),
+	    static_cast<unsigned>(elapsedByWorkers[1])
+	);
+	ESP_LOGI(DB_TESTER_TAG, "Parallel cold start test passed");
+}
+
+void DbTester::residentHeadersTest() {
+	constexpr int kDocs = 8;
+	constexpr size_t kResidentBudget = 2;
+	const char *dbPath = "/test_resident_headers_db";
+	const char *collection = "headers";
+	CollectionConfig colCfg;
+	colCfg.loadPolicy = CollectionLoadPolicy::Lazy;
+	colCfg.maxRecordsInMemory = kResidentBudget;
+	colCfg.residentHeaders = true;
+
+	ESPJsonDB headerDb;
+	ESPJsonDBConfig cfg;
+	cfg.autosync = false;
+	std::vector<std::string> ids;
+	{
+		if (!headerDb.init(dbPath, cfg).ok()) {
+			ESP_LOGE(DB_TESTER_TAG, "residentHeadersTest seed init failed");
+			return;
+		}
+		(void)headerDb.dropAll();
+		for (int i = 0; i < kDocs; ++i) {
+			JsonDocument doc;
+			doc["index"] = i;
+			doc["payload"] = std::string(static_cast<size_t>(16 * (i + 1)), 'h');
+			auto res = headerDb.create(collection, doc.as<JsonObjectConst>());
+			if (!res.status.ok()) {
+				ESP_LOGE(DB_TESTER_TAG, "residentHeadersTest seed create failed");
+				headerDb.deinit();
+				return;
+			}
+			ids.push_back(res.value);
+		}
+		(void)headerDb.syncNow();
+		headerDb.deinit();
+	}
+
+	if (!headerDb.init(dbPath, cfg).ok() ||
+	    !headerDb.configureCollection(collection, colCfg).ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "residentHeadersTest init failed");
+		return;
+	}
+	// Touch an update through the budget so one header must be refreshed
+	// when its record is evicted.
+	auto updateStatus =
+	    headerDb.updateById(collection, ids[0], [](DocView &v) { v["index"] = 100; });
+	(void)headerDb.syncNow();
+	for (int i = 1; i <= static_cast<int>(kResidentBudget); ++i) {
+		(void)headerDb.findById(collection, ids[i]);
+	}
+
+	auto colRes = headerDb.collection(collection);
+	auto headers = headerDb.findHeaders(collection, [](const DocumentHeader &) { return true; });
+	bool ok = updateStatus.ok() && colRes.status.ok() && headers.status.ok() &&
+	          headers.value.size() == kDocs && colRes.value->size() <= kResidentBudget;
+	uint32_t smallest = UINT32_MAX;
+	for (const auto &h : headers.value) {
+		ok = ok && h.createdAtMs != 0 && h.payloadSize != 0;
+		if (h.id == ids[0])
+			ok = ok && h.revision == 2 && h.updatedAtMs >= h.createdAtMs;
+		else
+			ok = ok && h.revision == 1;
+		if (h.payloadSize < smallest)
+			smallest = h.payloadSize;
+	}
+	// Filter on metadata alone.
+	auto larger = headerDb.findHeaders(collection, [smallest](const DocumentHeader &h) {
+		return h.payloadSize > smallest;
+	});
+	ok = ok && larger.status.ok() && larger.value.size() == kDocs - 1 &&
+	     colRes.value->size() <= kResidentBudget;
+
+	(void)headerDb.dropAll();
+	headerDb.deinit();
+	if (!ok) {
+		ESP_LOGE(DB_TESTER_TAG, "residentHeadersTest verification failed");
+		return;
+	}
+	ESP_LOGI(DB_TESTER_TAG, "Resident headers test passed");
+}
+
+void DbTester::payloadCompressionTest() {
+	constexpr int kDocs = 40;
+	const char *dbPath = "/test_codec_db";
+	const char *names[] = {"telemetry_plain", "telemetry_lz4"};
+	const PayloadCodec codecs[] = {PayloadCodec::None, PayloadCodec::Lz4};
+	ESPJsonDBConfig cfg;
+	cfg.autosync = false;
+
+	auto configure = [&](ESPJsonDB &target) {
+		for (size_t c = 0; c < 2; ++c) {
+			CollectionConfig colCfg;
+			colCfg.payloadCodec = codecs[c];
+			if (!target.configureCollection(names[c], colCfg).ok())
+				return false;
+		}
+		return true;
+	};
+
+	{
+		ESPJsonDB seedDb;
+		if (!seedDb.init(dbPath, cfg).ok() || !seedDb.dropAll().ok() || !configure(seedDb)) {
+			ESP_LOGE(DB_TESTER_TAG, "payloadCompressionTest seed init failed");
+			seedDb.deinit();
+			return;
+		}
+		// Twelve-field sensor readings: repeated keys and similar values.
+		for (int i = 0; i < kDocs; ++i) {
+			JsonDocument doc;
+			doc["deviceId"] = "sensor-node-01";
+			doc["sequence"] = i;
+			doc["temperature"] = 21.5 + (i % 5) * 0.1;
+			doc["humidity"] = 40 + (i % 7);
+			doc["pressure"] = 1013.25;
+			doc["battery"] = 3.7;
+			doc["rssi"] = -60 - (i % 4);
+			doc["firmware"] = "2.4.1";
+			doc["status"] = "ok";
+			doc["location"] = "greenhouse-north";
+			doc["unit"] = "metric";
+			doc["uptimeSeconds"] = 3600 + i;
+			for (size_t c = 0; c < 2; ++c) {
+				if (!seedDb.create(names[c], doc.as<JsonObjectConst>()).status.ok()) {
+					ESP_LOGE(DB_TESTER_TAG, "payloadCompressionTest seed create failed");
+					seedDb.deinit();
+					return;
+				}
+			}
+		}
+		(void)seedDb.syncNow();
+		seedDb.deinit();
+	}
+
+	size_t flashBytes[2] = {0, 0};
+	uint32_t readUs[2] = {0, 0};
+	bool ok = true;
+	for (size_t c = 0; c < 2; ++c)
+		flashBytes[c] = directoryBytes(std::string(dbPath) + "/" + names[c]);
+	{
+		ESPJsonDB readDb;
+		ok = readDb.init(dbPath, cfg).ok() && configure(readDb);
+		for (size_t c = 0; ok && c < 2; ++c) {
+			// Each pass loads and decodes every record of one collection.
+			const uint32_t startUs = micros();
+			auto docs = readDb.findMany(names[c], [](const DocView &) { return true; });
+			int seen = 0;
+			for (auto &view : docs.value) {
+				seen += view["location"].as<std::string>() == "greenhouse-north" ? 1 : 0;
+			}
+			readUs[c] = micros() - startUs;
+			ok = docs.status.ok() && seen == kDocs;
+		}
+		(void)readDb.dropAll();
+		readDb.deinit();
+	}
+	if (!ok || flashBytes[1] == 0 || flashBytes[1] >= flashBytes[0]) {
+		ESP_LOGE(DB_TESTER_TAG, "payloadCompressionTest verification failed");
+		return;
+	}
+
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "%d records on flash: plain %u bytes (%u us read), lz4 %u bytes (%u us read)",
+	    kDocs,
+	    static_cast<unsigned>(flashBytes[0]),
+	    static_cast<unsigned>(readUs[0]),
+	    static_cast<unsigned>(flashBytes[1]),
+	    static_cast<unsigned>(readUs[1])
+	);
+	ESP_LOGI(DB_TESTER_TAG, "Payload compression test passed");
+}
+
+void DbTester::keyInterningTest() {
+	constexpr int kDocs = 40;
+	const char *dbPath = "/test_keys_db";
+	const char *names[] = {"readings_plain", "readings_interned"};
+	ESPJsonDBConfig cfg;
+	cfg.autosync = false;
+
+	{
+		ESPJsonDB seedDb;
+		CollectionConfig internCfg;
+		internCfg.internKeys = true;
+		if (!seedDb.init(dbPath, cfg).ok() || !seedDb.dropAll().ok() ||
+		    !seedDb.configureCollection(names[1], internCfg).ok()) {
+			ESP_LOGE(DB_TESTER_TAG, "keyInterningTest seed init failed");
+			seedDb.deinit();
+			return;
+		}
+		for (int i = 0; i < kDocs; ++i) {
+			JsonDocument doc;
+			doc["deviceId"] = i;
+			doc["temperature"] = 21.5;
+			doc["humidity"] = 40 + (i % 7);
+			doc["pressure"] = 1013;
+			doc["batteryVoltage"] = 3.7;
+			doc["signalStrength"] = -60;
+			doc["firmwareVersion"] = 241;
+			doc["sampleInterval"] = 30;
+			doc["lastCalibration"] = 1700000000;
+			doc["errorCount"] = 0;
+			doc["uptimeSeconds"] = 3600 + i;
+			doc["config"]["reportingMode"] = "periodic";
+			for (size_t c = 0; c < 2; ++c) {
+				if (!seedDb.create(names[c], doc.as<JsonObjectConst>()).status.ok()) {
+					ESP_LOGE(DB_TESTER_TAG, "keyInterningTest seed create failed");
+					seedDb.deinit();
+					return;
+				}
+			}
+		}
+		(void)seedDb.syncNow();
+		seedDb.deinit();
+	}
+
+	const std::string dictPath = std::string(dbPath) + "/" + names[1] + "/_keys.dict";
+	File dict = LittleFS.open(dictPath.c_str(), FILE_READ);
+	const size_t dictBytes = dict ? dict.size() : 0;
+	if (dict)
+		dict.close();
+	const size_t plainBytes = directoryBytes(std::string(dbPath) + "/" + names[0]);
+	const size_t internedBytes =
+	    directoryBytes(std::string(dbPath) + "/" + names[1]) - dictBytes;
+
+	// Interned records read back through a handle that never enabled the option.
+	bool ok = dictBytes > 0 && internedBytes < plainBytes;
+	{
+		ESPJsonDB readDb;
+		ok = ok && readDb.init(dbPath, cfg).ok();
+		auto docs = readDb.findMany(names[1], [](const DocView &) { return true; });
+		int seen = 0;
+		for (auto &view : docs.value) {
+			seen += view["config"]["reportingMode"].as<std::string>() == "periodic" &&
+			                view["uptimeSeconds"].as<int>() >= 3600
+			            ? 1
+			            : 0;
+		}
+		ok = ok && docs.status.ok() && seen == kDocs;
+		(void)readDb.dropAll();
+		readDb.deinit();
+	}
+	if (!ok) {
+		ESP_LOGE(DB_TESTER_TAG, "keyInterningTest verification failed");
+		return;
+	}
+
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "%d records on flash: plain %u bytes, interned %u bytes plus %u dictionary bytes",
+	    kDocs,
+	    static_cast<unsigned>(plainBytes),
+	    static_cast<unsigned>(internedBytes),
+	    static_cast<unsigned>(dictBytes)
+	);
+	ESP_LOGI(DB_TESTER_TAG, "Key interning test passed");
+}
+
+void DbTester::slabPoolChurnTest() {
+#if !ESP_JSONDB_SLAB_POOLS
+	ESP_LOGI(DB_TESTER_TAG, "Slab pool churn test skipped (ESP_JSONDB_SLAB_POOLS=0)");
+	return;
+#else
+	constexpr int kRounds = 6;
+	constexpr int kDocs = 64;
+	ESPJsonDBConfig cfg;
+	cfg.autosync = false;
+	ESPJsonDB churnDb;
+	if (!churnDb.init("/test_slab_db", cfg).ok() || !churnDb.dropAll().ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "slabPoolChurnTest init failed");
+		churnDb.deinit();
+		return;
+	}
+
+	auto poolTotals = [&](uint32_t &slabs, uint32_t &inUse) {
+		slabs = 0;
+		inUse = 0;
+		JsonDocument diag = churnDb.getDiagnostics();
+		for (JsonObjectConst pool : diag["allocatorPools"]["internal"].as<JsonArrayConst>()) {
+			slabs += pool["slabs"].as<uint32_t>();
+			inUse += pool["inUse"].as<uint32_t>();
+		}
+	};
+
+	// Create and remove the same number of documents each round. Later rounds
+	// must not need more slabs than the first (one partly used slab per class
+	// is allowed for), and removing the documents must hand slabs back.
+	uint32_t peakSlabs = 0;
+	uint32_t slabs = 0;
+	uint32_t inUse = 0;
+	bool ok = true;
+	bool released = true;
+	for (int round = 0; ok && round < kRounds; ++round) {
+		std::vector<std::string> ids;
+		for (int i = 0; ok && i < kDocs; ++i) {
+			JsonDocument doc;
+			doc["round"] = round;
+			doc["slot"] = i;
+			doc["label"] = "churn";
+			auto created = churnDb.create("churn", doc);
+			ok = created.status.ok();
+			ids.push_back(created.value);
+		}
+		poolTotals(slabs, inUse);
+		const uint32_t loaded = slabs;
+		if (round == 0)
+			peakSlabs = loaded;
+		else
+			ok = ok && loaded <= peakSlabs + SlabPools::kClassCount;
+		for (const auto &id : ids)
+			ok = ok && churnDb.removeById("churn", id).ok();
+		ok = ok && churnDb.syncNow().ok();
+		poolTotals(slabs, inUse);
+		released = released && slabs < loaded;
+	}
+	churnDb.deinit();
+	if (!ok || peakSlabs == 0 || !released) {
+		ESP_LOGE(DB_TESTER_TAG, "slabPoolChurnTest verification failed");
+		return;
+	}
+
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "%d rounds of %d documents: %u slabs at the first peak, %u after the last, %u blocks in use",
+	    kRounds,
+	    kDocs,
+	    static_cast<unsigned>(peakSlabs),
+	    static_cast<unsigned>(slabs),
+	    static_cast<unsigned>(inUse)
+	);
+	ESP_LOGI(DB_TESTER_TAG, "Slab pool churn test passed");
+#endif
+}
+
+void DbTester::operationStatsTest() {
+	constexpr int kDocs = 24;
+	ESPJsonDBConfig cfg;
+	cfg.autosync = false;
+	ESPJsonDB statsDb;
+	if (!statsDb.init("/test_opstats_db", cfg).ok() || !statsDb.dropAll().ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "operationStatsTest init failed");
+		statsDb.deinit();
+		return;
+	}
+	// Operation counters are process-wide, so compare against a baseline.
+	JsonDocument before = statsDb.getDiagnostics();
+	if (before["operations"].isNull()) {
+		statsDb.deinit();
+		ESP_LOGI(DB_TESTER_TAG, "Operation stats test skipped (ESP_JSONDB_OP_STATS=0)");
+		return;
+	}
+
+	bool ok = true;
+	std::vector<std::string> ids;
+	for (int i = 0; ok && i < kDocs; ++i) {
+		JsonDocument doc;
+		doc["slot"] = i;
+		doc["label"] = "timed";
+		auto created = statsDb.create("timed", doc);
+		ok = created.status.ok();
+		ids.push_back(created.value);
+	}
+	for (const auto &id : ids)
+		ok = ok && statsDb.findById("timed", id).status.ok();
+	ok = ok && statsDb.syncNow().ok();
+
+	JsonDocument after = statsDb.getDiagnostics();
+	auto delta = [&](const char *op) {
+		return after["operations"][op]["count"].as<uint32_t>() -
+		       before["operations"][op]["count"].as<uint32_t>();
+	};
+	JsonObjectConst findById = after["operations"]["findById"];
+	JsonObjectConst timed = after["collectionOperations"]["timed"];
+	ok = ok && delta("findById") >= kDocs && delta("create") >= kDocs &&
+	     delta("recordWrite") >= kDocs && delta("flush") >= 1 &&
+	     findById["p50Us"].as<uint32_t>() <= findById["p99Us"].as<uint32_t>() &&
+	     findById["p99Us"].as<uint32_t>() <= findById["maxUs"].as<uint32_t>() &&
+	     timed["create"]["count"].as<uint32_t>() == kDocs &&
+	     timed["findById"]["count"].as<uint32_t>() == kDocs &&
+	     timed["create"]["bytes"].as<uint32_t>() > 0 && timed["flush"]["bytes"].as<uint32_t>() > 0;
+	(void)statsDb.dropAll();
+	statsDb.deinit();
+	if (!ok) {
+		ESP_LOGE(DB_TESTER_TAG, "operationStatsTest verification failed");
+		return;
+	}
+
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "findById over %d records: p50 %u us, p99 %u us, max %u us",
+	    kDocs,
+	    findById["p50Us"].as<unsigned>(),
+	    findById["p99Us"].as<unsigned>(),
+	    findById["maxUs"].as<unsigned>()
+	);
+	ESP_LOGI(DB_TESTER_TAG, "Operation stats test passed");
+}
+
+void DbTester::concurrentCollectionReadersTest() {
+	constexpr int kDocs = 16;
+	constexpr int kRounds = 40;
+	std::vector<std::string> ids;
+	for (int i = 0; i < kDocs; ++i) {
+		JsonDocument doc;
+		doc["slot"] = i;
+		auto created = db.create("concurrent_reads", doc.as<JsonObjectConst>());
+		if (!created.status.ok()) {
+			ESP_LOGE(DB_TESTER_TAG, "concurrentCollectionReadersTest seed create failed");
+			return;
+		}
+		ids.push_back(created.value);
+	}
+
+	// Single reader baseline
+	uint32_t started = millis();
+	uint32_t failures = readAllIds(db, ids, kRounds);
+	const uint32_t singleMs = millis() - started;
+
+	// Two readers on both cores, with a writer interleaved on this task
+	ConcurrentReaderCtx ctx;
+	ctx.db = &db;
+	ctx.ids = &ids;
+	ctx.rounds = kRounds;
+	if (xTaskCreatePinnedToCore(concurrentReaderTask, "dbReader", 6144, &ctx, 1, nullptr, 0) !=
+	    pdPASS) {
+		ESP_LOGE(DB_TESTER_TAG, "concurrentCollectionReadersTest reader task create failed");
+		return;
+	}
+	started = millis();
+	failures += readAllIds(db, ids, kRounds);
+	auto updated = db.updateById("concurrent_reads", ids.front(), [](DocView &doc) {
+		doc["slot"] = 100;
+	});
+	const uint32_t waitStarted = millis();
+	while (!ctx.done.load() && (millis() - waitStarted) < 10000) {
+		delay(5);
+	}
+	const uint32_t dualMs = millis() - started;
+
+	if (!ctx.done.load()) {
+		ESP_LOGE(DB_TESTER_TAG, "concurrentCollectionReadersTest reader task timed out");
+		return;
+	}
+	if (failures != 0 || ctx.failures.load() != 0 || !updated.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "concurrentCollectionReadersTest lookups failed (main %u, reader %u)",
+		    static_cast<unsigned>(failures),
+		    static_cast<unsigned>(ctx.failures.load())
+		);
+		return;
+	}
+
+	(void)db.dropCollection("concurrent_reads");
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "Concurrent findById: 1 reader %u ms, 2 readers %u ms for %d lookups each",
+	    static_cast<unsigned>(singleMs),
+	    static_cast<unsigned>(dualMs),
+	    kDocs * kRounds
+	);
+	ESP_LOGI(DB_TESTER_TAG, "Concurrent collection readers test passed");
+}
+
+void DbTester::lockContentionBenchmarkTest() {
+	constexpr int kDocs = 16;
+	constexpr int kRounds = 30;
+	constexpr size_t kTasks = 3; // two readers, one writer
+	std::vector<std::string> ids;
+	for (int i = 0; i < kDocs; ++i) {
+		JsonDocument doc;
+		doc["slot"] = i;
+		doc["round"] = -1;
+		auto created = db.create("lock_bench", doc.as<JsonObjectConst>());
+		if (!created.status.ok()) {
+			ESP_LOGE(DB_TESTER_TAG, "lockContentionBenchmarkTest seed create failed");
+			return;
+		}
+		ids.push_back(created.value);
+	}
+	// Lock counters are process-wide, so compare against a baseline.
+	JsonDocument before = db.getDiagnostics();
+
+	LockBenchCtx ctx[kTasks];
+	const uint32_t started = millis();
+	for (size_t i = 0; i < kTasks; ++i) {
+		ctx[i].db = &db;
+		ctx[i].ids = &ids;
+		ctx[i].rounds = kRounds;
+		ctx[i].writer = i == kTasks - 1;
+		if (xTaskCreatePinnedToCore(
+		        lockBenchTask,
+		        ctx[i].writer ? "dbBenchW" : "dbBenchR",
+		        6144,
+		        &ctx[i],
+		        1,
+		        nullptr,
+		        static_cast<BaseType_t>(i % 2)
+		    ) != pdPASS) {
+			ESP_LOGE(DB_TESTER_TAG, "lockContentionBenchmarkTest task create failed");
+			ctx[i].done.store(true);
+		}
+	}
+	bool finished = false;
+	while (!finished && (millis() - started) < 20000) {
+		delay(5);
+		finished = true;
+		for (const auto &task : ctx)
+			finished = finished && task.done.load();
+	}
+	const uint32_t elapsedMs = millis() - started;
+	if (!finished) {
+		ESP_LOGE(DB_TESTER_TAG, "lockContentionBenchmarkTest tasks timed out");
+		return;
+	}
+	uint32_t failures = 0;
+	for (const auto &task : ctx)
+		failures += task.failures.load();
+
+	JsonDocument after = db.getDiagnostics();
+	(void)db.dropCollection("lock_bench");
+	if (failures != 0) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "lockContentionBenchmarkTest %u operations failed",
+		    static_cast<unsigned>(failures)
+		);
+		return;
+	}
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "Lock benchmark: 2 readers + 1 writer, %d operations each in %u ms",
+	    kDocs * kRounds,
+	    static_cast<unsigned>(elapsedMs)
+	);
+	if (after["locks"].isNull()) {
+		ESP_LOGI(DB_TESTER_TAG, "Lock contention report skipped (ESP_JSONDB_LOCK_STATS=0)");
+		return;
+	}
+
+	// The collection lock takes every lookup and update, so it must be counted
+	// and, with three tasks hammering it, is expected among the top entries.
+	auto acquisitionsOf = [](JsonDocument &diag, const char *name, const char *mode) -> uint32_t {
+		for (JsonObjectConst entry : diag["locks"].as<JsonArrayConst>()) {
+			if (entry["name"] != name)
+				continue;
+			return mode ? entry[mode]["acquisitions"].as<uint32_t>()
+			            : entry["acquisitions"].as<uint32_t>();
+		}
+		return 0;
+	};
+	const uint32_t shared = acquisitionsOf(after, "collection:lock_bench", "shared") -
+	                        acquisitionsOf(before, "collection:lock_bench", "shared");
+	const uint32_t exclusive = acquisitionsOf(after, "collection:lock_bench", nullptr) -
+	                           acquisitionsOf(before, "collection:lock_bench", nullptr);
+	JsonArrayConst locks = after["locks"];
+	if (locks.size() == 0 || locks.size() > 8 || shared < 2u * kDocs * kRounds ||
+	    exclusive < static_cast<uint32_t>(kDocs * kRounds)) {
+		ESP_LOGE(DB_TESTER_TAG, "lockContentionBenchmarkTest lock report is incomplete");
+		return;
+	}
+	for (JsonObjectConst entry : locks) {
+		ESP_LOGI(
+		    DB_TESTER_TAG,
+		    "  %s: %u acquisitions, %u contended, wait avg %u / max %u us, hold avg %u us",
+		    entry["name"].as<const char *>(),
+		    entry["acquisitions"].as<unsigned>() + entry["shared"]["acquisitions"].as<unsigned>(),
+		    entry["contended"].as<unsigned>() + entry["shared"]["contended"].as<unsigned>(),
+		    entry["avgWaitUs"].as<unsigned>(),
+		    entry["maxWaitUs"].as<unsigned>(),
+		    entry["avgHoldUs"].as<unsigned>()
+		);
+	}
+	ESP_LOGI(DB_TESTER_TAG, "Lock contention benchmark test passed");
+}
+
+void DbTester::readSnapshotIsolationTest() {
+	std::vector<std::string> ids;
+	for (int i = 0; i < 4; ++i) {
+		JsonDocument doc;
+		doc["slot"] = i;
+		doc["state"] = "before";
+		auto created = db.create("snapshot_reads", doc.as<JsonObjectConst>());
+		if (!created.status.ok()) {
+			ESP_LOGE(DB_TESTER_TAG, "readSnapshotIsolationTest seed create failed");
+			return;
+		}
+		ids.push_back(created.value);
+	}
+
+	auto snap = db.beginRead();
+	if (!snap.valid()) {
+		ESP_LOGE(DB_TESTER_TAG, "readSnapshotIsolationTest beginRead failed");
+		return;
+	}
+
+	// Writers keep going while the snapshot is open
+	auto updated = db.updateMany("snapshot_reads", [](DocView &doc) { doc["state"] = "after"; });
+	auto removed = db.removeById("snapshot_reads", ids.back());
+	JsonDocument extra;
+	extra["slot"] = 99;
+	auto added = db.create("snapshot_reads", extra.as<JsonObjectConst>());
+	auto viewCommit = db.findById("snapshot_reads", ids.front());
+	if (viewCommit.status.ok()) {
+		viewCommit.value["slot"] = 42;
+		(void)viewCommit.value.commit();
+	}
+	if (!updated.status.ok() || updated.value != ids.size() || !removed.ok() ||
+	    !added.status.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "readSnapshotIsolationTest writes failed");
+		return;
+	}
+
+	auto seen = snap.findMany("snapshot_reads", nullptr);
+	bool consistent = seen.status.ok() && seen.value.size() == ids.size();
+	if (consistent) {
+		for (auto &view : seen.value) {
+			if (view["state"].as<std::string>() != "before" || view["slot"].as<int>() == 99 ||
+			    view["slot"].as<int>() == 42) {
+				consistent = false;
+			}
+		}
+	}
+	auto oldRemoved = snap.findById("snapshot_reads", ids.back());
+	auto hiddenAdded = snap.findById("snapshot_reads", added.value);
+	auto live = db.findById("snapshot_reads", ids.front());
+	if (!consistent || !oldRemoved.status.ok() ||
+	    hiddenAdded.status.code != DbStatusCode::NotFound || !live.status.ok() ||
+	    live.value["state"].as<std::string>() != "after" || live.value["slot"].as<int>() != 42) {
+		ESP_LOGE(DB_TESTER_TAG, "readSnapshotIsolationTest snapshot was not isolated");
+		return;
+	}
+
+	// Snapshot views are read-only
+	oldRemoved.value["state"] = "mutated";
+	if (oldRemoved.value.commit().ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "readSnapshotIsolationTest snapshot view accepted a commit");
+		return;
+	}
+
+	auto diagOpen = db.getDiagnostics();
+	const uint32_t retained = diagOpen["readSnapshots"]["retainedVersions"] | 0u;
+	snap.end();
+	auto diagClosed = db.getDiagnostics();
+	if (retained == 0 || (diagClosed["readSnapshots"]["retainedVersions"] | 0u) != 0 ||
+	    (diagClosed["readSnapshots"]["open"] | 0u) != 0) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "readSnapshotIsolationTest retained versions not released (%u while open)",
+		    static_cast<unsigned>(retained)
+		);
+		return;
+	}
+
+	(void)db.dropCollection("snapshot_reads");
+	ESP_LOGI(DB_TESTER_TAG, "Read snapshot isolation test passed");
+}
+
+void DbTester::readSnapshotBatchVisibilityTest() {
+	constexpr int kDocs = 6;
+	for (int i = 0; i < kDocs; ++i) {
+		JsonDocument doc;
+		doc["slot"] = i;
+		doc["state"] = "before";
+		if (!db.create("snapshot_batch", doc.as<JsonObjectConst>()).status.ok()) {
+			ESP_LOGE(DB_TESTER_TAG, "readSnapshotBatchVisibilityTest seed create failed");
+			return;
+		}
+	}
+
+	BatchSnapshotCtx ctx;
+	ctx.db = &db;
+	if (xTaskCreate(batchSnapshotReaderTask, "dbSnapReader", 6144, &ctx, 1, nullptr) != pdPASS) {
+		ESP_LOGE(DB_TESTER_TAG, "readSnapshotBatchVisibilityTest reader task create failed");
+		return;
+	}
+
+	// Open the snapshot on the reader task halfway through the updateMany
+	int mutated = 0;
+	auto updated = db.updateMany("snapshot_batch", [&](DocView &doc) {
+		doc["state"] = "after";
+		if (++mutated == kDocs / 2) {
+			ctx.go.store(true);
+			delay(30);
+		}
+	});
+	const uint32_t waitStarted = millis();
+	while (!ctx.done.load() && (millis() - waitStarted) < 5000) {
+		delay(5);
+	}
+
+	if (!ctx.done.load()) {
+		ESP_LOGE(DB_TESTER_TAG, "readSnapshotBatchVisibilityTest reader task timed out");
+		return;
+	}
+	if (!updated.status.ok() || updated.value != static_cast<size_t>(kDocs) || !ctx.ok ||
+	    ctx.before + ctx.after != kDocs || (ctx.before != 0 && ctx.after != 0)) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "readSnapshotBatchVisibilityTest snapshot saw a partial updateMany (%d before, %d "
+		    "after)",
+		    ctx.before,
+		    ctx.after
+		);
+		return;
+	}
+
+	(void)db.dropCollection("snapshot_batch");
+	ESP_LOGI(DB_TESTER_TAG, "Read snapshot batch visibility test passed");
+}
@@ -36,20 +36,44 @@ void DbTester::run() {
 	snapshotRestoreIdLifecycleTest();
 	snapshotStreamRoundTripTest();
 	snapshotStreamInvalidJsonTest();
+	snapshotStreamSlowSourceTest();
+	snapshotStreamRestoreProgressTest();
+	incrementalSnapshotTest();
+	tombstoneLogTornAppendTest();
+	snapshotBinaryRoundTripTest();
+	snapshotReadAheadTest();
+	snapshotChunkedExportTest();
 	docCodecCompatibilityTest();
+	crc32BenchmarkTest();
+	docArenaTest();
 	optimisticConflictTest();
 	collectionBudgetEnforcementTest();
+	collectionDurabilityModesTest();
+	parallelCollectionFlushTest();
+	parallelColdStartTest();
+	residentHeadersTest();
+	payloadCompressionTest();
+	keyInterningTest();
+	keyDictionarySharedFileTest();
+	slabPoolChurnTest();
+	operationStatsTest();
+	concurrentCollectionReadersTest();
+	lockContentionBenchmarkTest();
+	readSnapshotIsolationTest();
+	readSnapshotBatchVisibilityTest();
 	documentFileDeletionOnSyncTest();
 	fileStorageTest();
 	fileMetadataDiscoveryTest();
 	asyncFileUploadTest();
 	asyncFileUploadRetentionBoundTest();
 	asyncFileUploadQueueOrderTest();
+	fileStreamWriteLockIsolationTest();
 #if __has_include(<ESPCompressor.h>)
 	compressedSnapshotRoundTripTest();
 	compressedSnapshotFileRoundTripTest();
 	compressedSnapshotDbFilesRoundTripTest();
 	compressedSnapshotCorruptionTest();
+	compressedSnapshotStreamingTest();
 #endif
 	printDBDiag();
 	// Collection tests
@@ -82,8 +106,11 @@ void DbTester::run() {
 	syncStatusLateSubscriptionSnapshotTest();
 	syncStatusManualSyncNowTest();
 	syncStatusPeriodicExclusionTest();
+	syncDeadlineWakeupTest();
+	autosyncHighWaterFlushTest();
 	psramBufferWiringTest();
 	psramMemoryBenchmarkTest();
+	memoryTieringTest();
 	printDBDiag();
 	teardownLifecycle();
 }
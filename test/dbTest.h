@@ -26,20 +26,44 @@ class DbTester {
 	void snapshotRestoreIdLifecycleTest();
 	void snapshotStreamRoundTripTest();
 	void snapshotStreamInvalidJsonTest();
+	void snapshotStreamSlowSourceTest();
+	void snapshotStreamRestoreProgressTest();
+	void incrementalSnapshotTest();
+	void tombstoneLogTornAppendTest();
+	void snapshotBinaryRoundTripTest();
+	void snapshotReadAheadTest();
+	void snapshotChunkedExportTest();
 	void docCodecCompatibilityTest();
+	void crc32BenchmarkTest();
+	void docArenaTest();
 	void optimisticConflictTest();
 	void collectionBudgetEnforcementTest();
+	void collectionDurabilityModesTest();
+	void parallelCollectionFlushTest();
+	void parallelColdStartTest();
+	void residentHeadersTest();
+	void payloadCompressionTest();
+	void keyInterningTest();
+	void keyDictionarySharedFileTest();
+	void slabPoolChurnTest();
+	void operationStatsTest();
+	void concurrentCollectionReadersTest();
+	void lockContentionBenchmarkTest();
+	void readSnapshotIsolationTest();
+	void readSnapshotBatchVisibilityTest();
 	void documentFileDeletionOnSyncTest();
 	void fileStorageTest();
 	void fileMetadataDiscoveryTest();
 	void asyncFileUploadTest();
 	void asyncFileUploadRetentionBoundTest();
 	void asyncFileUploadQueueOrderTest();
+	void fileStreamWriteLockIsolationTest();
 #if __has_include(<ESPCompressor.h>)
 	void compressedSnapshotRoundTripTest();
 	void compressedSnapshotFileRoundTripTest();
 	void compressedSnapshotDbFilesRoundTripTest();
 	void compressedSnapshotCorruptionTest();
+	void compressedSnapshotStreamingTest();
 #endif
 	// Collection tests
 	void simpleCollectionCreate();
@@ -70,8 +94,11 @@ class DbTester {
 	void syncStatusLateSubscriptionSnapshotTest();
 	void syncStatusManualSyncNowTest();
 	void syncStatusPeriodicExclusionTest();
+	void syncDeadlineWakeupTest();
+	void autosyncHighWaterFlushTest();
 	void psramBufferWiringTest();
 	void psramMemoryBenchmarkTest();
+	void memoryTieringTest();
 	// Utils
 	void printDBDiag();
 	void teardownLifecycle();
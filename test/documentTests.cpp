@@ -1,4 +1,6 @@
 #include "../src/esp_jsondb/storage/doc_codec.h"
+#include "../src/esp_jsondb/storage/key_dictionary.h"
+#include "../src/esp_jsondb/storage/tombstone_log.h"
 #include "../src/esp_jsondb/utils/objectId.h"
 #include "dbTest.h"
 
@@ -71,6 +73,52 @@ encodeLegacyRecord(const RecordHeader &header, const JsonDbVector<uint8_t> &payl
 	appendU32(encoded, payloadCrc);
 	return encoded;
 }
+// Collects everything written to it.
+class CaptureStream : public Stream {
+  public:
+	using Print::write;
+	size_t write(uint8_t byte) override {
+		return write(&byte, 1);
+	}
+	size_t write(const uint8_t *data, size_t size) override {
+		bytes.append(reinterpret_cast<const char *>(data), size);
+		return size;
+	}
+	int available() override {
+		return 0;
+	}
+	int read() override {
+		return -1;
+	}
+	int peek() override {
+		return -1;
+	}
+
+	std::string bytes;
+};
+
+// Replays `bytes` like a network client whose data is still in flight:
+// peek() and available() report nothing, only read() delivers.
+class TrickleStream : public Stream {
+  public:
+	explicit TrickleStream(std::string data) : bytes(std::move(data)) {
+	}
+	size_t write(uint8_t) override {
+		return 0;
+	}
+	int available() override {
+		return 0;
+	}
+	int read() override {
+		return pos < bytes.size() ? static_cast<uint8_t>(bytes[pos++]) : -1;
+	}
+	int peek() override {
+		return -1;
+	}
+
+	std::string bytes;
+	size_t pos = 0;
+};
 } // namespace
 
 void DbTester::simpleDocCreate() {
@@ -506,6 +554,572 @@ void DbTester::snapshotStreamInvalidJsonTest() {
 	ESP_LOGI(DB_TESTER_TAG, "Snapshot stream invalid JSON test passed");
 }
 
+void DbTester::snapshotStreamSlowSourceTest() {
+	auto dropStatus = db.dropAll();
+	if (!dropStatus.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "snapshotStreamSlowSourceTest dropAll failed: %s",
+		    dropStatus.message
+		);
+		return;
+	}
+	JsonDocument seed;
+	seed["value"] = 7;
+	auto createRes = db.create("slow_source", seed.as<JsonObjectConst>());
+	if (!createRes.status.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotStreamSlowSourceTest create failed");
+		return;
+	}
+
+	CaptureStream out;
+	auto writeStatus = db.writeSnapshot(out, SnapshotMode::InMemoryConsistent);
+	if (!writeStatus.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotStreamSlowSourceTest writeSnapshot failed");
+		return;
+	}
+
+	// A source that ends before the first collection key leaves the DB alone
+	TrickleStream truncated("{\"collections\":{");
+	auto truncatedStatus = db.restoreFromSnapshot(truncated);
+	auto kept = db.findById("slow_source", createRes.value);
+	if (truncatedStatus.ok() || !kept.status.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotStreamSlowSourceTest truncated source dropped data");
+		return;
+	}
+
+	TrickleStream in(out.bytes);
+	auto restoreStatus = db.restoreFromSnapshot(in);
+	if (!restoreStatus.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "snapshotStreamSlowSourceTest restoreFromSnapshot failed: %s",
+		    restoreStatus.message
+		);
+		return;
+	}
+	auto restored = db.findById("slow_source", createRes.value);
+	if (!restored.status.ok() || restored.value["value"].as<int>() != 7) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotStreamSlowSourceTest restore verification failed");
+		return;
+	}
+
+	// The format byte of a binary snapshot is waited for as well
+	CaptureStream binaryOut;
+	writeStatus =
+	    db.writeSnapshot(binaryOut, SnapshotMode::InMemoryConsistent, SnapshotFormat::Binary);
+	TrickleStream binaryIn(binaryOut.bytes);
+	restoreStatus = writeStatus.ok() ? db.restoreFromSnapshot(binaryIn) : writeStatus;
+	restored = db.findById("slow_source", createRes.value);
+	if (!restoreStatus.ok() || !restored.status.ok() || restored.value["value"].as<int>() != 7) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "snapshotStreamSlowSourceTest binary restore failed: %s",
+		    restoreStatus.message
+		);
+		return;
+	}
+
+	(void)db.dropCollection("slow_source");
+	ESP_LOGI(DB_TESTER_TAG, "Snapshot stream slow source test passed");
+}
+
+void DbTester::snapshotStreamRestoreProgressTest() {
+	const char *snapshotPath = "/snapshot_progress.json";
+	(void)LittleFS.remove(snapshotPath);
+	File out = LittleFS.open(snapshotPath, FILE_WRITE);
+	if (!out) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotStreamRestoreProgressTest open write file failed");
+		return;
+	}
+	// Unknown top-level members and non-array collections are skipped.
+	out.print("{\"exportedBy\":{\"tool\":\"test\",\"tags\":[1,2]},\"collections\":{");
+	out.print("\"progress_a\":[");
+	out.print("{\"_id\":\"65f0a1b2c3d4e5f601234567\",\"n\":1,\"s\":\"a,]}\\\"\"},");
+	out.print("{\"_id\":\"65f0a1b2c3d4e5f601234568\",\"n\":2,\"_meta\":{\"revision\":4}},");
+	out.print("42,");
+	out.print("{\"_id\":\"65f0a1b2c3d4e5f601234569\",\"n\":3}],");
+	out.print("\"progress_skip\":{\"not\":\"an array\"},");
+	out.print("\"progress_b\":[{\"_id\":\"65f0a1b2c3d4e5f60123456a\",\"n\":4}]");
+	out.print("},\"version\":1}");
+	out.close();
+
+	File in = LittleFS.open(snapshotPath, FILE_READ);
+	if (!in) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotStreamRestoreProgressTest open read file failed");
+		(void)LittleFS.remove(snapshotPath);
+		return;
+	}
+	uint32_t callbacks = 0;
+	SnapshotRestoreProgress last;
+	auto restoreStatus = db.restoreFromSnapshot(in, [&](const SnapshotRestoreProgress &progress) {
+		++callbacks;
+		last = progress;
+	});
+	in.close();
+	(void)LittleFS.remove(snapshotPath);
+	if (!restoreStatus.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "snapshotStreamRestoreProgressTest restoreFromSnapshot failed: %s",
+		    restoreStatus.message
+		);
+		return;
+	}
+	if (callbacks != 4 || last.documentsRestored != 4 || last.collectionsRestored != 2 ||
+	    last.collectionName != "progress_b") {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "snapshotStreamRestoreProgressTest progress mismatch (%u callbacks)",
+		    static_cast<unsigned>(callbacks)
+		);
+		return;
+	}
+
+	auto first = db.findById("progress_a", "65f0a1b2c3d4e5f601234567");
+	auto second = db.findById("progress_a", "65f0a1b2c3d4e5f601234568");
+	auto fourth = db.findById("progress_b", "65f0a1b2c3d4e5f60123456a");
+	if (!first.status.ok() || first.value["s"].as<std::string>() != "a,]}\"" ||
+	    !second.status.ok() || second.value.meta().revision != 4 || !fourth.status.ok() ||
+	    fourth.value["n"].as<int>() != 4) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotStreamRestoreProgressTest restore verification failed");
+		return;
+	}
+	auto names = db.listCollectionNames();
+	if (std::find(names.begin(), names.end(), "progress_skip") != names.end()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "snapshotStreamRestoreProgressTest restored a non-array collection"
+		);
+		return;
+	}
+
+	ESP_LOGI(DB_TESTER_TAG, "Snapshot stream restore progress test passed");
+}
+
+void DbTester::incrementalSnapshotTest() {
+	auto dropStatus = db.dropAll();
+	if (!dropStatus.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "incrementalSnapshotTest dropAll failed: %s", dropStatus.message);
+		return;
+	}
+
+	const std::string collection = "incremental";
+	std::vector<std::string> ids;
+	for (int i = 0; i < 3; ++i) {
+		JsonDocument doc;
+		doc["index"] = i;
+		auto createRes = db.create(collection, doc.as<JsonObjectConst>());
+		if (!createRes.status.ok()) {
+			ESP_LOGE(
+			    DB_TESTER_TAG,
+			    "incrementalSnapshotTest create failed: %s",
+			    createRes.status.message
+			);
+			return;
+		}
+		ids.push_back(createRes.value);
+	}
+	(void)db.syncNow();
+	// Step past the watermark overlap so the untouched document drops out of
+	// the second export.
+	delay(1200);
+
+	const char *basePath = "/snapshot_inc_base.json";
+	const char *deltaPath = "/snapshot_inc_delta.json";
+	(void)LittleFS.remove(basePath);
+	(void)LittleFS.remove(deltaPath);
+	File out = LittleFS.open(basePath, FILE_WRITE);
+	auto base = out ? db.writeIncrementalSnapshot(out, 0)
+	                : DbResult<uint64_t>{{DbStatusCode::IoError, "open failed"}, 0};
+	if (out)
+		out.close();
+	if (!base.status.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "incrementalSnapshotTest base export failed: %s",
+		    base.status.message
+		);
+		(void)LittleFS.remove(basePath);
+		return;
+	}
+
+	(void)db.updateById(collection, ids[1], [](DocView &doc) { doc["index"] = 10; });
+	(void)db.removeById(collection, ids[2]);
+	JsonDocument added;
+	added["index"] = 3;
+	auto addedRes = db.create(collection, added.as<JsonObjectConst>());
+	(void)db.syncNow();
+
+	out = LittleFS.open(deltaPath, FILE_WRITE);
+	auto delta = out ? db.writeIncrementalSnapshot(out, base.value)
+	                 : DbResult<uint64_t>{{DbStatusCode::IoError, "open failed"}, 0};
+	if (out)
+		out.close();
+	if (!addedRes.status.ok() || !delta.status.ok() || delta.value < base.value) {
+		ESP_LOGE(DB_TESTER_TAG, "incrementalSnapshotTest delta export failed");
+		(void)LittleFS.remove(basePath);
+		(void)LittleFS.remove(deltaPath);
+		return;
+	}
+
+	File in = LittleFS.open(deltaPath, FILE_READ);
+	const bool rejected = in && db.restoreFromSnapshot(in).code == DbStatusCode::InvalidArgument;
+	if (in)
+		in.close();
+
+	(void)db.dropAll();
+	in = LittleFS.open(basePath, FILE_READ);
+	auto baseStatus = in ? db.applyIncremental(in)
+	                     : DbStatus{DbStatusCode::IoError, "open read file failed"};
+	if (in)
+		in.close();
+	uint32_t deltaEntries = 0;
+	auto onProgress = [&](const SnapshotRestoreProgress &progress) {
+		deltaEntries = progress.documentsRestored;
+	};
+	in = LittleFS.open(deltaPath, FILE_READ);
+	auto deltaStatus = in ? db.applyIncremental(in, onProgress)
+	                      : DbStatus{DbStatusCode::IoError, "open read file failed"};
+	if (in)
+		in.close();
+	(void)LittleFS.remove(basePath);
+	(void)LittleFS.remove(deltaPath);
+	if (!rejected || !baseStatus.ok() || !deltaStatus.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "incrementalSnapshotTest apply failed");
+		return;
+	}
+	// Updated, created and one tombstone; the untouched document is not resent.
+	if (deltaEntries != 3) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "incrementalSnapshotTest expected 3 delta entries, got %u",
+		    static_cast<unsigned>(deltaEntries)
+		);
+		return;
+	}
+
+	auto kept = db.findById(collection, ids[0]);
+	auto updated = db.findById(collection, ids[1]);
+	auto removed = db.findById(collection, ids[2]);
+	auto created = db.findById(collection, addedRes.value);
+	if (!kept.status.ok() || kept.value["index"].as<int>() != 0 || !updated.status.ok() ||
+	    updated.value["index"].as<int>() != 10 || removed.status.ok() || !created.status.ok() ||
+	    created.value["index"].as<int>() != 3) {
+		ESP_LOGE(DB_TESTER_TAG, "incrementalSnapshotTest verification failed");
+		return;
+	}
+
+	ESP_LOGI(DB_TESTER_TAG, "Incremental snapshot test passed");
+}
+
+void DbTester::keyDictionarySharedFileTest() {
+	const std::string dir = "/keys_shared";
+	const std::string path = dir + "/" + KeyDictionary::kFileName;
+	(void)LittleFS.remove(path.c_str());
+	const char *keys[] = {"alpha", "beta", "gamma"};
+	JsonDbVector<uint8_t> plain[3];
+	for (size_t i = 0; i < 3; ++i) {
+		JsonDocument doc;
+		doc[keys[i]] = static_cast<int>(i);
+		plain[i].resize(measureMsgPack(doc));
+		serializeMsgPack(doc, plain[i].data(), plain[i].size());
+	}
+
+	// `second` appends a key behind the back of `first`, which must pick it
+	// up instead of handing out the same id again.
+	KeyDictionary first(LittleFS);
+	KeyDictionary second(LittleFS);
+	JsonDbVector<uint8_t> interned[3];
+	bool ok = first.intern(dir, plain[0].data(), plain[0].size(), interned[0]).ok() &&
+	          second.intern(dir, plain[1].data(), plain[1].size(), interned[1]).ok() &&
+	          first.intern(dir, plain[2].data(), plain[2].size(), interned[2]).ok();
+	KeyDictionary reader(LittleFS);
+	for (size_t i = 0; ok && i < 3; ++i) {
+		JsonDbVector<uint8_t> expanded;
+		ok = reader.expand(dir, interned[i].data(), interned[i].size(), expanded).ok() &&
+		     expanded == plain[i];
+	}
+	(void)LittleFS.remove(path.c_str());
+	(void)LittleFS.rmdir(dir.c_str());
+	if (!ok) {
+		ESP_LOGE(DB_TESTER_TAG, "keyDictionarySharedFileTest ids were reassigned");
+		return;
+	}
+
+	ESP_LOGI(DB_TESTER_TAG, "Key dictionary shared file test passed");
+}
+
+void DbTester::tombstoneLogTornAppendTest() {
+	const std::string dir = "/tombstone_torn";
+	const std::string path = dir + "/" + TombstoneLog::kFileName;
+	(void)LittleFS.remove(path.c_str());
+	TombstoneLog log(LittleFS);
+	JsonDbVector<Tombstone> first(1);
+	first[0].id.assign("65f0a1b2c3d4e5f601234567");
+	first[0].deletedAtMs = 1000;
+	auto firstStatus = log.append(dir, first);
+
+	// Leave a partial entry behind, as a power cut mid-append would
+	File torn = LittleFS.open(path.c_str(), FILE_APPEND);
+	const bool tornWritten = torn && torn.print("65f0a") == 5;
+	if (torn)
+		torn.close();
+
+	JsonDbVector<Tombstone> second(1);
+	second[0].id.assign("65f0a1b2c3d4e5f601234568");
+	second[0].deletedAtMs = 2000;
+	auto secondStatus = log.append(dir, second);
+	JsonDbVector<Tombstone> read;
+	auto readStatus = log.read(dir, 0, read);
+	File in = LittleFS.open(path.c_str(), FILE_READ);
+	const size_t fileSize = in ? in.size() : 0;
+	if (in)
+		in.close();
+	(void)LittleFS.remove(path.c_str());
+	(void)LittleFS.rmdir(dir.c_str());
+	if (!firstStatus.ok() || !tornWritten || !secondStatus.ok() || !readStatus.ok() ||
+	    read.size() != 2 || read[1].id != second[0].id || read[1].deletedAtMs != 2000 ||
+	    fileSize != 2 * TombstoneLog::kEntrySize) {
+		ESP_LOGE(DB_TESTER_TAG, "tombstoneLogTornAppendTest entries out of frame after append");
+		return;
+	}
+
+	ESP_LOGI(DB_TESTER_TAG, "Tombstone log torn append test passed");
+}
+
+void DbTester::snapshotBinaryRoundTripTest() {
+	auto dropStatus = db.dropAll();
+	if (!dropStatus.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "snapshotBinaryRoundTripTest dropAll failed: %s",
+		    dropStatus.message
+		);
+		return;
+	}
+
+	const std::string collection = "snapshot_binary";
+	std::vector<std::string> ids;
+	for (int i = 0; i < 3; ++i) {
+		JsonDocument doc;
+		doc["index"] = i;
+		doc["kind"] = "binary";
+		auto createRes = db.create(collection, doc.as<JsonObjectConst>());
+		if (!createRes.status.ok()) {
+			ESP_LOGE(
+			    DB_TESTER_TAG,
+			    "snapshotBinaryRoundTripTest create failed: %s",
+			    createRes.status.message
+			);
+			return;
+		}
+		ids.push_back(createRes.value);
+	}
+	(void)db.syncNow();
+	// Left unflushed on purpose: InMemoryConsistent must still export it.
+	(void)db.updateById(collection, ids[1], [](DocView &doc) { doc["kind"] = "updated"; });
+	auto before = db.findById(collection, ids[1]);
+	const uint32_t revisionBefore = before.status.ok() ? before.value.meta().revision : 0;
+
+	const char *snapshotPath = "/snapshot_binary.jdbs";
+	(void)LittleFS.remove(snapshotPath);
+	File out = LittleFS.open(snapshotPath, FILE_WRITE);
+	if (!out) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotBinaryRoundTripTest open write file failed");
+		return;
+	}
+	auto writeStatus =
+	    db.writeSnapshot(out, SnapshotMode::InMemoryConsistent, SnapshotFormat::Binary);
+	out.close();
+	if (!writeStatus.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "snapshotBinaryRoundTripTest writeSnapshot failed: %s",
+		    writeStatus.message
+		);
+		(void)LittleFS.remove(snapshotPath);
+		return;
+	}
+
+	File in = LittleFS.open(snapshotPath, FILE_READ);
+	char magic[4] = {};
+	const bool magicOk = in && in.readBytes(magic, sizeof(magic)) == sizeof(magic) &&
+	                     std::memcmp(magic, "JDBS", sizeof(magic)) == 0;
+	if (in)
+		in.close();
+	if (!magicOk) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotBinaryRoundTripTest header mismatch");
+		(void)LittleFS.remove(snapshotPath);
+		return;
+	}
+
+	(void)db.dropAll();
+	in = LittleFS.open(snapshotPath, FILE_READ);
+	auto restoreStatus = in ? db.restoreFromSnapshot(in)
+	                        : DbStatus{DbStatusCode::IoError, "open read file failed"};
+	if (in)
+		in.close();
+	(void)LittleFS.remove(snapshotPath);
+	if (!restoreStatus.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "snapshotBinaryRoundTripTest restoreFromSnapshot failed: %s",
+		    restoreStatus.message
+		);
+		return;
+	}
+
+	for (std::size_t i = 0; i < ids.size(); ++i) {
+		auto findRes = db.findById(collection, ids[i]);
+		const char *expectedKind = i == 1 ? "updated" : "binary";
+		if (!findRes.status.ok() || findRes.value["index"].as<int>() != static_cast<int>(i) ||
+		    findRes.value["kind"].as<std::string>() != expectedKind) {
+			ESP_LOGE(DB_TESTER_TAG, "snapshotBinaryRoundTripTest restore verification failed");
+			return;
+		}
+		if (i == 1 && findRes.value.meta().revision != revisionBefore) {
+			ESP_LOGE(DB_TESTER_TAG, "snapshotBinaryRoundTripTest revision not preserved");
+			return;
+		}
+	}
+
+	ESP_LOGI(DB_TESTER_TAG, "Snapshot binary roundtrip test passed");
+}
+
+void DbTester::snapshotReadAheadTest() {
+	const char *dbPath = "/test_read_ahead_db";
+	const uint8_t depths[] = {0, 4};
+	std::string exports[2][2];
+
+	for (size_t run = 0; run < 2; ++run) {
+		ESPJsonDB exportDb;
+		ESPJsonDBConfig cfg;
+		cfg.autosync = false;
+		cfg.snapshotReadAhead = depths[run];
+		if (!exportDb.init(dbPath, cfg).ok()) {
+			ESP_LOGE(DB_TESTER_TAG, "snapshotReadAheadTest init failed");
+			return;
+		}
+		if (run == 0) {
+			(void)exportDb.dropAll();
+			for (int c = 0; c < 3; ++c) {
+				const std::string name = "read_ahead_" + std::to_string(c);
+				for (int d = 0; d < 8; ++d) {
+					JsonDocument doc;
+					doc["collection"] = c;
+					doc["index"] = d;
+					doc["payload"] = "read-ahead-payload-read-ahead-payload";
+					if (!exportDb.create(name, doc.as<JsonObjectConst>()).status.ok()) {
+						ESP_LOGE(DB_TESTER_TAG, "snapshotReadAheadTest seed create failed");
+						exportDb.deinit();
+						return;
+					}
+				}
+			}
+			(void)exportDb.syncNow();
+		}
+
+		const SnapshotFormat formats[] = {SnapshotFormat::Json, SnapshotFormat::Binary};
+		for (size_t f = 0; f < 2; ++f) {
+			CaptureStream out;
+			auto st = exportDb.writeSnapshot(out, SnapshotMode::OnDiskOnly, formats[f]);
+			if (!st.ok() || out.bytes.empty()) {
+				ESP_LOGE(DB_TESTER_TAG, "snapshotReadAheadTest export failed: %s", st.message);
+				exportDb.deinit();
+				return;
+			}
+			exports[run][f] = out.bytes;
+		}
+
+		exportDb.deinit();
+	}
+
+	if (exports[0][0] != exports[1][0] || exports[0][1] != exports[1][1]) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotReadAheadTest read-ahead output differs");
+		return;
+	}
+
+	ESP_LOGI(DB_TESTER_TAG, "Snapshot read-ahead test passed");
+}
+
+void DbTester::snapshotChunkedExportTest() {
+	auto dropStatus = db.dropAll();
+	if (!dropStatus.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotChunkedExportTest dropAll failed: %s", dropStatus.message);
+		return;
+	}
+	const char *collections[] = {"chunk_b", "chunk_a"};
+	for (const char *collection : collections) {
+		for (int i = 0; i < 5; ++i) {
+			JsonDocument doc;
+			doc["index"] = i;
+			doc["payload"] = "chunked-export-payload";
+			if (!db.create(collection, doc.as<JsonObjectConst>()).status.ok()) {
+				ESP_LOGE(DB_TESTER_TAG, "snapshotChunkedExportTest create failed");
+				return;
+			}
+		}
+	}
+	(void)db.syncNow();
+
+	SnapshotChunkLimits limits;
+	limits.maxBytes = 256;
+	limits.maxDocuments = 2;
+	std::string token;
+	std::string joined;
+	int calls = 0;
+	do {
+		CaptureStream out;
+		auto chunk = db.writeSnapshotChunk(out, token, limits);
+		if (!chunk.status.ok() || out.bytes.size() > limits.maxBytes || ++calls > 64) {
+			ESP_LOGE(DB_TESTER_TAG, "snapshotChunkedExportTest chunk failed");
+			return;
+		}
+		joined += out.bytes;
+		token = chunk.value;
+	} while (!token.empty());
+
+	JsonDocument snapshot;
+	if (deserializeJson(snapshot, joined) || calls < 5) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotChunkedExportTest output is not one snapshot");
+		return;
+	}
+	JsonObject cols = snapshot["collections"].as<JsonObject>();
+	std::string previousName;
+	for (JsonPair col : cols) {
+		const std::string name = col.key().c_str();
+		JsonArray docs = col.value().as<JsonArray>();
+		std::string previousId;
+		for (JsonObject doc : docs) {
+			const std::string id = doc["_id"].as<std::string>();
+			if (id <= previousId) {
+				ESP_LOGE(DB_TESTER_TAG, "snapshotChunkedExportTest ids out of order");
+				return;
+			}
+			previousId = id;
+		}
+		if (name <= previousName || docs.size() != 5) {
+			ESP_LOGE(DB_TESTER_TAG, "snapshotChunkedExportTest collection mismatch");
+			return;
+		}
+		previousName = name;
+	}
+	if (cols.size() != 2) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotChunkedExportTest collection count mismatch");
+		return;
+	}
+
+	CaptureStream rejected;
+	auto badToken = db.writeSnapshotChunk(rejected, "not-a-token", limits);
+	if (badToken.status.code != DbStatusCode::InvalidArgument || !rejected.bytes.empty()) {
+		ESP_LOGE(DB_TESTER_TAG, "snapshotChunkedExportTest accepted a bad token");
+		return;
+	}
+
+	ESP_LOGI(DB_TESTER_TAG, "Snapshot chunked export test passed");
+}
+
 #if __has_include(<ESPJsonDBCompressor.h>)
 void DbTester::compressedSnapshotRoundTripTest() {
 	auto dropStatus = db.dropAll();
@@ -817,6 +1431,67 @@ void DbTester::compressedSnapshotCorruptionTest() {
 
 	ESP_LOGI(DB_TESTER_TAG, "Compressed snapshot corruption test passed");
 }
+
+void DbTester::compressedSnapshotStreamingTest() {
+	// Many times the 4 KiB pipe, so both tasks wrap it repeatedly.
+	constexpr int kDocs = 160;
+	auto dropStatus = db.dropAll();
+	if (!dropStatus.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "compressedSnapshotStreamingTest dropAll failed");
+		return;
+	}
+	const std::string filler(200, 'z');
+	for (int i = 0; i < kDocs; ++i) {
+		JsonDocument doc;
+		doc["index"] = i;
+		doc["filler"] = filler;
+		if (!db.create("compressed_stream", doc.as<JsonObjectConst>()).status.ok()) {
+			ESP_LOGE(DB_TESTER_TAG, "compressedSnapshotStreamingTest create failed");
+			return;
+		}
+	}
+
+	ESPCompressor compressor;
+	if (compressor.init() != CompressionError::Ok) {
+		ESP_LOGE(DB_TESTER_TAG, "compressedSnapshotStreamingTest compressor init failed");
+		return;
+	}
+	std::vector<uint8_t> compressed;
+	DynamicBufferSink sink(compressed);
+	const uint32_t writeStarted = millis();
+	auto writeStatus = db.writeCompressedSnapshot(compressor, sink);
+	const uint32_t writeMs = millis() - writeStarted;
+	if (!writeStatus.ok() || compressed.empty() || !db.dropAll().ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "compressedSnapshotStreamingTest export failed");
+		return;
+	}
+
+	BufferSource source(compressed.data(), compressed.size());
+	const uint32_t restoreStarted = millis();
+	auto restoreStatus = db.restoreCompressedSnapshot(compressor, source);
+	const uint32_t restoreMs = millis() - restoreStarted;
+	auto restored = db.findMany("compressed_stream", nullptr);
+	if (!restoreStatus.ok() || !restored.status.ok() || restored.value.size() != kDocs) {
+		ESP_LOGE(DB_TESTER_TAG, "compressedSnapshotStreamingTest restore failed");
+		return;
+	}
+	for (auto &view : restored.value) {
+		if (view["filler"].as<std::string>() != filler) {
+			ESP_LOGE(DB_TESTER_TAG, "compressedSnapshotStreamingTest restored content differs");
+			return;
+		}
+	}
+	(void)db.dropCollection("compressed_stream");
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "Compressed streaming: %d docs to %u bytes, export %u ms, restore %u ms",
+	    kDocs,
+	    static_cast<unsigned>(compressed.size()),
+	    static_cast<unsigned>(writeMs),
+	    static_cast<unsigned>(restoreMs)
+	);
+	ESP_LOGI(DB_TESTER_TAG, "Compressed snapshot streaming test passed");
+}
 #endif
 
 void DbTester::docCodecCompatibilityTest() {
@@ -825,7 +1500,9 @@ void DbTester::docCodecCompatibilityTest() {
 	header.createdAtMs = 123456789ULL;
 	header.updatedAtMs = 123456999ULL;
 	header.revision = 7;
-	header.flags = 0x002A;
+	// Bits the storage flags use in v3 records are plain user flags here.
+	header.flags = 0xE02A;
+	header.storageFlags = DocCodec::kInternedKeysFlag;
 
 	JsonDocument payloadDoc;
 	payloadDoc["kind"] = "codec";
@@ -854,8 +1531,37 @@ void DbTester::docCodecCompatibilityTest() {
 	auto decodeStatus =
 	    DocCodec::decodeRecord(encoded.data(), encoded.size(), decoded, decodedPayload, false);
 	if (!decodeStatus.ok() || decoded.flags != header.flags ||
-	    decoded.revision != header.revision || decodedPayload != payload) {
-		ESP_LOGE(DB_TESTER_TAG, "docCodecCompatibilityTest v2 decode verification failed");
+	    decoded.storageFlags != header.storageFlags || decoded.revision != header.revision || decodedPayload != payload) {
+		ESP_LOGE(DB_TESTER_TAG, "docCodecCompatibilityTest v3 decode verification failed");
+		return;
+	}
+
+	RecordHeader sliced{};
+	size_t payloadOffset = 0;
+	size_t slicedSize = 0;
+	auto sliceStatus = DocCodec::decodeRecordInPlace(
+	    encoded.data(),
+	    encoded.size(),
+	    sliced,
+	    payloadOffset,
+	    slicedSize
+	);
+	if (!sliceStatus.ok() || slicedSize != payload.size() || sliced.flags != header.flags ||
+	    std::memcmp(encoded.data() + payloadOffset, payload.data(), slicedSize) != 0) {
+		ESP_LOGE(DB_TESTER_TAG, "docCodecCompatibilityTest in-place decode failed");
+		return;
+	}
+
+	// The scatter-write envelope must frame the payload exactly as encodeRecord.
+	RecordHeader envelopeHeader = header;
+	envelopeHeader.payloadCrc32 = DocCodec::crc32(payload.data(), payload.size());
+	uint8_t head[DocCodec::kEncodedHeaderSize];
+	uint8_t trailer[DocCodec::kTrailerSize];
+	auto envelopeStatus = DocCodec::encodeEnvelope(envelopeHeader, payload.size(), head, trailer);
+	if (!envelopeStatus.ok() || encoded.size() != sizeof(head) + payload.size() + sizeof(trailer) ||
+	    std::memcmp(encoded.data(), head, sizeof(head)) != 0 ||
+	    std::memcmp(encoded.data() + sizeof(head) + payload.size(), trailer, sizeof(trailer)) != 0) {
+		ESP_LOGE(DB_TESTER_TAG, "docCodecCompatibilityTest envelope mismatch");
 		return;
 	}
 
@@ -864,7 +1570,8 @@ void DbTester::docCodecCompatibilityTest() {
 	JsonDbVector<uint8_t> legacyPayload{JsonDbAllocator<uint8_t>(false)};
 	auto legacyStatus =
 	    DocCodec::decodeRecord(legacy.data(), legacy.size(), legacyDecoded, legacyPayload, false);
-	if (!legacyStatus.ok() || legacyDecoded.flags != header.flags || legacyPayload != payload) {
+	if (!legacyStatus.ok() || legacyDecoded.flags != header.flags ||
+	    legacyDecoded.storageFlags != 0 || legacyPayload != payload) {
 		ESP_LOGE(DB_TESTER_TAG, "docCodecCompatibilityTest legacy decode failed");
 		return;
 	}
@@ -886,6 +1593,127 @@ void DbTester::docCodecCompatibilityTest() {
 	ESP_LOGI(DB_TESTER_TAG, "DocCodec compatibility test passed");
 }
 
+void DbTester::crc32BenchmarkTest() {
+	constexpr size_t kRecordBytes = 4096;
+	constexpr int kRounds = 64;
+	const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+	if (DocCodec::crc32(check, sizeof(check)) != 0xCBF43926u ||
+	    DocCodec::crc32Portable(check, sizeof(check)) != 0xCBF43926u) {
+		ESP_LOGE(DB_TESTER_TAG, "crc32BenchmarkTest check value mismatch");
+		return;
+	}
+
+	// The bit-at-a-time loop the table version replaced, as a baseline.
+	auto bitwise = [](const uint8_t *data, size_t size) {
+		uint32_t crc = 0xFFFFFFFFu;
+		for (size_t i = 0; i < size; ++i) {
+			crc ^= data[i];
+			for (uint8_t bit = 0; bit < 8; ++bit)
+				crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+		}
+		return ~crc;
+	};
+
+	std::vector<uint8_t> buffer(kRecordBytes);
+	for (size_t i = 0; i < buffer.size(); ++i)
+		buffer[i] = static_cast<uint8_t>(esp_random());
+	// Every length mod 8 and alignment takes the same result on all paths.
+	for (size_t offset = 0; offset < 8; ++offset) {
+		for (size_t len = 0; len < 64; ++len) {
+			const uint32_t expected = bitwise(buffer.data() + offset, len);
+			if (DocCodec::crc32(buffer.data() + offset, len) != expected ||
+			    DocCodec::crc32Portable(buffer.data() + offset, len) != expected) {
+				ESP_LOGE(
+				    DB_TESTER_TAG,
+				    "crc32BenchmarkTest mismatch at length %u",
+				    static_cast<unsigned>(len)
+				);
+				return;
+			}
+		}
+	}
+
+	volatile uint32_t sink = 0;
+	uint32_t startUs = micros();
+	for (int i = 0; i < kRounds; ++i)
+		sink = sink ^ bitwise(buffer.data(), buffer.size());
+	const uint32_t bitwiseUs = micros() - startUs;
+	startUs = micros();
+	for (int i = 0; i < kRounds; ++i)
+		sink = sink ^ DocCodec::crc32Portable(buffer.data(), buffer.size());
+	const uint32_t tableUs = micros() - startUs;
+	startUs = micros();
+	for (int i = 0; i < kRounds; ++i)
+		sink = sink ^ DocCodec::crc32(buffer.data(), buffer.size());
+	const uint32_t activeUs = micros() - startUs;
+	(void)sink;
+
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "CRC32 of %u x %u bytes: bitwise %u us, slicing-by-8 %u us, crc32() %u us (rom=%d)",
+	    static_cast<unsigned>(kRounds),
+	    static_cast<unsigned>(kRecordBytes),
+	    static_cast<unsigned>(bitwiseUs),
+	    static_cast<unsigned>(tableUs),
+	    static_cast<unsigned>(activeUs),
+	    ESP_JSONDB_CRC32_USE_ROM
+	);
+	ESP_LOGI(DB_TESTER_TAG, "CRC32 benchmark test passed");
+}
+
+void DbTester::docArenaTest() {
+	constexpr int kRounds = 200;
+	JsonDocument source;
+	source["deviceId"] = "sensor-node-01";
+	source["location"] = "greenhouse-north";
+	for (int i = 0; i < 8; ++i)
+		source["samples"][i] = 20.0 + i;
+	source["config"]["mode"] = "periodic";
+	std::vector<uint8_t> msgpack(measureMsgPack(source));
+	serializeMsgPack(source, msgpack.data(), msgpack.size());
+
+	// After the first document the arena has grown to fit; later ones must
+	// decode into the same chunks.
+	JsonDbDocArena arena;
+	size_t settledCapacity = 0;
+	bool ok = true;
+	uint32_t startUs = micros();
+	for (int i = 0; ok && i < kRounds; ++i) {
+		{
+			JsonDocument doc(&arena);
+			ok = !deserializeMsgPack(doc, msgpack.data(), msgpack.size()) &&
+			     doc["config"]["mode"].as<std::string>() == "periodic" &&
+			     doc["samples"][7].as<double>() == 27.0;
+		}
+		arena.reset();
+		if (i == 0)
+			settledCapacity = arena.capacity();
+		ok = ok && arena.capacity() == settledCapacity;
+	}
+	const uint32_t arenaUs = micros() - startUs;
+	startUs = micros();
+	for (int i = 0; ok && i < kRounds; ++i) {
+		JsonDocument doc;
+		ok = !deserializeMsgPack(doc, msgpack.data(), msgpack.size());
+	}
+	const uint32_t heapUs = micros() - startUs;
+	if (!ok || settledCapacity == 0) {
+		ESP_LOGE(DB_TESTER_TAG, "docArenaTest verification failed");
+		return;
+	}
+
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "%d decodes of %u bytes: heap %u us, arena %u us in %u bytes",
+	    kRounds,
+	    static_cast<unsigned>(msgpack.size()),
+	    static_cast<unsigned>(heapUs),
+	    static_cast<unsigned>(arenaUs),
+	    static_cast<unsigned>(settledCapacity)
+	);
+	ESP_LOGI(DB_TESTER_TAG, "Document arena test passed");
+}
+
 void DbTester::optimisticConflictTest() {
 	auto clearStatus = db.dropAll();
 	if (!clearStatus.ok()) {
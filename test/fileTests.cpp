@@ -12,6 +12,41 @@ JsonObjectConst findFileEntry(JsonArrayConst entries, const char *path) {
 	}
 	return JsonObjectConst();
 }
+
+struct StalledWriterCtx {
+	ESPJsonDB *db = nullptr;
+	std::atomic<bool> inPull{false};
+	std::atomic<bool> release{false};
+	std::atomic<bool> done{false};
+	DbStatus status{DbStatusCode::Ok, ""};
+	size_t offset = 0;
+	size_t size = 0;
+};
+
+void stalledWriterTask(void *arg) {
+	auto *ctx = static_cast<StalledWriterCtx *>(arg);
+	DbFileUploadPullCb pullCb =
+	    [ctx](size_t requested, uint8_t *buffer, size_t &produced, bool &eof) -> DbStatus {
+		if (!ctx->inPull.exchange(true)) {
+			const uint32_t started = millis();
+			while (!ctx->release.load() && (millis() - started) < 5000) {
+				delay(5);
+			}
+		}
+		const size_t remaining = ctx->size - ctx->offset;
+		produced = remaining < requested ? remaining : requested;
+		memset(buffer, 0xA5, produced);
+		ctx->offset += produced;
+		eof = (ctx->offset >= ctx->size);
+		return {DbStatusCode::Ok, ""};
+	};
+	ESPJsonDBFileOptions opts;
+	opts.overwrite = true;
+	opts.chunkSize = 256;
+	ctx->status = ctx->db->files().writeFileStream("locks/stalled.bin", pullCb, opts);
+	ctx->done.store(true);
+	vTaskDelete(nullptr);
+}
 } // namespace
 
 void DbTester::fileStorageTest() {
@@ -623,3 +658,70 @@ void DbTester::asyncFileUploadQueueOrderTest() {
 
 	ESP_LOGI(DB_TESTER_TAG, "Async upload queue order test passed");
 }
+
+void DbTester::fileStreamWriteLockIsolationTest() {
+	auto seed = db.files().writeTextFile("locks/reader.txt", "reader payload", true);
+	if (!seed.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "fs lock isolation seed write failed: %s", seed.message);
+		return;
+	}
+
+	StalledWriterCtx ctx;
+	ctx.db = &db;
+	ctx.size = 4096;
+	if (xTaskCreate(stalledWriterTask, "fsLockWriter", 6144, &ctx, 1, nullptr) != pdPASS) {
+		ESP_LOGE(DB_TESTER_TAG, "fs lock isolation writer task create failed");
+		return;
+	}
+	const uint32_t waitStarted = millis();
+	while (!ctx.inPull.load() && (millis() - waitStarted) < 2000) {
+		delay(5);
+	}
+
+	// The writer is parked inside its pull callback. Reads of other files and
+	// record flushes must not wait for it.
+	const uint32_t started = millis();
+	auto readBack = db.files().readTextFile("locks/reader.txt");
+	JsonDocument doc;
+	doc["value"] = 1;
+	auto created = db.create("fs_lock_docs", doc.as<JsonObjectConst>());
+	const DbStatus syncSt = created.status.ok() ? db.syncNow() : created.status;
+	const uint32_t elapsed = millis() - started;
+	ctx.release.store(true);
+
+	const uint32_t doneStarted = millis();
+	while (!ctx.done.load() && (millis() - doneStarted) < 5000) {
+		delay(5);
+	}
+
+	if (!ctx.done.load() || !ctx.status.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "fs lock isolation stalled writer failed");
+		return;
+	}
+	if (!readBack.status.ok() || readBack.value != "reader payload" || !syncSt.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "fs lock isolation reader path failed");
+		return;
+	}
+	if (elapsed > 1000) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "fs lock isolation: reader waited %u ms on writer",
+		    static_cast<unsigned>(elapsed)
+		);
+		return;
+	}
+	auto size = db.files().fileSize("locks/stalled.bin");
+	if (!size.status.ok() || size.value != ctx.size) {
+		ESP_LOGE(DB_TESTER_TAG, "fs lock isolation stalled payload size mismatch");
+		return;
+	}
+	(void)db.files().removeFile("locks/reader.txt");
+	(void)db.files().removeFile("locks/stalled.bin");
+	(void)db.dropCollection("fs_lock_docs");
+	(void)db.syncNow();
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "File stream write lock isolation test passed (reader path %u ms)",
+	    static_cast<unsigned>(elapsed)
+	);
+}
@@ -330,3 +330,103 @@ void DbTester::psramMemoryBenchmarkTest() {
 	ESP_LOGI(DB_TESTER_TAG, "PSRAM memory benchmark test passed");
 #endif
 }
+
+void DbTester::memoryTieringTest() {
+	constexpr int kDocs = 32;
+	constexpr int kHotDocs = 4;
+	ESPJsonDBConfig cfg;
+	cfg.autosync = false;
+	CollectionConfig tierCfg;
+	tierCfg.loadPolicy = CollectionLoadPolicy::Lazy;
+	tierCfg.hotTierBytes = 512;
+	ESPJsonDB tierDb;
+	if (!tierDb.init("/test_tier_db", cfg).ok() || !tierDb.dropAll().ok() ||
+	    !tierDb.configureCollection("tiered", tierCfg).ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "memoryTieringTest init failed");
+		tierDb.deinit();
+		return;
+	}
+
+	std::vector<std::string> ids;
+	bool ok = true;
+	for (int i = 0; ok && i < kDocs; ++i) {
+		JsonDocument doc;
+		doc["slot"] = i;
+		doc["payload"] = "tttttttttttttttttttttttttttttttttttttttt";
+		auto created = tierDb.create("tiered", doc);
+		ok = created.status.ok();
+		ids.push_back(created.value);
+	}
+	ok = ok && tierDb.syncNow().ok();
+	auto col = tierDb.collection("tiered");
+	ok = ok && col.status.ok();
+
+	auto tierStats = [&]() {
+		JsonDocument diag = tierDb.getDiagnostics();
+		JsonDocument stats;
+		stats.set(diag["memoryTiers"]["tiered"]);
+		return stats;
+	};
+	auto touch = [&](int first, int count) {
+		for (int i = first; ok && i < first + count; ++i)
+			ok = tierDb.findById("tiered", ids[i]).status.ok();
+	};
+
+	// Tier bytes are counted where buffers really are, so without PSRAM
+	// everything stays hot and nothing moves.
+#if ESP_JSONDB_HAS_HEAP_CAPS
+	const bool hasPsram = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+#else
+	const bool hasPsram = false;
+#endif
+
+	// Only the recently read records fit the hot budget.
+	touch(0, kHotDocs);
+	if (ok)
+		col.value->rebalanceTiers();
+	JsonDocument demoted = tierStats();
+	if (hasPsram) {
+		ok = ok && demoted["hotBytes"].as<uint32_t>() <= tierCfg.hotTierBytes &&
+		     demoted["hotRecords"].as<uint32_t>() >= kHotDocs &&
+		     demoted["coldRecords"].as<uint32_t>() > 0 &&
+		     demoted["demotions"].as<uint32_t>() > 0;
+	} else {
+		ok = ok && demoted["coldRecords"].as<uint32_t>() == 0 &&
+		     demoted["demotions"].as<uint32_t>() == 0;
+	}
+
+	// Reading cold records brings them back.
+	touch(kHotDocs, kHotDocs);
+	if (ok)
+		col.value->rebalanceTiers();
+	JsonDocument promoted = tierStats();
+	ok = ok && (!hasPsram || promoted["promotions"].as<uint32_t>() >= kHotDocs);
+
+	// A cold cap evicts clean PSRAM records; they load again from flash.
+	tierCfg.coldTierBytes = 256;
+	ok = ok && tierDb.configureCollection("tiered", tierCfg).ok();
+	JsonDocument capped = tierStats();
+	ok = ok && capped["coldBytes"].as<uint32_t>() <= tierCfg.coldTierBytes &&
+	     (!hasPsram || capped["evictions"].as<uint32_t>() > 0);
+	for (int i = 0; ok && i < kDocs; ++i) {
+		auto found = tierDb.findById("tiered", ids[i]);
+		ok = found.status.ok() && found.value["slot"].as<int>() == i;
+	}
+	(void)tierDb.dropAll();
+	tierDb.deinit();
+	if (!ok) {
+		ESP_LOGE(DB_TESTER_TAG, "memoryTieringTest verification failed");
+		return;
+	}
+
+	ESP_LOGI(
+	    DB_TESTER_TAG,
+	    "%d records, %u hot bytes: %u demotions, %u promotions, %u evictions over the cold cap",
+	    kDocs,
+	    static_cast<unsigned>(tierCfg.hotTierBytes),
+	    capped["demotions"].as<unsigned>(),
+	    capped["promotions"].as<unsigned>(),
+	    capped["evictions"].as<unsigned>()
+	);
+	ESP_LOGI(DB_TESTER_TAG, "Memory tiering test passed");
+}
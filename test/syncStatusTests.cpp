@@ -270,3 +270,132 @@ void DbTester::syncStatusPeriodicExclusionTest() {
 
 	ESP_LOGI(DB_TESTER_TAG, "Sync status periodic exclusion test passed");
 }
+
+void DbTester::syncDeadlineWakeupTest() {
+	db.deinit();
+	ESPJsonDBConfig cfg;
+	cfg.autosync = true;
+	cfg.intervalMs = 100;
+	auto initStatus = db.init("/test_db", cfg);
+	if (!initStatus.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "re-init failed for sync deadline wakeup test: %s",
+		    initStatus.message
+		);
+		return;
+	}
+
+	JsonDocument doc;
+	doc["kind"] = "wakeup";
+	auto createRes = db.create("sync_wakeup", doc.as<JsonObjectConst>());
+	if (!createRes.status.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "sync deadline wakeup seed create failed: %s",
+		    createRes.status.message
+		);
+		return;
+	}
+
+	// No syncNow(): the write itself must wake the idle sync task, which then
+	// flushes once the interval deadline passes.
+	delay(400);
+	db.deinit();
+
+	cfg.autosync = false;
+	initStatus = db.init("/test_db", cfg);
+	if (!initStatus.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "re-init failed while verifying sync deadline wakeup: %s",
+		    initStatus.message
+		);
+		return;
+	}
+
+	auto found = db.findById("sync_wakeup", createRes.value);
+	if (!found.status.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "write was not flushed by the deadline wakeup: %s",
+		    found.status.message
+		);
+		return;
+	}
+
+	const uint32_t startMs = millis();
+	auto syncStatus = db.syncNow();
+	const uint32_t elapsedMs = millis() - startMs;
+	if (!syncStatus.ok()) {
+		ESP_LOGE(DB_TESTER_TAG, "idle syncNow() failed: %s", syncStatus.message);
+		return;
+	}
+	if (elapsedMs > 1000) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "idle syncNow() took too long to complete: %u ms",
+		    static_cast<unsigned>(elapsedMs)
+		);
+		return;
+	}
+
+	ESP_LOGI(DB_TESTER_TAG, "Sync deadline wakeup test passed");
+}
+
+void DbTester::autosyncHighWaterFlushTest() {
+	db.deinit();
+	ESPJsonDBConfig cfg;
+	cfg.autosync = true;
+	cfg.intervalMs = 60000;
+	cfg.maxIntervalMs = 120000;
+	cfg.dirtyBytesHighWater = 256;
+	auto initStatus = db.init("/test_db", cfg);
+	if (!initStatus.ok()) {
+		ESP_LOGE(
+		    DB_TESTER_TAG,
+		    "re-init failed for autosync high-water test: %s",
+		    initStatus.message
+		);
+		return;
+	}
+
+	for (int i = 0; i < 8; ++i) {
+		JsonDocument doc;
+		doc["kind"] = "high_water";
+		doc["index"] = i;
+		doc["padding"] = "0123456789abcdef0123456789abcdef0123456789abcdef";
+		auto createRes = db.create("sync_high_water", doc.as<JsonObjectConst>());
+		if (!createRes.status.ok()) {
+			ESP_LOGE(
+			    DB_TESTER_TAG,
+			    "autosync high-water seed create failed: %s",
+			    createRes.status.message
+			);
+			return;
+		}
+	}
+
+	// The interval is a minute away; only the high-water mark can flush this.
+	delay(300);
+	JsonDocument diag = db.getDiagnostics();
+	JsonObjectConst autosync = diag["autosync"].as<JsonObjectConst>();
+	if (autosync.isNull()) {
+		ESP_LOGE(DB_TESTER_TAG, "diagnostics missing autosync policy state");
+		return;
+	}
+	if ((autosync["highWaterPasses"] | 0u) < 1u) {
+		ESP_LOGE(DB_TESTER_TAG, "autosync did not flush early at the dirty-bytes high-water mark");
+		return;
+	}
+	if ((autosync["pendingDirtyBytes"] | 0u) >= cfg.dirtyBytesHighWater) {
+		ESP_LOGE(DB_TESTER_TAG, "autosync left dirty bytes above the high-water mark");
+		return;
+	}
+	if ((autosync["currentIntervalMs"] | 0u) != cfg.intervalMs) {
+		ESP_LOGE(DB_TESTER_TAG, "high-water flush should reset the autosync period to intervalMs");
+		return;
+	}
+
+	ESP_LOGI(DB_TESTER_TAG, "Autosync high-water flush test passed");
+}